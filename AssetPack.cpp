@@ -0,0 +1,326 @@
+#include "AssetPack.hpp"
+#include "read_write_chunk.hpp"
+#include "data_path.hpp"
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <climits>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <streambuf>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+//------------ streams ------------
+
+namespace {
+
+//reads straight out of memory (e.g., the mapped pack):
+struct MemoryBuf : std::streambuf {
+	MemoryBuf(char const *begin, uint64_t size) {
+		char *p = const_cast< char * >(begin); //(the get area is never written through)
+		setg(p, p, p + size);
+	}
+	pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) override {
+		if (!(which & std::ios_base::in)) return pos_type(off_type(-1));
+		char *at = (dir == std::ios_base::beg ? eback() : dir == std::ios_base::end ? egptr() : gptr()) + off;
+		if (at < eback() || at > egptr()) return pos_type(off_type(-1));
+		setg(eback(), at, egptr());
+		return pos_type(off_type(at - eback()));
+	}
+	pos_type seekpos(pos_type pos, std::ios_base::openmode which) override {
+		return seekoff(off_type(pos), std::ios_base::beg, which);
+	}
+};
+
+//inflates deflate-compressed memory as it is read:
+// large reads (e.g., read_chunk's) inflate directly into the caller's buffer; the small buffer is only for peek()/get()
+struct InflateBuf : std::streambuf {
+	InflateBuf(char const *begin, uint64_t size) {
+		z.next_in = reinterpret_cast< Bytef * >(const_cast< char * >(begin));
+		in_left = size;
+		if (inflateInit(&z) != Z_OK) done = true;
+	}
+	~InflateBuf() {
+		inflateEnd(&z);
+	}
+	int_type underflow() override {
+		if (gptr() < egptr()) return traits_type::to_int_type(*gptr());
+		uint64_t got = inflate_into(buffer, sizeof(buffer));
+		if (got == 0) return traits_type::eof();
+		setg(buffer, buffer, buffer + got);
+		return traits_type::to_int_type(buffer[0]);
+	}
+	std::streamsize xsgetn(char *to, std::streamsize count) override {
+		std::streamsize total = std::min< std::streamsize >(count, egptr() - gptr());
+		std::copy(gptr(), gptr() + total, to);
+		gbump(int(total));
+		while (total < count) {
+			uint64_t got = inflate_into(to + total, uint64_t(count - total));
+			if (got == 0) break;
+			total += std::streamsize(got);
+		}
+		return total;
+	}
+
+	//returns the number of bytes produced (0 at the end of the data, or if it is corrupt):
+	uint64_t inflate_into(char *to, uint64_t count) {
+		uint64_t produced = 0;
+		while (!done && produced < count) {
+			if (z.avail_in == 0) {
+				z.avail_in = uInt(std::min< uint64_t >(in_left, UINT_MAX));
+				in_left -= z.avail_in;
+			}
+			z.next_out = reinterpret_cast< Bytef * >(to + produced);
+			z.avail_out = uInt(std::min< uint64_t >(count - produced, UINT_MAX));
+			uInt before = z.avail_out;
+			int ret = inflate(&z, Z_NO_FLUSH);
+			produced += before - z.avail_out;
+			if (ret == Z_STREAM_END) {
+				done = true;
+			} else if (ret != Z_OK) {
+				std::cerr << "WARNING: compressed asset is corrupt (" << (z.msg ? z.msg : "zlib error " + std::to_string(ret)) << ")." << std::endl;
+				done = true;
+			}
+		}
+		return produced;
+	}
+
+	z_stream z{};
+	uint64_t in_left = 0; //compressed bytes not yet handed to zlib
+	bool done = false;
+	char buffer[4096];
+};
+
+//an istream that owns its streambuf:
+template< typename Buf >
+struct BufStream : std::istream {
+	template< typename... Args >
+	BufStream(Args &&... args) : std::istream(nullptr), buf(std::forward< Args >(args)...) {
+		rdbuf(&buf); //(also clears the bad bit from constructing with no buffer)
+	}
+	Buf buf;
+};
+
+}
+
+//------------ reading ------------
+
+AssetPack::AssetPack(std::string const &filename_) : filename(filename_) {
+	//map the file:
+	#if defined(_WIN32)
+	HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE) throw std::runtime_error("Failed to open asset pack '" + filename + "'.");
+	file_handle = file;
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size)) {
+		CloseHandle(file);
+		throw std::runtime_error("Failed to get size of asset pack '" + filename + "'.");
+	}
+	data_size = uint64_t(size.QuadPart);
+	if (data_size > 0) {
+		mapping_handle = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (mapping_handle) data = reinterpret_cast< char const * >(MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0));
+		if (!data) {
+			if (mapping_handle) CloseHandle(mapping_handle);
+			CloseHandle(file);
+			throw std::runtime_error("Failed to map asset pack '" + filename + "'.");
+		}
+	}
+	#else
+	int fd = ::open(filename.c_str(), O_RDONLY);
+	if (fd < 0) throw std::runtime_error("Failed to open asset pack '" + filename + "'.");
+	struct stat info;
+	if (fstat(fd, &info) != 0) {
+		::close(fd);
+		throw std::runtime_error("Failed to get size of asset pack '" + filename + "'.");
+	}
+	data_size = uint64_t(info.st_size);
+	if (data_size > 0) {
+		void *mapped = mmap(nullptr, data_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (mapped == MAP_FAILED) {
+			::close(fd);
+			throw std::runtime_error("Failed to map asset pack '" + filename + "'.");
+		}
+		data = reinterpret_cast< char const * >(mapped);
+	}
+	::close(fd); //(the mapping stays valid)
+	#endif
+
+	//read the table of contents:
+	try {
+		BufStream< MemoryBuf > from(data, data_size);
+		read_chunk(from, "pak0", &entries);
+		read_chunk(from, "str0", &names);
+		for (auto const &entry : entries) {
+			if (!(entry.name_begin <= entry.name_end && entry.name_end <= names.size())) {
+				throw std::runtime_error("entry has out-of-range name begin/end");
+			}
+			if (!(entry.offset <= data_size && entry.size <= data_size - entry.offset)) {
+				throw std::runtime_error("entry has out-of-range data");
+			}
+			if (!(entry.codec == Stored || entry.codec == Deflate)) {
+				throw std::runtime_error("entry has unknown codec " + std::to_string(entry.codec));
+			}
+			if (entry.codec == Stored && entry.size != entry.raw_size) {
+				throw std::runtime_error("stored entry has mismatched sizes");
+			}
+		}
+		if (!std::is_sorted(entries.begin(), entries.end(), [](Entry const &a, Entry const &b) { return a.hash < b.hash; })) {
+			throw std::runtime_error("table of contents isn't sorted");
+		}
+	} catch (std::exception &e) {
+		unmap(); //(the destructor doesn't run when a constructor throws)
+		throw std::runtime_error("Asset pack '" + filename + "' is invalid: " + e.what());
+	}
+}
+
+AssetPack::~AssetPack() {
+	unmap();
+}
+
+void AssetPack::unmap() {
+	#if defined(_WIN32)
+	if (data) UnmapViewOfFile(data);
+	if (mapping_handle) CloseHandle(mapping_handle);
+	if (file_handle) CloseHandle(file_handle);
+	mapping_handle = nullptr;
+	file_handle = nullptr;
+	#else
+	if (data) munmap(const_cast< char * >(data), data_size);
+	#endif
+	data = nullptr;
+	data_size = 0;
+}
+
+uint64_t AssetPack::hash_name(std::string const &name) {
+	//FNV-1a:
+	uint64_t hash = 14695981039346656037ULL;
+	for (char c : name) {
+		hash = (hash ^ uint8_t(c)) * 1099511628211ULL;
+	}
+	return hash;
+}
+
+AssetPack::Entry const *AssetPack::find(std::string const &name) const {
+	uint64_t hash = hash_name(name);
+	auto at = std::lower_bound(entries.begin(), entries.end(), hash, [](Entry const &e, uint64_t h) { return e.hash < h; });
+	for (; at != entries.end() && at->hash == hash; ++at) {
+		//(hashes can collide, so check the name too)
+		if (name.compare(0, std::string::npos, names.data() + at->name_begin, at->name_end - at->name_begin) == 0) return &*at;
+	}
+	return nullptr;
+}
+
+bool AssetPack::contains(std::string const &name) const {
+	return find(name) != nullptr;
+}
+
+std::unique_ptr< std::istream > AssetPack::open(std::string const &name) const {
+	Entry const *entry = find(name);
+	if (!entry) throw std::runtime_error("Asset pack '" + filename + "' has no entry '" + name + "'.");
+	if (entry->codec == Deflate) {
+		return std::make_unique< BufStream< InflateBuf > >(data + entry->offset, entry->size);
+	} else {
+		return std::make_unique< BufStream< MemoryBuf > >(data + entry->offset, entry->size);
+	}
+}
+
+//------------ writing ------------
+
+void AssetPack::write(std::string const &filename, std::string const &base, std::vector< std::string > const &paths) {
+	std::vector< Entry > entries;
+	std::vector< char > names;
+	std::vector< std::vector< char > > contents;
+
+	for (auto const &name : paths) {
+		std::ifstream file(base + name, std::ios::binary);
+		if (!file) throw std::runtime_error("Failed to open '" + base + name + "'.");
+		std::vector< char > raw((std::istreambuf_iterator< char >(file)), std::istreambuf_iterator< char >());
+
+		Entry entry;
+		entry.hash = hash_name(name);
+		entry.raw_size = raw.size();
+		entry.name_begin = uint32_t(names.size());
+		names.insert(names.end(), name.begin(), name.end());
+		entry.name_end = uint32_t(names.size());
+
+		//compress (if it helps enough to be worth inflating later):
+		uLongf compressed_size = compressBound(uLong(raw.size()));
+		std::vector< char > compressed(compressed_size);
+		int ret = compress2(reinterpret_cast< Bytef * >(compressed.data()), &compressed_size,
+			reinterpret_cast< Bytef const * >(raw.data()), uLong(raw.size()), Z_BEST_COMPRESSION);
+		if (ret == Z_OK && compressed_size <= (1.0f - MinSavings) * raw.size()) {
+			compressed.resize(compressed_size);
+			entry.codec = Deflate;
+			entry.size = compressed.size();
+			contents.emplace_back(std::move(compressed));
+		} else {
+			entry.codec = Stored;
+			entry.size = raw.size();
+			contents.emplace_back(std::move(raw));
+		}
+		entries.emplace_back(entry);
+	}
+
+	//lay out data after the table of contents (and its chunk headers):
+	auto align = [](uint64_t offset) { return (offset + DataAlignment - 1) / DataAlignment * DataAlignment; };
+	uint64_t offset = align(8 + entries.size() * sizeof(Entry) + 8 + names.size());
+	for (auto &entry : entries) {
+		entry.offset = offset;
+		offset = align(offset + entry.size);
+	}
+
+	//sort the table by hash, but write the data in the order given:
+	std::vector< Entry > toc = entries;
+	std::sort(toc.begin(), toc.end(), [](Entry const &a, Entry const &b) { return a.hash < b.hash; });
+	for (uint32_t i = 1; i < toc.size(); ++i) {
+		if (toc[i].hash == toc[i-1].hash
+		 && std::equal(names.begin() + toc[i].name_begin, names.begin() + toc[i].name_end,
+		               names.begin() + toc[i-1].name_begin, names.begin() + toc[i-1].name_end)) {
+			throw std::runtime_error("Asset '" + std::string(names.begin() + toc[i].name_begin, names.begin() + toc[i].name_end) + "' is listed twice.");
+		}
+	}
+
+	std::ofstream out(filename, std::ios::binary);
+	write_chunk("pak0", toc, &out);
+	write_chunk("str0", names, &out);
+	uint64_t at = 8 + toc.size() * sizeof(Entry) + 8 + names.size();
+	static char const zeros[DataAlignment] = {};
+	for (uint32_t i = 0; i < entries.size(); ++i) {
+		uint64_t target = entries[i].offset;
+		out.write(zeros, std::streamsize(target - at));
+		out.write(contents[i].data(), std::streamsize(contents[i].size()));
+		at = target + contents[i].size();
+	}
+	if (!out) throw std::runtime_error("Failed to write asset pack '" + filename + "'.");
+}
+
+//------------ shipped pack ------------
+
+std::unique_ptr< std::istream > open_asset(std::string const &name) {
+	//the shipped pack (if there is one) is mapped on first use and kept for the rest of the program:
+	static std::unique_ptr< AssetPack > const pack = []() -> std::unique_ptr< AssetPack > {
+		std::string filename = data_path("assets.pack");
+		if (!std::ifstream(filename, std::ios::binary)) return nullptr;
+		return std::make_unique< AssetPack >(filename);
+	}();
+
+	if (pack && pack->contains(name)) return pack->open(name);
+
+	std::string filename = data_path(name);
+	auto file = std::make_unique< std::ifstream >(filename, std::ios::binary);
+	if (!*file) throw std::runtime_error("Failed to open asset '" + name + "' (not in a pack, and no file '" + filename + "').");
+	return file;
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+/*
+ * An AssetPack is a single file holding many assets (e.g., every level's .pnci and .scene),
+ *  so a distribution needs fewer files and loading needs fewer file opens.
+ *
+ * The pack is memory-mapped; entries are looked up by name (hashed) in a table of contents
+ *  and read through std::istream, so anything built on read_chunk can load from it:
+ *
+ *  AssetPack pack(data_path("assets.pack"));
+ *  std::unique_ptr< std::istream > from = pack.open("levels/lvl0.scene");
+ *  read_chunk(*from, "str0", &names);
+ *
+ * Entries are either stored (read straight out of the mapping) or deflate-compressed
+ *  (inflated as they are read, directly into the reader's buffer).
+ *
+ * File layout (chunks as in read_write_chunk.hpp):
+ *  "pak0" -- table of contents (Entry structures, sorted by hash)
+ *  "str0" -- entry names
+ *  (padding to a multiple of DataAlignment)
+ *  entry data, each entry starting at a multiple of DataAlignment
+ *
+ * Most code should use open_asset(), which reads from the shipped pack when there is one
+ *  and falls back to loose files otherwise.
+ */
+
+#include <cstdint>
+#include <istream>
+#include <memory>
+#include <string>
+#include <vector>
+
+struct AssetPack {
+	//map a pack file:
+	// note: will throw if the file can't be opened or isn't a pack
+	AssetPack(std::string const &filename);
+	~AssetPack();
+
+	//is there an entry with this name?
+	bool contains(std::string const &name) const;
+
+	//stream an entry's contents (uncompressing if needed):
+	// note: will throw if the entry doesn't exist; the stream reads from the pack's mapping, so the pack must outlive it
+	std::unique_ptr< std::istream > open(std::string const &name) const;
+
+	//write a pack holding the given files ('names' are the names in the pack; they are read from 'base' + name):
+	// entries are compressed when that saves at least 'MinSavings' of their size
+	static void write(std::string const &filename, std::string const &base, std::vector< std::string > const &names);
+
+	static constexpr uint32_t DataAlignment = 16;
+	static constexpr float MinSavings = 0.1f;
+
+	//-- internals --
+	enum Codec : uint32_t {
+		Stored = 0,
+		Deflate = 1,
+	};
+	struct Entry {
+		uint64_t hash; //(of the name; see hash_name)
+		uint64_t offset; //of the data, from the start of the file
+		uint64_t size; //of the data, as stored
+		uint64_t raw_size; //of the data, once uncompressed
+		uint32_t codec;
+		uint32_t name_begin, name_end; //in the "str0" chunk
+		uint32_t padding = 0;
+	};
+	static_assert(sizeof(Entry) == 48, "Entry is packed.");
+
+	static uint64_t hash_name(std::string const &name);
+	Entry const *find(std::string const &name) const;
+	void unmap();
+
+	std::string filename;
+	std::vector< Entry > entries;
+	std::vector< char > names;
+
+	//the mapped file:
+	char const *data = nullptr;
+	uint64_t data_size = 0;
+	#ifdef _WIN32
+	void *file_handle = nullptr;
+	void *mapping_handle = nullptr;
+	#endif
+
+	AssetPack(AssetPack const &) = delete;
+	AssetPack &operator=(AssetPack const &) = delete;
+};
+
+//open an asset by name (relative to the data path, e.g., "levels/lvl0.scene"):
+// reads from data_path("assets.pack") if that pack exists and has the asset, otherwise from data_path(name)
+// note: will throw if the asset can't be found
+std::unique_ptr< std::istream > open_asset(std::string const &name);
@@ -0,0 +1,161 @@
+#include "Attraction.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+//build parameters:
+static constexpr uint32_t LeafSources = 4; //nodes with this many sources or fewer aren't split
+static constexpr uint32_t MaxDepth = 20; //(coincident sources would otherwise split forever)
+static constexpr uint32_t StackSize = 7 * MaxDepth + 8; //deepest possible traversal stack
+
+//add the pull of a (possibly lumped-together) source at 'from' on a point at 'at':
+static void add_pull(glm::vec3 const &at, glm::vec3 const &from, float strength, float min_pull, glm::vec3 *total) {
+	glm::vec3 to = from - at;
+	float distance = glm::length(to);
+	if (distance == 0.0f) return; //(no direction to pull in)
+	float pull = strength / glm::max(distance, Attraction::MinDistance);
+	if (pull < min_pull) return;
+	*total += to * (pull / distance);
+}
+
+void Attraction::build(Source const *sources_, uint32_t count) {
+	assert(sources_ || count == 0);
+	sources.assign(sources_, sources_ + count);
+	source_indices.resize(count);
+	for (uint32_t i = 0; i < count; ++i) source_indices[i] = i;
+	nodes.clear();
+	if (count == 0) return;
+
+	//root cube encloses every source:
+	glm::vec3 min = sources[0].position, max = sources[0].position;
+	for (auto const &source : sources) {
+		min = glm::min(min, source.position);
+		max = glm::max(max, source.position);
+	}
+	glm::vec3 size = max - min;
+	nodes.emplace_back();
+	nodes[0].center = 0.5f * (min + max);
+	nodes[0].half = 0.5f * glm::max(size.x, glm::max(size.y, size.z));
+	build_node(0, 0, count, 0);
+}
+
+void Attraction::build_node(uint32_t index, uint32_t begin, uint32_t end, uint32_t depth) {
+	//gather totals:
+	float strength = 0.0f;
+	glm::vec3 weighted = glm::vec3(0.0f);
+	for (uint32_t i = begin; i < end; ++i) {
+		strength += sources[i].strength;
+		weighted += sources[i].strength * sources[i].position;
+	}
+	{
+		Node &node = nodes[index];
+		node.strength = strength;
+		node.focus = (strength > 0.0f ? weighted / strength : node.center);
+		if (end - begin <= LeafSources || depth >= MaxDepth) {
+			node.leaf = true;
+			node.first = begin;
+			node.count = end - begin;
+			return;
+		}
+	}
+
+	//sort sources into octants (bit 0: +x, bit 1: +y, bit 2: +z) by partitioning on each axis in turn:
+	glm::vec3 center = nodes[index].center;
+	float half = nodes[index].half;
+	auto octant_of = [&](uint32_t i) {
+		glm::vec3 const &p = sources[i].position;
+		return (p.x >= center.x ? 1u : 0u) | (p.y >= center.y ? 2u : 0u) | (p.z >= center.z ? 4u : 0u);
+	};
+	uint32_t counts[8] = {};
+	for (uint32_t i = begin; i < end; ++i) counts[octant_of(i)] += 1;
+	uint32_t starts[8];
+	for (uint32_t o = 0, at = begin; o < 8; ++o) {
+		starts[o] = at;
+		at += counts[o];
+	}
+	{ //in-place counting sort (cycle each source into its octant's next slot):
+		uint32_t next[8];
+		std::copy(starts, starts + 8, next);
+		for (uint32_t o = 0; o < 8; ++o) {
+			uint32_t stop = starts[o] + counts[o];
+			while (next[o] < stop) {
+				uint32_t i = next[o];
+				uint32_t target = octant_of(i);
+				if (target == o) {
+					next[o] += 1;
+				} else {
+					std::swap(sources[i], sources[next[target]]);
+					std::swap(source_indices[i], source_indices[next[target]]);
+					next[target] += 1;
+				}
+			}
+		}
+	}
+
+	//children for non-empty octants, stored contiguously:
+	uint32_t first = uint32_t(nodes.size());
+	uint32_t child_count = 0;
+	for (uint32_t o = 0; o < 8; ++o) {
+		if (counts[o] == 0) continue;
+		nodes.emplace_back();
+		Node &child = nodes.back();
+		child.half = 0.5f * half;
+		child.center = center + child.half * glm::vec3(
+			(o & 1u) ? 1.0f : -1.0f,
+			(o & 2u) ? 1.0f : -1.0f,
+			(o & 4u) ? 1.0f : -1.0f
+		);
+		++child_count;
+	}
+	nodes[index].leaf = false;
+	nodes[index].first = first;
+	nodes[index].count = child_count;
+
+	for (uint32_t o = 0, child = first; o < 8; ++o) {
+		if (counts[o] == 0) continue;
+		build_node(child, starts[o], starts[o] + counts[o], depth + 1);
+		++child;
+	}
+}
+
+glm::vec3 Attraction::pull(glm::vec3 const &at, float min_pull, uint32_t ignore) const {
+	if (exact || nodes.empty()) return pull_exact(at, min_pull, ignore);
+
+	glm::vec3 total = glm::vec3(0.0f);
+	uint32_t stack[StackSize];
+	uint32_t top = 0;
+	stack[top++] = 0;
+	while (top > 0) {
+		Node const &node = nodes[stack[--top]];
+		if (node.leaf) {
+			for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+				if (source_indices[i] == ignore) continue;
+				add_pull(at, sources[i].position, sources[i].strength, min_pull, &total);
+			}
+			continue;
+		}
+
+		//far enough away (and not containing 'at', so never containing the ignored source)? lump it together:
+		glm::vec3 offset = glm::abs(at - node.center);
+		bool outside = offset.x > node.half || offset.y > node.half || offset.z > node.half;
+		if (outside && 2.0f * node.half < theta * glm::distance(at, node.focus)) {
+			add_pull(at, node.focus, node.strength, min_pull, &total);
+			continue;
+		}
+
+		for (uint32_t c = node.first; c < node.first + node.count; ++c) {
+			assert(top < StackSize);
+			stack[top++] = c;
+		}
+	}
+	return total;
+}
+
+glm::vec3 Attraction::pull_exact(glm::vec3 const &at, float min_pull, uint32_t ignore) const {
+	glm::vec3 total = glm::vec3(0.0f);
+	for (uint32_t i = 0; i < uint32_t(sources.size()); ++i) {
+		if (source_indices[i] == ignore) continue;
+		add_pull(at, sources[i].position, sources[i].strength, min_pull, &total);
+	}
+	return total;
+}
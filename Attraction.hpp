@@ -0,0 +1,60 @@
+#pragma once
+
+/*
+ * Attraction computes the pull of many attractors ("gravity wells", e.g., holes)
+ *  on many attracted objects, using a Barnes-Hut octree over the attractors.
+ *
+ * Each attractor pulls with acceleration strength / distance toward its position.
+ * Pulls weaker than a cutoff are ignored (so wells have a limited reach);
+ *  distant clusters of attractors are lumped together and cut off as one.
+ *
+ * Example:
+ *  Attraction attraction;
+ *  attraction.build(sources); //(once per step, after attractors move)
+ *  body.force += attraction.pull(body.position, min_pull) * body.mass;
+ *
+ * Setting 'exact' sums every attractor directly (O(n^2) over a whole step),
+ *  which is useful for checking the approximation.
+ */
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+struct Attraction {
+	struct Source {
+		glm::vec3 position = glm::vec3(0.0f);
+		float strength = 0.0f; //pull at distance d is strength / d
+	};
+
+	//(re)build the octree over a set of attractors:
+	void build(Source const *sources, uint32_t count);
+
+	//total acceleration toward attractors at 'at' (ignoring pulls weaker than 'min_pull',
+	// and the source with index 'ignore' -- e.g., the attractor being pulled):
+	glm::vec3 pull(glm::vec3 const &at, float min_pull, uint32_t ignore = -1U) const;
+
+	//tuning:
+	float theta = 0.5f; //a node is lumped together when (node size / distance) < theta
+	bool exact = false; //sum every source directly instead of using the octree
+
+	static constexpr float MinDistance = 0.005f; //pulls are evaluated at least this far out
+
+	//-- internals --
+	struct Node {
+		glm::vec3 center = glm::vec3(0.0f); //of the node's cube
+		float half = 0.0f; //half the cube's size
+		glm::vec3 focus = glm::vec3(0.0f); //strength-weighted center of the sources inside
+		float strength = 0.0f; //total strength of the sources inside
+		uint32_t first = 0; //interior: first child (children are contiguous); leaf: first source
+		uint32_t count = 0; //interior: number of children; leaf: number of sources
+		bool leaf = true;
+	};
+	std::vector< Node > nodes; //nodes[0] is the root
+	std::vector< Source > sources; //reordered so every leaf's sources are contiguous
+	std::vector< uint32_t > source_indices; //index in the array passed to build() for each source
+
+	void build_node(uint32_t node, uint32_t begin, uint32_t end, uint32_t depth);
+	glm::vec3 pull_exact(glm::vec3 const &at, float min_pull, uint32_t ignore) const;
+};
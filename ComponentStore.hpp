@@ -0,0 +1,143 @@
+#pragma once
+
+/*
+ * A ComponentStore< T > keeps components packed in one contiguous array,
+ *  so that systems (drawing, physics) iterate them without chasing pointers.
+ *
+ * Components are referred to long-term by Handle, which stays valid until that
+ *  component is erased (erased handles are detected via a per-slot generation count):
+ *
+ *  ComponentStore< Scene::Light > lights;
+ *  auto handle = lights.emplace(transform);
+ *  lights[handle].energy = glm::vec3(2.0f);
+ *  for (auto &light : lights) { ... } //dense iteration
+ *  lights.erase(handle); //swap-remove: the last component moves into the hole
+ *
+ * NOTE: like std::vector, adding or erasing components invalidates pointers/references
+ *  to components (and changes iteration order on erase). Keep Handles instead.
+ */
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+template< typename T >
+struct ComponentStore {
+	struct Handle {
+		uint32_t slot = -1U;
+		uint32_t generation = 0;
+		bool operator==(Handle const &o) const { return slot == o.slot && generation == o.generation; }
+		bool operator!=(Handle const &o) const { return !(*this == o); }
+	};
+
+	//add a component (constructed from 'args') at the end of the dense array:
+	template< typename... Args >
+	Handle emplace(Args&&... args) {
+		uint32_t slot;
+		if (free_slot != -1U) {
+			slot = free_slot;
+			free_slot = slots[slot].next_free;
+		} else {
+			slot = uint32_t(slots.size());
+			slots.emplace_back();
+		}
+		slots[slot].index = uint32_t(dense.size());
+		dense.emplace_back(std::forward< Args >(args)...);
+		dense_slots.emplace_back(slot);
+		return Handle{slot, slots[slot].generation};
+	}
+
+	//container-style add, for code that just wants the new component:
+	template< typename... Args >
+	T &emplace_back(Args&&... args) {
+		emplace(std::forward< Args >(args)...);
+		return dense.back();
+	}
+
+	//remove a component by moving the last component into its place:
+	void erase(Handle handle) {
+		assert(contains(handle));
+		uint32_t index = slots[handle.slot].index;
+		erase_index(index);
+	}
+
+	//remove the component at a dense index (e.g., while iterating backward):
+	void erase_index(uint32_t index) {
+		assert(index < dense.size());
+		uint32_t slot = dense_slots[index];
+		uint32_t last = uint32_t(dense.size()) - 1;
+		if (index != last) {
+			dense[index] = std::move(dense[last]);
+			dense_slots[index] = dense_slots[last];
+			slots[dense_slots[index]].index = index;
+		}
+		dense.pop_back();
+		dense_slots.pop_back();
+
+		//retire the slot (bumping generation so old handles stop matching):
+		slots[slot].generation += 1;
+		slots[slot].index = -1U;
+		slots[slot].next_free = free_slot;
+		free_slot = slot;
+	}
+
+	bool contains(Handle handle) const {
+		return handle.slot < slots.size()
+		    && slots[handle.slot].generation == handle.generation
+		    && slots[handle.slot].index != -1U;
+	}
+
+	//lookup (returns nullptr for stale handles):
+	T *get(Handle handle) { return contains(handle) ? &dense[slots[handle.slot].index] : nullptr; }
+	T const *get(Handle handle) const { return contains(handle) ? &dense[slots[handle.slot].index] : nullptr; }
+
+	T &operator[](Handle handle) { assert(contains(handle)); return dense[slots[handle.slot].index]; }
+	T const &operator[](Handle handle) const { assert(contains(handle)); return dense[slots[handle.slot].index]; }
+
+	//handle for the component at a dense index:
+	Handle handle_at(uint32_t index) const {
+		assert(index < dense.size());
+		uint32_t slot = dense_slots[index];
+		return Handle{slot, slots[slot].generation};
+	}
+
+	void clear() {
+		//(retire every slot, so that outstanding handles become stale)
+		for (uint32_t i = uint32_t(dense.size()); i > 0; --i) {
+			erase_index(i - 1);
+		}
+	}
+
+	void reserve(size_t count) {
+		dense.reserve(count);
+		dense_slots.reserve(count);
+	}
+
+	//dense access:
+	size_t size() const { return dense.size(); }
+	bool empty() const { return dense.empty(); }
+	T *data() { return dense.data(); }
+	T const *data() const { return dense.data(); }
+	T &front() { return dense.front(); }
+	T const &front() const { return dense.front(); }
+	T &back() { return dense.back(); }
+	T const &back() const { return dense.back(); }
+	typename std::vector< T >::iterator begin() { return dense.begin(); }
+	typename std::vector< T >::iterator end() { return dense.end(); }
+	typename std::vector< T >::const_iterator begin() const { return dense.begin(); }
+	typename std::vector< T >::const_iterator end() const { return dense.end(); }
+
+	//-- internals --
+	std::vector< T > dense; //packed components
+	std::vector< uint32_t > dense_slots; //slot that owns each dense component
+
+	struct Slot {
+		uint32_t index = -1U; //index into 'dense' (or -1U if free)
+		uint32_t generation = 0;
+		uint32_t next_free = -1U; //free list link
+	};
+	std::vector< Slot > slots;
+	uint32_t free_slot = -1U;
+};
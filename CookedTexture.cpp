@@ -0,0 +1,102 @@
+#include "CookedTexture.hpp"
+
+#include "read_write_chunk.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+CookedTexture::CookedTexture(std::string const &filename) {
+	std::ifstream file(filename, std::ios::binary);
+	load(file, filename);
+}
+
+CookedTexture::CookedTexture(std::istream &from, std::string const &filename) {
+	load(from, filename);
+}
+
+void CookedTexture::load(std::istream &from, std::string const &filename) {
+	std::vector< Header > header;
+	read_chunk(from, "tex0", &header);
+	if (header.size() != 1) throw std::runtime_error("Cooked texture '" + filename + "' should have exactly one header.");
+	size = glm::uvec2(header[0].width, header[0].height);
+	levels = header[0].levels;
+	if (size.x == 0 || size.y == 0 || levels == 0 || levels > 32 || ((size.x >> (levels - 1)) == 0 && (size.y >> (levels - 1)) == 0)) {
+		throw std::runtime_error("Cooked texture '" + filename + "' has an invalid size or level count.");
+	}
+
+	//(all levels in one read)
+	read_chunk(from, "mip0", &texels);
+	if (texels.size() != level_offset(levels)) {
+		throw std::runtime_error("Cooked texture '" + filename + "' has " + std::to_string(texels.size()) + " texels, but its levels need " + std::to_string(level_offset(levels)) + ".");
+	}
+
+	if (header[0].origin == 1) {
+		for (uint32_t l = 0; l < levels; ++l) {
+			glm::uvec2 ls = level_size(l);
+			glm::u8vec4 *level = texels.data() + level_offset(l);
+			for (uint32_t y = 0; y < ls.y / 2; ++y) {
+				std::swap_ranges(level + y * ls.x, level + (y + 1) * ls.x, level + (ls.y - 1 - y) * ls.x);
+			}
+		}
+	} else if (header[0].origin != 0) {
+		throw std::runtime_error("Cooked texture '" + filename + "' has an unknown origin.");
+	}
+
+	if (from.peek() != EOF) {
+		std::cerr << "WARNING: trailing data in cooked texture '" << filename << "'" << std::endl;
+	}
+}
+
+size_t CookedTexture::level_offset(uint32_t level) const {
+	size_t offset = 0;
+	for (uint32_t l = 0; l < level; ++l) {
+		glm::uvec2 ls = level_size(l);
+		offset += size_t(ls.x) * ls.y;
+	}
+	return offset;
+}
+
+CookedTexture CookedTexture::make(glm::uvec2 size, std::vector< glm::u8vec4 > const &data) {
+	if (size.x == 0 || size.y == 0 || data.size() != size_t(size.x) * size.y) {
+		throw std::runtime_error("Can't make mipmaps of a " + std::to_string(size.x) + "x" + std::to_string(size.y) + " image with " + std::to_string(data.size()) + " texels.");
+	}
+
+	CookedTexture ret;
+	ret.size = size;
+	ret.levels = 1;
+	while ((size.x >> ret.levels) || (size.y >> ret.levels)) ret.levels += 1;
+
+	ret.texels.reserve(ret.level_offset(ret.levels));
+	ret.texels.insert(ret.texels.end(), data.begin(), data.end());
+	for (uint32_t l = 1; l < ret.levels; ++l) {
+		glm::uvec2 from = ret.level_size(l - 1);
+		glm::uvec2 to = ret.level_size(l);
+		size_t above = ret.level_offset(l - 1);
+		for (uint32_t y = 0; y < to.y; ++y) {
+			//(odd sizes: the last row / column is averaged with itself)
+			uint32_t y0 = std::min(2 * y, from.y - 1), y1 = std::min(2 * y + 1, from.y - 1);
+			for (uint32_t x = 0; x < to.x; ++x) {
+				uint32_t x0 = std::min(2 * x, from.x - 1), x1 = std::min(2 * x + 1, from.x - 1);
+				glm::uvec4 sum = glm::uvec4(ret.texels[above + y0 * from.x + x0]) + glm::uvec4(ret.texels[above + y0 * from.x + x1])
+				               + glm::uvec4(ret.texels[above + y1 * from.x + x0]) + glm::uvec4(ret.texels[above + y1 * from.x + x1]);
+				ret.texels.emplace_back(glm::u8vec4((sum + glm::uvec4(2)) / 4U));
+			}
+		}
+	}
+	assert(ret.texels.size() == ret.level_offset(ret.levels));
+
+	return ret;
+}
+
+void CookedTexture::save(std::ostream &to) const {
+	std::vector< Header > header(1);
+	header[0].width = size.x;
+	header[0].height = size.y;
+	header[0].levels = levels;
+	header[0].origin = 0;
+	write_chunk("tex0", header, &to);
+	write_chunk("mip0", texels, &to);
+}
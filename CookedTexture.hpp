@@ -0,0 +1,57 @@
+#pragma once
+
+/*
+ * A CookedTexture is an RGBA8 image along with its whole mip chain, stored so that
+ *  loading is one read of the pixel data and one upload per level (no PNG decoding,
+ *  no mipmap generation at startup). The cook-textures tool makes them from .png files.
+ *
+ *  CookedTexture texture(*open_asset("levels/grass.tex"), "levels/grass.tex");
+ *  TextureArrays::get().add(texture);
+ *
+ * .tex layout (chunks as in read_write_chunk.hpp):
+ *  "tex0" -- one Header
+ *  "mip0" -- RGBA8 texels of every level, largest level first, rows bottom-to-top
+ *            (or top-to-bottom, if the header's origin says so)
+ */
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <istream>
+#include <string>
+#include <vector>
+
+struct CookedTexture {
+	CookedTexture() = default;
+	//read from a stream ('filename' names the data in messages); rows are flipped if needed so that the origin is at the lower left:
+	// note: will throw if the data isn't a cooked texture
+	CookedTexture(std::istream &from, std::string const &filename);
+	//..or from a file:
+	CookedTexture(std::string const &filename);
+
+	//build the mip chain for an image (origin at the lower left) by repeated 2x2 box filtering:
+	static CookedTexture make(glm::uvec2 size, std::vector< glm::u8vec4 > const &data);
+
+	//write in .tex format:
+	void save(std::ostream &to) const;
+
+	glm::uvec2 size = glm::uvec2(0); //of level 0
+	uint32_t levels = 0;
+	std::vector< glm::u8vec4 > texels; //every level, largest first
+
+	//size of, and offset (in texels) of the start of, a level:
+	glm::uvec2 level_size(uint32_t level) const { return glm::max(glm::uvec2(1), glm::uvec2(size.x >> level, size.y >> level)); }
+	size_t level_offset(uint32_t level) const;
+
+	//-- internals --
+
+	//used by the constructors:
+	void load(std::istream &from, std::string const &filename);
+
+	struct Header {
+		uint32_t width = 0, height = 0;
+		uint32_t levels = 0;
+		uint32_t origin = 0; //0: lower left (ready for OpenGL), 1: upper left
+	};
+	static_assert(sizeof(Header) == 16, "Header is packed.");
+};
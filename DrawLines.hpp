@@ -6,9 +6,14 @@
  *
  * Similar usage pattern to DrawSprites.
  *
+ * Vertices are kept in the creating thread's FrameArena, so a DrawLines
+ *  must be destroyed within the frame it was created in.
+ *
  */
 
 
+#include "FrameArena.hpp"
+
 #include <glm/glm.hpp>
 
 #include <string>
@@ -43,6 +48,6 @@ struct DrawLines {
 		glm::vec3 Position;
 		glm::u8vec4 Color;
 	};
-	std::vector< Vertex > attribs;
+	FrameVector< Vertex > attribs;
 
 };
@@ -0,0 +1,160 @@
+#include "DynamicResolution.hpp"
+
+#include "gl_errors.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+
+DynamicResolution::~DynamicResolution() {
+	for (auto &query : queries) {
+		if (query.id) glDeleteQueries(1, &query.id);
+		query.id = 0;
+	}
+	if (framebuffer) glDeleteFramebuffers(1, &framebuffer);
+	if (color) glDeleteRenderbuffers(1, &color);
+	if (depth) glDeleteRenderbuffers(1, &depth);
+	framebuffer = color = depth = 0;
+}
+
+DynamicResolution &DynamicResolution::get() {
+	//(never destroyed, since the context may be gone by the time static destructors run)
+	static DynamicResolution *resolution = new DynamicResolution();
+	return *resolution;
+}
+
+//size of the scene at 'scale' (never zero in either dimension):
+static glm::uvec2 scaled(glm::uvec2 const &drawable_size, float scale) {
+	return glm::max(glm::uvec2(1), glm::uvec2(glm::vec2(drawable_size) * scale + 0.5f));
+}
+
+glm::uvec2 DynamicResolution::predict_render_size(glm::uvec2 const &drawable_size) const {
+	if (drawable_size.x == 0 || drawable_size.y == 0) return drawable_size;
+	return scaled(drawable_size, latest_scale.load(std::memory_order_relaxed));
+}
+
+glm::uvec2 DynamicResolution::begin(glm::uvec2 const &drawable_size) {
+	poll();
+
+	//nothing to draw into (e.g., a minimized window), so no offscreen target and no timing:
+	if (drawable_size.x == 0 || drawable_size.y == 0) {
+		render_size = drawable_size;
+		offscreen = false;
+		return render_size;
+	}
+
+	scale = std::clamp(scale, min_scale, max_scale);
+	latest_scale.store(scale, std::memory_order_relaxed);
+	render_size = scaled(drawable_size, scale);
+	offscreen = (render_size != drawable_size);
+
+	if (offscreen) {
+		if (allocated_size != drawable_size) allocate(drawable_size);
+		glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	}
+	glViewport(0, 0, render_size.x, render_size.y);
+
+	//time the scene (skipping this frame if every query is still in flight):
+	Query &query = queries[next_query];
+	if (!query.pending) {
+		if (query.id == 0) glGenQueries(1, &query.id);
+		glBeginQuery(GL_TIME_ELAPSED, query.id);
+		query.scale = float(render_size.y) / float(drawable_size.y);
+		active_query = next_query;
+		next_query = (next_query + 1) % uint32_t(queries.size());
+	}
+
+	GL_ERRORS();
+	return render_size;
+}
+
+void DynamicResolution::end(glm::uvec2 const &drawable_size) {
+	if (active_query != -1U) {
+		glEndQuery(GL_TIME_ELAPSED);
+		queries[active_query].pending = true;
+		active_query = -1U;
+	}
+
+	if (offscreen) {
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+		glBlitFramebuffer(
+			0, 0, render_size.x, render_size.y,
+			0, 0, drawable_size.x, drawable_size.y,
+			GL_COLOR_BUFFER_BIT, GL_LINEAR
+		);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		offscreen = false;
+	}
+	glViewport(0, 0, drawable_size.x, drawable_size.y);
+
+	GL_ERRORS();
+}
+
+void DynamicResolution::poll() {
+	//queries finish in the order they were issued, so check from the oldest:
+	for (uint32_t i = 0; i < queries.size(); ++i) {
+		Query &query = queries[(next_query + i) % queries.size()];
+		if (!query.pending) continue;
+		GLint available = GL_FALSE;
+		glGetQueryObjectiv(query.id, GL_QUERY_RESULT_AVAILABLE, &available);
+		if (available == GL_FALSE) break;
+		GLuint64 ns = 0;
+		glGetQueryObjectui64v(query.id, GL_QUERY_RESULT, &ns);
+		query.pending = false;
+		update_scale(float(double(ns) * 1e-6), query.scale);
+	}
+}
+
+void DynamicResolution::update_scale(float ms, float at_scale) {
+	gpu_ms = ms;
+
+	//(assumes the cost is mostly per-pixel, so it goes with the square of the scale)
+	float cost = ms / (at_scale * at_scale);
+	if (!have_estimate) {
+		full_ms = cost;
+		have_estimate = true;
+	} else {
+		full_ms += (cost - full_ms) * 0.2f;
+	}
+
+	if (!enabled) return;
+
+	float desired = max_scale;
+	if (full_ms > 0.0f) desired = std::clamp(std::sqrt(target_ms / full_ms), min_scale, max_scale);
+
+	if (desired < scale) {
+		//over budget: drop right away
+		scale = desired;
+	} else if (desired > scale && desired >= std::min(scale * 1.05f, max_scale)) {
+		//plenty of headroom (or enough to get all the way back to max_scale): creep back up
+		// (so a single cheap frame doesn't cause a jump)
+		scale = std::min(desired, scale + 0.02f);
+	}
+}
+
+void DynamicResolution::allocate(glm::uvec2 const &size) {
+	if (framebuffer == 0) glGenFramebuffers(1, &framebuffer);
+	if (color == 0) glGenRenderbuffers(1, &color);
+	if (depth == 0) glGenRenderbuffers(1, &depth);
+
+	glBindRenderbuffer(GL_RENDERBUFFER, color);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, size.x, size.y);
+	glBindRenderbuffer(GL_RENDERBUFFER, depth);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, size.x, size.y);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depth);
+	GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	if (status != GL_FRAMEBUFFER_COMPLETE) {
+		throw std::runtime_error("Scene framebuffer (" + std::to_string(size.x) + "x" + std::to_string(size.y) + ") is incomplete: status " + std::to_string(status) + ".");
+	}
+
+	allocated_size = size;
+
+	GL_ERRORS();
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+/*
+ * DynamicResolution renders the scene into an offscreen framebuffer at a fraction of the
+ *  window's resolution, picking that fraction from GPU timer queries so that drawing the
+ *  scene takes about 'target_ms', then upscales it into the window:
+ *
+ *  DynamicResolution &resolution = DynamicResolution::get();
+ *  resolution.begin(drawable_size); //binds the scene framebuffer and viewport, starts the timer
+ *  ... draw the scene ...
+ *  resolution.end(drawable_size); //stops the timer, upscales into the window, restores the viewport
+ *  ... draw the HUD (at full resolution) ...
+ *
+ * Timer results arrive a few frames late (queries are never waited on), so each is
+ *  converted into an estimate of what the scene would cost at full resolution; the scale
+ *  drops as soon as that estimate is over budget and creeps back up when there is headroom.
+ * At a scale of 1 the scene is drawn straight into the window (no offscreen copy at all).
+ *
+ */
+
+#include "GL.hpp"
+
+#include <glm/glm.hpp>
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+struct DynamicResolution {
+	DynamicResolution() = default;
+	~DynamicResolution();
+
+	DynamicResolution(DynamicResolution const &) = delete;
+
+	//the instance used by the game (created on first use; GL thread only, except for predict_render_size):
+	static DynamicResolution &get();
+
+	//settings:
+	float target_ms = 12.0f; //scene GPU time to aim for (leaves some of a 60Hz frame for the HUD, upscale, and compositor)
+	float min_scale = 0.5f;
+	float max_scale = 1.0f;
+	bool enabled = true; //if false, 'scale' stays wherever it was set
+
+	//state:
+	float scale = 1.0f; //fraction of the window's width and height the scene is rendered at
+	float gpu_ms = 0.0f; //most recently measured scene time
+
+	//start a frame; returns the size the scene is being rendered at:
+	glm::uvec2 begin(glm::uvec2 const &drawable_size);
+	//finish the scene part of a frame:
+	void end(glm::uvec2 const &drawable_size);
+
+	//the size the next begin(drawable_size) will most likely render at (safe from any thread;
+	// e.g., for picking LODs on the main thread for a frame the render thread will draw):
+	glm::uvec2 predict_render_size(glm::uvec2 const &drawable_size) const;
+
+	//-- internals --
+
+	//offscreen target (allocated at the full drawable size; lower scales use its lower-left corner):
+	GLuint framebuffer = 0;
+	GLuint color = 0, depth = 0; //renderbuffers
+	glm::uvec2 allocated_size = glm::uvec2(0);
+	glm::uvec2 render_size = glm::uvec2(0); //this frame's
+	bool offscreen = false; //this frame's
+	std::atomic< float > latest_scale{1.0f}; //'scale' as of the last begin(), for predict_render_size
+
+	//GL_TIME_ELAPSED queries, in flight for a few frames each:
+	struct Query {
+		GLuint id = 0;
+		bool pending = false;
+		float scale = 1.0f; //scale the measured frame was rendered at
+	};
+	std::array< Query, 4 > queries;
+	uint32_t next_query = 0;
+	uint32_t active_query = -1U;
+
+	float full_ms = 0.0f; //smoothed estimate of the scene's cost at scale 1
+	bool have_estimate = false;
+
+	//read back any finished queries (without waiting):
+	void poll();
+	//fold in a measurement of 'ms' taken at scale 'at_scale', and pick a new scale:
+	void update_scale(float ms, float at_scale);
+	//(re-)create the offscreen target at 'size':
+	void allocate(glm::uvec2 const &size);
+};
@@ -0,0 +1,105 @@
+#include "FrameArena.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+#include <new>
+
+FrameArena::FrameArena(size_t capacity) : block_size(capacity) {
+	block = static_cast< char * >(::operator new(block_size));
+}
+
+FrameArena::~FrameArena() {
+	for (void *ptr : overflow) {
+		::operator delete(ptr);
+	}
+	::operator delete(block);
+}
+
+FrameArena &FrameArena::current() {
+	static thread_local FrameArena arena;
+	return arena;
+}
+
+void *FrameArena::allocate(size_t size, size_t align) {
+	assert(align != 0 && (align & (align - 1)) == 0 && "alignment must be a power of two");
+	assert(align <= alignof(std::max_align_t) && "over-aligned types aren't supported");
+	if (size == 0) size = 1;
+
+	//reserve enough room to align within, so a single atomic add is all that's needed:
+	size_t reserve = size + align - 1;
+	size_t start = offset.fetch_add(reserve);
+	if (start + reserve <= block_size) {
+		uintptr_t ptr = reinterpret_cast< uintptr_t >(block + start);
+		ptr = (ptr + (align - 1)) & ~uintptr_t(align - 1);
+		return reinterpret_cast< void * >(ptr);
+	}
+
+	//didn't fit; fall back to the heap for the rest of this frame:
+	void *ret = ::operator new(size);
+	std::unique_lock< std::mutex > lock(overflow_mutex);
+	overflow.emplace_back(ret);
+	overflow_bytes += size;
+	return ret;
+}
+
+void FrameArena::reset() {
+	for (void *ptr : overflow) {
+		::operator delete(ptr);
+	}
+
+	if (!overflow.empty()) {
+		//grow so that a frame like the last one fits without overflowing:
+		size_t needed = offset;
+		while (block_size < needed) block_size *= 2;
+		::operator delete(block);
+		block = static_cast< char * >(::operator new(block_size));
+	}
+
+	overflow.clear();
+	overflow_bytes = 0;
+	offset = 0;
+}
+
+size_t FrameArena::used() const {
+	return std::min< size_t >(offset, block_size) + overflow_bytes;
+}
+
+//------------ heap allocation counter ------------
+//(replaces the global operator new so that hot loops can be checked for allocations)
+// opt-in, since shipped builds shouldn't pay for an atomic increment on every allocation
+
+#ifdef COUNT_HEAP_ALLOCATIONS
+
+static std::atomic< uint64_t > heap_allocation_count{0};
+
+uint64_t FrameArena::heap_allocations() {
+	return heap_allocation_count.load(std::memory_order_relaxed);
+}
+
+void *operator new(size_t size) {
+	heap_allocation_count.fetch_add(1, std::memory_order_relaxed);
+	if (size == 0) size = 1;
+	while (true) {
+		if (void *ptr = std::malloc(size)) return ptr;
+		std::new_handler handler = std::get_new_handler();
+		if (!handler) throw std::bad_alloc();
+		handler();
+	}
+}
+
+void operator delete(void *ptr) noexcept {
+	std::free(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept {
+	std::free(ptr);
+}
+
+#else
+
+uint64_t FrameArena::heap_allocations() {
+	return 0;
+}
+
+#endif
@@ -0,0 +1,94 @@
+#pragma once
+
+/*
+ * FrameArena is a linear ("bump") allocator for data that only lives for one frame.
+ *
+ * Allocation just advances an offset into a pre-allocated block, deallocation does
+ *  nothing, and reset() reclaims everything at once -- so per-frame containers
+ *  stop hitting malloc/free once the block has grown to fit a typical frame.
+ *
+ * Each thread has its own arena (FrameArena::current()), reset by whichever loop
+ *  owns that thread: main.cpp resets the main thread's arena at the top of every frame,
+ *  and RenderThread resets its arena before drawing each frame.
+ *
+ * Use with standard containers via FrameAllocator:
+ *  FrameVector< Scene::Collision > collisions; //uses FrameArena::current()
+ *
+ * NOTE: anything allocated from an arena must be destroyed before the arena is reset.
+ *  (allocation itself is thread-safe, so job system tasks may grow containers
+ *   that were created on the main thread)
+ */
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+struct FrameArena {
+	FrameArena(size_t capacity = 256 * 1024);
+	~FrameArena();
+
+	FrameArena(FrameArena const &) = delete;
+
+	//the calling thread's arena:
+	static FrameArena &current();
+
+	//'size' bytes aligned to 'align' (a power of two); valid until the next reset():
+	void *allocate(size_t size, size_t align);
+
+	//reclaim all allocations; if the last frame overflowed, the block grows to fit it:
+	// (must not be called while other threads are allocating from this arena)
+	void reset();
+
+	//bytes allocated since the last reset (including overflow):
+	size_t used() const;
+	size_t capacity() const { return block_size; }
+
+	//heap allocations made (by any thread, through operator new) since program start:
+	// only counted in builds compiled with -DCOUNT_HEAP_ALLOCATIONS (which replaces the global operator new); otherwise always 0
+	static uint64_t heap_allocations();
+#ifdef COUNT_HEAP_ALLOCATIONS
+	static constexpr bool CountsHeapAllocations = true;
+#else
+	static constexpr bool CountsHeapAllocations = false;
+#endif
+
+	//-- internals --
+	char *block = nullptr;
+	size_t block_size = 0;
+	std::atomic< size_t > offset{0};
+
+	//allocations that didn't fit in 'block' (freed on reset):
+	std::mutex overflow_mutex;
+	std::vector< void * > overflow;
+	size_t overflow_bytes = 0;
+};
+
+//STL-compatible allocator over a FrameArena (by default, the arena of the thread that creates it):
+template< typename T >
+struct FrameAllocator {
+	using value_type = T;
+
+	FrameAllocator() : arena(&FrameArena::current()) { }
+	FrameAllocator(FrameArena &arena_) : arena(&arena_) { }
+	template< typename U >
+	FrameAllocator(FrameAllocator< U > const &other) : arena(other.arena) { }
+
+	T *allocate(size_t n) {
+		return static_cast< T * >(arena->allocate(n * sizeof(T), alignof(T)));
+	}
+	void deallocate(T *, size_t) {
+		//nothing to do; memory is reclaimed all at once by FrameArena::reset()
+	}
+
+	FrameArena *arena;
+};
+
+template< typename T, typename U >
+bool operator==(FrameAllocator< T > const &a, FrameAllocator< U > const &b) { return a.arena == b.arena; }
+template< typename T, typename U >
+bool operator!=(FrameAllocator< T > const &a, FrameAllocator< U > const &b) { return a.arena != b.arena; }
+
+template< typename T >
+using FrameVector = std::vector< T, FrameAllocator< T > >;
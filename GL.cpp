@@ -1,3 +1,5 @@
+//GL.cpp implements the state cache, so it calls the driver directly:
+#define GL_NO_STATE_CACHE
 #include "GL.hpp"
 
 #include <SDL.h>
@@ -298,6 +300,8 @@ void init_GL() {
 	DO(glVertexAttribP3uiv)
 	DO(glVertexAttribP4ui)
 	DO(glVertexAttribP4uiv)
+
+	gl_state_invalidate();
 }
 #ifdef _WIN32
 	 void (APIENTRYFP glDrawRangeElements) (GLenum mode, GLuint start, GLuint end, GLsizei count, GLenum type, const void *indices);
@@ -584,3 +588,148 @@ void init_GL() {
 	 void (APIENTRYFP glVertexAttribP4ui) (GLuint index, GLenum type, GLboolean normalized, GLuint value);
 	 void (APIENTRYFP glVertexAttribP4uiv) (GLuint index, GLenum type, GLboolean normalized, const GLuint *value);
 #endif
+
+//------------------------------------------------
+//State cache:
+
+GLStateStats gl_state_stats;
+GLStateStats gl_state_last_frame;
+
+//cached values are 'Unknown' until first set after gl_state_invalidate() (which init_GL() calls):
+static constexpr GLuint Unknown = -1U;
+
+//texture units and targets beyond these are passed straight through:
+static constexpr uint32_t CachedTextureUnits = 32;
+static constexpr GLenum CachedTextureTargets[] = {
+	GL_TEXTURE_1D, GL_TEXTURE_2D, GL_TEXTURE_3D,
+	GL_TEXTURE_1D_ARRAY, GL_TEXTURE_2D_ARRAY,
+	GL_TEXTURE_RECTANGLE, GL_TEXTURE_CUBE_MAP, GL_TEXTURE_BUFFER,
+	GL_TEXTURE_2D_MULTISAMPLE, GL_TEXTURE_2D_MULTISAMPLE_ARRAY,
+};
+static constexpr uint32_t CachedTextureTargetCount = sizeof(CachedTextureTargets) / sizeof(CachedTextureTargets[0]);
+
+//enable/disable capabilities (others are passed straight through):
+static constexpr GLenum CachedCapabilities[] = {
+	GL_BLEND, GL_CULL_FACE, GL_DEPTH_TEST, GL_STENCIL_TEST, GL_SCISSOR_TEST,
+	GL_POLYGON_OFFSET_FILL, GL_FRAMEBUFFER_SRGB, GL_MULTISAMPLE, GL_PROGRAM_POINT_SIZE,
+	GL_PRIMITIVE_RESTART, GL_SAMPLE_ALPHA_TO_COVERAGE, GL_DEPTH_CLAMP, GL_LINE_SMOOTH,
+};
+static constexpr uint32_t CachedCapabilityCount = sizeof(CachedCapabilities) / sizeof(CachedCapabilities[0]);
+
+static struct {
+	GLuint program;
+	GLuint vertex_array;
+	GLuint array_buffer;
+	GLuint element_array_buffer; //(part of the vertex array's state)
+	GLuint active_unit;
+	GLuint textures[CachedTextureUnits][CachedTextureTargetCount];
+	GLuint capabilities[CachedCapabilityCount]; //GL_TRUE, GL_FALSE, or Unknown
+} state;
+
+template< uint32_t N >
+static uint32_t index_of(GLenum const (&list)[N], GLenum value) {
+	for (uint32_t i = 0; i < N; ++i) {
+		if (list[i] == value) return i;
+	}
+	return N;
+}
+
+//update a cached value; returns true if the call should be passed to the driver:
+static bool changes(GLuint *cached, GLuint value) {
+	if (cached && *cached == value) {
+		gl_state_stats.filtered += 1;
+		return false;
+	}
+	if (cached) *cached = value;
+	gl_state_stats.issued += 1;
+	return true;
+}
+
+void gl_state_next_frame() {
+	gl_state_last_frame = gl_state_stats;
+	gl_state_stats = GLStateStats();
+}
+
+void gl_state_invalidate() {
+	state.program = Unknown;
+	state.vertex_array = Unknown;
+	state.array_buffer = Unknown;
+	state.element_array_buffer = Unknown;
+	state.active_unit = Unknown;
+	for (auto &unit : state.textures) {
+		for (auto &texture : unit) texture = Unknown;
+	}
+	for (auto &cap : state.capabilities) cap = Unknown;
+}
+
+void gl_state_UseProgram(GLuint program) {
+	if (changes(&state.program, program)) glUseProgram(program);
+}
+
+void gl_state_BindVertexArray(GLuint array) {
+	if (changes(&state.vertex_array, array)) {
+		glBindVertexArray(array);
+		state.element_array_buffer = Unknown;
+	}
+}
+
+void gl_state_BindBuffer(GLenum target, GLuint buffer) {
+	GLuint *cached = nullptr;
+	if (target == GL_ARRAY_BUFFER) cached = &state.array_buffer;
+	else if (target == GL_ELEMENT_ARRAY_BUFFER) cached = &state.element_array_buffer;
+	if (changes(cached, buffer)) glBindBuffer(target, buffer);
+}
+
+void gl_state_ActiveTexture(GLenum texture) {
+	if (changes(&state.active_unit, texture - GL_TEXTURE0)) glActiveTexture(texture);
+}
+
+void gl_state_BindTexture(GLenum target, GLuint texture) {
+	GLuint *cached = nullptr;
+	uint32_t t = index_of(CachedTextureTargets, target);
+	if (state.active_unit < CachedTextureUnits && t < CachedTextureTargetCount) {
+		cached = &state.textures[state.active_unit][t];
+	}
+	if (changes(cached, texture)) glBindTexture(target, texture);
+}
+
+void gl_state_Enable(GLenum cap) {
+	uint32_t c = index_of(CachedCapabilities, cap);
+	if (changes(c < CachedCapabilityCount ? &state.capabilities[c] : nullptr, GL_TRUE)) glEnable(cap);
+}
+
+void gl_state_Disable(GLenum cap) {
+	uint32_t c = index_of(CachedCapabilities, cap);
+	if (changes(c < CachedCapabilityCount ? &state.capabilities[c] : nullptr, GL_FALSE)) glDisable(cap);
+}
+
+void gl_state_DeleteVertexArrays(GLsizei n, const GLuint *arrays) {
+	for (GLsizei i = 0; i < n; ++i) {
+		if (arrays[i] != 0 && arrays[i] == state.vertex_array) {
+			state.vertex_array = 0;
+			state.element_array_buffer = Unknown;
+		}
+	}
+	glDeleteVertexArrays(n, arrays);
+}
+
+void gl_state_DeleteBuffers(GLsizei n, const GLuint *buffers) {
+	for (GLsizei i = 0; i < n; ++i) {
+		if (buffers[i] == 0) continue;
+		if (buffers[i] == state.array_buffer) state.array_buffer = 0;
+		if (buffers[i] == state.element_array_buffer) state.element_array_buffer = 0;
+	}
+	glDeleteBuffers(n, buffers);
+}
+
+void gl_state_DeleteTextures(GLsizei n, const GLuint *textures) {
+	for (GLsizei i = 0; i < n; ++i) {
+		if (textures[i] == 0) continue;
+		for (auto &unit : state.textures) {
+			for (auto &texture : unit) {
+				if (texture == textures[i]) texture = 0;
+			}
+		}
+	}
+	glDeleteTextures(n, textures);
+}
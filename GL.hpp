@@ -1277,3 +1277,52 @@ GLAPI void (APIENTRYFP glVertexAttribP4ui) (GLuint index, GLenum type, GLboolean
 GLAPI void (APIENTRYFP glVertexAttribP4uiv) (GLuint index, GLenum type, GLboolean normalized, const GLuint *value);
 
 }
+
+//------------------------------------------------
+//State cache:
+// glUseProgram, glBindVertexArray, glBindBuffer, glActiveTexture, glBindTexture, glEnable, and glDisable
+//  are routed through a cache of the context's current state, and calls that wouldn't change
+//  anything are dropped before they reach the driver.
+// (define GL_NO_STATE_CACHE before including GL.hpp to call the driver directly)
+//
+// The cache assumes every change to these bindings goes through it; if something else
+//  (e.g., a library) might have changed them, call gl_state_invalidate().
+
+struct GLStateStats {
+	uint32_t issued = 0; //calls passed to the driver
+	uint32_t filtered = 0; //calls dropped as redundant
+};
+extern GLStateStats gl_state_stats; //since the last gl_state_next_frame()
+extern GLStateStats gl_state_last_frame; //for the frame before that
+
+//call once per frame (e.g., after swapping) to move gl_state_stats to gl_state_last_frame:
+void gl_state_next_frame();
+
+//forget all cached state (the next call to each entry point will be passed through):
+void gl_state_invalidate();
+
+void gl_state_UseProgram(GLuint program);
+void gl_state_BindVertexArray(GLuint array);
+void gl_state_BindBuffer(GLenum target, GLuint buffer);
+void gl_state_ActiveTexture(GLenum texture);
+void gl_state_BindTexture(GLenum target, GLuint texture);
+void gl_state_Enable(GLenum cap);
+void gl_state_Disable(GLenum cap);
+
+//deleting objects unbinds them, so deletes also go through the cache:
+void gl_state_DeleteVertexArrays(GLsizei n, const GLuint *arrays);
+void gl_state_DeleteBuffers(GLsizei n, const GLuint *buffers);
+void gl_state_DeleteTextures(GLsizei n, const GLuint *textures);
+
+#ifndef GL_NO_STATE_CACHE
+#define glUseProgram gl_state_UseProgram
+#define glBindVertexArray gl_state_BindVertexArray
+#define glBindBuffer gl_state_BindBuffer
+#define glActiveTexture gl_state_ActiveTexture
+#define glBindTexture gl_state_BindTexture
+#define glEnable gl_state_Enable
+#define glDisable gl_state_Disable
+#define glDeleteVertexArrays gl_state_DeleteVertexArrays
+#define glDeleteBuffers gl_state_DeleteBuffers
+#define glDeleteTextures gl_state_DeleteTextures
+#endif
@@ -0,0 +1,311 @@
+#include "JobSystem.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+//index of the queue owned by the current thread (or -1U for non-worker threads):
+static thread_local JobSystem const *current_system = nullptr;
+static thread_local uint32_t current_queue = -1U;
+
+//allocate_shared< Task > draws from recycled blocks, so making tasks stops touching the heap once enough blocks exist:
+struct BlockPool {
+	std::mutex mutex;
+	std::vector< void * > free;
+};
+template< typename T >
+struct PoolAllocator {
+	using value_type = T;
+
+	PoolAllocator() = default;
+	template< typename U >
+	PoolAllocator(PoolAllocator< U > const &) { }
+
+	//(never destroyed, since tasks may be released during other static destructors)
+	static BlockPool &pool() {
+		static BlockPool *pool = new BlockPool;
+		return *pool;
+	}
+
+	T *allocate(size_t n) {
+		if (n == 1) {
+			BlockPool &blocks = pool();
+			std::unique_lock< std::mutex > lock(blocks.mutex);
+			if (!blocks.free.empty()) {
+				void *ret = blocks.free.back();
+				blocks.free.pop_back();
+				return static_cast< T * >(ret);
+			}
+		}
+		return static_cast< T * >(::operator new(n * sizeof(T)));
+	}
+	void deallocate(T *ptr, size_t n) {
+		if (n == 1) {
+			BlockPool &blocks = pool();
+			std::unique_lock< std::mutex > lock(blocks.mutex);
+			blocks.free.emplace_back(ptr);
+			return;
+		}
+		::operator delete(ptr);
+	}
+};
+template< typename T, typename U >
+bool operator==(PoolAllocator< T > const &, PoolAllocator< U > const &) { return true; }
+template< typename T, typename U >
+bool operator!=(PoolAllocator< T > const &, PoolAllocator< U > const &) { return false; }
+
+uint32_t JobSystem::default_worker_count() {
+	uint32_t hardware = std::thread::hardware_concurrency();
+	//(hardware_concurrency may return 0 if unknown)
+	return (hardware > 1 ? hardware - 1 : 0);
+}
+
+JobSystem &JobSystem::get() {
+	static JobSystem shared;
+	return shared;
+}
+
+JobSystem::JobSystem(uint32_t workers) {
+	queues.reserve(workers + 1);
+	for (uint32_t i = 0; i < workers + 1; ++i) {
+		queues.emplace_back(new Queue);
+	}
+	stats_start = std::chrono::steady_clock::now();
+
+	threads.reserve(workers);
+	for (uint32_t i = 0; i < workers; ++i) {
+		threads.emplace_back(&JobSystem::worker_loop, this, i);
+	}
+}
+
+JobSystem::~JobSystem() {
+	//help drain anything still queued:
+	while (run_one(uint32_t(queues.size()) - 1)) { }
+
+	{
+		std::unique_lock< std::mutex > lock(sleep_mutex);
+		quit = true;
+	}
+	wake.notify_all();
+	for (auto &thread : threads) {
+		thread.join();
+	}
+}
+
+JobSystem::TaskHandle JobSystem::make_task() {
+	return std::allocate_shared< Task >(PoolAllocator< Task >());
+}
+
+JobSystem::TaskHandle JobSystem::run(std::function< void() > const &fn, std::vector< TaskHandle > const &dependencies) {
+	TaskHandle task = make_task();
+	task->fn = fn;
+
+	for (auto const &dependency : dependencies) {
+		assert(dependency);
+		std::unique_lock< std::mutex > lock(dependency->mutex);
+		if (!dependency->finished) {
+			task->blockers += 1;
+			dependency->continuations.emplace_back(task);
+		}
+	}
+
+	//release the setup blocker; schedule if nothing else is pending:
+	if (--task->blockers == 0) {
+		schedule(task);
+	}
+	return task;
+}
+
+void JobSystem::schedule(TaskHandle const &task) {
+	//push to the calling worker's own queue, or to the shared queue from other threads:
+	uint32_t index = (current_system == this ? current_queue : uint32_t(queues.size()) - 1);
+	Queue &queue = *queues[index];
+	{
+		std::unique_lock< std::mutex > lock(queue.mutex);
+		//(counted before it can be taken, so a thief's 'queued -= 1' can never come first)
+		queued += 1;
+		queue.push_back(task);
+	}
+
+	{ //(taking the lock here prevents a worker from missing the wakeup between checking 'queued' and sleeping)
+		std::unique_lock< std::mutex > lock(sleep_mutex);
+	}
+	wake.notify_one();
+	notify_waiters(); //(a waiter may be able to help with it)
+}
+
+void JobSystem::notify_waiters() {
+	if (waiters == 0) return;
+	{ //(as in schedule, so a waiter can't miss this between checking and sleeping)
+		std::unique_lock< std::mutex > lock(sleep_mutex);
+	}
+	settled.notify_all();
+}
+
+template< typename Done >
+void JobSystem::help_until(Done const &done) {
+	uint32_t index = (current_system == this ? current_queue : uint32_t(queues.size()) - 1);
+	while (!done()) {
+		if (run_one(index)) continue;
+
+		//nothing to help with (the rest is running elsewhere), so sleep until a task finishes or more are queued:
+		std::unique_lock< std::mutex > lock(sleep_mutex);
+		waiters += 1;
+		settled.wait(lock, [&](){ return done() || queued > 0; });
+		waiters -= 1;
+	}
+}
+
+bool JobSystem::run_one(uint32_t index) {
+	TaskHandle task;
+	bool stolen = false;
+
+	{ //own queue first, newest task first:
+		Queue &own = *queues[index];
+		std::unique_lock< std::mutex > lock(own.mutex);
+		task = own.pop_back();
+	}
+
+	//otherwise, steal the oldest task from some other queue:
+	for (uint32_t offset = 1; !task && offset < queues.size(); ++offset) {
+		Queue &victim = *queues[(index + offset) % queues.size()];
+		std::unique_lock< std::mutex > lock(victim.mutex);
+		task = victim.pop_front();
+		stolen = bool(task);
+	}
+
+	if (!task) return false;
+
+	queued -= 1;
+	Queue &queue = *queues[index];
+	if (stolen) queue.steals += 1;
+	execute(task, queue);
+	return true;
+}
+
+void JobSystem::execute(TaskHandle const &task, Queue &queue) {
+	auto before = std::chrono::steady_clock::now();
+	if (task->range.call) {
+		task->range.call(task->range.data, task->begin, task->end);
+	} else {
+		task->fn();
+		task->fn = nullptr; //release any captured state
+	}
+	auto after = std::chrono::steady_clock::now();
+
+	queue.tasks_run += 1;
+	queue.busy_ns += uint64_t(std::chrono::duration_cast< std::chrono::nanoseconds >(after - before).count());
+
+	std::vector< TaskHandle > continuations;
+	{
+		std::unique_lock< std::mutex > lock(task->mutex);
+		task->finished = true;
+		continuations = std::move(task->continuations);
+	}
+	for (auto const &next : continuations) {
+		if (--next->blockers == 0) {
+			schedule(next);
+		}
+	}
+
+	//(last, since the parallel_for that owns 'remaining' -- and the range function -- may return as soon as it hits zero)
+	if (task->remaining) *task->remaining -= 1;
+	notify_waiters();
+}
+
+void JobSystem::wait(TaskHandle const &task) {
+	assert(task);
+	help_until([&task](){ return task->finished.load(); });
+}
+
+void JobSystem::parallel_for(uint32_t begin, uint32_t end, uint32_t grain, RangeFn const &fn) {
+	if (begin >= end) return;
+	grain = std::max(grain, 1U);
+
+	//small ranges (or no workers) run inline:
+	if (threads.empty() || end - begin <= grain) {
+		for (uint32_t b = begin; b < end; b += grain) {
+			fn.call(fn.data, b, std::min(end, b + grain));
+		}
+		return;
+	}
+
+	std::atomic< uint32_t > remaining{ (end - begin + grain - 1) / grain };
+	for (uint32_t b = begin; b < end; b += grain) {
+		TaskHandle chunk = make_task();
+		chunk->range = fn;
+		chunk->begin = b;
+		chunk->end = std::min(end, b + grain);
+		chunk->remaining = &remaining;
+		chunk->blockers = 0;
+		schedule(chunk);
+	}
+	//help until every chunk is done (this thread pops from the back of its queue, so it starts with the chunks it queued last):
+	help_until([&remaining](){ return remaining == 0; });
+}
+
+void JobSystem::Queue::push_back(TaskHandle const &task) {
+	if (count == ring.size()) {
+		//full: grow, unwrapping the ring so the oldest task is at index 0:
+		std::vector< TaskHandle > grown(std::max< size_t >(16, ring.size() * 2));
+		for (uint32_t i = 0; i < count; ++i) {
+			grown[i] = std::move(ring[(head + i) & (ring.size() - 1)]);
+		}
+		ring = std::move(grown);
+		head = 0;
+	}
+	ring[(head + count) & (ring.size() - 1)] = task;
+	count += 1;
+}
+
+JobSystem::TaskHandle JobSystem::Queue::pop_back() {
+	if (count == 0) return nullptr;
+	count -= 1;
+	return std::move(ring[(head + count) & (ring.size() - 1)]);
+}
+
+JobSystem::TaskHandle JobSystem::Queue::pop_front() {
+	if (count == 0) return nullptr;
+	TaskHandle ret = std::move(ring[head]);
+	head = (head + 1) & uint32_t(ring.size() - 1);
+	count -= 1;
+	return ret;
+}
+
+std::vector< JobSystem::WorkerStats > JobSystem::stats() const {
+	double elapsed = std::chrono::duration< double >(std::chrono::steady_clock::now() - stats_start).count();
+	std::vector< WorkerStats > ret;
+	ret.reserve(queues.size());
+	for (auto const &queue : queues) {
+		ret.emplace_back();
+		ret.back().tasks = queue->tasks_run;
+		ret.back().steals = queue->steals;
+		ret.back().busy = double(queue->busy_ns) * 1e-9;
+		ret.back().elapsed = elapsed;
+	}
+	return ret;
+}
+
+void JobSystem::reset_stats() {
+	for (auto &queue : queues) {
+		queue->tasks_run = 0;
+		queue->steals = 0;
+		queue->busy_ns = 0;
+	}
+	stats_start = std::chrono::steady_clock::now();
+}
+
+void JobSystem::worker_loop(uint32_t index) {
+	current_system = this;
+	current_queue = index;
+
+	while (true) {
+		if (run_one(index)) continue;
+
+		std::unique_lock< std::mutex > lock(sleep_mutex);
+		wake.wait(lock, [this](){ return quit || queued > 0; });
+		if (quit && queued == 0) break;
+	}
+
+	current_system = nullptr;
+	current_queue = -1U;
+}
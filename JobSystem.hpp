@@ -0,0 +1,145 @@
+#pragma once
+
+/*
+ * JobSystem is a small work-stealing task scheduler.
+ *
+ * Each worker thread owns a deque of tasks: it pushes and pops work at the back
+ *  (so recently-spawned, cache-warm tasks run first) and, when it runs dry,
+ *  steals from the front of other workers' deques.
+ * Threads that aren't workers (e.g., the main thread) push into a shared deque
+ *  and help run tasks while they wait.
+ *
+ * Example:
+ *  JobSystem &jobs = JobSystem::get();
+ *  auto a = jobs.run([](){ ... });
+ *  auto b = jobs.run([](){ ... });
+ *  auto c = jobs.run([](){ ... }, {a, b}); //runs after a and b finish
+ *  jobs.wait(c);
+ *
+ *  jobs.parallel_for(0, count, 64, [&](uint32_t begin, uint32_t end){
+ *      for (uint32_t i = begin; i < end; ++i) { ... }
+ *  });
+ *
+ * Tasks may spawn and wait on other tasks. It is safe to use from Load<> functions,
+ *  physics, and draw preparation -- but tasks must not make OpenGL calls.
+ *
+ * Task records come from a recycled pool and queues are ring buffers, so once they have
+ *  grown to fit, parallel_for doesn't touch the heap. ('run' copies its std::function,
+ *  which may allocate for large captures, and tasks with dependencies allocate continuations.)
+ */
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct JobSystem {
+	//start 'workers' worker threads; by default, one fewer than the hardware concurrency
+	// (since the thread calling 'wait' also runs tasks):
+	JobSystem(uint32_t workers = default_worker_count());
+	~JobSystem(); //finishes all queued tasks, then joins workers
+
+	JobSystem(JobSystem const &) = delete;
+
+	//shared instance (created on first use):
+	static JobSystem &get();
+
+	static uint32_t default_worker_count();
+
+	struct Task;
+	using TaskHandle = std::shared_ptr< Task >;
+
+	//queue 'fn' to run once every task in 'dependencies' has finished:
+	TaskHandle run(std::function< void() > const &fn, std::vector< TaskHandle > const &dependencies = {});
+
+	//block until 'task' is finished (running other tasks in the meantime):
+	void wait(TaskHandle const &task);
+
+	//call fn(chunk_begin, chunk_end) over [begin,end) in chunks of (at most) 'grain' elements:
+	// returns once all chunks are done; chunk boundaries are always begin + k * grain
+	// ('fn' is called by reference, never copied)
+	template< typename Fn >
+	void parallel_for(uint32_t begin, uint32_t end, uint32_t grain, Fn const &fn) {
+		parallel_for(begin, end, grain, RangeFn{ &fn, [](void const *data, uint32_t b, uint32_t e) {
+			(*static_cast< Fn const * >(data))(b, e);
+		} });
+	}
+
+	//non-owning reference to a parallel_for function (so chunks don't need a std::function each):
+	struct RangeFn {
+		void const *data = nullptr;
+		void (*call)(void const *data, uint32_t begin, uint32_t end) = nullptr;
+	};
+	void parallel_for(uint32_t begin, uint32_t end, uint32_t grain, RangeFn const &fn);
+
+	//utilization counters (per worker, plus one last entry for all non-worker threads):
+	struct WorkerStats {
+		uint64_t tasks = 0; //tasks run
+		uint64_t steals = 0; //tasks taken from another thread's deque
+		double busy = 0.0; //seconds spent running tasks
+		double elapsed = 0.0; //seconds since counters were reset
+		float utilization() const { return (elapsed > 0.0 ? float(busy / elapsed) : 0.0f); }
+	};
+	std::vector< WorkerStats > stats() const;
+	void reset_stats();
+
+	uint32_t worker_count() const { return uint32_t(threads.size()); }
+
+	//-- internals --
+
+	struct Task {
+		std::function< void() > fn;
+		//parallel_for chunks call range(begin, end) instead of 'fn', then count down *remaining:
+		RangeFn range;
+		uint32_t begin = 0, end = 0;
+		std::atomic< uint32_t > *remaining = nullptr;
+		std::atomic< uint32_t > blockers{1}; //unfinished dependencies (+1 while being set up)
+		std::atomic< bool > finished{false};
+		std::mutex mutex; //protects 'continuations' (and finishing)
+		std::vector< TaskHandle > continuations; //tasks depending on this one
+	};
+
+	struct Queue {
+		std::mutex mutex;
+		//tasks, oldest first, in a ring buffer (a std::deque would keep allocating as it wraps around):
+		std::vector< TaskHandle > ring; //(size is zero or a power of two)
+		uint32_t head = 0; //index of oldest task
+		uint32_t count = 0;
+		void push_back(TaskHandle const &task);
+		TaskHandle pop_back(); //newest task (or null)
+		TaskHandle pop_front(); //oldest task (or null)
+		//counters:
+		std::atomic< uint64_t > tasks_run{0};
+		std::atomic< uint64_t > steals{0};
+		std::atomic< uint64_t > busy_ns{0};
+	};
+	//queues[0 .. workers-1] belong to workers; queues.back() is shared by all other threads:
+	std::vector< std::unique_ptr< Queue > > queues;
+	std::vector< std::thread > threads;
+
+	std::chrono::steady_clock::time_point stats_start;
+
+	//sleeping workers wait on 'wake' when no tasks are queued:
+	std::mutex sleep_mutex;
+	std::condition_variable wake;
+	std::atomic< uint32_t > queued{0}; //(incremented under the queue's lock, before the task can be taken)
+	//threads in wait() / parallel_for() with nothing to help with sleep on 'settled' until a task finishes or is queued:
+	std::condition_variable settled;
+	std::atomic< uint32_t > waiters{0};
+	bool quit = false;
+
+	TaskHandle make_task(); //(from the pool)
+	void schedule(TaskHandle const &task);
+	bool run_one(uint32_t queue_index); //returns false if no task could be found
+	void execute(TaskHandle const &task, Queue &queue);
+	void notify_waiters();
+	//run tasks until done() is true, sleeping on 'settled' when there are none to run:
+	template< typename Done >
+	void help_until(Done const &done);
+	void worker_loop(uint32_t index);
+};
@@ -0,0 +1,54 @@
+#include "LatencyMeter.hpp"
+
+#include <iostream>
+
+void LatencyMeter::event(SDL_Event const &evt) {
+	if (evt.type == SDL_MOUSEMOTION || evt.type == SDL_MOUSEBUTTONDOWN || evt.type == SDL_MOUSEBUTTONUP || evt.type == SDL_KEYDOWN || evt.type == SDL_KEYUP) {
+		uint32_t t = evt.common.timestamp;
+		if (evt.type == SDL_MOUSEMOTION && latched_until != 0 && t <= latched_until) return; //(already counted by latched())
+		if (t == 0) t = 1; //(0 is reserved for 'no input')
+		if (oldest_input == 0 || t < oldest_input) oldest_input = t;
+	}
+}
+
+uint32_t LatencyMeter::take_input_time() {
+	uint32_t ret = oldest_input;
+	oldest_input = 0;
+	return ret;
+}
+
+uint32_t LatencyMeter::latched(uint32_t input_time, uint32_t latch_time) {
+	if (latch_time == 0) return input_time;
+	latched_until = latch_time;
+	return (input_time != 0 ? input_time : latch_time);
+}
+
+void LatencyMeter::swapped(uint32_t input_time) {
+	uint32_t now = SDL_GetTicks();
+	if (report_start == 0) report_start = now;
+
+	frames += 1;
+	if (input_time != 0) {
+		uint32_t ms = now - input_time;
+		samples += 1;
+		total_ms += ms;
+		if (ms < min_ms) min_ms = ms;
+		if (ms > max_ms) max_ms = ms;
+	}
+
+	//report every few seconds:
+	if (now - report_start >= 5000) {
+		if (samples) {
+			std::cout << "Input-to-swap latency over " << samples << " of " << frames << " frames: "
+			          << "min " << min_ms << " ms, avg " << (float(total_ms) / float(samples)) << " ms, max " << max_ms << " ms." << std::endl;
+		} else {
+			std::cout << "Input-to-swap latency: no input in the last " << frames << " frames." << std::endl;
+		}
+		report_start = now;
+		samples = 0;
+		total_ms = 0;
+		min_ms = -1U;
+		max_ms = 0;
+		frames = 0;
+	}
+}
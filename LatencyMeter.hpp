@@ -0,0 +1,47 @@
+#pragma once
+
+/*
+ * LatencyMeter estimates input-to-photon latency:
+ *  the main loop notes the SDL timestamp of each input event it polls,
+ *  and reports when the frame that consumed those events has been swapped.
+ *
+ * Latency is measured from the oldest input event in a frame to the end of that
+ *  frame's swap (with a glFinish() so the swap has actually happened), and summary
+ *  statistics are printed every few seconds.
+ *
+ * Enable in the game with the '--latency' command line flag.
+ */
+
+#include <SDL.h>
+
+#include <cstdint>
+
+struct LatencyMeter {
+	//call for every polled event (only input events are noted):
+	void event(SDL_Event const &evt);
+
+	//take the timestamp of the oldest input event noted since the last call (or 0 if none):
+	// (call once per frame, just before drawing/submitting the frame)
+	uint32_t take_input_time();
+
+	//call (after take_input_time) if the frame also shows input pulled in at 'latch_time' while drawing:
+	// returns the frame's input time accounting for it, and makes 'event' skip the mouse motion that was
+	// pumped into the queue by then (it gets polled next frame, but this frame already showed it)
+	uint32_t latched(uint32_t input_time, uint32_t latch_time);
+
+	//call after the swap for a frame whose oldest input was at 'input_time' has completed:
+	// (may be called from a render thread)
+	void swapped(uint32_t input_time);
+
+	//-- internals --
+	uint32_t oldest_input = 0; //oldest input event this frame (SDL ticks, ms), 0 if none
+	uint32_t latched_until = 0; //mouse motion up to this time was already shown (SDL ticks, ms), 0 if none
+
+	//statistics since last report (only touched by the thread calling 'swapped'):
+	uint32_t report_start = 0;
+	uint32_t samples = 0;
+	uint32_t total_ms = 0;
+	uint32_t min_ms = -1U;
+	uint32_t max_ms = 0;
+	uint32_t frames = 0;
+};
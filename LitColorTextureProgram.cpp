@@ -1,44 +1,29 @@
 #include "LitColorTextureProgram.hpp"
 
 #include "gl_compile_program.hpp"
+#include "UniformBlocks.hpp"
+#include "TextureArrays.hpp"
 #include "gl_errors.hpp"
 
-Scene::Drawable::Pipeline lit_color_texture_program_pipeline;
+Scene::Material lit_color_texture_program_material;
 
 Load< LitColorTextureProgram > lit_color_texture_program(LoadTagEarly, []() -> LitColorTextureProgram const * {
 	LitColorTextureProgram *ret = new LitColorTextureProgram();
 
-	//----- build the pipeline template -----
-	lit_color_texture_program_pipeline.program = ret->program;
+	//----- build the material template -----
+	lit_color_texture_program_material.program = ret->program;
 
-	lit_color_texture_program_pipeline.OBJECT_TO_CLIP_mat4 = ret->OBJECT_TO_CLIP_mat4;
-	lit_color_texture_program_pipeline.OBJECT_TO_LIGHT_mat4x3 = ret->OBJECT_TO_LIGHT_mat4x3;
-	lit_color_texture_program_pipeline.NORMAL_TO_LIGHT_mat3 = ret->NORMAL_TO_LIGHT_mat3;
+	//(transforms come from the "Object" block; lighting from the "Frame" block, set with set_frame_uniforms())
+	lit_color_texture_program_material.Object_block = ret->Object_block;
+	//(lets Scene::draw pre-pass depth with a position-only program)
+	lit_color_texture_program_material.Position_location = ret->Position_vec4;
 
-	/* This will be used later if/when we build a light loop into the Scene:
-	lit_color_texture_program_pipeline.LIGHT_TYPE_int = ret->LIGHT_TYPE_int;
-	lit_color_texture_program_pipeline.LIGHT_LOCATION_vec3 = ret->LIGHT_LOCATION_vec3;
-	lit_color_texture_program_pipeline.LIGHT_DIRECTION_vec3 = ret->LIGHT_DIRECTION_vec3;
-	lit_color_texture_program_pipeline.LIGHT_ENERGY_vec3 = ret->LIGHT_ENERGY_vec3;
-	lit_color_texture_program_pipeline.LIGHT_CUTOFF_float = ret->LIGHT_CUTOFF_float;
-	*/
-
-	//make a 1-pixel white texture to bind by default:
-	GLuint tex;
-	glGenTextures(1, &tex);
-
-	glBindTexture(GL_TEXTURE_2D, tex);
-	std::vector< glm::u8vec4 > tex_data(1, glm::u8vec4(0xff));
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, tex_data.data());
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glBindTexture(GL_TEXTURE_2D, 0);
-
-
-	lit_color_texture_program_pipeline.textures[0].texture = tex;
-	lit_color_texture_program_pipeline.textures[0].target = GL_TEXTURE_2D;
+	//sample a white texel by default (it lives in the level texture arrays, so textured materials share its binding):
+	TextureArrays::Slot white = TextureArrays::get().white();
+	lit_color_texture_program_material.textures[0].texture = white.texture;
+	lit_color_texture_program_material.textures[0].target = GL_TEXTURE_2D_ARRAY;
+	lit_color_texture_program_material.texture_layer = white.layer;
+	lit_color_texture_program_material.texture_rect = white.rect;
 
 	return ret;
 });
@@ -48,9 +33,7 @@ LitColorTextureProgram::LitColorTextureProgram() {
 	program = gl_compile_program(
 		//vertex shader:
 		"#version 330\n"
-		"uniform mat4 OBJECT_TO_CLIP;\n"
-		"uniform mat4x3 OBJECT_TO_LIGHT;\n"
-		"uniform mat3 NORMAL_TO_LIGHT;\n"
+		OBJECT_BLOCK_GLSL
 		"in vec4 Position;\n"
 		"in vec3 Normal;\n"
 		"in vec4 Color;\n"
@@ -58,27 +41,25 @@ LitColorTextureProgram::LitColorTextureProgram() {
 		"out vec3 position;\n"
 		"out vec3 normal;\n"
 		"out vec4 color;\n"
-		"out vec2 texCoord;\n"
+		"out vec3 texCoord;\n"
+		"invariant gl_Position;\n" //(must match PositionOnlyProgram's depth exactly)
 		"void main() {\n"
 		"	gl_Position = OBJECT_TO_CLIP * Position;\n"
 		"	position = OBJECT_TO_LIGHT * Position;\n"
 		"	normal = NORMAL_TO_LIGHT * Normal;\n"
 		"	color = Color;\n"
-		"	texCoord = TexCoord;\n"
+		"	texCoord = vec3(TexCoord, TEX_LAYER);\n"
 		"}\n"
 	,
 		//fragment shader:
 		"#version 330\n"
-		"uniform sampler2D TEX;\n"
-		"uniform int LIGHT_TYPE;\n"
-		"uniform vec3 LIGHT_LOCATION;\n"
-		"uniform vec3 LIGHT_DIRECTION;\n"
-		"uniform vec3 LIGHT_ENERGY;\n"
-		"uniform float LIGHT_CUTOFF;\n"
+		"uniform sampler2DArray TEX;\n"
+		FRAME_BLOCK_GLSL
+		OBJECT_BLOCK_GLSL
 		"in vec3 position;\n"
 		"in vec3 normal;\n"
 		"in vec4 color;\n"
-		"in vec2 texCoord;\n"
+		"in vec3 texCoord;\n"
 		"out vec4 fragColor;\n"
 		"void main() {\n"
 		"	vec3 n = normalize(normal);\n"
@@ -102,7 +83,9 @@ LitColorTextureProgram::LitColorTextureProgram() {
 		"	} else { //(LIGHT_TYPE == 3) //directional light \n"
 		"		e = max(0.0, dot(n,-LIGHT_DIRECTION)) * LIGHT_ENERGY;\n"
 		"	}\n"
-		"	vec4 albedo = texture(TEX, texCoord) * color;\n"
+		"	//map into the texture's slot (packed textures clamp, so they never sample their neighbors; see TextureArrays.hpp):\n"
+		"	vec2 uv = (TEX_RECT.zw == vec2(1.0) ? texCoord.xy : clamp(texCoord.xy, 0.0, 1.0));\n"
+		"	vec4 albedo = texture(TEX, vec3(TEX_RECT.xy + uv * TEX_RECT.zw, texCoord.z)) * color;\n"
 		"	fragColor = vec4(e*albedo.rgb, albedo.a);\n"
 		"}\n"
 	);
@@ -115,24 +98,17 @@ LitColorTextureProgram::LitColorTextureProgram() {
 	Color_vec4 = glGetAttribLocation(program, "Color");
 	TexCoord_vec2 = glGetAttribLocation(program, "TexCoord");
 
-	//look up the locations of uniforms:
-	OBJECT_TO_CLIP_mat4 = glGetUniformLocation(program, "OBJECT_TO_CLIP");
-	OBJECT_TO_LIGHT_mat4x3 = glGetUniformLocation(program, "OBJECT_TO_LIGHT");
-	NORMAL_TO_LIGHT_mat3 = glGetUniformLocation(program, "NORMAL_TO_LIGHT");
-
-	LIGHT_TYPE_int = glGetUniformLocation(program, "LIGHT_TYPE");
-	LIGHT_LOCATION_vec3 = glGetUniformLocation(program, "LIGHT_LOCATION");
-	LIGHT_DIRECTION_vec3 = glGetUniformLocation(program, "LIGHT_DIRECTION");
-	LIGHT_ENERGY_vec3 = glGetUniformLocation(program, "LIGHT_ENERGY");
-	LIGHT_CUTOFF_float = glGetUniformLocation(program, "LIGHT_CUTOFF");
+	//look up (and bind) the uniform blocks:
+	bind_uniform_blocks(program, &Frame_block, &Object_block);
 
+	//look up the locations of uniforms:
 
-	GLuint TEX_sampler2D = glGetUniformLocation(program, "TEX");
+	GLuint TEX_sampler2DArray = glGetUniformLocation(program, "TEX");
 
 	//set TEX to always refer to texture binding zero:
 	glUseProgram(program); //bind program -- glUniform* calls refer to this program now
 
-	glUniform1i(TEX_sampler2D, 0); //set TEX to sample from GL_TEXTURE0
+	glUniform1i(TEX_sampler2DArray, 0); //set TEX to sample from GL_TEXTURE0
 
 	glUseProgram(0); //unbind program -- glUniform* calls refer to ??? now
 }
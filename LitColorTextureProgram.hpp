@@ -17,24 +17,16 @@ struct LitColorTextureProgram {
 	GLuint Color_vec4 = -1U;
 	GLuint TexCoord_vec2 = -1U;
 
-	//Uniform (per-invocation variable) locations:
-	GLuint OBJECT_TO_CLIP_mat4 = -1U;
-	GLuint OBJECT_TO_LIGHT_mat4x3 = -1U;
-	GLuint NORMAL_TO_LIGHT_mat3 = -1U;
-
-	//lighting:
-	GLuint LIGHT_TYPE_int = -1U;
-	GLuint LIGHT_LOCATION_vec3 = -1U;
-	GLuint LIGHT_DIRECTION_vec3 = -1U;
-	GLuint LIGHT_ENERGY_vec3 = -1U;
-	GLuint LIGHT_CUTOFF_float = -1U;
-	
+	//Uniform blocks (see UniformBlocks.hpp):
+	GLuint Frame_block = -1U; //lighting (LIGHT_TYPE, LIGHT_LOCATION, LIGHT_DIRECTION, LIGHT_ENERGY, LIGHT_CUTOFF)
+	GLuint Object_block = -1U; //transforms (OBJECT_TO_CLIP, OBJECT_TO_LIGHT, NORMAL_TO_LIGHT)
+
 	//Textures:
-	//TEXTURE0 - texture that is accessed by TexCoord
+	//TEXTURE0 - array texture that is accessed by TexCoord (mapped into the drawable's TEX_RECT / TEX_LAYER; see TextureArrays.hpp)
 };
 
 extern Load< LitColorTextureProgram > lit_color_texture_program;
 
-//For convenient scene-graph setup, copy this object:
-// NOTE: by default, has texture bound to 1-pixel white texture -- so it's okay to use with vertex-color-only meshes.
-extern Scene::Drawable::Pipeline lit_color_texture_program_pipeline;
+//For convenient scene-graph setup, add this material to a scene (Scene::add_material):
+// NOTE: by default, samples a white texel (TextureArrays::white()) -- so it's okay to use with vertex-color-only meshes.
+extern Scene::Material lit_color_texture_program_material;
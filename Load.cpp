@@ -21,6 +21,7 @@ void call_load_functions() {
 	static bool has_been_called = false;
 	assert(!has_been_called && "call_load_functions should only be called *once*");
 	has_been_called = true;
+	(void)has_been_called; //(only read by the assert)
 
 	auto &load_lists = get_load_lists();
 	for (auto &fn_list : load_lists) {
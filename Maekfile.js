@@ -30,6 +30,7 @@ if (maek.OS === "windows") {
 		`/I${NEST_LIBS}/SDL2/include`,
 		`/I${NEST_LIBS}/glm/include`,
 		`/I${NEST_LIBS}/libpng/include`,
+		`/I${NEST_LIBS}/zlib/include`,
 		//#disable a few warnings:
 		`/wd4146`, //-1U is still unsigned
 		`/wd4297`, //unforunately SDLmain is nothrow
@@ -49,7 +50,8 @@ if (maek.OS === "windows") {
 		//include paths for nest libraries:
 		`-I${NEST_LIBS}/SDL2/include/SDL2`, `-D_THREAD_SAFE`, //the output of sdl-config --cflags
 		`-I${NEST_LIBS}/glm/include`,
-		`-I${NEST_LIBS}/libpng/include`
+		`-I${NEST_LIBS}/libpng/include`,
+		`-I${NEST_LIBS}/zlib/include`
 	);
 	maek.options.LINKLibs.push(
 		//linker flags for nest libraries:
@@ -63,7 +65,8 @@ if (maek.OS === "windows") {
 		//include paths for nest libraries:
 		`-I${NEST_LIBS}/SDL2/include/SDL2`, `-D_THREAD_SAFE`, //the output of sdl-config --cflags
 		`-I${NEST_LIBS}/glm/include`,
-		`-I${NEST_LIBS}/libpng/include`
+		`-I${NEST_LIBS}/libpng/include`,
+		`-I${NEST_LIBS}/zlib/include`
 	);
 	maek.options.LINKLibs.push(
 		//linker flags for nest libraries:
@@ -93,26 +96,52 @@ if (maek.OS === 'windows') {
 // cppFile: name of c++ file to compile
 // objFileBase (optional): base name object file to produce (if not supplied, set to options.objDir + '/' + cppFile without the extension)
 //returns objFile: objFileBase + a platform-dependant suffix ('.o' or '.obj')
+const main_names = [
+	maek.CPP('main.cpp'),
+	maek.CPP('LatencyMeter.cpp')
+];
+
 const game_names = [
 	maek.CPP('PlayMode.cpp'),
-	maek.CPP('main.cpp'),
 	maek.CPP('LitColorTextureProgram.cpp')
 	//, maek.CPP('ColorTextureProgram.cpp')  //not used right now, but you might want it
 ];
 
+//objects that the offline tools share with the game (maek.CPP should only be called once per file):
+const triangle_bvh_obj = maek.CPP('TriangleBVH.cpp');
+const data_path_obj = maek.CPP('data_path.cpp');
+const asset_pack_obj = maek.CPP('AssetPack.cpp');
+const cooked_texture_obj = maek.CPP('CookedTexture.cpp');
+const load_save_png_obj = maek.CPP('load_save_png.cpp');
+
 const common_names = [
-	maek.CPP('data_path.cpp'),
+	data_path_obj,
 	maek.CPP('PathFont.cpp'),
 	maek.CPP('PathFont-font.cpp'),
 	maek.CPP('DrawLines.cpp'),
 	maek.CPP('ColorProgram.cpp'),
 	maek.CPP('Scene.cpp'),
+	maek.CPP('UniformBlocks.cpp'),
 	maek.CPP('Mesh.cpp'),
-	maek.CPP('load_save_png.cpp'),
+	maek.CPP('StaticGeometry.cpp'),
+	maek.CPP('TextureArrays.cpp'),
+	maek.CPP('DynamicResolution.cpp'),
+	maek.CPP('PositionOnlyProgram.cpp'),
+	cooked_texture_obj,
+	load_save_png_obj,
+	maek.CPP('load_pngs.cpp'),
 	maek.CPP('gl_compile_program.cpp'),
 	maek.CPP('Mode.cpp'),
+	maek.CPP('RenderThread.cpp'),
+	maek.CPP('JobSystem.cpp'),
+	maek.CPP('FrameArena.cpp'),
+	triangle_bvh_obj,
+	maek.CPP('SceneQuery.cpp'),
+	maek.CPP('Attraction.cpp'),
 	maek.CPP('GL.cpp'),
-	maek.CPP('Load.cpp')
+	maek.CPP('gl_errors.cpp'),
+	maek.CPP('Load.cpp'),
+	asset_pack_obj
 ];
 
 const show_mesh_names = [
@@ -127,16 +156,59 @@ const show_scene_names = [
 	maek.CPP('ShowSceneMode.cpp')
 ];
 
+//offline tool that indexes and re-orders exported meshes (no OpenGL needed):
+const cook_mesh_names = [
+	maek.CPP('cook-meshes.cpp'),
+	maek.CPP('MeshOptimize.cpp'),
+	triangle_bvh_obj
+];
+
+//offline tool that builds mip chains for textures (no OpenGL needed):
+const cook_texture_names = [
+	maek.CPP('cook-textures.cpp'),
+	cooked_texture_obj,
+	load_save_png_obj
+];
+
+//offline tool that bundles assets into a single pack file:
+const pack_asset_names = [
+	maek.CPP('pack-assets.cpp'),
+	asset_pack_obj,
+	data_path_obj
+];
+
+//the benchmark suite links against the game code (but not the game's main):
+const benchmark_names = [
+	maek.CPP('benchmarks.cpp')
+];
+
 //the '[exeFile =] LINK(objFiles, exeFileBase, [, options])' links an array of objects into an executable:
 // objFiles: array of objects to link
 // exeFileBase: name of executable file to produce
 //returns exeFile: exeFileBase + a platform-dependant suffix (e.g., '.exe' on windows)
-const game_exe = maek.LINK([...game_names, ...common_names], 'dist/game');
+const game_exe = maek.LINK([...main_names, ...game_names, ...common_names], 'dist/game');
 const show_meshes_exe = maek.LINK([...show_mesh_names, ...common_names], 'scenes/show-meshes');
 const show_scene_exe = maek.LINK([...show_scene_names, ...common_names], 'scenes/show-scene');
+//(cook meshes with, e.g., scenes/cook-meshes dist/levels/lvl0.pnct dist/levels/lvl0.pnci)
+const cook_meshes_exe = maek.LINK(cook_mesh_names, 'scenes/cook-meshes');
+//(cook textures with, e.g., scenes/cook-textures --cache scenes/texture-cache levels/grass.png dist/levels/grass.tex)
+const cook_textures_exe = maek.LINK(cook_texture_names, 'scenes/cook-textures');
+//(pack assets with, e.g., scenes/pack-assets dist/assets.pack dist/ levels/lvl0.pnci levels/lvl0.scene)
+const pack_assets_exe = maek.LINK(pack_asset_names, 'scenes/pack-assets');
+//(benchmarks live next to the game so that data_path() finds the levels)
+const benchmarks_exe = maek.LINK([...benchmark_names, ...game_names, ...common_names], 'dist/benchmarks');
 
 //set the default target to the game (and copy the readme files):
-maek.TARGETS = [game_exe, show_meshes_exe, show_scene_exe, ...copies];
+maek.TARGETS = [game_exe, show_meshes_exe, show_scene_exe, cook_meshes_exe, cook_textures_exe, pack_assets_exe, ...copies];
+
+//the benchmark suite isn't built by default; build it with:
+//  $ node Maekfile.js :benchmarks
+//and run it with:
+//  $ dist/benchmarks --out bench_output.csv
+const benchmarks_task = async () => { };
+benchmarks_task.depends = [benchmarks_exe];
+benchmarks_task.label = 'BENCHMARKS';
+maek.tasks[':benchmarks'] = benchmarks_task;
 
 //Note that tasks that produce ':abstract targets' are never cached.
 // This is similar to how .PHONY targets behave in make.
@@ -10,47 +10,63 @@
 #include <string>
 #include <set>
 #include <cstddef>
+#include <utility>
 
 MeshBuffer::MeshBuffer(std::string const &filename) {
-	glGenBuffers(1, &buffer);
-
 	std::ifstream file(filename, std::ios::binary);
+	load(file, filename);
+}
 
-	GLuint total = 0;
+MeshBuffer::MeshBuffer(std::istream &from, std::string const &filename) {
+	load(from, filename);
+}
 
-	struct Vertex {
-		glm::vec3 Position;
-		glm::vec3 Normal;
-		glm::u8vec4 Color;
-		glm::vec2 TexCoord;
-	};
-	static_assert(sizeof(Vertex) == 3*4+3*4+4*1+2*4, "Vertex is packed.");
+MeshBuffer::MeshBuffer(std::vector< Vertex > const &vertices, std::vector< uint32_t > const &indices, std::map< std::string, Mesh > const &meshes_) : meshes(meshes_) {
+	for (uint32_t i : indices) {
+		if (i >= vertices.size()) throw std::runtime_error("MeshBuffer given an out-of-range vertex index");
+	}
+	upload(vertices, indices);
+
+	GLuint total = GLuint(positions.size());
+	for (auto &[name, mesh] : meshes) {
+		if (!(mesh.start <= total && mesh.count <= total - mesh.start)) {
+			throw std::runtime_error("MeshBuffer given mesh '" + name + "' with an out-of-range start/count");
+		}
+		mesh.index_type = index_type;
+	}
+}
+
+void MeshBuffer::load(std::istream &file, std::string const &filename) {
 	std::vector< Vertex > data;
 
 	//read + upload data chunk:
+	bool indexed = false;
+	std::vector< uint32_t > indices;
 	if (filename.size() >= 5 && filename.substr(filename.size()-5) == ".pnct") {
 		read_chunk(file, "pnct", &data);
-
-		//upload data:
-		glBindBuffer(GL_ARRAY_BUFFER, buffer);
-		glBufferData(GL_ARRAY_BUFFER, data.size() * sizeof(Vertex), data.data(), GL_STATIC_DRAW);
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-		total = GLuint(data.size()); //store total for later checks on index
-
-		//store attrib locations:
-		Position = Attrib(3, GL_FLOAT, GL_FALSE, sizeof(Vertex), offsetof(Vertex, Position));
-		Normal = Attrib(3, GL_FLOAT, GL_FALSE, sizeof(Vertex), offsetof(Vertex, Normal));
-		Color = Attrib(4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Vertex), offsetof(Vertex, Color));
-		TexCoord = Attrib(2, GL_FLOAT, GL_FALSE, sizeof(Vertex), offsetof(Vertex, TexCoord));
+	} else if (filename.size() >= 5 && filename.substr(filename.size()-5) == ".pnci") {
+		read_chunk(file, "pnct", &data);
+		read_chunk(file, "i032", &indices);
+		for (uint32_t i : indices) {
+			if (i >= data.size()) throw std::runtime_error("mesh file '" + filename + "' has an out-of-range vertex index");
+		}
+		indexed = true;
 	} else {
 		throw std::runtime_error("Unknown file type '" + filename + "'");
 	}
 
+	upload(std::move(data), std::move(indices));
+
+	//(for indexed meshes, positions has one entry per index)
+	GLuint total = GLuint(positions.size()); //store total for later checks on index
+
 	std::vector< char > strings;
 	read_chunk(file, "str0", &strings);
 
+	std::vector< std::string > mesh_names; //(in index order, for lod entries)
+
 	{ //read index chunk, add to meshes:
+		//(for .pnci files, the ranges are of indices rather than vertices)
 		struct IndexEntry {
 			uint32_t name_begin, name_end;
 			uint32_t vertex_begin, vertex_end;
@@ -58,7 +74,7 @@ MeshBuffer::MeshBuffer(std::string const &filename) {
 		static_assert(sizeof(IndexEntry) == 16, "Index entry should be packed");
 
 		std::vector< IndexEntry > index;
-		read_chunk(file, "idx0", &index);
+		read_chunk(file, (indexed ? "idx1" : "idx0"), &index);
 
 		for (auto const &entry : index) {
 			if (!(entry.name_begin <= entry.name_end && entry.name_end <= strings.size())) {
@@ -68,13 +84,15 @@ MeshBuffer::MeshBuffer(std::string const &filename) {
 				throw std::runtime_error("index entry has out-of-range vertex start/count");
 			}
 			std::string name(&strings[0] + entry.name_begin, &strings[0] + entry.name_end);
+			mesh_names.emplace_back(name);
 			Mesh mesh;
 			mesh.type = GL_TRIANGLES;
 			mesh.start = entry.vertex_begin;
 			mesh.count = entry.vertex_end - entry.vertex_begin;
+			mesh.index_type = index_type;
 			for (uint32_t v = entry.vertex_begin; v < entry.vertex_end; ++v) {
-				mesh.min = glm::min(mesh.min, data[v].Position);
-				mesh.max = glm::max(mesh.max, data[v].Position);
+				mesh.min = glm::min(mesh.min, positions[v]);
+				mesh.max = glm::max(mesh.max, positions[v]);
 			}
 			bool inserted = meshes.insert(std::make_pair(name, mesh)).second;
 			if (!inserted) {
@@ -83,6 +101,32 @@ MeshBuffer::MeshBuffer(std::string const &filename) {
 		}
 	}
 
+	if (indexed && file.peek() != EOF) { //read simplified levels of detail (if the cooker made any):
+		struct LODEntry {
+			uint32_t mesh;
+			uint32_t index_begin, index_end;
+			float error;
+		};
+		static_assert(sizeof(LODEntry) == 16, "LOD entry should be packed");
+
+		std::vector< LODEntry > lods;
+		read_chunk(file, "lod0", &lods);
+
+		for (auto const &entry : lods) {
+			if (!(entry.mesh < mesh_names.size())) {
+				throw std::runtime_error("lod entry has out-of-range mesh");
+			}
+			if (!(entry.index_begin <= entry.index_end && entry.index_end <= total)) {
+				throw std::runtime_error("lod entry has out-of-range index start/count");
+			}
+			Mesh::LOD lod;
+			lod.start = entry.index_begin;
+			lod.count = entry.index_end - entry.index_begin;
+			lod.error = entry.error;
+			meshes.at(mesh_names[entry.mesh]).lods.emplace_back(lod);
+		}
+	}
+
 	if (file.peek() != EOF) {
 		std::cerr << "WARNING: trailing data in mesh file '" << filename << "'" << std::endl;
 	}
@@ -98,6 +142,52 @@ MeshBuffer::MeshBuffer(std::string const &filename) {
 	*/
 }
 
+void MeshBuffer::upload(std::vector< Vertex > data, std::vector< uint32_t > indices_) {
+	vertices = std::move(data);
+	indices = std::move(indices_);
+
+	glGenBuffers(1, &buffer);
+
+	{ //upload data:
+		glBindBuffer(GL_ARRAY_BUFFER, buffer);
+		glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(), GL_STATIC_DRAW);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+		//store attrib locations:
+		Position = Attrib(3, GL_FLOAT, GL_FALSE, sizeof(Vertex), offsetof(Vertex, Position));
+		Normal = Attrib(3, GL_FLOAT, GL_FALSE, sizeof(Vertex), offsetof(Vertex, Normal));
+		Color = Attrib(4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Vertex), offsetof(Vertex, Color));
+		TexCoord = Attrib(2, GL_FLOAT, GL_FALSE, sizeof(Vertex), offsetof(Vertex, TexCoord));
+	}
+
+	positions.clear();
+	if (!indices.empty()) {
+		//upload indices (as 16-bit indices when they fit, which halves index fetch bandwidth):
+		// (through the array buffer binding, since the element array binding belongs to whatever vertex array is bound)
+		glGenBuffers(1, &index_buffer);
+		glBindBuffer(GL_ARRAY_BUFFER, index_buffer);
+		if (vertices.size() <= 0x10000) {
+			index_type = GL_UNSIGNED_SHORT;
+			std::vector< uint16_t > shorts(indices.begin(), indices.end());
+			glBufferData(GL_ARRAY_BUFFER, shorts.size() * sizeof(uint16_t), shorts.data(), GL_STATIC_DRAW);
+		} else {
+			index_type = GL_UNSIGNED_INT;
+			glBufferData(GL_ARRAY_BUFFER, indices.size() * sizeof(uint32_t), indices.data(), GL_STATIC_DRAW);
+		}
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+		positions.reserve(indices.size());
+		for (uint32_t i : indices) {
+			positions.emplace_back(vertices[i].Position);
+		}
+	} else {
+		positions.reserve(vertices.size());
+		for (auto const &v : vertices) {
+			positions.emplace_back(v.Position);
+		}
+	}
+}
+
 const Mesh &MeshBuffer::lookup(std::string const &name) const {
 	auto f = meshes.find(name);
 	if (f == meshes.end()) {
@@ -128,6 +218,8 @@ GLuint MeshBuffer::make_vao_for_program(GLuint program) const {
 	bind_attribute("Color", Color);
 	bind_attribute("TexCoord", TexCoord);
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	//(the element array binding is part of the vertex array object's state)
+	if (index_buffer) glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer);
 	glBindVertexArray(0);
 
 	//Check that all active attributes were bound:
@@ -7,21 +7,37 @@
  *  a single OpenGL array buffer. Individual meshes can be looked up by name
  *  using the MeshBuffer::lookup() function.
  *
+ * MeshBuffer loads both exported ".pnct" files (plain triangle lists) and
+ *  ".pnci" files written by the cook-meshes tool (indexed, with triangles
+ *  ordered for the vertex cache and for less overdraw). It can also be built
+ *  from vertices already in memory (e.g., baked static geometry).
+ *
  */
 
 #include "GL.hpp"
 #include <glm/glm.hpp>
+#include <istream>
 #include <map>
 #include <limits>
 #include <string>
+#include <vector>
 
 
 struct Mesh {
 	//Meshes are vertex ranges (and primitive types) in their MeshBuffer:
 
 	GLenum type = GL_TRIANGLES; //type of primitives in mesh
-	GLuint start = 0; //index of first vertex
-	GLuint count = 0; //count of vertices
+	GLuint start = 0; //index of first vertex (or, for indexed meshes, of first index)
+	GLuint count = 0; //count of vertices (or, for indexed meshes, of indices)
+	GLenum index_type = GL_NONE; //GL_UNSIGNED_SHORT or GL_UNSIGNED_INT when drawn from the MeshBuffer's index_buffer
+
+	//simplified versions (cooked .pnci meshes only), coarser with each entry:
+	struct LOD {
+		GLuint start = 0; //index of first index
+		GLuint count = 0; //count of indices
+		float error = 0.0f; //largest distance between this and the full mesh's surface
+	};
+	std::vector< LOD > lods;
 
 	//Bounding box.
 	//useful for debug visualization and (perhaps, eventually) collision detection:
@@ -30,9 +46,22 @@ struct Mesh {
 };
 
 struct MeshBuffer {
+	//the vertex format of every MeshBuffer:
+	struct Vertex {
+		glm::vec3 Position;
+		glm::vec3 Normal;
+		glm::u8vec4 Color;
+		glm::vec2 TexCoord;
+	};
+	static_assert(sizeof(Vertex) == 3*4+3*4+4*1+2*4, "Vertex is packed.");
+
 	//construct from a file:
 	// note: will throw if file fails to read.
 	MeshBuffer(std::string const &filename);
+	//..or from a stream (e.g., an asset pack entry); 'filename' picks the format and names the data in messages:
+	MeshBuffer(std::istream &from, std::string const &filename);
+	//..or from vertices in memory, with 'meshes_' ranges being of 'indices' (or of vertices, if 'indices' is empty):
+	MeshBuffer(std::vector< Vertex > const &vertices, std::vector< uint32_t > const &indices, std::map< std::string, Mesh > const &meshes_);
 
 	//look up a particular mesh by name:
 	// note: will throw if mesh not found.
@@ -45,8 +74,25 @@ struct MeshBuffer {
 	//This is the OpenGL vertex buffer object containing the mesh data:
 	GLuint buffer = 0;
 
+	//Element array buffer for indexed (.pnci) meshes (0 if nothing is indexed):
+	GLuint index_buffer = 0;
+	GLenum index_type = GL_NONE; //GL_UNSIGNED_SHORT or GL_UNSIGNED_INT (if there is an index_buffer)
+
+	//CPU-side copy of the data in 'buffer' and 'index_buffer' (indices always 32-bit; empty if nothing is indexed),
+	// for load-time processing like baking static geometry:
+	std::vector< Vertex > vertices;
+	std::vector< uint32_t > indices;
+
+	//CPU-side copy of vertex positions as triangle lists, so positions[mesh.start] .. positions[mesh.start + mesh.count - 1]
+	// are the mesh's triangle corners whether or not it is indexed (used to build collision meshes):
+	std::vector< glm::vec3 > positions;
+
 	//-- internals ---
 
+	//used by the constructors:
+	void load(std::istream &from, std::string const &filename);
+	void upload(std::vector< Vertex > data, std::vector< uint32_t > indices); //(keeps them as 'vertices' and 'indices')
+
 	//used by the lookup() function:
 	std::map< std::string, Mesh > meshes;
 
@@ -0,0 +1,491 @@
+#include "MeshOptimize.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <unordered_map>
+
+VertexCacheStats analyze_vertex_cache(std::vector< uint32_t > const &indices, uint32_t vertex_count, uint32_t cache_size) {
+	assert(indices.size() % 3 == 0);
+	VertexCacheStats stats;
+	if (indices.empty()) return stats;
+
+	//FIFO cache, tracked by the time each vertex entered it:
+	std::vector< uint32_t > entered(vertex_count, 0);
+	std::vector< bool > used(vertex_count, false);
+	uint32_t time = cache_size + 1; //(so that entered == 0 is always out of the cache)
+	uint32_t misses = 0;
+	uint32_t unique = 0;
+	for (uint32_t i : indices) {
+		assert(i < vertex_count);
+		if (!used[i]) {
+			used[i] = true;
+			unique += 1;
+		}
+		if (time - entered[i] > cache_size) {
+			entered[i] = time;
+			time += 1;
+			misses += 1;
+		}
+	}
+	stats.acmr = float(misses) / float(indices.size() / 3);
+	stats.atvr = float(misses) / float(unique);
+	return stats;
+}
+
+//------------ vertex cache ------------
+
+//scoring parameters from Forsyth's article:
+static constexpr uint32_t CacheSize = 32; //modeled LRU cache size
+static constexpr float CacheDecayPower = 1.5f;
+static constexpr float LastTriScore = 0.75f;
+static constexpr float ValenceBoostScale = 2.0f;
+static constexpr float ValenceBoostPower = 0.5f;
+
+static float vertex_score(int32_t cache_position, uint32_t remaining) {
+	if (remaining == 0) return -1.0f; //(no triangles need this vertex anymore)
+	float score = 0.0f;
+	if (cache_position >= 0) {
+		if (cache_position < 3) {
+			//the last triangle's vertices get a fixed score, so the order doesn't just ping-pong:
+			score = LastTriScore;
+		} else {
+			float scaler = 1.0f / float(CacheSize - 3);
+			score = std::pow(1.0f - float(cache_position - 3) * scaler, CacheDecayPower);
+		}
+	}
+	//boost vertices with few triangles left, to get rid of lone triangles early:
+	score += ValenceBoostScale * std::pow(float(remaining), -ValenceBoostPower);
+	return score;
+}
+
+void optimize_vertex_cache(std::vector< uint32_t > *indices_, uint32_t vertex_count) {
+	assert(indices_);
+	std::vector< uint32_t > &indices = *indices_;
+	assert(indices.size() % 3 == 0);
+	uint32_t triangle_count = uint32_t(indices.size() / 3);
+	if (triangle_count == 0) return;
+
+	//vertex -> triangles adjacency (as offsets into one array):
+	std::vector< uint32_t > remaining(vertex_count, 0);
+	for (uint32_t i : indices) remaining[i] += 1;
+	std::vector< uint32_t > adjacency_offset(vertex_count + 1, 0);
+	for (uint32_t v = 0; v < vertex_count; ++v) adjacency_offset[v+1] = adjacency_offset[v] + remaining[v];
+	std::vector< uint32_t > adjacency(indices.size());
+	{
+		std::vector< uint32_t > fill(adjacency_offset.begin(), adjacency_offset.end() - 1);
+		for (uint32_t t = 0; t < triangle_count; ++t) {
+			for (uint32_t k = 0; k < 3; ++k) {
+				uint32_t v = indices[3*t+k];
+				adjacency[fill[v]++] = t;
+			}
+		}
+	}
+
+	std::vector< int32_t > cache_position(vertex_count, -1);
+	std::vector< float > score(vertex_count);
+	for (uint32_t v = 0; v < vertex_count; ++v) score[v] = vertex_score(-1, remaining[v]);
+
+	std::vector< float > triangle_score(triangle_count);
+	std::vector< bool > emitted(triangle_count, false);
+	for (uint32_t t = 0; t < triangle_count; ++t) {
+		triangle_score[t] = score[indices[3*t+0]] + score[indices[3*t+1]] + score[indices[3*t+2]];
+	}
+
+	std::vector< uint32_t > cache, next_cache;
+	cache.reserve(CacheSize + 3);
+	next_cache.reserve(CacheSize + 3);
+
+	std::vector< uint32_t > result;
+	result.reserve(indices.size());
+
+	uint32_t best = 0;
+	for (uint32_t t = 1; t < triangle_count; ++t) {
+		if (triangle_score[t] > triangle_score[best]) best = t;
+	}
+	uint32_t cursor = 0; //for finding a fresh triangle when nothing in the cache is usable
+
+	while (true) {
+		//emit the best triangle:
+		emitted[best] = true;
+		uint32_t const *tri = &indices[3*best];
+		for (uint32_t k = 0; k < 3; ++k) {
+			uint32_t v = tri[k];
+			result.emplace_back(v);
+
+			//remove the triangle from the vertex's (unemitted) adjacency:
+			uint32_t *begin = &adjacency[adjacency_offset[v]];
+			uint32_t *end = begin + remaining[v];
+			uint32_t *found = std::find(begin, end, best);
+			assert(found != end);
+			std::swap(*found, *(end - 1));
+			remaining[v] -= 1;
+		}
+
+		//move its vertices to the front of the (LRU) cache:
+		next_cache.assign(tri, tri + 3);
+		for (uint32_t v : cache) {
+			if (v != tri[0] && v != tri[1] && v != tri[2]) next_cache.emplace_back(v);
+		}
+		std::swap(cache, next_cache);
+		//(anything past CacheSize just fell out of the cache)
+		for (uint32_t i = CacheSize; i < cache.size(); ++i) cache_position[cache[i]] = -1;
+
+		//re-score the affected vertices, then their triangles, looking for the best next triangle:
+		for (uint32_t i = 0; i < cache.size(); ++i) {
+			uint32_t v = cache[i];
+			if (i < CacheSize) cache_position[v] = int32_t(i);
+			score[v] = vertex_score(cache_position[v], remaining[v]);
+		}
+		float best_score = -1.0f;
+		best = -1U;
+		for (uint32_t v : cache) {
+			for (uint32_t a = adjacency_offset[v]; a < adjacency_offset[v] + remaining[v]; ++a) {
+				uint32_t t = adjacency[a];
+				float s = score[indices[3*t+0]] + score[indices[3*t+1]] + score[indices[3*t+2]];
+				triangle_score[t] = s;
+				if (s > best_score) {
+					best_score = s;
+					best = t;
+				}
+			}
+		}
+		if (cache.size() > CacheSize) cache.resize(CacheSize);
+
+		if (best == -1U) {
+			//nothing connected to the cache is left; start somewhere new:
+			while (cursor < triangle_count && emitted[cursor]) ++cursor;
+			if (cursor == triangle_count) break;
+			best = cursor;
+		}
+	}
+
+	assert(result.size() == indices.size());
+	indices = std::move(result);
+}
+
+//------------ overdraw ------------
+
+void optimize_overdraw(std::vector< uint32_t > *indices_, std::vector< glm::vec3 > const &positions, float threshold) {
+	assert(indices_);
+	std::vector< uint32_t > &indices = *indices_;
+	uint32_t triangle_count = uint32_t(indices.size() / 3);
+	if (triangle_count < 2) return;
+	uint32_t vertex_count = uint32_t(positions.size());
+
+	//split into clusters wherever a triangle has to load all three of its vertices (the cache starts over there anyway):
+	std::vector< uint32_t > cluster_starts;
+	{
+		constexpr uint32_t FifoSize = 16;
+		std::vector< uint32_t > entered(vertex_count, 0);
+		uint32_t time = FifoSize + 1;
+		for (uint32_t t = 0; t < triangle_count; ++t) {
+			uint32_t misses = 0;
+			for (uint32_t k = 0; k < 3; ++k) {
+				uint32_t v = indices[3*t+k];
+				if (time - entered[v] > FifoSize) {
+					entered[v] = time++;
+					misses += 1;
+				}
+			}
+			if (t == 0 || misses == 3) cluster_starts.emplace_back(t);
+		}
+	}
+	if (cluster_starts.size() < 2) return;
+	cluster_starts.emplace_back(triangle_count);
+
+	//occlusion potential: how far a cluster sits out along its own facing direction, relative to the mesh center
+	// (outward-facing clusters on the outside of the mesh are likely to cover the rest, so they draw first):
+	glm::vec3 mesh_center = glm::vec3(0.0f);
+	float mesh_area = 0.0f;
+	struct Cluster {
+		uint32_t begin, end;
+		glm::vec3 center;
+		glm::vec3 normal;
+		float area;
+		float potential;
+	};
+	std::vector< Cluster > clusters;
+	for (uint32_t c = 0; c + 1 < cluster_starts.size(); ++c) {
+		Cluster cluster{cluster_starts[c], cluster_starts[c+1], glm::vec3(0.0f), glm::vec3(0.0f), 0.0f, 0.0f};
+		for (uint32_t t = cluster.begin; t < cluster.end; ++t) {
+			glm::vec3 const &a = positions[indices[3*t+0]];
+			glm::vec3 const &b = positions[indices[3*t+1]];
+			glm::vec3 const &p = positions[indices[3*t+2]];
+			glm::vec3 n = glm::cross(b - a, p - a); //(length is twice the area)
+			float area = 0.5f * glm::length(n);
+			cluster.normal += n;
+			cluster.center += area * (a + b + p) / 3.0f;
+			cluster.area += area;
+		}
+		mesh_center += cluster.center;
+		mesh_area += cluster.area;
+		clusters.emplace_back(cluster);
+	}
+	if (mesh_area > 0.0f) mesh_center /= mesh_area;
+	for (auto &cluster : clusters) {
+		if (cluster.area > 0.0f) cluster.center /= cluster.area;
+		float normal_length = glm::length(cluster.normal);
+		if (normal_length > 0.0f) cluster.potential = glm::dot(cluster.center - mesh_center, cluster.normal / normal_length);
+	}
+	std::stable_sort(clusters.begin(), clusters.end(), [](Cluster const &a, Cluster const &b) {
+		return a.potential > b.potential;
+	});
+
+	std::vector< uint32_t > sorted;
+	sorted.reserve(indices.size());
+	for (auto const &cluster : clusters) {
+		sorted.insert(sorted.end(), indices.begin() + 3 * cluster.begin, indices.begin() + 3 * cluster.end);
+	}
+
+	//only keep the new order if it doesn't give back too much of the cache efficiency:
+	float before = analyze_vertex_cache(indices, vertex_count).acmr;
+	float after = analyze_vertex_cache(sorted, vertex_count).acmr;
+	if (after <= before * threshold) indices = std::move(sorted);
+}
+
+//------------ vertex fetch ------------
+
+std::vector< uint32_t > optimize_vertex_fetch(std::vector< uint32_t > *indices_, uint32_t vertex_count) {
+	assert(indices_);
+	std::vector< uint32_t > &indices = *indices_;
+	std::vector< uint32_t > new_index(vertex_count, -1U);
+	std::vector< uint32_t > old_index;
+	old_index.reserve(vertex_count);
+	for (uint32_t &i : indices) {
+		if (new_index[i] == -1U) {
+			new_index[i] = uint32_t(old_index.size());
+			old_index.emplace_back(i);
+		}
+		i = new_index[i];
+	}
+	return old_index;
+}
+
+//------------ simplification ------------
+
+//boundary edges get constraint planes (perpendicular to their face) this much stronger than the surface,
+// so open borders only shrink when that is much cheaper than anything else:
+static constexpr double BoundaryWeight = 10.0;
+
+//a collapse is rejected if it turns any remaining triangle further than this (cosine) from its old facing:
+static constexpr float MinFlipCosine = 0.2f;
+
+namespace {
+//symmetric 4x4 matrix of the (area-weighted) sum of squared distances to a set of planes:
+struct Quadric {
+	double a2 = 0.0, ab = 0.0, ac = 0.0, ad = 0.0;
+	double b2 = 0.0, bc = 0.0, bd = 0.0;
+	double c2 = 0.0, cd = 0.0;
+	double d2 = 0.0;
+	double weight = 0.0; //(total weight of the planes, to turn the sum into a mean)
+
+	Quadric() = default;
+	Quadric(glm::dvec3 const &n, double d, double w)
+		: a2(w*n.x*n.x), ab(w*n.x*n.y), ac(w*n.x*n.z), ad(w*n.x*d)
+		, b2(w*n.y*n.y), bc(w*n.y*n.z), bd(w*n.y*d)
+		, c2(w*n.z*n.z), cd(w*n.z*d)
+		, d2(w*d*d), weight(w) { }
+
+	Quadric &operator+=(Quadric const &o) {
+		a2 += o.a2; ab += o.ab; ac += o.ac; ad += o.ad;
+		b2 += o.b2; bc += o.bc; bd += o.bd;
+		c2 += o.c2; cd += o.cd;
+		d2 += o.d2;
+		weight += o.weight;
+		return *this;
+	}
+
+	//weighted sum of squared distances from p to the planes:
+	double evaluate(glm::vec3 const &p_) const {
+		glm::dvec3 p(p_);
+		double r = a2*p.x*p.x + b2*p.y*p.y + c2*p.z*p.z
+		         + 2.0 * (ab*p.x*p.y + ac*p.x*p.z + bc*p.y*p.z)
+		         + 2.0 * (ad*p.x + bd*p.y + cd*p.z)
+		         + d2;
+		return std::max(r, 0.0); //(round-off can push it slightly negative)
+	}
+};
+}
+
+std::vector< uint32_t > simplify(std::vector< uint32_t > const &indices, std::vector< glm::vec3 > const &positions,
+	uint32_t target_index_count, float max_error, float *error_) {
+	assert(indices.size() % 3 == 0);
+	uint32_t vertex_count = uint32_t(positions.size());
+	uint32_t triangle_count = uint32_t(indices.size() / 3);
+
+	std::vector< uint32_t > tris = indices; //(working copy; dead triangles are marked in 'alive')
+	std::vector< bool > alive(triangle_count, true);
+	uint32_t live_triangles = triangle_count;
+
+	//vertex -> triangles (grows as triangles move onto the vertices they collapse to):
+	std::vector< std::vector< uint32_t > > vertex_tris(vertex_count);
+	for (uint32_t t = 0; t < triangle_count; ++t) {
+		for (uint32_t k = 0; k < 3; ++k) vertex_tris[tris[3*t+k]].emplace_back(t);
+	}
+
+	//quadrics from each triangle's plane:
+	std::vector< Quadric > quadrics(vertex_count);
+	auto triangle_normal = [&](glm::vec3 const &a, glm::vec3 const &b, glm::vec3 const &c) {
+		return glm::dvec3(glm::cross(b - a, c - a)); //(length is twice the area)
+	};
+	for (uint32_t t = 0; t < triangle_count; ++t) {
+		glm::vec3 const &a = positions[tris[3*t+0]];
+		glm::vec3 const &b = positions[tris[3*t+1]];
+		glm::vec3 const &c = positions[tris[3*t+2]];
+		glm::dvec3 n = triangle_normal(a, b, c);
+		double length = glm::length(n);
+		if (length == 0.0) continue;
+		n /= length;
+		Quadric q(n, -glm::dot(n, glm::dvec3(a)), 0.5 * length);
+		for (uint32_t k = 0; k < 3; ++k) quadrics[tris[3*t+k]] += q;
+	}
+
+	//..and from the planes through boundary edges (edges used by only one triangle):
+	std::unordered_map< uint64_t, uint32_t > edge_uses;
+	{
+		auto key = [](uint32_t a, uint32_t b) { return (uint64_t(std::min(a, b)) << 32) | std::max(a, b); };
+		for (uint32_t i = 0; i < tris.size(); ++i) {
+			edge_uses[key(tris[i], tris[i - i % 3 + (i + 1) % 3])] += 1;
+		}
+		for (uint32_t t = 0; t < triangle_count; ++t) {
+			glm::dvec3 n = triangle_normal(positions[tris[3*t+0]], positions[tris[3*t+1]], positions[tris[3*t+2]]);
+			if (glm::length(n) == 0.0) continue;
+			n = glm::normalize(n);
+			for (uint32_t k = 0; k < 3; ++k) {
+				uint32_t a = tris[3*t+k], b = tris[3*t+(k+1)%3];
+				if (edge_uses[key(a, b)] != 1) continue;
+				glm::dvec3 edge = glm::dvec3(positions[b]) - glm::dvec3(positions[a]);
+				double length2 = glm::dot(edge, edge);
+				if (length2 == 0.0) continue;
+				glm::dvec3 side = glm::normalize(glm::cross(edge, n));
+				Quadric q(side, -glm::dot(side, glm::dvec3(positions[a])), BoundaryWeight * length2);
+				quadrics[a] += q;
+				quadrics[b] += q;
+			}
+		}
+	}
+
+	//cost of moving 'from' onto 'to' (rms distance to the planes the two vertices carry):
+	auto collapse_error = [&](uint32_t from, uint32_t to) {
+		Quadric q = quadrics[from];
+		q += quadrics[to];
+		if (q.weight == 0.0) return 0.0f;
+		return float(std::sqrt(q.evaluate(positions[to]) / q.weight));
+	};
+
+	//candidate collapses, cheapest first; entries go stale when either vertex changes (tracked by 'stamp'):
+	struct Candidate {
+		float error;
+		uint32_t from, to;
+		uint32_t from_stamp, to_stamp;
+		bool operator<(Candidate const &o) const { return error > o.error; } //(so the heap's top is the cheapest)
+	};
+	std::vector< Candidate > heap;
+	std::vector< uint32_t > stamp(vertex_count, 0);
+	std::vector< bool > removed(vertex_count, false);
+	auto push_edge = [&](uint32_t a, uint32_t b) {
+		float ab = collapse_error(a, b);
+		float ba = collapse_error(b, a);
+		if (ba < ab) std::swap(a, b);
+		heap.emplace_back(Candidate{std::min(ab, ba), a, b, stamp[a], stamp[b]});
+		std::push_heap(heap.begin(), heap.end());
+	};
+	for (auto const &edge : edge_uses) {
+		uint32_t a = uint32_t(edge.first >> 32), b = uint32_t(edge.first);
+		if (a != b) push_edge(a, b);
+	}
+
+	//(scratch for the topology check)
+	std::vector< uint32_t > neighbors_from, neighbors_to;
+	auto gather_neighbors = [&](uint32_t v, std::vector< uint32_t > *out) {
+		out->clear();
+		for (uint32_t t : vertex_tris[v]) {
+			if (!alive[t]) continue;
+			for (uint32_t k = 0; k < 3; ++k) {
+				if (tris[3*t+k] != v) out->emplace_back(tris[3*t+k]);
+			}
+		}
+		std::sort(out->begin(), out->end());
+		out->erase(std::unique(out->begin(), out->end()), out->end());
+	};
+
+	float worst = 0.0f;
+	while (live_triangles * 3 > target_index_count && !heap.empty()) {
+		std::pop_heap(heap.begin(), heap.end());
+		Candidate c = heap.back();
+		heap.pop_back();
+		if (removed[c.from] || removed[c.to]) continue;
+		if (stamp[c.from] != c.from_stamp || stamp[c.to] != c.to_stamp) continue;
+		if (c.error > max_error) break;
+
+		//is 'from'-'to' still an edge? and do they share no more neighbors than the triangles on that edge (which would pinch the surface)?
+		gather_neighbors(c.from, &neighbors_from);
+		if (!std::binary_search(neighbors_from.begin(), neighbors_from.end(), c.to)) continue;
+		gather_neighbors(c.to, &neighbors_to);
+		uint32_t shared = 0;
+		uint32_t edge_triangles = 0;
+		for (uint32_t t : vertex_tris[c.from]) {
+			if (!alive[t]) continue;
+			if (tris[3*t+0] == c.to || tris[3*t+1] == c.to || tris[3*t+2] == c.to) ++edge_triangles;
+		}
+		for (uint32_t n : neighbors_from) {
+			if (std::binary_search(neighbors_to.begin(), neighbors_to.end(), n)) ++shared;
+		}
+		if (shared > edge_triangles) continue;
+
+		//would any triangle that moves flip over (or collapse to nothing)?
+		bool flips = false;
+		for (uint32_t t : vertex_tris[c.from]) {
+			if (!alive[t]) continue;
+			uint32_t const *tri = &tris[3*t];
+			if (tri[0] == c.to || tri[1] == c.to || tri[2] == c.to) continue; //(these disappear)
+			glm::vec3 corners[3];
+			for (uint32_t k = 0; k < 3; ++k) corners[k] = positions[tri[k]];
+			glm::vec3 before = glm::cross(corners[1] - corners[0], corners[2] - corners[0]);
+			for (uint32_t k = 0; k < 3; ++k) if (tri[k] == c.from) corners[k] = positions[c.to];
+			glm::vec3 after = glm::cross(corners[1] - corners[0], corners[2] - corners[0]);
+			float lengths = glm::length(before) * glm::length(after);
+			if (lengths == 0.0f || glm::dot(before, after) < MinFlipCosine * lengths) {
+				flips = true;
+				break;
+			}
+		}
+		if (flips) continue;
+
+		//collapse:
+		for (uint32_t t : vertex_tris[c.from]) {
+			if (!alive[t]) continue;
+			uint32_t *tri = &tris[3*t];
+			if (tri[0] == c.to || tri[1] == c.to || tri[2] == c.to) {
+				alive[t] = false;
+				live_triangles -= 1;
+			} else {
+				for (uint32_t k = 0; k < 3; ++k) if (tri[k] == c.from) tri[k] = c.to;
+				vertex_tris[c.to].emplace_back(t);
+			}
+		}
+		vertex_tris[c.from].clear();
+		removed[c.from] = true;
+		quadrics[c.to] += quadrics[c.from];
+		stamp[c.to] += 1;
+		worst = std::max(worst, c.error);
+
+		//(drop dead triangles from the kept vertex's list so it doesn't keep growing)
+		auto &list = vertex_tris[c.to];
+		list.erase(std::remove_if(list.begin(), list.end(), [&](uint32_t t){ return !alive[t]; }), list.end());
+
+		//re-queue the edges around the kept vertex:
+		gather_neighbors(c.to, &neighbors_to);
+		for (uint32_t n : neighbors_to) push_edge(c.to, n);
+	}
+
+	if (error_) *error_ = worst;
+
+	std::vector< uint32_t > result;
+	result.reserve(live_triangles * 3);
+	for (uint32_t t = 0; t < triangle_count; ++t) {
+		if (alive[t]) result.insert(result.end(), &tris[3*t], &tris[3*t] + 3);
+	}
+	return result;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+/*
+ * Offline triangle-order optimizations for indexed triangle lists
+ *  (used by the cook-meshes tool; nothing here touches OpenGL).
+ *
+ * A typical pipeline, per mesh:
+ *  optimize_vertex_cache(indices, vertex_count); //Forsyth's linear-speed ordering
+ *  optimize_overdraw(indices, positions); //sort cache-friendly clusters outside-in
+ *  remap = optimize_vertex_fetch(indices, vertex_count); //renumber vertices by first use
+ *
+ * Level-of-detail meshes come from simplify(), which collapses edges in order of
+ *  quadric error (Garland and Heckbert, "Surface Simplification Using Quadric Error Metrics").
+ *
+ * Vertex cache efficiency is reported as:
+ *  ACMR -- average cache misses (vertex shader runs) per triangle; 3.0 is no reuse, ~0.5-0.7 is good.
+ *  ATVR -- average transforms per vertex; 1.0 means every vertex is shaded exactly once.
+ */
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+struct VertexCacheStats {
+	float acmr = 0.0f;
+	float atvr = 0.0f;
+};
+
+//simulate a FIFO post-transform cache of 'cache_size' entries over the triangle list:
+VertexCacheStats analyze_vertex_cache(std::vector< uint32_t > const &indices, uint32_t vertex_count, uint32_t cache_size = 16);
+
+//reorder triangles so that recently-used vertices are re-used soon (Forsyth, "Linear-Speed Vertex Cache Optimisation"):
+void optimize_vertex_cache(std::vector< uint32_t > *indices, uint32_t vertex_count);
+
+//reorder runs of triangles (split where the vertex cache would have to start over) so that clusters facing outward
+// from the mesh draw first and hide what is behind them (after Sander et al., "Fast Triangle Reordering for Vertex
+// Locality and Reduced Overdraw"); keeps the original order if that would make ACMR worse by more than 'threshold':
+void optimize_overdraw(std::vector< uint32_t > *indices, std::vector< glm::vec3 > const &positions, float threshold = 1.05f);
+
+//renumber vertices in order of first use (so vertex fetches walk memory forward); updates 'indices' and returns,
+// for each new vertex, the index of the old vertex it came from:
+std::vector< uint32_t > optimize_vertex_fetch(std::vector< uint32_t > *indices, uint32_t vertex_count);
+
+//collapse edges (cheapest first) until at most 'target_index_count' indices are left, or until the next collapse would move
+// the surface by more than 'max_error'; vertices only ever collapse onto other vertices, so the result indexes 'positions'.
+//vertices should be welded by position first (attribute seams would otherwise be torn open).
+//if 'error' is given, it gets the largest (rms) distance any collapse moved the surface, in the units of 'positions':
+std::vector< uint32_t > simplify(std::vector< uint32_t > const &indices, std::vector< glm::vec3 > const &positions,
+	uint32_t target_index_count, float max_error, float *error = nullptr);
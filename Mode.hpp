@@ -20,6 +20,23 @@ struct Mode : std::enable_shared_from_this< Mode > {
 	//draw is called after update:
 	virtual void draw(glm::uvec2 const &drawable_size) = 0;
 
+	//(optional) support for drawing on a separate render thread (see RenderThread.hpp):
+	//A 'Snapshot' holds a copy of everything needed to draw one frame:
+	struct Snapshot {
+		virtual ~Snapshot() { }
+		//called on the render thread (which owns the GL context); should produce the same image as Mode::draw:
+		virtual void draw(glm::uvec2 const &drawable_size) const = 0;
+	};
+	//snapshot is called (instead of draw) after update when rendering is threaded:
+	// should copy the current state into *into (allocating or replacing it if it isn't the right type)
+	// returns 'false' if the mode doesn't support snapshots (it will be drawn with 'draw' instead)
+	// ('drawable_size' is the size the snapshot will be drawn at)
+	virtual bool snapshot(std::unique_ptr< Snapshot > *into, glm::uvec2 const &drawable_size) { return false; }
+
+	//(optional) SDL ticks at which the mode last pulled in input itself -- e.g., by pumping events to late-latch the mouse -- or 0:
+	// the main loop counts that input as shown by the frame being drawn (see LatencyMeter::latched)
+	uint32_t latched_input_time = 0;
+
 	//Mode::current is the Mode to which events are dispatched.
 	// use 'set_current' to change the current Mode (e.g., to switch to a menu)
 	static std::shared_ptr< Mode > current;
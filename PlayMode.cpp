@@ -1,109 +1,99 @@
 #include "PlayMode.hpp"
 
 #include "LitColorTextureProgram.hpp"
+#include "UniformBlocks.hpp"
 
 #include "DrawLines.hpp"
 #include "Mesh.hpp"
 #include "Load.hpp"
 #include "gl_errors.hpp"
-#include "data_path.hpp"
+#include "AssetPack.hpp"
+#include "StaticGeometry.hpp"
+#include "DynamicResolution.hpp"
+#include "JobSystem.hpp"
+#include "FrameArena.hpp"
 
 #include <glm/gtc/type_ptr.hpp>
 
+#include <algorithm>
+#include <array>
+#include <cmath>
 #include <random>
 
 GLuint level_meshes_for_lit_color_texture_program = 0;
 
-Load< MeshBuffer > level0_meshes(LoadTagDefault, []() -> MeshBuffer const * {
-	MeshBuffer const *ret = new MeshBuffer(data_path("levels/lvl0.pnct"));
-	level_meshes_for_lit_color_texture_program = ret->make_vao_for_program(lit_color_texture_program->program);
-	return ret;
-});
+bool PlayMode::is_static(Scene::Transform const &transform) {
+	for (Scene::Transform const *t = &transform; t; t = t->parent) {
+		if (t->name == "Player" || t->name == "Hand" || t->name == "AimHand" || t->name == "Club") return false;
+		if (t->name == "Ball" || t->name == "Hole") return false;
+		if (t->name.substr(0, 4) == "Item") return false;
+	}
+	return true;
+}
 
-Load< Scene > level0_scene(LoadTagDefault, []() -> Scene const * {
-	return new Scene(data_path("levels/lvl0.scene"), [&](Scene &scene, Scene::Transform *transform, std::string const &mesh_name){
-		Mesh const &mesh = level0_meshes->lookup(mesh_name);
+//each level's static geometry, merged at load time (never freed, like the levels' own MeshBuffers):
+static std::vector< MeshBuffer const * > level_static_meshes;
+
+//scene for a level, with a drawable (drawn with lit_color_texture_program) for each of its meshes,
+// and its static geometry baked (see StaticGeometry.hpp):
+static Scene *load_level(MeshBuffer const &meshes, std::string const &filename) {
+	Scene *ret = new Scene(*open_asset(filename), filename, [&](Scene &scene, Scene::Transform *transform, std::string const &mesh_name){
+		Mesh const &mesh = meshes.lookup(mesh_name);
 
 		scene.drawables.emplace_back(transform);
 		Scene::Drawable &drawable = scene.drawables.back();
 
-		drawable.pipeline = lit_color_texture_program_pipeline;
+		drawable.pipeline.material = scene.add_material(lit_color_texture_program_material);
 
 		drawable.pipeline.vao = level_meshes_for_lit_color_texture_program;
 		drawable.pipeline.type = mesh.type;
 		drawable.pipeline.start = mesh.start;
 		drawable.pipeline.count = mesh.count;
-
+		drawable.pipeline.index_type = mesh.index_type;
+		drawable.pipeline.shape = scene.add_shape(Scene::Shape::make(mesh));
 	});
+	level_static_meshes.emplace_back(bake_static_geometry(*ret, meshes, PlayMode::is_static));
+	return ret;
+}
+
+Load< MeshBuffer > level0_meshes(LoadTagDefault, []() -> MeshBuffer const * {
+	MeshBuffer const *ret = new MeshBuffer(*open_asset("levels/lvl0.pnci"), "levels/lvl0.pnci");
+	level_meshes_for_lit_color_texture_program = ret->make_vao_for_program(lit_color_texture_program->program);
+	return ret;
+});
+
+Load< Scene > level0_scene(LoadTagDefault, []() -> Scene const * {
+	return load_level(*level0_meshes, "levels/lvl0.scene");
 });
 
 Load< MeshBuffer > level1_meshes(LoadTagDefault, []() -> MeshBuffer const * {
-	MeshBuffer const *ret = new MeshBuffer(data_path("levels/lvl1.pnct"));
+	MeshBuffer const *ret = new MeshBuffer(*open_asset("levels/lvl1.pnci"), "levels/lvl1.pnci");
 	level_meshes_for_lit_color_texture_program = ret->make_vao_for_program(lit_color_texture_program->program);
 	return ret;
 });
 
 Load< Scene > level1_scene(LoadTagDefault, []() -> Scene const * {
-	return new Scene(data_path("levels/lvl1.scene"), [&](Scene &scene, Scene::Transform *transform, std::string const &mesh_name){
-		Mesh const &mesh = level1_meshes->lookup(mesh_name);
-
-		scene.drawables.emplace_back(transform);
-		Scene::Drawable &drawable = scene.drawables.back();
-
-		drawable.pipeline = lit_color_texture_program_pipeline;
-
-		drawable.pipeline.vao = level_meshes_for_lit_color_texture_program;
-		drawable.pipeline.type = mesh.type;
-		drawable.pipeline.start = mesh.start;
-		drawable.pipeline.count = mesh.count;
-
-	});
+	return load_level(*level1_meshes, "levels/lvl1.scene");
 });
 
 Load< MeshBuffer > level2_meshes(LoadTagDefault, []() -> MeshBuffer const * {
-	MeshBuffer const *ret = new MeshBuffer(data_path("levels/lvl2.pnct"));
+	MeshBuffer const *ret = new MeshBuffer(*open_asset("levels/lvl2.pnci"), "levels/lvl2.pnci");
 	level_meshes_for_lit_color_texture_program = ret->make_vao_for_program(lit_color_texture_program->program);
 	return ret;
 });
 
 Load< Scene > level2_scene(LoadTagDefault, []() -> Scene const * {
-	return new Scene(data_path("levels/lvl2.scene"), [&](Scene &scene, Scene::Transform *transform, std::string const &mesh_name){
-		Mesh const &mesh = level2_meshes->lookup(mesh_name);
-
-		scene.drawables.emplace_back(transform);
-		Scene::Drawable &drawable = scene.drawables.back();
-
-		drawable.pipeline = lit_color_texture_program_pipeline;
-
-		drawable.pipeline.vao = level_meshes_for_lit_color_texture_program;
-		drawable.pipeline.type = mesh.type;
-		drawable.pipeline.start = mesh.start;
-		drawable.pipeline.count = mesh.count;
-
-	});
+	return load_level(*level2_meshes, "levels/lvl2.scene");
 });
 
 Load< MeshBuffer > level3_meshes(LoadTagDefault, []() -> MeshBuffer const * {
-	MeshBuffer const *ret = new MeshBuffer(data_path("levels/lvl3.pnct"));
+	MeshBuffer const *ret = new MeshBuffer(*open_asset("levels/lvl3.pnci"), "levels/lvl3.pnci");
 	level_meshes_for_lit_color_texture_program = ret->make_vao_for_program(lit_color_texture_program->program);
 	return ret;
 });
 
 Load< Scene > level3_scene(LoadTagDefault, []() -> Scene const * {
-	return new Scene(data_path("levels/lvl3.scene"), [&](Scene &scene, Scene::Transform *transform, std::string const &mesh_name){
-		Mesh const &mesh = level3_meshes->lookup(mesh_name);
-
-		scene.drawables.emplace_back(transform);
-		Scene::Drawable &drawable = scene.drawables.back();
-
-		drawable.pipeline = lit_color_texture_program_pipeline;
-
-		drawable.pipeline.vao = level_meshes_for_lit_color_texture_program;
-		drawable.pipeline.type = mesh.type;
-		drawable.pipeline.start = mesh.start;
-		drawable.pipeline.count = mesh.count;
-
-	});
+	return load_level(*level3_meshes, "levels/lvl3.scene");
 });
 
 std::vector< Load <MeshBuffer> > level_meshes_vec;
@@ -131,33 +121,35 @@ PlayMode::~PlayMode() {
 
 void PlayMode::init() {
 	scene = *scene_vec[lvl_index];
+	Scene::Transform *hole_transform = nullptr;
+	Scene::Transform *ball_transform = nullptr;
 	for (auto &transform : scene.transforms) {
 		if (transform.name == "Player") player = &transform;
 		else if (transform.name == "Hand") hand = &transform;
 		else if (transform.name == "AimHand") aimhand = &transform;
 		else if (transform.name == "Club") club = &transform;
 
-		else if (transform.name == "Hole") {
-			hole = std::make_shared<Scene::RigidBody>(&transform, std::make_shared<Scene::SphereCollider>(glm::vec3(0), hole_radius_start));
-			hole->is_hole = true;
-		}
-
-		else if (transform.name == "Ball") {
-			ball = std::make_shared<Scene::RigidBody>(&transform, std::make_shared<Scene::SphereCollider>(glm::vec3(0), ball_radius_start));
-			ball->is_ball = true;
-		}
+		else if (transform.name == "Hole") hole_transform = &transform;
+		else if (transform.name == "Ball") ball_transform = &transform;
 		
-		
-		else if (transform.name == "Ground") collision_objects.emplace_back(std::make_shared<Scene::CollisionObject>(&transform, std::make_shared<Scene::PlaneCollider>(glm::vec3(0,0,1.0f), 0.0f), 0.7f));
+		else if (transform.name == "Ground") static_objects.emplace(&transform, std::make_shared<Scene::PlaneCollider>(glm::vec3(0,0,1.0f), 0.0f), 0.7f);
 
 		else if (transform.name.substr(0, 4) == "Wall") {
 			const Mesh &mesh = level_meshes_vec[lvl_index]->lookup(transform.name);
-			collision_objects.emplace_back(std::make_shared<Scene::CollisionObject>(&transform, std::make_shared<Scene::BoxCollider>(mesh.min, mesh.max)));
+			static_objects.emplace(&transform, std::make_shared<Scene::BoxCollider>(mesh.min, mesh.max));
+		}
+		else if (transform.name.substr(0, 7) == "Terrain") {
+			//arbitrary level geometry collides against its actual triangles:
+			MeshBuffer const &buffer = *level_meshes_vec[lvl_index];
+			const Mesh &mesh = buffer.lookup(transform.name);
+			if (mesh.type != GL_TRIANGLES) throw std::runtime_error("Terrain mesh '" + transform.name + "' is not a triangle list.");
+			std::shared_ptr<const TriangleBVH> &bvh = terrain_bvhs[&mesh];
+			if (!bvh) bvh = std::make_shared<TriangleBVH>(buffer.positions.data() + mesh.start, mesh.count); //(built once, re-used on level restart)
+			static_objects.emplace(&transform, std::make_shared<Scene::TriangleMeshCollider>(bvh));
 		}
 		else if (transform.name.substr(0, 4) == "Item") {
-			std::shared_ptr<Scene::CollisionObject> item = std::make_shared<Scene::CollisionObject>(&transform, std::make_shared<Scene::SphereCollider>(glm::vec3(0), item_radius));
-			item->is_pickup = true;
-			collision_objects.emplace_back(item);
+			Scene::CollisionObject &item = static_objects.emplace_back(&transform, std::make_shared<Scene::SphereCollider>(glm::vec3(0), item_radius));
+			item.is_pickup = true;
 		}
 	}
 
@@ -166,14 +158,52 @@ void PlayMode::init() {
 	if (aimhand == nullptr) throw std::runtime_error("Hand not found.");
 	if (club == nullptr) throw std::runtime_error("Club not found.");
 
-	if (hole == nullptr) throw std::runtime_error("Hole not found.");
-	if (ball == nullptr) throw std::runtime_error("Ball not found.");
+	if (hole_transform == nullptr) throw std::runtime_error("Hole not found.");
+	if (ball_transform == nullptr) throw std::runtime_error("Ball not found.");
+
+	ball = bodies.emplace(ball_transform, std::make_shared<Scene::SphereCollider>(glm::vec3(0), ball_radius_start));
+	bodies[ball].is_ball = true;
+	hole = bodies.emplace(hole_transform, std::make_shared<Scene::SphereCollider>(glm::vec3(0), hole_radius_start));
+	bodies[hole].is_hole = true;
 
+	ball_transform->position += glm::vec3(0,0,0.2f);
+	hole_transform->position += glm::vec3(0,0,0.2f);
+
+	{ //register everything with the scene query structure:
+		for (auto &object : static_objects) {
+			object.query_proxy = query.add_collider(object.transform, object.collider, SceneQuery::Static);
+		}
+		for (auto &body : bodies) {
+			body.query_proxy = query.add_collider(body.transform, body.collider, SceneQuery::Dynamic);
+		}
 
-	collision_objects.emplace_back(ball);
-	collision_objects.emplace_back(hole);
-	ball->transform->position += glm::vec3(0,0,0.2f);
-	hole->transform->position += glm::vec3(0,0,0.2f);
+		//drawables are found by their mesh bounds; anything attached to the player, ball, or hole moves:
+		auto moves = [&](Scene::Transform const *transform) {
+			for (; transform; transform = transform->parent) {
+				if (transform == player || transform == ball_transform || transform == hole_transform) return true;
+			}
+			return false;
+		};
+		MeshBuffer const &buffer = *level_meshes_vec[lvl_index];
+		for (auto const &drawable : scene.drawables) {
+			Scene::Drawable::Pipeline const &pipeline = drawable.pipeline;
+			if (drawable.transform->name == StaticGeometryTransform) {
+				//(merged static geometry lives in its own buffer; it gets one box around its bounding sphere)
+				glm::vec4 const &bounds = scene.shapes.at(pipeline.shape).bounds;
+				glm::vec3 center = glm::vec3(bounds);
+				query.add_bounds(drawable.transform, center - glm::vec3(bounds.w), center + glm::vec3(bounds.w), SceneQuery::Static);
+				continue;
+			}
+			if (pipeline.count == 0 || pipeline.start + pipeline.count > buffer.positions.size()) continue;
+			glm::vec3 min = buffer.positions[pipeline.start];
+			glm::vec3 max = min;
+			for (GLuint i = pipeline.start + 1; i < pipeline.start + pipeline.count; ++i) {
+				min = glm::min(min, buffer.positions[i]);
+				max = glm::max(max, buffer.positions[i]);
+			}
+			query.add_bounds(drawable.transform, min, max, moves(drawable.transform) ? SceneQuery::Dynamic : SceneQuery::Static);
+		}
+	}
 
 	//get pointer to camera for convenience:
 	if (scene.cameras.size() != 1) throw std::runtime_error("Expecting scene to have exactly one camera, but it has " + std::to_string(scene.cameras.size()));
@@ -202,7 +232,10 @@ void PlayMode::cleanup_go_next() {
 	aimhand = nullptr;
 	club = nullptr;
 
-	collision_objects = std::vector<std::shared_ptr<Scene::CollisionObject>>();
+	static_objects.clear();
+	bodies.clear();
+	query.clear();
+	destroy_queue.clear();
 
 	if (++lvl_index < level_meshes_vec.size()) {
 		init();
@@ -251,6 +284,9 @@ bool PlayMode::handle_event(SDL_Event const &evt, glm::uvec2 const &window_size)
 		} else if (evt.key.keysym.sym == SDLK_F3) {
 			show_fps = !show_fps;
 			return true;
+		} else if (evt.key.keysym.sym == SDLK_F4) {
+			show_overdraw = !show_overdraw;
+			return true;
 		} else if (show_fps && evt.key.keysym.sym == SDLK_DOWN) {
 			player->position.z -= 0.2f;
 			return true;
@@ -299,20 +335,8 @@ bool PlayMode::handle_event(SDL_Event const &evt, glm::uvec2 const &window_size)
 	}
 	else if (evt.type == SDL_MOUSEMOTION) {
 		if (SDL_GetRelativeMouseMode() == SDL_TRUE) {
-			glm::vec2 motion = glm::vec2(
-				evt.motion.xrel / float(window_size.y),
-				-evt.motion.yrel / float(window_size.y)
-			);
-			player->rotation = glm::normalize(
-				player->rotation * glm::angleAxis(-motion.x * camera->fovy, glm::vec3(0.0f, 0.0f, 1.0f))
-			);
-			const float adjust_camera_pitch = glm::clamp(camera_pitch + motion.y * camera->fovy, cam_pitch_min, cam_pitch_max) - camera_pitch;
-			if (glm::abs(adjust_camera_pitch) >= glm::epsilon<float>()) {
-				camera->transform->rotation = glm::normalize(
-					camera->transform->rotation * glm::angleAxis(adjust_camera_pitch, glm::vec3(1.0f, 0.0f, 0.0f))
-				);
-				camera_pitch += adjust_camera_pitch;
-			}
+			//motion is coalesced and applied by latch_mouse() (see update() and draw()):
+			mouse_window_size = window_size;
 			return true;
 		}
 	}
@@ -320,10 +344,63 @@ bool PlayMode::handle_event(SDL_Event const &evt, glm::uvec2 const &window_size)
 	return false;
 }
 
+void PlayMode::latch_mouse() {
+	//pick up any motion that arrived since the main loop last polled events:
+	// (pumping leaves the events queued; their deltas are only ever applied through SDL_GetRelativeMouseState)
+	SDL_PumpEvents();
+
+	int xrel = 0, yrel = 0;
+	SDL_GetRelativeMouseState(&xrel, &yrel); //(also resets the accumulated motion)
+	if (loading || SDL_GetRelativeMouseMode() != SDL_TRUE) return;
+	if (xrel == 0 && yrel == 0) return;
+	//(the pumped motion events still get polled next frame, so note that this frame is the one showing them -- see LatencyMeter)
+	latched_input_time = SDL_GetTicks();
+
+	glm::vec2 motion = glm::vec2(
+		xrel / float(mouse_window_size.y),
+		-yrel / float(mouse_window_size.y)
+	);
+	player->rotation = glm::normalize(
+		player->rotation * glm::angleAxis(-motion.x * camera->fovy, glm::vec3(0.0f, 0.0f, 1.0f))
+	);
+	const float adjust_camera_pitch = glm::clamp(camera_pitch + motion.y * camera->fovy, cam_pitch_min, cam_pitch_max) - camera_pitch;
+	if (glm::abs(adjust_camera_pitch) >= glm::epsilon<float>()) {
+		camera->transform->rotation = glm::normalize(
+			camera->transform->rotation * glm::angleAxis(adjust_camera_pitch, glm::vec3(1.0f, 0.0f, 0.0f))
+		);
+		camera_pitch += adjust_camera_pitch;
+	}
+}
+
+void PlayMode::attach_club() {
+	// we lerp between hand and aimhand (which is where club held while hitting ball)
+	float alpha = 1-(glm::clamp(glm::eulerAngles(camera->transform->rotation).x, cam_pitch_aim_end, cam_pitch_aim_start) - cam_pitch_aim_end) / (cam_pitch_aim_start - cam_pitch_aim_end);
+	
+	glm::mat4x3 camera_world_transform = camera->transform->make_local_to_world(); // save like 0.00001s by computing once instead of twice
+	glm::mat4x3 hand_world = camera_world_transform * glm::mat4(hand->make_local_to_parent());
+	glm::mat4x3 aimhand_world = camera_world_transform * glm::mat4(aimhand->make_local_to_parent());
+
+	glm::vec3 start_pos = hand_world * glm::vec4(0,0,0,1.0f);
+	glm::vec3 end_pos = aimhand_world * glm::vec4(0,0,0,1.0f);
+
+	club->position = glm::mix(start_pos, end_pos, alpha);
+	club->rotation = glm::angleAxis(glm::eulerAngles(player->rotation).z, glm::vec3(0.0f,0.0f,1.0f))
+	* glm::angleAxis(-swing_acc, glm::vec3(0,1.0f,0));
+}
+
 void PlayMode::update(float elapsed) {
 	if (loading) return;
 	fps = 1.0f / elapsed;
 
+	//count heap allocations since the last update (i.e., over one whole frame):
+	uint64_t heap_allocations = FrameArena::heap_allocations();
+	frame_allocations = heap_allocations - last_heap_allocations;
+	last_heap_allocations = heap_allocations;
+
+	//apply all mouse motion since the last frame (movement below depends on facing):
+	latched_input_time = 0;
+	latch_mouse();
+
 	//move player:
 	{
 
@@ -372,25 +449,12 @@ void PlayMode::update(float elapsed) {
 		}
 	}
 
-	{ // attach club to hand
-		// we lerp between hand and aimhand (which is where club held while hitting ball)
-		float alpha = 1-(glm::clamp(glm::eulerAngles(camera->transform->rotation).x, cam_pitch_aim_end, cam_pitch_aim_start) - cam_pitch_aim_end) / (cam_pitch_aim_start - cam_pitch_aim_end);
-		
-		glm::mat4x3 camera_world_transform = camera->transform->make_local_to_world(); // save like 0.00001s by computing once instead of twice
-		glm::mat4x3 hand_world = camera_world_transform * glm::mat4(hand->make_local_to_parent());
-		glm::mat4x3 aimhand_world = camera_world_transform * glm::mat4(aimhand->make_local_to_parent());
-
-		glm::vec3 start_pos = hand_world * glm::vec4(0,0,0,1.0f);
-		glm::vec3 end_pos = aimhand_world * glm::vec4(0,0,0,1.0f);
-
-		club->position = glm::mix(start_pos, end_pos, alpha);
-		club->rotation = glm::angleAxis(glm::eulerAngles(player->rotation).z, glm::vec3(0.0f,0.0f,1.0f))
-		* glm::angleAxis(-swing_acc, glm::vec3(0,1.0f,0));
-	}
+	attach_club();
 
 	// handle physics, thanks Winterdev (https://www.youtube.com/watch?v=-_IspRG548E)
 	// and https://winter.dev/articles/physics-engine
 	handle_physics(elapsed);
+	query.update();
 
 	//reset button press counters:
 	left.downs = 0;
@@ -398,82 +462,172 @@ void PlayMode::update(float elapsed) {
 	up.downs = 0;
 	down.downs = 0;
 
+	flush_destroyed();
+
 	if (cleanup_next_update) {
 		cleanup_next_update = false;
 		cleanup_go_next();
 	}
 }
 
+void PlayMode::flush_destroyed() {
+	if (destroy_queue.empty()) return;
+
+	// drawables, cameras, lights and transforms (the queue comes back sorted, with descendants added):
+	scene.erase(&destroy_queue);
+	auto doomed = [&](Scene::Transform const *transform) {
+		return std::binary_search(destroy_queue.begin(), destroy_queue.end(), transform);
+	};
+
+	// query proxies (colliders and drawable bounds):
+	query.remove_attached(destroy_queue);
+
+	// collision objects:
+	bool erased_static = false;
+	for (uint32_t i = uint32_t(static_objects.size()); i > 0; --i) {
+		if (!doomed(static_objects.data()[i-1].transform)) continue;
+		static_objects.erase_index(i-1);
+		erased_static = true;
+	}
+	for (uint32_t i = uint32_t(bodies.size()); i > 0; --i) {
+		if (!doomed(bodies.data()[i-1].transform)) continue;
+		assert(bodies.handle_at(i-1) != ball && bodies.handle_at(i-1) != hole);
+		bodies.erase_index(i-1);
+	}
+	// (something might have been resting on an erased static object)
+	if (erased_static) {
+		for (Scene::RigidBody &body : bodies) {
+			if (body.sleeping) wake(body);
+		}
+	}
+
+	destroy_queue.clear();
+}
+
 void PlayMode::handle_physics(float elapsed) {
 
+	// gravity wells: every hole attracts, with strength growing with its size
+	//  (sources are indexed like 'bodies', so a hole can ignore its own pull)
+	FrameVector<Attraction::Source> sources;
+	FrameVector<uint32_t> source_of_body(bodies.size(), -1U);
+	bool wells_moving = false;
+	for (uint32_t i = 0; i < uint32_t(bodies.size()); ++i) {
+		Scene::RigidBody const &body = bodies.data()[i];
+		if (!body.is_hole) continue;
+		const float scale = body.transform->scale.x;
+		source_of_body[i] = uint32_t(sources.size());
+		sources.emplace_back(Attraction::Source{body.transform->make_local_to_world() * glm::vec4(0,0,0,1), hole_pull_strength_start * scale * scale});
+		wells_moving = wells_moving || !body.sleeping;
+	}
+	attraction.build(sources.data(), uint32_t(sources.size()));
+
+	// pickups within reach of a well get vacuumed up: they become bodies, and fall toward it
+	for (uint32_t i = uint32_t(static_objects.size()); i > 0; --i) {
+		Scene::CollisionObject const &object = static_objects.data()[i-1];
+		if (!object.is_pickup || object.to_delete) continue;
+		const glm::vec3 position = object.transform->make_local_to_world() * glm::vec4(0,0,0,1);
+		if (attraction.pull(position, min_pull_strength) == glm::vec3(0)) continue;
+
+		Scene::RigidBody &body = bodies.emplace_back(object.transform, object.collider);
+		body.is_pickup = true;
+		body.pickup_value = object.pickup_value;
+		body.damp = object.damp;
+		body.friction = object.friction;
+		body.rest_position = object.transform->position;
+		if (object.query_proxy != -1U) query.remove(object.query_proxy);
+		body.query_proxy = query.add_collider(body.transform, body.collider, SceneQuery::Dynamic);
+		static_objects.erase_index(i-1);
+	}
+	source_of_body.resize(bodies.size(), -1U);
+
 	// find collisions
-	std::vector<Scene::Collision> collisions;
-	for (auto obj_a : collision_objects) {
-		for (auto obj_b : collision_objects) {
-			if (obj_a == obj_b) break;
+	// static objects never move, so only pairs involving a body are tested: each body against every static object,
+	//  then against every earlier body. Pair tests are independent, so large counts are split across the job system;
+	//  each block of bodies collects its own list, keeping the final order the same as the serial loop.
+	//  Sleeping bodies aren't tested against static objects or against each other.
+	uint32_t body_count = uint32_t(bodies.size());
+	uint32_t static_count = uint32_t(static_objects.size());
+	Scene::RigidBody *body_data = bodies.data();
+	Scene::CollisionObject *static_data = static_objects.data();
+	//(all of these lists live in this thread's frame arena, so steady-state frames don't touch the heap)
+	FrameVector<FrameVector<Scene::Collision>> block_collisions((body_count + PhysicsBlock - 1) / PhysicsBlock, FrameVector<Scene::Collision>());
+	auto find_collisions = [&](uint32_t begin, uint32_t end) {
+		FrameVector<Scene::Collision> &found = block_collisions[begin / PhysicsBlock];
+		for (uint32_t a = begin; a < end; ++a) {
+			Scene::RigidBody &body_a = body_data[a];
+			if (!body_a.collider) continue;
+
+			for (uint32_t b = 0; b < (body_a.sleeping ? 0 : static_count); ++b) {
+				Scene::CollisionObject &obj_b = static_data[b];
+				if (!obj_b.collider) continue;
+
+				Scene::CollisionPoints points = Scene::test_collision(
+					body_a.collider, body_a.transform,
+					obj_b.collider, obj_b.transform
+				);
 
-			if (!obj_a->collider || !obj_b->collider)
-				continue;
-			
-			Scene::CollisionPoints points = Scene::test_collision(
-				obj_a->collider, obj_a->transform,
-				obj_b->collider, obj_b->transform
-			);
-
-			if (points.has_collision) {
-				collisions.emplace_back(obj_a, obj_b, points);
+				if (points.has_collision) {
+					found.emplace_back(&body_a, &obj_b, nullptr, points);
+				}
 			}
+
+			for (uint32_t b = 0; b < a; ++b) {
+				Scene::RigidBody &body_b = body_data[b];
+				if (!body_b.collider) continue;
+				if (body_a.sleeping && body_b.sleeping) continue;
+
+				Scene::CollisionPoints points = Scene::test_collision(
+					body_a.collider, body_a.transform,
+					body_b.collider, body_b.transform
+				);
+
+				if (points.has_collision) {
+					found.emplace_back(&body_a, &body_b, &body_b, points);
+				}
+			}
+		}
+	};
+	if (uint64_t(body_count) * (static_count + body_count) >= PhysicsParallelPairs) {
+		JobSystem::get().parallel_for(0, body_count, PhysicsBlock, find_collisions);
+	} else {
+		for (uint32_t begin = 0; begin < body_count; begin += PhysicsBlock) {
+			find_collisions(begin, std::min(body_count, begin + PhysicsBlock));
 		}
 	}
 
+	FrameVector<Scene::Collision> collisions;
+	size_t collision_count = 0;
+	for (auto const &found : block_collisions) collision_count += found.size();
+	collisions.reserve(collision_count);
+	for (auto const &found : block_collisions) {
+		collisions.insert(collisions.end(), found.begin(), found.end());
+	}
+
 	uint8_t delete_count = 0;
+	Scene::RigidBody &hole_body = bodies[hole];
+
+	// grow a black hole by a pickup's value (adding mass) and delete the pickup:
+	auto eat = [&](Scene::RigidBody &eater, Scene::CollisionObject &pickup) {
+		delete_count++;
+		const float scale = eater.transform->scale.x + pickup.pickup_value;
+		if (&eater == &hole_body) hole_scale = scale;
+		eater.transform->scale = glm::vec3(scale);
+		eater.mass = scale;
+		pickup.to_delete = true; //(skipped by the rest of this step; removed at the end of the frame)
+		destroy_queue.emplace_back(pickup.transform);
+	};
 
 	// solve collisions
-	for (auto col : collisions) {
+	for (auto const &col : collisions) {
 		if (col.obj_a->to_delete || col.obj_b->to_delete) continue;
-		if (!col.obj_a->is_dynamic && !col.obj_b->is_dynamic) continue;
-		else if (!col.obj_a->is_dynamic) { // b is moving
-			if (col.obj_b->is_hole) {
-				if (col.obj_a->is_pickup) { // grow black hole, add mass and delete pickup
-					delete_count++;
-					hole_scale += col.obj_a->pickup_value;
-					hole->transform->scale = glm::vec3(hole_scale);
-					hole->mass = hole_scale;
-					col.obj_a->to_delete = true;
-					col.obj_a->transform->scale = glm::vec3(0);
-					continue;
-				}
-			}
-
-			std::shared_ptr<Scene::RigidBody> body_b = std::static_pointer_cast<Scene::RigidBody>(col.obj_b);
-			if (glm::length(body_b->velocity) < 0.00001f) return;
-			glm::vec3 out_velocity = col.obj_b->friction * (body_b->velocity - 2.0f * col.obj_a->damp * glm::dot(body_b->velocity, -col.points.normal) * -col.points.normal);
-			glm::vec3 out_force = body_b->mass * gravity - 2.0f * glm::dot(body_b->mass * gravity, col.points.normal) * col.points.normal;
-			glm::vec3 out_dir = glm::normalize(out_velocity);
-			// move body_b back to where it hit
-			glm::vec3 vel_dir = glm::normalize(body_b->velocity);
-			float angled_dist = col.points.depth / glm::dot(col.points.normal, vel_dir);
-			body_b->transform->position = body_b->transform->position - vel_dir * angled_dist + out_dir * angled_dist;
-
-			// apply new physics
-			body_b->velocity = out_velocity;
-			body_b->force = out_force;
-		}
-		else if (!col.obj_b->is_dynamic) { // a is moving
-			if (col.obj_a->is_hole) {
-				if (col.obj_b->is_pickup) {
-					delete_count++;
-					hole_scale += col.obj_b->pickup_value;
-					hole->transform->scale = glm::vec3(hole_scale);
-					hole->mass = hole_scale;
-					col.obj_b->to_delete = true;
-					col.obj_b->transform->scale = glm::vec3(0);
-					continue;
-				}
+		if (!col.body_b) { // a is moving, b is static
+			if (col.obj_a->is_hole && col.obj_b->is_pickup) {
+				eat(*col.obj_a, *col.obj_b);
+				continue;
 			}
 
-			std::shared_ptr<Scene::RigidBody> body_a = std::static_pointer_cast<Scene::RigidBody>(col.obj_a);
-			if (glm::length(body_a->velocity) < 0.00001f) return;
+			Scene::RigidBody *body_a = col.obj_a;
+			if (glm::length(body_a->velocity) < 0.00001f) continue;
 			glm::vec3 out_velocity = col.obj_b->friction * (body_a->velocity - 2.0f * col.obj_b->damp * glm::dot(body_a->velocity, col.points.normal) * col.points.normal);
 			glm::vec3 out_force = body_a->mass * gravity - 2.0f * glm::dot(body_a->mass * gravity, -col.points.normal) * col.points.normal;
 			glm::vec3 out_dir = glm::normalize(out_velocity);
@@ -486,7 +640,18 @@ void PlayMode::handle_physics(float elapsed) {
 			body_a->velocity = out_velocity;
 			body_a->force = out_force;
 		}
-		else {// currently this only happens when we finish a hole but it could happen if we make items vacuum
+		else {// both moving: finishing a hole, or a hole catching a vacuumed-up pickup
+			// (an awake body touching a sleeping one wakes it)
+			if (col.obj_a->sleeping) wake(*col.obj_a);
+			if (col.body_b->sleeping) wake(*col.body_b);
+			if (col.obj_a->is_hole && col.body_b->is_pickup) {
+				eat(*col.obj_a, *col.body_b);
+				continue;
+			}
+			if (col.body_b->is_hole && col.obj_a->is_pickup) {
+				eat(*col.body_b, *col.obj_a);
+				continue;
+			}
 			if ((col.obj_a->is_ball && col.obj_b->is_hole) || (col.obj_a->is_hole && col.obj_b->is_ball)) {
 				// win level
 				if (col.points.depth > 0.1f)
@@ -495,51 +660,158 @@ void PlayMode::handle_physics(float elapsed) {
 		}
 	}
 
+	// continuous collision candidates come from the scene query (whose proxies were refit at the end of last frame;
+	//  bodies already moved this step may have drifted a little inside their fattened boxes):
+	FrameVector<Scene::CollisionObject const *> object_of_proxy;
+	auto candidates_for = [&](glm::vec3 const &min, glm::vec3 const &max) -> std::vector< uint32_t > const & {
+		if (object_of_proxy.empty()) {
+			object_of_proxy.assign(query.proxies.size(), nullptr);
+			for (Scene::CollisionObject const &object : static_objects) {
+				if (object.query_proxy != -1U) object_of_proxy[object.query_proxy] = &object;
+			}
+			for (Scene::RigidBody const &body : bodies) {
+				if (body.query_proxy != -1U) object_of_proxy[body.query_proxy] = &body;
+			}
+		}
+		query_results.clear();
+		query.overlap_box(min, max, &query_results);
+		return query_results;
+	};
+
 	// move dynamics
-	for (auto obj : collision_objects) {
-		if (obj->is_dynamic) {
-			std::shared_ptr<Scene::RigidBody> body = std::static_pointer_cast<Scene::RigidBody>(obj);
-			body->force += body->mass * gravity;
-			body->force += -body->velocity * drag;
-			if (body->transform->name == "Ball") {
-				const float hole_dist = glm::max(0.005f, glm::distance(body->transform->position, hole->transform->position));
-				const float pull_strength = (hole_pull_strength_start*hole_scale*hole_scale/hole_dist);
-				if (pull_strength >= min_pull_strength) {
-					body->force += glm::normalize(hole->transform->position - body->transform->position) * pull_strength * body->mass;
+	for (uint32_t i = 0; i < body_count; ++i) {
+		Scene::RigidBody &body = body_data[i];
+		if (body.to_delete) continue;
+		const glm::vec3 pull = attraction.pull(body.transform->make_local_to_world() * glm::vec4(0,0,0,1), min_pull_strength, source_of_body[i]);
+		if (body.sleeping) {
+			// moving wells change their pull, so they wake anything they are pulling on:
+			if (pull != glm::vec3(0) && wells_moving) wake(body);
+			else continue;
+		}
+
+		body.force += body.mass * gravity;
+		body.force += -body.velocity * drag;
+		body.force += pull * body.mass;
+
+		body.velocity += body.force / body.mass * elapsed;
+		glm::vec3 motion = body.velocity * elapsed;
+
+		// continuous collision: a sphere moving far enough this step to skip past something thin is swept,
+		//  and stopped just inside the first thing it would hit (the discrete test + solver respond next step);
+		//  pickups and the hole are passed through, so that eating and sinking work as they do at low speed:
+		if (body.collider && body.collider->type == Scene::ColliderType::Sphere) {
+			auto const &sphere = *std::static_pointer_cast<const Scene::SphereCollider>(body.collider);
+			const float radius = sphere.radius * body.transform->scale.x;
+			if (glm::length(motion) > CcdMotion * radius) {
+				const float skin = CcdSkin * radius;
+				const glm::vec3 center = body.transform->make_local_to_world() * glm::vec4(sphere.center, 1.0f);
+				const glm::vec3 reach = glm::vec3(radius + skin);
+				float first = 1.0f;
+				for (uint32_t proxy : candidates_for(glm::min(center, center + motion) - reach, glm::max(center, center + motion) + reach)) {
+					Scene::CollisionObject const *other = object_of_proxy[proxy];
+					if (!other || other == &body || !other->collider || other->to_delete) continue;
+					if (other->is_pickup || other->is_hole) continue;
+					float toi;
+					if (Scene::sweep_sphere(body.collider, body.transform, motion, other->collider, other->transform, skin, &toi)) {
+						first = glm::min(first, toi);
+					}
 				}
+				motion *= first;
 			}
+		}
+
+		body.transform->position += motion;
+
+		body.force = glm::vec3(0);
 
-			body->velocity += body->force / body->mass * elapsed;
-			body->transform->position += body->velocity * elapsed;
+		if (glm::distance(body.transform->position, body.rest_position) <= SleepSpeed * SleepTime) {
+			body.rest_time += elapsed;
+		} else {
+			body.rest_position = body.transform->position;
+			body.rest_time = 0.0f;
+		}
+	}
 
-			body->force = glm::vec3(0);
+	// put islands to sleep
+	// bodies touching each other this frame form an island (union-find over body-body contacts);
+	//  an island sleeps only once every body in it has been resting for SleepTime:
+	FrameVector<uint32_t> island_parent(body_count);
+	for (uint32_t i = 0; i < body_count; ++i) island_parent[i] = i;
+	auto find = [&](uint32_t i) {
+		while (island_parent[i] != i) {
+			island_parent[i] = island_parent[island_parent[i]]; //(path halving)
+			i = island_parent[i];
 		}
+		return i;
+	};
+	for (auto const &col : collisions) {
+		if (!col.body_b) continue;
+		uint32_t a = find(uint32_t(col.obj_a - body_data));
+		uint32_t b = find(uint32_t(col.body_b - body_data));
+		if (a != b) island_parent[a] = b;
+	}
+
+	FrameVector<uint8_t> island_rests(body_count, 1);
+	for (uint32_t i = 0; i < body_count; ++i) {
+		Scene::RigidBody const &body = body_data[i];
+		if (body.sleeping || body.rest_time < SleepTime) island_rests[find(i)] = 0;
+	}
+	FrameVector<uint32_t> island_ids(body_count, -1U);
+	for (uint32_t i = 0; i < body_count; ++i) {
+		uint32_t root = find(i);
+		if (!island_rests[root]) continue;
+		if (island_ids[root] == -1U) island_ids[root] = next_island++;
+		Scene::RigidBody &body = body_data[i];
+		body.sleeping = true;
+		body.island = island_ids[root];
+		body.velocity = glm::vec3(0);
+		body.force = glm::vec3(0);
 	}
 
 }
 
+void PlayMode::wake(Scene::RigidBody &body) {
+	auto wake_one = [](Scene::RigidBody &b) {
+		b.sleeping = false;
+		b.island = -1U;
+		b.rest_position = b.transform->position;
+		b.rest_time = 0.0f;
+	};
+	if (body.island == -1U) {
+		wake_one(body);
+		return;
+	}
+	uint32_t island = body.island;
+	for (Scene::RigidBody &other : bodies) {
+		if (other.island == island) wake_one(other);
+	}
+}
+
 void PlayMode::swing() {
 	should_swing = false;
-	const glm::vec3 hole_pos = hole->transform->make_local_to_world() * glm::vec4(0,0,0,1);
-	const float dist = glm::distance(hole_pos, player->position);
-	
-	if (swing_power > 0 && dist <= hit_radius + hole_radius_start * hole_scale) {//can hit hole here
-		hole->velocity += hole->mass * swing_power/swing_max * player->make_local_to_world() * glm::vec4(-max_hit_velocity,0,0,0);
+	Scene::RigidBody &hole_body = bodies[hole];
+	if (swing_power <= 0) return;
+
+	//can hit the hole if its collider is within reach of the player:
+	const glm::vec3 player_pos = player->make_local_to_world() * glm::vec4(0,0,0,1);
+	query_results.clear();
+	query.overlap_sphere(SceneQuery::Sphere{player_pos, hit_radius}, &query_results);
+	if (std::find(query_results.begin(), query_results.end(), hole_body.query_proxy) != query_results.end()) {
+		if (hole_body.sleeping) wake(hole_body);
+		hole_body.velocity += hole_body.mass * swing_power/swing_max * player->make_local_to_world() * glm::vec4(-max_hit_velocity,0,0,0);
 	}
 }
 
-void PlayMode::draw(glm::uvec2 const &drawable_size) {
-	if (loading) return;
-	//update camera aspect ratio for drawable:
-	camera->aspect = float(drawable_size.x) / float(drawable_size.y);
-
-	//set up light type and position for lit_color_texture_program:
+//drawing helpers shared by PlayMode::draw and PlayMode::Snapshot::draw:
+static void setup_draw(glm::mat4 const &world_to_clip) {
+	//set up camera + light for this frame (read by lit_color_texture_program through its "Frame" block):
 	// TODO: consider using the Light(s) in the scene to do this
-	glUseProgram(lit_color_texture_program->program);
-	glUniform1i(lit_color_texture_program->LIGHT_TYPE_int, 1);
-	glUniform3fv(lit_color_texture_program->LIGHT_DIRECTION_vec3, 1, glm::value_ptr(glm::vec3(0.0f, 0.0f,-1.0f)));
-	glUniform3fv(lit_color_texture_program->LIGHT_ENERGY_vec3, 1, glm::value_ptr(glm::vec3(1.0f, 1.0f, 0.95f)));
-	glUseProgram(0);
+	FrameUniforms frame;
+	frame.WORLD_TO_CLIP = world_to_clip;
+	frame.LIGHT_TYPE = 1; //hemisphere
+	frame.LIGHT_DIRECTION = glm::vec3(0.0f, 0.0f,-1.0f);
+	frame.LIGHT_ENERGY = glm::vec3(1.0f, 1.0f, 0.95f);
+	set_frame_uniforms(frame);
 
 	glClearColor(0.1f, 0.045f, 0.24f, 1.0f);
 	glClearDepth(1.0f); //1.0 is actually the default value to clear the depth buffer to, but FYI you can change it.
@@ -549,35 +821,142 @@ void PlayMode::draw(glm::uvec2 const &drawable_size) {
 	glDepthFunc(GL_LESS); //this is the default depth comparison function, but FYI you can change it.
 
 	GL_ERRORS(); //print any errors produced by this setup code
+}
 
-	scene.draw(*camera);
-
-	{ //use DrawLines to overlay some text:
-		glDisable(GL_DEPTH_TEST);
-		float aspect = float(drawable_size.x) / float(drawable_size.y);
-		DrawLines lines(glm::mat4(
-			1.0f / aspect, 0.0f, 0.0f, 0.0f,
-			0.0f, 1.0f, 0.0f, 0.0f,
-			0.0f, 0.0f, 1.0f, 0.0f,
-			0.0f, 0.0f, 0.0f, 1.0f
-		));
-
-		constexpr float H = 0.09f;
-		lines.draw_text("Mouse + WASD to move, LSHIFT to run. Look down + hold LMB to swing. R to reset level.",
-			glm::vec3(-aspect + 0.1f * H, -1.0 + 0.1f * H, 0.0),
+static void draw_hud(glm::uvec2 const &drawable_size, bool show_fps, float fps, uint64_t frame_allocations, Scene::OpaqueMode opaque_mode) {
+	//use DrawLines to overlay some text:
+	glDisable(GL_DEPTH_TEST);
+	float aspect = float(drawable_size.x) / float(drawable_size.y);
+	DrawLines lines(glm::mat4(
+		1.0f / aspect, 0.0f, 0.0f, 0.0f,
+		0.0f, 1.0f, 0.0f, 0.0f,
+		0.0f, 0.0f, 1.0f, 0.0f,
+		0.0f, 0.0f, 0.0f, 1.0f
+	));
+
+	//(static so that drawing the HUD doesn't allocate a string every frame)
+	static std::string const help = "Mouse + WASD to move, LSHIFT to run. Look down + hold LMB to swing. R to reset level.";
+	static std::string const allocations_label = "  allocs/frame: ";
+	static std::string const resolution_label = "  res%: ";
+	static std::array< std::string, 3 > const opaque_labels{"  unordered", "  front-to-back", "  pre-pass"};
+
+	constexpr float H = 0.09f;
+	lines.draw_text(help,
+		glm::vec3(-aspect + 0.1f * H, -1.0 + 0.1f * H, 0.0),
+		glm::vec3(H, 0.0f, 0.0f), glm::vec3(0.0f, H, 0.0f),
+		glm::u8vec4(0x00, 0x00, 0x00, 0x00));
+	float ofs = 2.0f / drawable_size.y;
+	lines.draw_text(help,
+		glm::vec3(-aspect + 0.1f * H + ofs, -1.0 + 0.1f * H + ofs, 0.0),
+		glm::vec3(H, 0.0f, 0.0f), glm::vec3(0.0f, H, 0.0f),
+		glm::u8vec4(0xff, 0xff, 0xff, 0x00));
+
+	if (show_fps) {
+		glm::vec3 anchor;
+		lines.draw_text(std::to_string(fps), 
+		glm::vec3(-aspect + 0.1f * H, 1.0 - H, 0.0),
+		glm::vec3(H, 0.0f, 0.0f), glm::vec3(0.0f, H, 0.0f), 
+		glm::u8vec4(0xff, 0xff, 0xff, 0x00), &anchor);
+		//heap allocations over the last frame (should be zero once a level is running; only counted in COUNT_HEAP_ALLOCATIONS builds):
+		if (FrameArena::CountsHeapAllocations) {
+			lines.draw_text(allocations_label, anchor,
 			glm::vec3(H, 0.0f, 0.0f), glm::vec3(0.0f, H, 0.0f),
-			glm::u8vec4(0x00, 0x00, 0x00, 0x00));
-		float ofs = 2.0f / drawable_size.y;
-		lines.draw_text("Mouse + WASD to move, LSHIFT to run. Look down + hold LMB to swing. R to reset level.",
-			glm::vec3(-aspect + 0.1f * H + ofs, -1.0 + 0.1f * H + ofs, 0.0),
+			glm::u8vec4(0xff, 0xff, 0xff, 0x00), &anchor);
+			lines.draw_text(std::to_string(frame_allocations), anchor,
 			glm::vec3(H, 0.0f, 0.0f), glm::vec3(0.0f, H, 0.0f),
-			glm::u8vec4(0xff, 0xff, 0xff, 0x00));
-
-		if (show_fps) {
-			lines.draw_text(std::to_string(fps), 
-			glm::vec3(-aspect + 0.1f * H, 1.0 - H, 0.0),
-			glm::vec3(H, 0.0f, 0.0f), glm::vec3(0.0f, H, 0.0f), 
-			glm::u8vec4(0xff, 0xff, 0xff, 0x00));
+			glm::u8vec4(0xff, 0xff, 0xff, 0x00), &anchor);
 		}
+		//scene resolution (see DynamicResolution):
+		lines.draw_text(resolution_label, anchor,
+		glm::vec3(H, 0.0f, 0.0f), glm::vec3(0.0f, H, 0.0f),
+		glm::u8vec4(0xff, 0xff, 0xff, 0x00), &anchor);
+		lines.draw_text(std::to_string(int32_t(std::round(DynamicResolution::get().scale * 100.0f))), anchor,
+		glm::vec3(H, 0.0f, 0.0f), glm::vec3(0.0f, H, 0.0f),
+		glm::u8vec4(0xff, 0xff, 0xff, 0x00), &anchor);
+		//opaque drawing order (see Scene::OpaquePicker):
+		lines.draw_text(opaque_labels[size_t(opaque_mode)], anchor,
+		glm::vec3(H, 0.0f, 0.0f), glm::vec3(0.0f, H, 0.0f),
+		glm::u8vec4(0xff, 0xff, 0xff, 0x00));
+	}
+}
+
+void PlayMode::draw(glm::uvec2 const &drawable_size) {
+	if (loading) return;
+	//update camera aspect ratio for drawable:
+	camera->aspect = float(drawable_size.x) / float(drawable_size.y);
+
+	//late-latch: apply the newest mouse motion right before the camera matrix is built:
+	// (and re-attach the club, which isn't parented to the camera, so it turns with the view)
+	latch_mouse();
+	attach_club();
+	glm::mat4 world_to_clip = camera->make_projection() * glm::mat4(camera->transform->make_world_to_local());
+
+	//the scene goes through DynamicResolution (which may draw it smaller and scale it up); the HUD is drawn at full resolution:
+	DynamicResolution &resolution = DynamicResolution::get();
+	glm::uvec2 render_size = resolution.begin(drawable_size);
+	//(LODs are picked inside scene.draw, by the height actually rendered at)
+	scene.lod_settings.viewport_height = float(render_size.y);
+	scene.opaque_settings = opaque_picker->begin(lvl_index, render_size);
+	scene.opaque_settings.show_overdraw = show_overdraw;
+	setup_draw(world_to_clip);
+	scene.draw(world_to_clip);
+	opaque_picker->end();
+	resolution.end(drawable_size);
+
+	draw_hud(drawable_size, show_fps, fps, frame_allocations, opaque_picker->mode);
+}
+
+bool PlayMode::snapshot(std::unique_ptr< Mode::Snapshot > *into, glm::uvec2 const &drawable_size) {
+	assert(into);
+	//re-use the previous snapshot (and its storage) when possible:
+	PlayMode::Snapshot *frame = dynamic_cast< PlayMode::Snapshot * >(into->get());
+	if (!frame) {
+		frame = new PlayMode::Snapshot;
+		into->reset(frame);
 	}
+
+	frame->loading = loading;
+	if (loading) return true; //nothing to draw (same as draw() during loading)
+
+	//late-latch (as in draw()), so the render thread gets the newest camera orientation:
+	latch_mouse();
+	attach_club();
+
+	frame->world_to_camera = camera->transform->make_world_to_local();
+	frame->fovy = camera->fovy;
+	frame->near = camera->near;
+
+	//(LODs are picked here, so the choices carry over to the next frame; the render thread
+	// sets the actual render size in Snapshot::draw, so use DynamicResolution's prediction of it)
+	scene.lod_settings.viewport_height = float(DynamicResolution::get().predict_render_size(drawable_size).y);
+	float aspect = float(drawable_size.x) / float(drawable_size.y);
+	scene.snapshot(&frame->scene, glm::infinitePerspective(frame->fovy, aspect, frame->near) * glm::mat4(frame->world_to_camera));
+
+	frame->show_fps = show_fps;
+	frame->fps = fps;
+	frame->frame_allocations = frame_allocations;
+	frame->lvl_index = lvl_index;
+	frame->show_overdraw = show_overdraw;
+	frame->opaque_picker = opaque_picker;
+
+	return true;
+}
+
+void PlayMode::Snapshot::draw(glm::uvec2 const &drawable_size) const {
+	if (loading) return;
+
+	float aspect = float(drawable_size.x) / float(drawable_size.y);
+	glm::mat4 world_to_clip = glm::infinitePerspective(fovy, aspect, near) * glm::mat4(world_to_camera);
+
+	//(as in PlayMode::draw)
+	DynamicResolution &resolution = DynamicResolution::get();
+	glm::uvec2 render_size = resolution.begin(drawable_size);
+	Scene::OpaqueSettings opaque = opaque_picker->begin(lvl_index, render_size);
+	opaque.show_overdraw = show_overdraw;
+	setup_draw(world_to_clip);
+	Scene::draw(scene, world_to_clip, glm::mat4x3(1.0f), opaque);
+	opaque_picker->end();
+	resolution.end(drawable_size);
+
+	draw_hud(drawable_size, show_fps, fps, frame_allocations, opaque_picker->mode);
 }
@@ -1,11 +1,16 @@
 #include "Mode.hpp"
 
 #include "Scene.hpp"
+#include "Mesh.hpp"
+#include "SceneQuery.hpp"
+#include "Attraction.hpp"
 
 #include <glm/glm.hpp>
 
 #include <vector>
 #include <deque>
+#include <memory>
+#include <unordered_map>
 
 struct PlayMode : Mode {
 	PlayMode();
@@ -22,8 +27,35 @@ struct PlayMode : Mode {
 	virtual void update(float elapsed) override;
 	virtual void draw(glm::uvec2 const &drawable_size) override;
 
+	//threaded rendering support:
+	struct Snapshot : Mode::Snapshot {
+		virtual void draw(glm::uvec2 const &drawable_size) const override;
+		bool loading = true;
+		Scene::Snapshot scene;
+		//camera (aspect comes from drawable_size at draw time):
+		glm::mat4x3 world_to_camera = glm::mat4x3(1.0f);
+		float fovy = glm::radians(60.0f);
+		float near = 0.01f;
+		//HUD:
+		bool show_fps = false;
+		float fps = 0.0f;
+		uint64_t frame_allocations = 0;
+		//opaque drawing:
+		uint8_t lvl_index = 0;
+		bool show_overdraw = false;
+		std::shared_ptr< Scene::OpaquePicker > opaque_picker; //(PlayMode's)
+	};
+	virtual bool snapshot(std::unique_ptr< Mode::Snapshot > *into, glm::uvec2 const &drawable_size) override;
+
 	float fps = 0;
 	bool show_fps = false;
+	uint64_t frame_allocations = 0; //heap allocations during the last frame (shown with fps in COUNT_HEAP_ALLOCATIONS builds; see FrameArena.hpp)
+	uint64_t last_heap_allocations = 0;
+	bool show_overdraw = false; //F4: draw the scene as a heat map of shaded fragments
+	//picks how opaque drawables are ordered by measuring frames as they're drawn; re-measures for each level:
+	// (shared with snapshots, since it's used wherever drawing happens -- the render thread, when there is one;
+	//  the last reference is then a snapshot's, released on the render thread -- see RenderThread.hpp)
+	std::shared_ptr< Scene::OpaquePicker > opaque_picker = std::make_shared< Scene::OpaquePicker >();
 
 	//----- game state -----
 
@@ -44,6 +76,8 @@ struct PlayMode : Mode {
 	float max_hit_velocity = 8.0f;
 	const float hit_radius = 0.3f;
 	void swing();
+	//place the club between hand and aimhand (which hang off the camera), following the player's facing and the swing:
+	void attach_club();
 
 
 	// hole/ball stuff
@@ -56,6 +90,9 @@ struct PlayMode : Mode {
 
 	//local copy of the game scene (so code can change it during gameplay):
 	Scene scene;
+	//level transforms that never move -- everything but the player (and what it carries), the ball, the hole, and items:
+	// (their drawables are merged by bake_static_geometry() when levels load)
+	static bool is_static(Scene::Transform const &transform);
 	
 	//player and camera:
 	Scene::Transform *player = nullptr;
@@ -66,6 +103,11 @@ struct PlayMode : Mode {
 	const float cam_pitch_min = 0;
 	const float cam_pitch_max = glm::pi<float>();
 
+	//mouse motion is coalesced and applied once per update, then again right before drawing ("late-latching"),
+	// so the view reflects the newest mouse state rather than the state at the start of the frame:
+	void latch_mouse();
+	glm::uvec2 mouse_window_size = glm::uvec2(1280, 720); //motion is scaled by window height
+
 	const float cam_pitch_aim_start = 0.65f;
 	const float cam_pitch_aim_end = 0.35f;
 
@@ -74,14 +116,41 @@ struct PlayMode : Mode {
 	Scene::Transform *hand = nullptr;
 	Scene::Transform *aimhand = nullptr;
 	Scene::Transform *club = nullptr;
-	std::shared_ptr<Scene::RigidBody> ball = nullptr;
-	std::shared_ptr<Scene::RigidBody> hole = nullptr;
+	ComponentStore<Scene::RigidBody>::Handle ball; //in 'bodies'
+	ComponentStore<Scene::RigidBody>::Handle hole; //in 'bodies'
 
 	const float drag = 0.3f;
 
 	// physics
 	void handle_physics(float elapsed);
 	const glm::vec3 gravity = glm::vec3(0,0,-9.8f);
-	std::vector<std::shared_ptr<Scene::CollisionObject>> collision_objects;
+	//objects are packed by kind, so the solver knows which side of a collision moves without casting:
+	ComponentStore<Scene::CollisionObject> static_objects; //ground, walls, pickups
+	ComponentStore<Scene::RigidBody> bodies; //ball, hole, vacuumed-up pickups
+	//collision BVHs for "Terrain*" meshes, by mesh:
+	std::unordered_map<Mesh const *, std::shared_ptr<const TriangleBVH>> terrain_bvhs;
+	//collision detection runs on the job system once there are enough pairs to be worth it:
+	static constexpr uint32_t PhysicsParallelPairs = 8192;
+	static constexpr uint32_t PhysicsBlock = 8; //bodies per job
+	//bodies that average less than SleepSpeed over SleepTime (along with everything they touch) stop being simulated:
+	// (measured by displacement rather than instantaneous velocity, since resting bodies still jitter against the ground)
+	static constexpr float SleepSpeed = 0.02f;
+	static constexpr float SleepTime = 0.5f;
+	uint32_t next_island = 0;
+	void wake(Scene::RigidBody &body); //wakes the body's whole island
+	//every hole is a gravity well pulling on all bodies (and on pickups, which get vacuumed up into bodies):
+	Attraction attraction; //(rebuilt every step)
+	//spheres moving more than CcdMotion radii in one step are swept against everything (so they can't tunnel),
+	// and stop once CcdSkin radii deep in whatever they hit first:
+	static constexpr float CcdMotion = 0.5f;
+	static constexpr float CcdSkin = 0.1f;
+
+	//transforms to remove (along with everything attached to them) at the end of the frame:
+	std::vector< Scene::Transform const * > destroy_queue;
+	void flush_destroyed();
+
+	//raycast / overlap queries over colliders and drawable bounds (refit after physics each update):
+	SceneQuery query;
+	std::vector< uint32_t > query_results; //(scratch, reused between queries)
 
 };
@@ -0,0 +1,64 @@
+#include "PositionOnlyProgram.hpp"
+
+#include "gl_compile_program.hpp"
+#include "UniformBlocks.hpp"
+#include "gl_errors.hpp"
+
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+
+PositionOnlyProgram const &PositionOnlyProgram::get(GLuint Position_location) {
+	//(never destroyed, since the context may be gone by the time static destructors run)
+	static auto *programs = new std::unordered_map< GLuint, std::unique_ptr< PositionOnlyProgram > >();
+	auto f = programs->find(Position_location);
+	if (f == programs->end()) {
+		f = programs->emplace(Position_location, std::make_unique< PositionOnlyProgram >(Position_location)).first;
+	}
+	return *f->second;
+}
+
+PositionOnlyProgram::PositionOnlyProgram(GLuint Position_location) {
+	//(invariant, so that depth matches the shading pass exactly -- see LitColorTextureProgram)
+	std::string vertex_shader =
+		"#version 330\n"
+		OBJECT_BLOCK_GLSL
+		"layout(location = " + std::to_string(Position_location) + ") in vec4 Position;\n"
+		"invariant gl_Position;\n"
+		"void main() {\n"
+		"	gl_Position = OBJECT_TO_CLIP * Position;\n"
+		"}\n";
+
+	depth_program = gl_compile_program(vertex_shader,
+		"#version 330\n"
+		"void main() {\n"
+		"}\n"
+	);
+
+	overdraw_program = gl_compile_program(vertex_shader,
+		"#version 330\n"
+		"out vec4 fragColor;\n"
+		"void main() {\n"
+		"	fragColor = vec4(0.1, 0.06, 0.03, 1.0);\n"
+		"}\n"
+	);
+
+	Position_vec4 = glGetAttribLocation(depth_program, "Position");
+	if (Position_vec4 != Position_location) {
+		throw std::runtime_error("Position-only program put Position at " + std::to_string(Position_vec4) + " rather than " + std::to_string(Position_location) + ".");
+	}
+
+	//look up (and bind) the uniform blocks:
+	GLuint Frame_block = -1U, overdraw_Object_block = -1U;
+	bind_uniform_blocks(depth_program, &Frame_block, &Object_block);
+	bind_uniform_blocks(overdraw_program, &Frame_block, &overdraw_Object_block);
+
+	GL_ERRORS();
+}
+
+PositionOnlyProgram::~PositionOnlyProgram() {
+	glDeleteProgram(depth_program);
+	glDeleteProgram(overdraw_program);
+	depth_program = overdraw_program = 0;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "GL.hpp"
+
+//Shader programs that only transform positions (through the "Object" block; see UniformBlocks.hpp),
+// used by Scene::draw for depth pre-passes and for showing overdraw (see Scene::OpaqueSettings).
+//Position is read from a fixed attribute location, so that they can draw with the vertex arrays
+// made for another program that reads Position from the same location (Scene::Material::Position_location):
+struct PositionOnlyProgram {
+	PositionOnlyProgram(GLuint Position_location);
+	~PositionOnlyProgram();
+
+	//(one per attribute location, created on first use; GL thread only)
+	static PositionOnlyProgram const &get(GLuint Position_location);
+
+	GLuint depth_program = 0; //writes nothing but depth (draw with the color mask off)
+	GLuint overdraw_program = 0; //writes a constant, dim color (draw with additive blending; brighter = more fragments)
+
+	//Attribute (per-vertex variable) locations:
+	GLuint Position_vec4 = -1U;
+
+	//Uniform blocks (see UniformBlocks.hpp):
+	GLuint Object_block = -1U; //transforms (only OBJECT_TO_CLIP is used)
+
+	//Textures:
+	// none
+};
@@ -0,0 +1,127 @@
+#include "RenderThread.hpp"
+
+#include "GL.hpp"
+#include "gl_errors.hpp"
+#include "FrameArena.hpp"
+
+#include <cassert>
+#include <iostream>
+
+RenderThread::RenderThread(SDL_Window *window_, SDL_GLContext context_) : window(window_), context(context_) {
+	assert(window);
+	assert(context);
+	thread = std::thread(&RenderThread::loop, this);
+}
+
+RenderThread::~RenderThread() {
+	{
+		std::unique_lock< std::mutex > lock(mutex);
+		quit = true;
+	}
+	cv.notify_all();
+	thread.join();
+}
+
+void RenderThread::submit(Mode &mode, glm::uvec2 const &drawable_size, uint32_t input_time) {
+	uint32_t w = write_slot;
+	{ //wait until the render thread is done with the slot we're about to fill:
+		std::unique_lock< std::mutex > lock(mutex);
+		cv.wait(lock, [&](){ return drawing_slot != int32_t(w) && pending_slot != int32_t(w); });
+	}
+
+	//slot 'w' is now only touched by this thread, so copy without holding the lock:
+	if (!mode.snapshot(&slots[w].snapshot, drawable_size)) {
+		//mode can't be snapshotted, so draw it directly (main thread waits, so mode state is safe to read):
+		run([&](){
+			glViewport(0, 0, drawable_size.x, drawable_size.y);
+			mode.draw(drawable_size);
+			SDL_GL_SwapWindow(window);
+			gl_state_next_frame();
+			if (on_swap) on_swap(input_time);
+		});
+		return;
+	}
+	slots[w].drawable_size = drawable_size;
+	slots[w].input_time = (on_snapshot ? on_snapshot(mode, input_time) : input_time);
+
+	{ //queue the slot, waiting (at most one frame) for the render thread to take the previous one:
+		std::unique_lock< std::mutex > lock(mutex);
+		cv.wait(lock, [&](){ return pending_slot == -1; });
+		pending_slot = int32_t(w);
+	}
+	cv.notify_all();
+
+	write_slot = 1 - w;
+}
+
+void RenderThread::run(std::function< void() > const &fn) {
+	std::unique_lock< std::mutex > lock(mutex);
+	cv.wait(lock, [&](){ return task_done; });
+	task = fn;
+	task_done = false;
+	cv.notify_all();
+	cv.wait(lock, [&](){ return task_done; });
+}
+
+void RenderThread::finish() {
+	std::unique_lock< std::mutex > lock(mutex);
+	cv.wait(lock, [&](){ return pending_slot == -1 && drawing_slot == -1 && task_done; });
+}
+
+void RenderThread::loop() {
+	if (SDL_GL_MakeCurrent(window, context) != 0) {
+		std::cerr << "ERROR: render thread couldn't make GL context current: " << SDL_GetError() << std::endl;
+	}
+
+	std::unique_lock< std::mutex > lock(mutex);
+	while (true) {
+		cv.wait(lock, [&](){ return quit || pending_slot != -1 || task; });
+
+		//nothing from the previous frame/task is still using the render thread's scratch memory:
+		FrameArena::current().reset();
+
+		if (task) {
+			std::function< void() > fn = std::move(task);
+			task = nullptr;
+			lock.unlock();
+			fn();
+			lock.lock();
+			task_done = true;
+			cv.notify_all();
+			continue;
+		}
+
+		if (pending_slot == -1) {
+			assert(quit);
+			break;
+		}
+
+		//take the pending slot:
+		drawing_slot = pending_slot;
+		pending_slot = -1;
+		Slot const &slot = slots[drawing_slot];
+		lock.unlock();
+		cv.notify_all(); //main thread may be waiting to queue another frame
+
+		glViewport(0, 0, slot.drawable_size.x, slot.drawable_size.y);
+		slot.snapshot->draw(slot.drawable_size);
+
+		//Wait until the recently-drawn frame is shown before drawing another:
+		SDL_GL_SwapWindow(window);
+		gl_state_next_frame();
+		if (on_swap) on_swap(slot.input_time);
+
+		lock.lock();
+		drawing_slot = -1;
+		cv.notify_all();
+	}
+	lock.unlock();
+
+	//release the snapshots here, while the context is current, since they may hold the last reference to GL objects:
+	// (the main thread is waiting in ~RenderThread, so nothing else touches the slots)
+	for (auto &slot : slots) {
+		slot.snapshot.reset();
+	}
+
+	SDL_GL_MakeCurrent(window, nullptr);
+}
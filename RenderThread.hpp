@@ -0,0 +1,85 @@
+#pragma once
+
+/*
+ * A RenderThread owns the OpenGL context and draws Mode snapshots on a separate thread.
+ *
+ * Usage (from main thread, once assets are loaded):
+ *   SDL_GL_MakeCurrent(window, nullptr); //release context so the render thread can take it
+ *   RenderThread render_thread(window, context);
+ *   while (...) {
+ *     mode->update(elapsed);
+ *     render_thread.submit(*mode, drawable_size); //returns as soon as the snapshot is copied
+ *   }
+ *
+ * Snapshots are double-buffered: while the render thread draws (and swaps) frame N,
+ *  the main thread is free to simulate frame N+1 and copy it into the other buffer.
+ * 'submit' only blocks if the main thread gets more than one frame ahead.
+ *
+ * NOTE: only the render thread may make GL calls while it is running.
+ *  (use 'run' for one-off GL work like screenshots)
+ *  Snapshots are destroyed on the render thread (with the context current), so they may hold
+ *  the last reference to something that frees GL objects when destroyed.
+ *
+ */
+
+#include "Mode.hpp"
+
+#include <SDL.h>
+#include <glm/glm.hpp>
+
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+struct RenderThread {
+	//starts the render thread, which makes 'context' current:
+	// (context must not be current on any other thread)
+	RenderThread(SDL_Window *window, SDL_GLContext context);
+	//draws any pending frame, then stops the thread (context is left un-current):
+	~RenderThread();
+
+	//copy the current state of 'mode' into a snapshot and queue it to be drawn at 'drawable_size':
+	// if mode doesn't support snapshots, draws it synchronously on the render thread instead.
+	// 'input_time' is passed through to 'on_swap' (used for latency measurement)
+	void submit(Mode &mode, glm::uvec2 const &drawable_size, uint32_t input_time = 0);
+
+	//(optional) called on the main thread right after each snapshot is taken; returns the 'input_time' to pass to 'on_swap':
+	// (lets the caller account for input the mode pulled in while snapshotting)
+	std::function< uint32_t(Mode &mode, uint32_t input_time) > on_snapshot;
+
+	//(optional) called on the render thread after each frame's swap:
+	std::function< void(uint32_t input_time) > on_swap;
+
+	//run 'fn' on the render thread (with the context current) and wait for it to return:
+	void run(std::function< void() > const &fn);
+
+	//wait until every submitted frame has been drawn and swapped:
+	void finish();
+
+	//-- internals --
+	void loop();
+
+	SDL_Window *window = nullptr;
+	SDL_GLContext context = nullptr;
+
+	std::mutex mutex;
+	std::condition_variable cv;
+
+	struct Slot {
+		std::unique_ptr< Mode::Snapshot > snapshot;
+		glm::uvec2 drawable_size = glm::uvec2(0);
+		uint32_t input_time = 0;
+	} slots[2];
+	uint32_t write_slot = 0; //slot the main thread fills next
+	int32_t pending_slot = -1; //slot waiting to be drawn (or -1)
+	int32_t drawing_slot = -1; //slot being drawn right now (or -1)
+
+	std::function< void() > task; //one-off work queued by 'run'
+	bool task_done = true;
+
+	bool quit = false;
+
+	std::thread thread;
+};
@@ -2,9 +2,16 @@
 
 #include "gl_errors.hpp"
 #include "read_write_chunk.hpp"
+#include "JobSystem.hpp"
+#include "UniformBlocks.hpp"
+#include "PositionOnlyProgram.hpp"
+#include "FrameArena.hpp"
+#include "Mesh.hpp"
 
 #include <glm/gtc/type_ptr.hpp>
 
+#include <algorithm>
+#include <cstring>
 #include <fstream>
 
 //-------------------------
@@ -87,89 +94,540 @@ void Scene::draw(Camera const &camera) const {
 	draw(world_to_clip, world_to_light);
 }
 
-void Scene::draw(glm::mat4 const &world_to_clip, glm::mat4x3 const &world_to_light) const {
+//pixels covered by one world-space unit at clip w == 1 (the projection's y scale is the length of world_to_clip's y row):
+static float lod_pixels_per_unit(glm::mat4 const &world_to_clip, Scene::LODSettings const &settings) {
+	return 0.5f * settings.viewport_height * glm::length(glm::vec3(world_to_clip[0][1], world_to_clip[1][1], world_to_clip[2][1]));
+}
 
-	//Iterate through all drawables, sending each one to OpenGL:
-	for (auto const &drawable : drawables) {
-		//Reference to drawable's pipeline for convenience:
-		Scene::Drawable::Pipeline const &pipeline = drawable.pipeline;
+//helper used by both scene and snapshot drawing; picks the level of detail to draw, given the one drawn last frame:
+static uint32_t pick_lod(Scene::Shape const *shape, uint32_t current, glm::mat4x3 const &object_to_world, glm::mat4 const &world_to_clip, float pixels_per_unit, Scene::LODSettings const &settings) {
+	if (!settings.enabled || !shape || shape->lods[0].count == 0) return 0;
+
+	//distance to the near side of the bounding sphere:
+	float scale = glm::max(glm::length(object_to_world[0]), glm::max(glm::length(object_to_world[1]), glm::length(object_to_world[2])));
+	glm::vec3 center = object_to_world * glm::vec4(glm::vec3(shape->bounds), 1.0f);
+	float w = (world_to_clip * glm::vec4(center, 1.0f)).w - scale * shape->bounds.w;
+	if (w <= 0.0f) return 0; //(camera is inside the bounds, or they're behind it)
+	float error_to_pixels = pixels_per_unit * scale / w;
+
+	//coarsest level whose error fits on screen; moving to a coarser level than last frame needs some margin, and so does leaving the current one:
+	for (uint32_t l = Scene::Shape::LODCount; l > 0; --l) {
+		auto const &lod = shape->lods[l-1];
+		if (lod.count == 0) continue;
+		float limit = settings.max_error * (l > current ? 1.0f - settings.hysteresis : 1.0f + settings.hysteresis);
+		if (lod.error * error_to_pixels <= limit) return l;
+	}
+	return 0;
+}
+
+//set the standard transforms as plain uniforms (for programs without an "Object" uniform block):
+static void set_object_uniforms(Scene::Material const &material, glm::mat4x3 const &object_to_world, glm::mat4 const &world_to_clip, glm::mat4x3 const &world_to_light) {
+	//OBJECT_TO_CLIP takes vertices from object space to clip space:
+	if (material.OBJECT_TO_CLIP_mat4 != -1U) {
+		glm::mat4 object_to_clip = world_to_clip * glm::mat4(object_to_world);
+		glUniformMatrix4fv(material.OBJECT_TO_CLIP_mat4, 1, GL_FALSE, glm::value_ptr(object_to_clip));
+	}
+
+	//the object-to-light matrix is used in the next two uniforms:
+	glm::mat4x3 object_to_light = world_to_light * glm::mat4(object_to_world);
 
-		//skip any drawables without a shader program set:
-		if (pipeline.program == 0) continue;
-		//skip any drawables that don't reference any vertex array:
-		if (pipeline.vao == 0) continue;
-		//skip any drawables that don't contain any vertices:
-		if (pipeline.count == 0) continue;
+	//OBJECT_TO_CLIP takes vertices from object space to light space:
+	if (material.OBJECT_TO_LIGHT_mat4x3 != -1U) {
+		glUniformMatrix4x3fv(material.OBJECT_TO_LIGHT_mat4x3, 1, GL_FALSE, glm::value_ptr(object_to_light));
+	}
 
+	//NORMAL_TO_CLIP takes normals from object space to light space:
+	if (material.NORMAL_TO_LIGHT_mat3 != -1U) {
+		glm::mat3 normal_to_light = glm::inverse(glm::transpose(glm::mat3(object_to_light)));
+		glUniformMatrix3fv(material.NORMAL_TO_LIGHT_mat3, 1, GL_FALSE, glm::value_ptr(normal_to_light));
+	}
+}
 
-		//Set shader program:
-		glUseProgram(pipeline.program);
+//helper used by both scene and snapshot drawing; sends one drawable to OpenGL:
+// (materials with an "Object" uniform block use block 'object_block' of UniformRing::get()'s current batch; the matrices are only used otherwise)
+static void draw_pipeline(Scene::Material const &material, Scene::Drawable::Pipeline const &pipeline, Scene::Shape const *shape, uint32_t lod, uint32_t object_block, glm::mat4x3 const &object_to_world, glm::mat4 const &world_to_clip, glm::mat4x3 const &world_to_light) {
+	//skip any drawables without a shader program set:
+	if (material.program == 0) return;
+	//skip any drawables that don't reference any vertex array:
+	if (pipeline.vao == 0) return;
+	//skip any drawables that don't contain any vertices:
+	if (pipeline.count == 0) return;
 
-		//Set attribute sources:
-		glBindVertexArray(pipeline.vao);
 
-		//Configure program uniforms:
+	//Set shader program:
+	glUseProgram(material.program);
 
-		//the object-to-world matrix is used in all three of these uniforms:
-		assert(drawable.transform); //drawables *must* have a transform
-		glm::mat4x3 object_to_world = drawable.transform->make_local_to_world();
+	//Set attribute sources:
+	glBindVertexArray(pipeline.vao);
 
-		//OBJECT_TO_CLIP takes vertices from object space to clip space:
-		if (pipeline.OBJECT_TO_CLIP_mat4 != -1U) {
-			glm::mat4 object_to_clip = world_to_clip * glm::mat4(object_to_world);
-			glUniformMatrix4fv(pipeline.OBJECT_TO_CLIP_mat4, 1, GL_FALSE, glm::value_ptr(object_to_clip));
+	//Configure program uniforms:
+	if (material.Object_block != -1U) {
+		//(already written by the caller)
+		UniformRing::get().bind(ObjectBinding, object_block);
+	} else {
+		set_object_uniforms(material, object_to_world, world_to_clip, world_to_light);
+	}
+
+	//set up textures:
+	// (left bound afterward -- drawables sharing a material usually come one after another -- and un-bound by finish_drawing)
+	for (uint32_t i = 0; i < Scene::Material::TextureCount; ++i) {
+		if (material.textures[i].texture != 0) {
+			glActiveTexture(GL_TEXTURE0 + i);
+			glBindTexture(material.textures[i].target, material.textures[i].texture);
+		}
+	}
+
+	//draw the object (at the chosen level of detail):
+	GLuint start = pipeline.start;
+	GLuint count = pipeline.count;
+	if (lod > 0 && shape && shape->lods[lod-1].count != 0) {
+		start = shape->lods[lod-1].start;
+		count = shape->lods[lod-1].count;
+	}
+	if (pipeline.index_type != GL_NONE) {
+		GLsizeiptr index_size = (pipeline.index_type == GL_UNSIGNED_SHORT ? 2 : 4);
+		glDrawElements(pipeline.type, count, pipeline.index_type, (GLbyte *)0 + start * index_size);
+	} else {
+		glDrawArrays(pipeline.type, start, count);
+	}
+}
+
+//helper used by both scene and snapshot drawing; un-binds everything draw_pipeline may have left bound:
+static void finish_drawing(std::vector< Scene::Material > const &materials) {
+	for (auto const &material : materials) {
+		for (uint32_t i = 0; i < Scene::Material::TextureCount; ++i) {
+			if (material.textures[i].texture != 0) {
+				glActiveTexture(GL_TEXTURE0 + i);
+				glBindTexture(material.textures[i].target, 0);
+			}
 		}
+	}
+	glActiveTexture(GL_TEXTURE0);
+
+	glUseProgram(0);
+	glBindVertexArray(0);
+}
+
+bool Scene::Material::operator==(Material const &other) const {
+	if (program != other.program) return false;
+	if (Object_block != other.Object_block) return false;
+	if (OBJECT_TO_CLIP_mat4 != other.OBJECT_TO_CLIP_mat4) return false;
+	if (OBJECT_TO_LIGHT_mat4x3 != other.OBJECT_TO_LIGHT_mat4x3) return false;
+	if (NORMAL_TO_LIGHT_mat3 != other.NORMAL_TO_LIGHT_mat3) return false;
+	for (uint32_t i = 0; i < TextureCount; ++i) {
+		if (textures[i].texture != other.textures[i].texture) return false;
+		if (textures[i].target != other.textures[i].target) return false;
+	}
+	if (texture_layer != other.texture_layer) return false;
+	if (texture_rect != other.texture_rect) return false;
+	if (Position_location != other.Position_location) return false;
+	return true;
+}
+
+uint32_t Scene::add_material(Material const &material) {
+	for (uint32_t i = 0; i < materials.size(); ++i) {
+		if (materials[i] == material) return i;
+	}
+	materials.emplace_back(material);
+	return uint32_t(materials.size()) - 1;
+}
+
+Scene::Shape Scene::Shape::make(Mesh const &mesh) {
+	Shape shape;
+	for (uint32_t l = 0; l < mesh.lods.size() && l < LODCount; ++l) {
+		shape.lods[l].start = mesh.lods[l].start;
+		shape.lods[l].count = mesh.lods[l].count;
+		shape.lods[l].error = mesh.lods[l].error;
+	}
+	shape.bounds = glm::vec4(0.5f * (mesh.min + mesh.max), 0.5f * glm::length(mesh.max - mesh.min));
+	return shape;
+}
+
+bool Scene::Shape::operator==(Shape const &other) const {
+	for (uint32_t l = 0; l < LODCount; ++l) {
+		if (lods[l].start != other.lods[l].start) return false;
+		if (lods[l].count != other.lods[l].count) return false;
+		if (lods[l].error != other.lods[l].error) return false;
+	}
+	if (bounds != other.bounds) return false;
+	return true;
+}
+
+uint32_t Scene::add_shape(Shape const &shape) {
+	//(checked newest-first, since drawables using the same mesh tend to be added together)
+	for (uint32_t i = uint32_t(shapes.size()); i > 0; --i) {
+		if (shapes[i-1] == shape) return i-1;
+	}
+	shapes.emplace_back(shape);
+	return uint32_t(shapes.size()) - 1;
+}
+
+//material for a drawable (or an empty one, which isn't drawn, if it doesn't have one):
+static Scene::Material const &material_for(std::vector< Scene::Material > const &materials, Scene::Drawable::Pipeline const &pipeline) {
+	static Scene::Material const none;
+	return (pipeline.material < materials.size() ? materials[pipeline.material] : none);
+}
 
-		//the object-to-light matrix is used in the next two uniforms:
-		glm::mat4x3 object_to_light = world_to_light * glm::mat4(object_to_world);
+//shape for a drawable (or nullptr if it doesn't have one):
+static Scene::Shape const *shape_for(std::vector< Scene::Shape > const &shapes, Scene::Drawable::Pipeline const &pipeline) {
+	return (pipeline.shape < shapes.size() ? &shapes[pipeline.shape] : nullptr);
+}
+
+//view depth of the center of a drawable's bounds, as a key that sorts nearest-first:
+// (non-negative floats order the same way as their bits; the low half is the drawable's index, which keeps ties in list order)
+static uint64_t depth_key(Scene::Shape const *shape, glm::mat4x3 const &object_to_world, glm::mat4 const &world_to_clip, uint32_t index) {
+	glm::vec3 center = object_to_world * glm::vec4(shape ? glm::vec3(shape->bounds) : glm::vec3(0.0f), 1.0f);
+	float w = std::max(0.0f, (world_to_clip * glm::vec4(center, 1.0f)).w);
+	uint32_t bits;
+	std::memcpy(&bits, &w, sizeof(bits));
+	return (uint64_t(bits) << 32) | index;
+}
 
-		//OBJECT_TO_CLIP takes vertices from object space to light space:
-		if (pipeline.OBJECT_TO_LIGHT_mat4x3 != -1U) {
-			glUniformMatrix4x3fv(pipeline.OBJECT_TO_LIGHT_mat4x3, 1, GL_FALSE, glm::value_ptr(object_to_light));
+//helper used by both scene and snapshot drawing; draws 'count' drawables in the passes 'settings' asks for:
+// pipeline_of(i) is drawable i's pipeline; draw(i, material) sends drawable i to OpenGL with 'material' (its own or a position-only stand-in)
+// 'order' holds depth_key()s in drawing order (or is empty, for list order)
+template< typename PipelineOf, typename Draw >
+static void draw_opaque(std::vector< Scene::Material > const &materials, uint32_t count, FrameVector< uint64_t > const &order, Scene::OpaqueSettings const &settings, PipelineOf const &pipeline_of, Draw const &draw) {
+	bool prepass = (settings.mode == Scene::OpaqueMode::DepthPrepass);
+
+	//position-only stand-ins for each material (with program 0 if the material can't use one):
+	FrameVector< Scene::Material > depth_materials, overdraw_materials;
+	if (prepass || settings.show_overdraw) {
+		for (auto const &material : materials) {
+			Scene::Material depth, overdraw;
+			if (material.program != 0 && material.Object_block != -1U && material.Position_location != -1U) {
+				PositionOnlyProgram const &program = PositionOnlyProgram::get(material.Position_location);
+				depth.program = program.depth_program;
+				overdraw.program = program.overdraw_program;
+				depth.Object_block = overdraw.Object_block = program.Object_block;
+			}
+			depth_materials.emplace_back(depth);
+			overdraw_materials.emplace_back(overdraw);
 		}
+	}
+	auto stand_in = [](FrameVector< Scene::Material > const &stand_ins, Scene::Drawable::Pipeline const &pipeline) -> Scene::Material const * {
+		if (pipeline.material >= stand_ins.size() || stand_ins[pipeline.material].program == 0) return nullptr;
+		return &stand_ins[pipeline.material];
+	};
 
-		//NORMAL_TO_CLIP takes normals from object space to light space:
-		if (pipeline.NORMAL_TO_LIGHT_mat3 != -1U) {
-			glm::mat3 normal_to_light = glm::inverse(glm::transpose(glm::mat3(object_to_light)));
-			glUniformMatrix3fv(pipeline.NORMAL_TO_LIGHT_mat3, 1, GL_FALSE, glm::value_ptr(normal_to_light));
+	auto for_each = [&](auto const &fn) {
+		if (order.empty()) {
+			for (uint32_t i = 0; i < count; ++i) fn(i);
+		} else {
+			for (uint64_t key : order) fn(uint32_t(key));
 		}
+	};
+	auto shade = [&](uint32_t i) {
+		Scene::Drawable::Pipeline const &pipeline = pipeline_of(i);
+		Scene::Material const *overdraw = (settings.show_overdraw ? stand_in(overdraw_materials, pipeline) : nullptr);
+		draw(i, overdraw ? *overdraw : material_for(materials, pipeline));
+	};
 
-		//set any requested custom uniforms:
-		if (pipeline.set_uniforms) pipeline.set_uniforms();
+	//lay down depth for everything that can be drawn position-only:
+	if (prepass) {
+		glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+		for_each([&](uint32_t i) {
+			if (Scene::Material const *depth = stand_in(depth_materials, pipeline_of(i))) draw(i, *depth);
+		});
+		glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+	}
 
-		//set up textures:
-		for (uint32_t i = 0; i < Drawable::Pipeline::TextureCount; ++i) {
-			if (pipeline.textures[i].texture != 0) {
-				glActiveTexture(GL_TEXTURE0 + i);
-				glBindTexture(pipeline.textures[i].target, pipeline.textures[i].texture);
+	if (settings.show_overdraw) {
+		glEnable(GL_BLEND);
+		glBlendFunc(GL_ONE, GL_ONE);
+	}
+	if (settings.samples_query) glBeginQuery(GL_SAMPLES_PASSED, settings.samples_query);
+
+	if (prepass) {
+		//drawables already in the depth buffer only shade where they ended up nearest:
+		glDepthFunc(GL_EQUAL);
+		glDepthMask(GL_FALSE);
+		for_each([&](uint32_t i) {
+			if (stand_in(depth_materials, pipeline_of(i))) shade(i);
+		});
+		glDepthFunc(GL_LESS);
+		glDepthMask(GL_TRUE);
+
+		//...and the rest are drawn as usual:
+		for_each([&](uint32_t i) {
+			if (!stand_in(depth_materials, pipeline_of(i))) shade(i);
+		});
+	} else {
+		for_each(shade);
+	}
+
+	if (settings.samples_query) glEndQuery(GL_SAMPLES_PASSED);
+	if (settings.show_overdraw) glDisable(GL_BLEND);
+}
+
+void Scene::draw(glm::mat4 const &world_to_clip, glm::mat4x3 const &world_to_light) const {
+
+	float pixels_per_unit = lod_pixels_per_unit(world_to_clip, lod_settings);
+	lod_stats = LODStats();
+
+	//write every drawable's "Object" uniform block up front, so that drawing only has to bind offsets:
+	UniformRing &ring = UniformRing::get();
+	uint32_t blocks = 0;
+	for (auto const &drawable : drawables) {
+		if (material_for(materials, drawable.pipeline).Object_block != -1U) blocks += 1;
+	}
+	if (blocks) ring.allocate(blocks, sizeof(ObjectUniforms));
+
+	//(blocks are remembered per drawable, since drawing may not happen in list order)
+	Drawable const *drawable = drawables.data();
+	uint32_t count = uint32_t(drawables.size());
+	FrameVector< uint32_t > object_blocks(count, -1U);
+	FrameVector< uint64_t > order;
+	bool sorted = (opaque_settings.mode != OpaqueMode::Unordered);
+	if (sorted) order.reserve(count);
+
+	uint32_t block = 0;
+	for (uint32_t i = 0; i < count; ++i) {
+		//the object-to-world matrix is used in all three of the standard uniforms:
+		assert(drawable[i].transform); //drawables *must* have a transform
+		glm::mat4x3 object_to_world = drawable[i].transform->make_local_to_world();
+
+		Shape const *shape = shape_for(shapes, drawable[i].pipeline);
+		uint32_t lod = pick_lod(shape, drawable[i].lod, object_to_world, world_to_clip, pixels_per_unit, lod_settings);
+		if (lod != drawable[i].lod) lod_stats.switches += 1;
+		drawable[i].lod = uint8_t(lod);
+		lod_stats.full_triangles += drawable[i].pipeline.count / 3;
+		lod_stats.triangles += (lod ? shape->lods[lod-1].count : drawable[i].pipeline.count) / 3;
+
+		if (sorted) order.emplace_back(depth_key(shape, object_to_world, world_to_clip, i));
+
+		Material const &material = material_for(materials, drawable[i].pipeline);
+		if (material.Object_block != -1U) {
+			ObjectUniforms uniforms = ObjectUniforms::make(object_to_world, world_to_clip, world_to_light);
+			uniforms.TEX_RECT = material.texture_rect;
+			uniforms.TEX_LAYER = float(material.texture_layer);
+			object_blocks[i] = block;
+			std::memcpy(ring.block< ObjectUniforms >(block++), &uniforms, sizeof(uniforms)); //(mapped memory: write only, in order)
+		}
+	}
+	if (blocks) ring.upload();
+	if (sorted) std::sort(order.begin(), order.end());
+
+	//Send each drawable to OpenGL:
+	draw_opaque(materials, count, order, opaque_settings,
+		[&](uint32_t i) -> Drawable::Pipeline const & { return drawable[i].pipeline; },
+		[&](uint32_t i, Material const &material) {
+			if (material.Object_block != -1U) {
+				draw_pipeline(material, drawable[i].pipeline, shape_for(shapes, drawable[i].pipeline), drawable[i].lod, object_blocks[i], glm::mat4x3(1.0f) /* (unused) */, world_to_clip, world_to_light);
+			} else {
+				draw_pipeline(material, drawable[i].pipeline, shape_for(shapes, drawable[i].pipeline), drawable[i].lod, -1U, drawable[i].transform->make_local_to_world(), world_to_clip, world_to_light);
 			}
 		}
+	);
+	ring.fence();
 
-		//draw the object:
-		glDrawArrays(pipeline.type, pipeline.start, pipeline.count);
+	finish_drawing(materials);
 
-		//un-bind textures:
-		for (uint32_t i = 0; i < Drawable::Pipeline::TextureCount; ++i) {
-			if (pipeline.textures[i].texture != 0) {
-				glActiveTexture(GL_TEXTURE0 + i);
-				glBindTexture(pipeline.textures[i].target, 0);
+	GL_ERRORS();
+}
+
+void Scene::snapshot(Snapshot *snapshot_) const {
+	snapshot_lods(snapshot_, nullptr);
+}
+
+void Scene::snapshot(Snapshot *snapshot_, glm::mat4 const &world_to_clip) const {
+	snapshot_lods(snapshot_, &world_to_clip);
+}
+
+void Scene::snapshot_lods(Snapshot *snapshot_, glm::mat4 const *world_to_clip) const {
+	assert(snapshot_);
+	auto &items = snapshot_->items;
+
+	//(materials and shapes are few and rarely change, so they're copied whole)
+	snapshot_->materials = materials;
+	snapshot_->shapes = shapes;
+
+	//resize (rather than clear) so that items' storage gets re-used from frame to frame:
+	items.resize(drawables.size());
+
+	//drawables are packed, so items[i] comes from drawables.data()[i];
+	// world matrices (walking each parent chain) are the expensive part, and independent per drawable:
+	Drawable const *drawable = drawables.data();
+	float pixels_per_unit = (world_to_clip ? lod_pixels_per_unit(*world_to_clip, lod_settings) : 0.0f);
+	auto compute = [&](uint32_t begin, uint32_t end) {
+		for (uint32_t i = begin; i < end; ++i) {
+			assert(drawable[i].transform); //drawables *must* have a transform
+			items[i].pipeline = drawable[i].pipeline;
+			items[i].object_to_world = drawable[i].transform->make_local_to_world();
+			items[i].lod = drawable[i].lod;
+			if (world_to_clip) {
+				items[i].lod = pick_lod(shape_for(shapes, items[i].pipeline), drawable[i].lod, items[i].object_to_world, *world_to_clip, pixels_per_unit, lod_settings);
 			}
 		}
-		glActiveTexture(GL_TEXTURE0);
+	};
+	constexpr uint32_t Block = 256;
+	if (items.size() > Block) {
+		JobSystem::get().parallel_for(0, uint32_t(items.size()), Block, compute);
+	} else {
+		compute(0, uint32_t(items.size()));
+	}
 
+	if (world_to_clip) {
+		//keep the choices for next frame's hysteresis (and count what they cost):
+		lod_stats = LODStats();
+		for (uint32_t i = 0; i < items.size(); ++i) {
+			Drawable::Pipeline const &pipeline = items[i].pipeline;
+			uint32_t lod = items[i].lod;
+			if (lod != drawable[i].lod) lod_stats.switches += 1;
+			drawable[i].lod = uint8_t(lod);
+			lod_stats.full_triangles += pipeline.count / 3;
+			lod_stats.triangles += (lod ? shapes[pipeline.shape].lods[lod-1].count : pipeline.count) / 3;
+		}
 	}
+}
 
-	glUseProgram(0);
-	glBindVertexArray(0);
+void Scene::draw(Snapshot const &snapshot, glm::mat4 const &world_to_clip, glm::mat4x3 const &world_to_light) {
+	draw(snapshot, world_to_clip, world_to_light, OpaqueSettings());
+}
+
+void Scene::draw(Snapshot const &snapshot, glm::mat4 const &world_to_clip, glm::mat4x3 const &world_to_light, OpaqueSettings const &opaque) {
+	//write the "Object" uniform blocks up front (as in Scene::draw):
+	UniformRing &ring = UniformRing::get();
+	uint32_t count = uint32_t(snapshot.items.size());
+	FrameVector< uint32_t > object_blocks(count, -1U);
+	uint32_t blocks = 0;
+	for (uint32_t i = 0; i < count; ++i) {
+		if (material_for(snapshot.materials, snapshot.items[i].pipeline).Object_block != -1U) object_blocks[i] = blocks++;
+	}
+	if (blocks) {
+		ring.allocate(blocks, sizeof(ObjectUniforms));
+		for (uint32_t i = 0; i < count; ++i) {
+			if (object_blocks[i] == -1U) continue;
+			Snapshot::Item const &item = snapshot.items[i];
+			Material const &material = material_for(snapshot.materials, item.pipeline);
+			ObjectUniforms uniforms = ObjectUniforms::make(item.object_to_world, world_to_clip, world_to_light);
+			uniforms.TEX_RECT = material.texture_rect;
+			uniforms.TEX_LAYER = float(material.texture_layer);
+			std::memcpy(ring.block< ObjectUniforms >(object_blocks[i]), &uniforms, sizeof(uniforms));
+		}
+		ring.upload();
+	}
+
+	FrameVector< uint64_t > order;
+	if (opaque.mode != OpaqueMode::Unordered) {
+		order.reserve(count);
+		for (uint32_t i = 0; i < count; ++i) {
+			order.emplace_back(depth_key(shape_for(snapshot.shapes, snapshot.items[i].pipeline), snapshot.items[i].object_to_world, world_to_clip, i));
+		}
+		std::sort(order.begin(), order.end());
+	}
+
+	draw_opaque(snapshot.materials, count, order, opaque,
+		[&](uint32_t i) -> Drawable::Pipeline const & { return snapshot.items[i].pipeline; },
+		[&](uint32_t i, Material const &material) {
+			Snapshot::Item const &item = snapshot.items[i];
+			draw_pipeline(material, item.pipeline, shape_for(snapshot.shapes, item.pipeline), item.lod, object_blocks[i], item.object_to_world, world_to_clip, world_to_light);
+		}
+	);
+	ring.fence();
+
+	finish_drawing(snapshot.materials);
 
 	GL_ERRORS();
 }
 
+Scene::OpaquePicker::~OpaquePicker() {
+	//(a picker that was never drawn with made no queries, so needs no context)
+	for (Query &query : queries) {
+		if (query.id != 0) glDeleteQueries(1, &query.id);
+		query.id = 0;
+	}
+}
+
+Scene::OpaqueSettings Scene::OpaquePicker::begin(uint32_t key_, glm::uvec2 const &render_size) {
+	poll();
+
+	if (key_ != key) {
+		key = key_;
+		restart();
+	} else if (!measuring && ++frames >= remeasure_frames) {
+		restart();
+	}
+
+	OpaqueSettings settings;
+	settings.mode = mode;
+
+	//draw this frame in the next mode to be measured (skipping it if every query is still in flight):
+	if (measuring && to_draw < samples_per_pixel.size() && render_size.x != 0 && render_size.y != 0) {
+		Query &query = queries[next_query];
+		if (!query.pending) {
+			if (query.id == 0) glGenQueries(1, &query.id);
+			query.mode = OpaqueMode(to_draw);
+			query.pixels = float(render_size.x) * float(render_size.y);
+			query.measurement = measurement;
+			settings.mode = query.mode;
+			settings.samples_query = query.id;
+			active_query = next_query;
+			next_query = (next_query + 1) % uint32_t(queries.size());
+			to_draw += 1;
+		}
+	}
+
+	return settings;
+}
+
+void Scene::OpaquePicker::end() {
+	if (active_query != -1U) {
+		queries[active_query].pending = true;
+		active_query = -1U;
+	}
+}
+
+void Scene::OpaquePicker::restart() {
+	measurement += 1;
+	measuring = true;
+	to_draw = 0;
+	samples_per_pixel.fill(-1.0f);
+}
+
+void Scene::OpaquePicker::poll() {
+	//queries finish in the order they were issued, so check from the oldest:
+	for (uint32_t i = 0; i < queries.size(); ++i) {
+		Query &query = queries[(next_query + i) % queries.size()];
+		if (!query.pending) continue;
+		GLint available = GL_FALSE;
+		glGetQueryObjectiv(query.id, GL_QUERY_RESULT_AVAILABLE, &available);
+		if (available == GL_FALSE) break;
+		GLuint64 samples = 0;
+		glGetQueryObjectui64v(query.id, GL_QUERY_RESULT, &samples);
+		query.pending = false;
+		if (query.measurement == measurement) samples_per_pixel[size_t(query.mode)] = float(double(samples) / query.pixels);
+	}
+
+	if (!measuring) return;
+	for (float spp : samples_per_pixel) {
+		if (spp < 0.0f) return;
+	}
+
+	//with a pre-pass, each visible pixel is shaded once; that's the baseline:
+	float base = std::max(samples_per_pixel[size_t(OpaqueMode::DepthPrepass)], 1e-6f);
+	float unordered = samples_per_pixel[size_t(OpaqueMode::Unordered)] / base;
+	float sorted = samples_per_pixel[size_t(OpaqueMode::FrontToBack)] / base;
+
+	//(a pre-pass draws every vertex twice, and sorting costs a little CPU, so each has to save a fair amount of shading)
+	if (unordered < 1.2f) mode = OpaqueMode::Unordered;
+	else if (sorted < 1.2f) mode = OpaqueMode::FrontToBack;
+	else mode = OpaqueMode::DepthPrepass;
+
+	measuring = false;
+	frames = 0;
+}
+
 
 void Scene::load(std::string const &filename,
 	std::function< void(Scene &, Transform *, std::string const &) > const &on_drawable) {
 
 	std::ifstream file(filename, std::ios::binary);
+	load(file, filename, on_drawable);
+}
+
+void Scene::load(std::istream &file, std::string const &filename,
+	std::function< void(Scene &, Transform *, std::string const &) > const &on_drawable) {
 
 	std::vector< char > names;
 	read_chunk(file, "str0", &names);
@@ -318,6 +776,10 @@ Scene::Scene(std::string const &filename, std::function< void(Scene &, Transform
 	load(filename, on_drawable);
 }
 
+Scene::Scene(std::istream &from, std::string const &filename, std::function< void(Scene &, Transform *, std::string const &) > const &on_drawable) {
+	load(from, filename, on_drawable);
+}
+
 Scene::Scene(Scene const &other) {
 	set(other);
 }
@@ -350,6 +812,7 @@ void Scene::set(Scene const &other, std::unordered_map< Transform const *, Trans
 		//store mapping between transforms old and new:
 		auto ret = transform_to_transform.insert(std::make_pair(&t, &transforms.back()));
 		assert(ret.second);
+		(void)ret; //(only used by the assert)
 	}
 
 	//update transform parents:
@@ -357,6 +820,10 @@ void Scene::set(Scene const &other, std::unordered_map< Transform const *, Trans
 		t.parent = transform_to_transform.at(t.parent);
 	}
 
+	//copy other's materials and shapes (drawables refer to them by index, so the indices stay valid):
+	materials = other.materials;
+	shapes = other.shapes;
+
 	//copy other's drawables, updating transform pointers:
 	drawables = other.drawables;
 	for (auto &d : drawables) {
@@ -376,6 +843,43 @@ void Scene::set(Scene const &other, std::unordered_map< Transform const *, Trans
 	}
 }
 
+void Scene::erase(std::vector< Transform const * > *doomed_) {
+	assert(doomed_);
+	std::vector< Transform const * > &doomed = *doomed_;
+	std::sort(doomed.begin(), doomed.end());
+	doomed.erase(std::unique(doomed.begin(), doomed.end()), doomed.end());
+	if (doomed.empty()) return;
+
+	//anything below a doomed transform goes too:
+	auto is_doomed = [&doomed](Transform const *t) {
+		return std::binary_search(doomed.begin(), doomed.end(), t);
+	};
+	size_t explicit_count = doomed.size();
+	for (auto const &t : transforms) {
+		for (Transform const *p = t.parent; p; p = p->parent) {
+			if (std::binary_search(doomed.begin(), doomed.begin() + explicit_count, p)) {
+				doomed.emplace_back(&t);
+				break;
+			}
+		}
+	}
+	std::sort(doomed.begin(), doomed.end());
+	doomed.erase(std::unique(doomed.begin(), doomed.end()), doomed.end());
+
+	//components (iterating backward, since erasing moves the last component into the hole):
+	for (uint32_t i = uint32_t(drawables.size()); i > 0; --i) {
+		if (is_doomed(drawables.data()[i-1].transform)) drawables.erase_index(i-1);
+	}
+	for (uint32_t i = uint32_t(cameras.size()); i > 0; --i) {
+		if (is_doomed(cameras.data()[i-1].transform)) cameras.erase_index(i-1);
+	}
+	for (uint32_t i = uint32_t(lights.size()); i > 0; --i) {
+		if (is_doomed(lights.data()[i-1].transform)) lights.erase_index(i-1);
+	}
+
+	transforms.remove_if([&](Transform const &t) { return is_doomed(&t); });
+}
+
 Scene::CollisionPoints Scene::test_sphere_sphere(std::shared_ptr<Collider> a, const Transform *ta, std::shared_ptr<Collider> b, const Transform *tb) {
 	std::shared_ptr<const SphereCollider> sp_a = std::static_pointer_cast<const SphereCollider>(a);
 	std::shared_ptr<const SphereCollider> sp_b = std::static_pointer_cast<const SphereCollider>(b);
@@ -466,6 +970,59 @@ Scene::CollisionPoints Scene::test_sphere_box(std::shared_ptr<Collider> a, const
 	return CollisionPoints{pt_a, pt_b, normal, depth, true};
 }
 
+Scene::CollisionPoints Scene::test_sphere_mesh(std::shared_ptr<Collider> a, const Transform *ta, std::shared_ptr<Collider> b, const Transform *tb) {
+	std::shared_ptr<const SphereCollider> sp_a = std::static_pointer_cast<const SphereCollider>(a);
+	std::shared_ptr<const TriangleMeshCollider> m_b = std::static_pointer_cast<const TriangleMeshCollider>(b);
+
+	const glm::mat4x3 a_world = ta->make_local_to_world();
+	const glm::mat4x3 b_world = tb->make_local_to_world();
+	const glm::mat4x3 world_to_b = tb->make_world_to_local();
+
+	const glm::vec3 a_center = a_world * glm::vec4(sp_a->center, 1);
+	const float a_radius = (a_world * glm::vec4(sp_a->radius,0,0,0)).x; // uniform scale again
+
+	// query the BVH in mesh space with a radius big enough to cover any scaling,
+	// then do the exact closest-point test on world-space triangles:
+	const float max_scale = glm::max(glm::length(world_to_b[0]), glm::max(glm::length(world_to_b[1]), glm::length(world_to_b[2])));
+	const glm::vec3 local_center = world_to_b * glm::vec4(a_center, 1);
+
+	float best_dist2 = a_radius * a_radius;
+	glm::vec3 pt_b = glm::vec3(0);
+	glm::vec3 face_normal = glm::vec3(0,0,1);
+	bool hit = false;
+	m_b->bvh->overlap_sphere(local_center, a_radius * max_scale, [&](TriangleBVH::Triangle const &local) {
+		TriangleBVH::Triangle tri{
+			b_world * glm::vec4(local.a, 1),
+			b_world * glm::vec4(local.b, 1),
+			b_world * glm::vec4(local.c, 1)
+		};
+		glm::vec3 close = TriangleBVH::closest_point(a_center, tri);
+		glm::vec3 to = a_center - close;
+		float dist2 = glm::dot(to, to);
+		if (dist2 <= best_dist2) {
+			best_dist2 = dist2;
+			pt_b = close;
+			face_normal = glm::cross(tri.b - tri.a, tri.c - tri.a);
+			hit = true;
+		}
+	});
+	if (!hit) return CollisionPoints();
+
+	// push out along the direction to the closest point (or the face normal if the center is right on the surface):
+	glm::vec3 normal;
+	if (best_dist2 > 1e-12f) {
+		normal = glm::normalize(a_center - pt_b);
+	} else {
+		if (glm::dot(face_normal, face_normal) == 0.0f) return CollisionPoints(); //degenerate triangle
+		normal = glm::normalize(face_normal);
+	}
+	const glm::vec3 pt_a = a_center - a_radius * normal;
+
+	const float depth = glm::distance(pt_b, pt_a);
+
+	return CollisionPoints{pt_a, pt_b, normal, depth, true};
+}
+
 Scene::CollisionPoints Scene::test_collision(std::shared_ptr<Collider> a, const Transform *ta, std::shared_ptr<Collider> b, const Transform *tb) {
 	if (a->type == ColliderType::Sphere) {
 		if (b->type == ColliderType::Sphere) {
@@ -477,6 +1034,9 @@ Scene::CollisionPoints Scene::test_collision(std::shared_ptr<Collider> a, const
 		if (b->type == ColliderType::Box) {
 			return test_sphere_box(a, ta, b, tb);
 		}
+		if (b->type == ColliderType::TriangleMesh) {
+			return test_sphere_mesh(a, ta, b, tb);
+		}
 	}
 	if (b->type == ColliderType::Sphere) {
 		if (a->type == ColliderType::Plane) {
@@ -485,8 +1045,126 @@ Scene::CollisionPoints Scene::test_collision(std::shared_ptr<Collider> a, const
 		if (a->type == ColliderType::Box) {
 			return test_sphere_box(b, tb, a, ta);
 		}
+		if (a->type == ColliderType::TriangleMesh) {
+			return test_sphere_mesh(b, tb, a, ta);
+		}
 	}
 	// we only deal with sphere-related collisions
 	return CollisionPoints();
 }
 
+
+// conservative advancement of a sphere (center 'start', moving by 'motion') toward a shape given by
+// distance(p, limit) -> distance from p to the shape (or >= limit if farther than that): step forward by the
+// current gap (the sphere can't touch sooner than that) until the gap closes or the motion runs out
+template< typename Distance >
+static bool advance_sphere(glm::vec3 const &start, glm::vec3 const &motion, float radius, Distance &&distance, float *toi) {
+	constexpr uint32_t MaxIterations = 32;
+	const float motion_length = glm::length(motion);
+	const float close_enough = 0.001f * radius;
+	auto gap = [&](float t) {
+		return distance(start + t * motion, radius + motion_length * (1.0f - t) + close_enough) - radius;
+	};
+
+	float t = 0.0f;
+	float g = gap(t);
+	if (g <= close_enough) return false; // already touching at the start: the discrete tests handle it
+	for (uint32_t iter = 0; iter < MaxIterations; ++iter) {
+		t += g / motion_length;
+		if (t > 1.0f) return false;
+		g = gap(t);
+		if (g <= close_enough) {
+			*toi = t;
+			return true;
+		}
+	}
+
+	// grazing approaches close in slowly; march the rest of the way in radius-sized steps
+	// (nothing can fit between samples without touching one), then bisect any crossing:
+	const float step = radius / motion_length;
+	for (float prev = t; prev < 1.0f; prev += step) {
+		float next = glm::min(prev + step, 1.0f);
+		if (gap(next) > close_enough) continue;
+		float lo = prev, hi = next;
+		for (uint32_t iter = 0; iter < 16; ++iter) {
+			float mid = 0.5f * (lo + hi);
+			if (gap(mid) > close_enough) lo = mid;
+			else hi = mid;
+		}
+		*toi = hi;
+		return true;
+	}
+	return false;
+}
+
+bool Scene::sweep_sphere(std::shared_ptr<Collider> a, const Transform *ta, glm::vec3 const &motion, std::shared_ptr<Collider> b, const Transform *tb, float skin, float *toi) {
+	if (a->type != ColliderType::Sphere) return false;
+	std::shared_ptr<const SphereCollider> sp_a = std::static_pointer_cast<const SphereCollider>(a);
+
+	const glm::mat4x3 a_world = ta->make_local_to_world();
+	const glm::vec3 a_center = a_world * glm::vec4(sp_a->center, 1);
+	// sweeping a slightly smaller sphere finds the moment the real one is 'skin' deep:
+	const float a_radius = (a_world * glm::vec4(sp_a->radius,0,0,0)).x - skin; // uniform scale again
+	if (a_radius <= 0.0f || motion == glm::vec3(0)) return false;
+
+	if (b->type == ColliderType::Sphere) {
+		// ray vs. sphere of the combined radius:
+		std::shared_ptr<const SphereCollider> sp_b = std::static_pointer_cast<const SphereCollider>(b);
+		const glm::mat4x3 b_world = tb->make_local_to_world();
+		const glm::vec3 b_center = b_world * glm::vec4(sp_b->center, 1);
+		const float radius = a_radius + (b_world * glm::vec4(sp_b->radius,0,0,0)).x;
+
+		const glm::vec3 m = a_center - b_center;
+		const float c = glm::dot(m, m) - radius * radius;
+		const float half_b = glm::dot(m, motion);
+		if (c <= 0.0f || half_b >= 0.0f) return false; // starts inside, or moving away
+		const float aa = glm::dot(motion, motion);
+		const float disc = half_b * half_b - aa * c;
+		if (disc < 0.0f) return false;
+		const float t = (-half_b - std::sqrt(disc)) / aa;
+		if (t > 1.0f) return false;
+		*toi = glm::max(t, 0.0f);
+		return true;
+	}
+
+	if (b->type == ColliderType::Plane) {
+		// (same plane placement as test_sphere_plane)
+		std::shared_ptr<const PlaneCollider> p_b = std::static_pointer_cast<const PlaneCollider>(b);
+		const glm::mat4x3 b_world = tb->make_local_to_world();
+		const glm::vec3 normal = glm::normalize(b_world * glm::vec4(p_b->normal, 0));
+		const glm::vec3 b_distance = b_world * glm::vec4(normal * p_b->distance, 0);
+
+		const float start = glm::dot(a_center - b_distance, normal);
+		const float end = start + glm::dot(motion, normal);
+		if (start <= a_radius || end > a_radius) return false;
+		*toi = (start - a_radius) / (start - end);
+		return true;
+	}
+
+	// boxes and meshes are swept in b's space:
+	const glm::mat4x3 world_to_b = tb->make_world_to_local();
+	const glm::vec3 start = world_to_b * glm::vec4(a_center, 1);
+	const glm::vec3 local_motion = world_to_b * glm::vec4(motion, 0);
+	const float radius = a_radius * glm::length(world_to_b[0]);
+
+	if (b->type == ColliderType::Box) {
+		std::shared_ptr<const BoxCollider> b_b = std::static_pointer_cast<const BoxCollider>(b);
+		return advance_sphere(start, local_motion, radius, [&](glm::vec3 const &p, float) {
+			return glm::distance(p, glm::clamp(p, b_b->min, b_b->max));
+		}, toi);
+	}
+
+	if (b->type == ColliderType::TriangleMesh) {
+		std::shared_ptr<const TriangleMeshCollider> m_b = std::static_pointer_cast<const TriangleMeshCollider>(b);
+		return advance_sphere(start, local_motion, radius, [&](glm::vec3 const &p, float limit) {
+			float best2 = limit * limit;
+			m_b->bvh->overlap_sphere(p, limit, [&](TriangleBVH::Triangle const &tri) {
+				const glm::vec3 to = TriangleBVH::closest_point(p, tri) - p;
+				best2 = glm::min(best2, glm::dot(to, to));
+			});
+			return std::sqrt(best2);
+		}, toi);
+	}
+
+	return false;
+}
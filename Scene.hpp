@@ -8,13 +8,19 @@
  *  - Camera information (via "Camera")
  *  - Light information (via "Light")
  *
+ * Drawables, cameras, and lights are kept in ComponentStores (packed arrays),
+ *  so pointers to them are only stable until more are added.
+ *
  */
 
 #include "GL.hpp"
+#include "ComponentStore.hpp"
+#include "TriangleBVH.hpp"
 
 #include <glm/glm.hpp>
 #include <glm/gtc/quaternion.hpp>
 
+#include <array>
 #include <list>
 #include <memory>
 #include <functional>
@@ -22,6 +28,8 @@
 #include <vector>
 #include <unordered_map>
 
+struct Mesh; //(see Mesh.hpp)
+
 struct Scene {
 	struct Transform {
 		//Transform names are useful for debugging and looking up locations in a loaded scene:
@@ -49,14 +57,52 @@ struct Scene {
 		Transform() = default;
 	};
 
+	//A 'Material' is the part of drawing state that many drawables share: the program, how it gets its uniforms, and its textures.
+	// Materials live in Scene::materials (see add_material) and drawables refer to them by index,
+	// which keeps the per-drawable data that draw() walks every frame small.
+	struct Material {
+		GLuint program = 0; //shader program; passed to glUseProgram
+
+		//uniforms:
+		// if the program has an "Object" uniform block (see UniformBlocks.hpp), the transforms are written there
+		// and draw() binds each drawable's block with one glBindBufferRange; otherwise they are set with glUniform*:
+		GLuint Object_block = -1U; //uniform block index of the "Object" block
+		GLuint OBJECT_TO_CLIP_mat4 = -1U; //uniform location for object to clip space matrix
+		GLuint OBJECT_TO_LIGHT_mat4x3 = -1U; //uniform location for object to light space (== world space) matrix
+		GLuint NORMAL_TO_LIGHT_mat3 = -1U; //uniform location for normal to light space (== world space) matrix
+		//(per-frame values, like lights, come from the "Frame" block; see set_frame_uniforms())
+
+		//texture objects to bind for the first TextureCount textures:
+		enum : uint32_t { TextureCount = 4 };
+		struct TextureInfo {
+			GLuint texture = 0;
+			GLenum target = GL_TEXTURE_2D;
+		} textures[TextureCount];
+
+		//where in textures[0] to sample, for array textures shared by many materials (see TextureArrays.hpp):
+		// (written to each drawable's "Object" block as TEX_LAYER / TEX_RECT)
+		uint32_t texture_layer = 0;
+		glm::vec4 texture_rect = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f); //texture coordinate offset (xy) and scale (zw)
+
+		//attribute location of Position in 'program', for materials with an "Object" block:
+		// lets draw() use position-only programs (PositionOnlyProgram.hpp) with the same vertex arrays for
+		// depth pre-passes and overdraw display; -1U: always drawn with 'program' (and never pre-passed)
+		GLuint Position_location = -1U;
+
+		bool operator==(Material const &other) const;
+	};
+
 	struct Drawable {
 		//a 'Drawable' attaches attribute data to a transform:
 		Drawable(Transform *transform_) : transform(transform_) { assert(transform); }
 		Transform * transform;
 
-		//Contains all the data needed to run the OpenGL pipeline:
+		//Contains the per-drawable data needed to run the OpenGL pipeline:
+		// (shared state, like the program and textures, is in the Material it refers to;
+		//  level-of-detail ranges and bounds are in the Shape it refers to)
 		struct Pipeline {
-			GLuint program = 0; //shader program; passed to glUseProgram
+			uint32_t material = -1U; //index into Scene::materials (drawables without one aren't drawn)
+			uint32_t shape = -1U; //index into Scene::shapes (drawables without one have no LODs, and are sorted by their transform's origin)
 
 			//attributes:
 			GLuint vao = 0; //attrib->buffer mapping; passed to glBindVertexArray
@@ -64,21 +110,32 @@ struct Scene {
 			GLenum type = GL_TRIANGLES; //what sort of primitive to draw; passed to glDrawArrays
 			GLuint start = 0; //first vertex to draw; passed to glDrawArrays
 			GLuint count = 0; //number of vertices to draw; passed to glDrawArrays
+			GLenum index_type = GL_NONE; //if set, start/count are in indices and drawing uses glDrawElements with the vao's element buffer
+		} pipeline;
 
-			//uniforms:
-			GLuint OBJECT_TO_CLIP_mat4 = -1U; //uniform location for object to clip space matrix
-			GLuint OBJECT_TO_LIGHT_mat4x3 = -1U; //uniform location for object to light space (== world space) matrix
-			GLuint NORMAL_TO_LIGHT_mat3 = -1U; //uniform location for normal to light space (== world space) matrix
-
-			std::function< void() > set_uniforms; //(optional) function to set any other useful uniforms
+		//level of detail last drawn (0: full detail, n: shape's lods[n-1]); kept between frames for hysteresis:
+		mutable uint8_t lod = 0;
+	};
 
-			//texture objects to bind for the first TextureCount textures:
-			enum : uint32_t { TextureCount = 4 };
-			struct TextureInfo {
-				GLuint texture = 0;
-				GLenum target = GL_TEXTURE_2D;
-			} textures[TextureCount];
-		} pipeline;
+	//A 'Shape' holds what draw() needs to know about a drawable's mesh beyond how to draw it --
+	// its simplified versions and its extent -- used when picking LODs and sorting by depth.
+	// Shapes live in Scene::shapes (see add_shape) and drawables refer to them by index (usually one per mesh),
+	//  which keeps Drawable small for the per-frame walk over every drawable:
+	struct Shape {
+		//simplified versions of the same mesh, coarser with each entry (unused entries have count == 0):
+		// draw() uses the coarsest one whose error covers less than LODSettings::max_error pixels
+		enum : uint32_t { LODCount = 3 };
+		struct LOD {
+			GLuint start = 0; //as Pipeline::start
+			GLuint count = 0; //as Pipeline::count
+			float error = 0.0f; //how far the simplified surface is from the full mesh (object space)
+		} lods[LODCount];
+		glm::vec4 bounds = glm::vec4(0.0f); //object-space bounding sphere (xyz: center, w: radius), for distance to the camera
+
+		//LODs (if it has any) and bounds of a mesh:
+		static Shape make(Mesh const &mesh);
+
+		bool operator==(Shape const &other) const;
 	};
 
 	struct Camera {
@@ -124,7 +181,8 @@ struct Scene {
 	enum ColliderType {
 		Sphere,
 		Plane,
-		Box
+		Box,
+		TriangleMesh
 	};
 	
 	struct Collider {
@@ -154,6 +212,12 @@ struct Scene {
 		glm::vec3 max;
 	};
 
+	// arbitrary (static) geometry; the BVH is in the transform's local space and may be shared between colliders:
+	struct TriangleMeshCollider : Collider {
+		TriangleMeshCollider(std::shared_ptr<const TriangleBVH> bvh_) : Collider(ColliderType::TriangleMesh), bvh(bvh_) { assert(bvh); }
+		std::shared_ptr<const TriangleBVH> bvh;
+	};
+
 	struct CollisionPoints {
 		glm::vec3 a; // furthest point of a in b
 		glm::vec3 b; // furthest point of b in a
@@ -175,11 +239,25 @@ struct Scene {
 		std::shared_ptr<Collider> a, const Transform *ta,
 		std::shared_ptr<Collider> b, const Transform *tb);
 
+	static CollisionPoints test_sphere_mesh(
+		std::shared_ptr<Collider> a, const Transform *ta,
+		std::shared_ptr<Collider> b, const Transform *tb);
+
 	// generic func that calls the appropriate specific test func
 	static CollisionPoints test_collision(
 		std::shared_ptr<Collider> a, const Transform *ta,
 		std::shared_ptr<Collider> b, const Transform *tb);
+
+	// continuous (swept) test for fast spheres: sphere a moves by 'motion' (world space) from where ta puts it;
+	// finds the earliest fraction *toi in [0,1] of that motion at which a has sunk 'skin' deep into b
+	// (so the discrete tests above will see the contact). returns false if that never happens,
+	// or if a already starts that deep in b. b may be a sphere, plane, box or triangle mesh.
+	static bool sweep_sphere(
+		std::shared_ptr<Collider> a, const Transform *ta, glm::vec3 const &motion,
+		std::shared_ptr<Collider> b, const Transform *tb, float skin, float *toi);
 	
+	// collision objects and rigid bodies are stored by value (see PlayMode's ComponentStores),
+	// so neither has virtual functions -- code that needs a RigidBody keeps one directly
 	struct CollisionObject {
 		CollisionObject(Transform *transform_, std::shared_ptr<Collider> collider_, float damp_ = 0.95) : transform(transform_), collider(collider_), damp(damp_) {
 			assert(transform); 
@@ -189,8 +267,6 @@ struct Scene {
 			assert(transform); 
 			assert(collider);
 		}
-		virtual ~CollisionObject() {
-		}
 		Transform * transform = nullptr;
 		std::shared_ptr<Collider> collider = nullptr;
 		bool is_dynamic = false;
@@ -202,25 +278,31 @@ struct Scene {
 		bool is_ball = false;
 
 		bool to_delete = false;
+		uint32_t query_proxy = -1U; // proxy in PlayMode's SceneQuery (if registered)
 	};
 
 	struct RigidBody : CollisionObject {
 		RigidBody(Transform *transform_, std::shared_ptr<Collider> collider_) : CollisionObject(transform_, collider_) {
 			is_dynamic = true; 
 		}
-		~RigidBody() {
-		}
 		glm::vec3 velocity = glm::vec3(0);
 		glm::vec3 force = glm::vec3(0);
 		float mass = 1;
 
+		// sleeping bodies are skipped by collision detection and integration until something wakes them:
+		bool sleeping = false;
+		glm::vec3 rest_position = glm::vec3(0); // where the body has been staying near
+		float rest_time = 0; // seconds spent near rest_position
+		uint32_t island = -1U; // id shared by bodies that fell asleep touching each other (they wake together)
+
 	};
 
+	// (pointers into component stores; only valid until objects are added or removed)
 	struct Collision {
-		Collision(std::shared_ptr<CollisionObject> a, std::shared_ptr<CollisionObject> b, CollisionPoints p) : obj_a(a), obj_b(b), points(p) {}
-		~Collision() {}
-		std::shared_ptr<CollisionObject> obj_a;
-		std::shared_ptr<CollisionObject> obj_b;
+		Collision(RigidBody *a, CollisionObject *b, RigidBody *body_b_, CollisionPoints p) : obj_a(a), obj_b(b), body_b(body_b_), points(p) {}
+		RigidBody *obj_a; // always a moving body
+		CollisionObject *obj_b;
+		RigidBody *body_b; // == obj_b if b is also a moving body, otherwise nullptr
 		CollisionPoints points;
 	};
 
@@ -228,9 +310,99 @@ struct Scene {
 
 	//Scenes, of course, may have many of the above objects:
 	std::list< Transform > transforms;
-	std::list< Drawable > drawables;
-	std::list< Camera > cameras;
-	std::list< Light > lights;
+	ComponentStore< Drawable > drawables;
+	ComponentStore< Camera > cameras;
+	ComponentStore< Light > lights;
+
+	//materials referred to by drawables (Drawable::Pipeline::material):
+	std::vector< Material > materials;
+	//index of a material identical to 'material', adding it if there isn't one yet:
+	uint32_t add_material(Material const &material);
+
+	//shapes referred to by drawables (Drawable::Pipeline::shape):
+	std::vector< Shape > shapes;
+	//index of a shape identical to 'shape', adding it if there isn't one yet:
+	uint32_t add_shape(Shape const &shape);
+
+	//remove transforms, along with their descendants and every drawable/camera/light attached to any of them:
+	// on return, 'doomed' is sorted and includes the descendants (so callers can drop their own references,
+	//  by pointer comparison only -- the transforms themselves are gone)
+	void erase(std::vector< Transform const * > *doomed);
+
+	//Level of detail selection, used by draw() (and snapshot(), when given a view):
+	struct LODSettings {
+		bool enabled = true;
+		float max_error = 1.0f; //pixels of simplification error allowed on screen
+		float hysteresis = 0.25f; //switch coarser only below (1 - hysteresis) * max_error, and back finer only above (1 + hysteresis) * max_error
+		float viewport_height = 720.0f; //pixels; set to the drawable height
+	} lod_settings;
+
+	//triangle counts from the most recent LOD selection (for benchmarking and HUDs):
+	struct LODStats {
+		uint32_t triangles = 0; //triangles drawn
+		uint32_t full_triangles = 0; //triangles that would have been drawn at full detail
+		uint32_t switches = 0; //drawables that changed LOD
+	};
+	mutable LODStats lod_stats;
+
+	//How draw() orders opaque drawables, trading CPU / vertex work for fewer shaded-then-hidden fragments:
+	enum class OpaqueMode : uint8_t {
+		Unordered, //list order
+		FrontToBack, //sorted nearest-first by the view depth of their bounds' centers, so the depth test rejects more hidden fragments
+		DepthPrepass, //front-to-back depth-only pass with a trivial program, then shading with GL_EQUAL (each pixel is shaded once)
+	};
+	struct OpaqueSettings {
+		OpaqueMode mode = OpaqueMode::Unordered;
+		bool show_overdraw = false; //shade with a dim constant color, blended additively (brighter = shaded more times; materials without a Position_location keep their own program)
+		GLuint samples_query = 0; //if non-zero, the shading pass is counted with glBeginQuery(GL_SAMPLES_PASSED, samples_query)
+	} opaque_settings;
+	//(draw() expects -- and leaves -- glDepthFunc(GL_LESS), depth writes on, and blending off)
+
+	//OpaquePicker picks an OpaqueMode by measuring frames as they are drawn:
+	// while measuring, consecutive frames are drawn in each mode in turn with their shaded samples counted,
+	// results are read back a few frames later (queries are never waited on), and the cheapest mode that keeps
+	// overdraw near what a depth pre-pass gets is used until the next measurement.
+	//  OpaqueSettings settings = picker.begin(key, render_size); //'key' changing (e.g., a new level) restarts measuring
+	//  ... draw the scene with 'settings' ...
+	//  picker.end();
+	// (GL thread only -- including its destructor, which deletes its queries)
+	struct OpaquePicker {
+		OpaquePicker() = default;
+		~OpaquePicker();
+		OpaquePicker(OpaquePicker const &) = delete;
+
+		OpaqueMode mode = OpaqueMode::DepthPrepass; //current choice (the safe one until something has been measured)
+		uint32_t remeasure_frames = 600; //frames between measurements (since the view keeps changing)
+
+		OpaqueSettings begin(uint32_t key, glm::uvec2 const &render_size);
+		void end();
+
+		//-- internals --
+
+		//GL_SAMPLES_PASSED queries, in flight for a few frames each:
+		struct Query {
+			GLuint id = 0;
+			bool pending = false;
+			OpaqueMode mode = OpaqueMode::Unordered; //mode the measured frame was drawn in
+			float pixels = 0.0f; //size it was drawn at (DynamicResolution may change this between frames)
+			uint32_t measurement = 0; //which measurement it belongs to
+		};
+		std::array< Query, 4 > queries;
+		uint32_t next_query = 0;
+		uint32_t active_query = -1U;
+
+		uint32_t key = -1U;
+		uint32_t measurement = 0; //bumped whenever measuring restarts (so stale results are dropped)
+		bool measuring = false;
+		uint32_t to_draw = 0; //next mode to draw while measuring
+		std::array< float, 3 > samples_per_pixel; //this measurement's results, by mode (negative until read back)
+		uint32_t frames = 0; //frames since the last measurement finished
+
+		//start a new measurement:
+		void restart();
+		//read back any finished queries (without waiting):
+		void poll();
+	};
 
 	//The "draw" function provides a convenient way to pass all the things in a scene to OpenGL:
 	void draw(Camera const &camera) const;
@@ -238,12 +410,39 @@ struct Scene {
 	//..sometimes, you want to draw with a custom projection matrix and/or light space:
 	void draw(glm::mat4 const &world_to_clip, glm::mat4x3 const &world_to_light = glm::mat4x3(1.0f)) const;
 
+	//A 'Snapshot' is an immutable copy of everything "draw" needs from the scene:
+	// (useful for drawing on another thread while the scene keeps changing)
+	struct Snapshot {
+		struct Item {
+			Drawable::Pipeline pipeline;
+			glm::mat4x3 object_to_world = glm::mat4x3(1.0f);
+			uint32_t lod = 0; //(as Drawable::lod)
+		};
+		std::vector< Item > items;
+		std::vector< Material > materials; //(copy of the scene's materials, which items refer to)
+		std::vector< Shape > shapes; //(likewise)
+	};
+
+	//copy drawables + their world transforms (and current LODs) into 'snapshot' (re-using its storage):
+	void snapshot(Snapshot *snapshot) const;
+	//..choosing LODs for 'world_to_clip' first, as draw() would:
+	void snapshot(Snapshot *snapshot, glm::mat4 const &world_to_clip) const;
+	void snapshot_lods(Snapshot *snapshot, glm::mat4 const *world_to_clip) const; //(both of the above)
+
+	//draw a snapshot taken from some scene; same result as calling draw() on that scene (with 'opaque' as its opaque_settings):
+	static void draw(Snapshot const &snapshot, glm::mat4 const &world_to_clip, glm::mat4x3 const &world_to_light = glm::mat4x3(1.0f));
+	static void draw(Snapshot const &snapshot, glm::mat4 const &world_to_clip, glm::mat4x3 const &world_to_light, OpaqueSettings const &opaque);
+
 	//add transforms/objects/cameras from a scene file to this scene:
 	// the 'on_drawable' callback gives your code a chance to look up mesh data and make Drawables:
 	// throws on file format errors
 	void load(std::string const &filename,
 		std::function< void(Scene &, Transform *, std::string const &) > const &on_drawable = nullptr
 	);
+	//..or from a stream (e.g., an asset pack entry); 'filename' is only used in messages:
+	void load(std::istream &from, std::string const &filename,
+		std::function< void(Scene &, Transform *, std::string const &) > const &on_drawable = nullptr
+	);
 
 	//this function is called to read extra chunks from the scene file after the main chunks are read:
 	// this is useful if you, e.g., subclassing scene to represent a game level/area
@@ -254,6 +453,7 @@ struct Scene {
 
 	//load a scene:
 	Scene(std::string const &filename, std::function< void(Scene &, Transform *, std::string const &) > const &on_drawable);
+	Scene(std::istream &from, std::string const &filename, std::function< void(Scene &, Transform *, std::string const &) > const &on_drawable);
 
 	//copy a scene (with proper pointer fixup):
 	Scene(Scene const &); //...as a constructor
@@ -0,0 +1,506 @@
+#include "SceneQuery.hpp"
+
+#include "JobSystem.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+
+//leaves are enlarged by this much (world units) so small movements don't need re-insertion:
+static constexpr float FatMargin = 0.1f;
+
+//batches smaller than this run on the calling thread:
+static constexpr uint32_t BatchGrain = 32;
+
+static float area(glm::vec3 const &min, glm::vec3 const &max) {
+	glm::vec3 e = max - min;
+	return 2.0f * (e.x * e.y + e.y * e.z + e.z * e.x);
+}
+
+static bool contains(SceneQuery::Node const &node, glm::vec3 const &min, glm::vec3 const &max) {
+	return glm::all(glm::lessThanEqual(node.min, min)) && glm::all(glm::lessThanEqual(max, node.max));
+}
+
+static bool boxes_overlap(glm::vec3 const &a_min, glm::vec3 const &a_max, glm::vec3 const &b_min, glm::vec3 const &b_max) {
+	return glm::all(glm::lessThanEqual(a_min, b_max)) && glm::all(glm::lessThanEqual(b_min, a_max));
+}
+
+static bool sphere_overlaps_box(SceneQuery::Sphere const &sphere, glm::vec3 const &min, glm::vec3 const &max) {
+	glm::vec3 to = glm::clamp(sphere.center, min, max) - sphere.center;
+	return glm::dot(to, to) <= sphere.radius * sphere.radius;
+}
+
+//entry distance of a ray into a box (or infinity if it misses within [0, max_t]):
+static float ray_enter(glm::vec3 const &origin, glm::vec3 const &inv_dir, float max_t, glm::vec3 const &min, glm::vec3 const &max, uint32_t *axis = nullptr) {
+	glm::vec3 t0 = (min - origin) * inv_dir;
+	glm::vec3 t1 = (max - origin) * inv_dir;
+	glm::vec3 lo = glm::min(t0, t1);
+	glm::vec3 hi = glm::max(t0, t1);
+	float near = glm::max(glm::max(lo.x, lo.y), glm::max(lo.z, 0.0f));
+	float far = glm::min(glm::min(hi.x, hi.y), glm::min(hi.z, max_t));
+	if (!(near <= far)) return std::numeric_limits< float >::infinity();
+	if (axis) *axis = (near == lo.x ? 0 : (near == lo.y ? 1 : (near == lo.z ? 2 : -1U)));
+	return near;
+}
+
+//local-space bounds of a collider (false for unbounded colliders, i.e., planes):
+static bool collider_bounds(Scene::Collider const &collider, glm::vec3 *min, glm::vec3 *max) {
+	if (collider.type == Scene::ColliderType::Sphere) {
+		Scene::SphereCollider const &sphere = static_cast< Scene::SphereCollider const & >(collider);
+		*min = sphere.center - glm::vec3(sphere.radius);
+		*max = sphere.center + glm::vec3(sphere.radius);
+		return true;
+	} else if (collider.type == Scene::ColliderType::Box) {
+		Scene::BoxCollider const &box = static_cast< Scene::BoxCollider const & >(collider);
+		*min = box.min;
+		*max = box.max;
+		return true;
+	} else if (collider.type == Scene::ColliderType::TriangleMesh) {
+		Scene::TriangleMeshCollider const &mesh = static_cast< Scene::TriangleMeshCollider const & >(collider);
+		if (mesh.bvh->nodes.empty()) {
+			*min = *max = glm::vec3(0.0f);
+		} else {
+			*min = mesh.bvh->nodes[0].min;
+			*max = mesh.bvh->nodes[0].max;
+		}
+		return true;
+	}
+	return false;
+}
+
+//------------ proxies ------------
+
+uint32_t SceneQuery::add_collider(Scene::Transform const *transform, std::shared_ptr< Scene::Collider > collider, Motion motion, uint32_t user) {
+	assert(transform);
+	assert(collider);
+	Proxy proxy;
+	proxy.transform = transform;
+	proxy.collider = collider;
+	proxy.motion = motion;
+	proxy.user = user;
+	if (!collider_bounds(*collider, &proxy.local_min, &proxy.local_max)) {
+		proxy.local_min = glm::vec3(-std::numeric_limits< float >::infinity());
+		proxy.local_max = glm::vec3( std::numeric_limits< float >::infinity());
+	}
+	return add_proxy(std::move(proxy));
+}
+
+uint32_t SceneQuery::add_bounds(Scene::Transform const *transform, glm::vec3 const &min, glm::vec3 const &max, Motion motion, uint32_t user) {
+	assert(transform);
+	Proxy proxy;
+	proxy.transform = transform;
+	proxy.local_min = min;
+	proxy.local_max = max;
+	proxy.motion = motion;
+	proxy.user = user;
+	return add_proxy(std::move(proxy));
+}
+
+uint32_t SceneQuery::add_proxy(Proxy &&proxy_) {
+	uint32_t id;
+	if (!free_proxies.empty()) {
+		id = free_proxies.back();
+		free_proxies.pop_back();
+	} else {
+		id = uint32_t(proxies.size());
+		proxies.emplace_back();
+	}
+	Proxy &proxy = proxies[id];
+	proxy = std::move(proxy_);
+	proxy.used = true;
+
+	if (std::isinf(proxy.local_min.x)) {
+		//infinite things don't go in the tree:
+		unbounded.emplace_back(id);
+		return id;
+	}
+
+	proxy.leaf = allocate_node();
+	nodes[proxy.leaf].proxy = id;
+	refresh(id);
+
+	if (proxy.motion == Dynamic) dynamic.emplace_back(id);
+	return id;
+}
+
+void SceneQuery::remove(uint32_t id) {
+	assert(id < proxies.size() && proxies[id].used);
+	Proxy &proxy = proxies[id];
+
+	if (proxy.leaf == -1U) {
+		unbounded.erase(std::find(unbounded.begin(), unbounded.end(), id));
+	} else {
+		remove_leaf(proxy.leaf);
+		free_nodes.emplace_back(proxy.leaf);
+		if (proxy.motion == Dynamic) {
+			dynamic.erase(std::find(dynamic.begin(), dynamic.end(), id));
+		}
+	}
+
+	proxy = Proxy();
+	free_proxies.emplace_back(id);
+}
+
+void SceneQuery::remove_attached(std::vector< Scene::Transform const * > const &sorted_transforms) {
+	if (sorted_transforms.empty()) return;
+	for (uint32_t id = 0; id < uint32_t(proxies.size()); ++id) {
+		if (!proxies[id].used) continue;
+		if (std::binary_search(sorted_transforms.begin(), sorted_transforms.end(), proxies[id].transform)) remove(id);
+	}
+}
+
+void SceneQuery::clear() {
+	*this = SceneQuery();
+}
+
+void SceneQuery::update() {
+	for (uint32_t id : dynamic) {
+		Proxy const &proxy = proxies[id];
+		glm::vec3 min, max;
+		world_bounds(proxy, &min, &max);
+		//still inside the fattened box? then nothing in the tree needs to change:
+		if (contains(nodes[proxy.leaf], min, max)) continue;
+		refresh(id);
+	}
+}
+
+void SceneQuery::refresh(uint32_t id) {
+	assert(id < proxies.size() && proxies[id].used);
+	Proxy const &proxy = proxies[id];
+	if (proxy.leaf == -1U) return; //(unbounded)
+
+	//re-insert with a new fattened box:
+	Node &leaf = nodes[proxy.leaf];
+	if (leaf.parent != -1U || root == proxy.leaf) remove_leaf(proxy.leaf);
+	glm::vec3 min, max;
+	world_bounds(proxy, &min, &max);
+	leaf.min = min - glm::vec3(FatMargin);
+	leaf.max = max + glm::vec3(FatMargin);
+	insert_leaf(proxy.leaf);
+}
+
+void SceneQuery::world_bounds(Proxy const &proxy, glm::vec3 *min, glm::vec3 *max) const {
+	//transform the local box's center and extents:
+	glm::mat4x3 local_to_world = proxy.transform->make_local_to_world();
+	glm::vec3 center = 0.5f * (proxy.local_min + proxy.local_max);
+	glm::vec3 half = 0.5f * (proxy.local_max - proxy.local_min);
+	glm::vec3 world_center = local_to_world * glm::vec4(center, 1.0f);
+	glm::vec3 world_half =
+		  glm::abs(local_to_world[0]) * half.x
+		+ glm::abs(local_to_world[1]) * half.y
+		+ glm::abs(local_to_world[2]) * half.z;
+	*min = world_center - world_half;
+	*max = world_center + world_half;
+}
+
+//------------ tree ------------
+
+uint32_t SceneQuery::allocate_node() {
+	uint32_t index;
+	if (!free_nodes.empty()) {
+		index = free_nodes.back();
+		free_nodes.pop_back();
+	} else {
+		index = uint32_t(nodes.size());
+		nodes.emplace_back();
+	}
+	nodes[index] = Node();
+	return index;
+}
+
+void SceneQuery::insert_leaf(uint32_t leaf) {
+	if (root == -1U) {
+		root = leaf;
+		nodes[leaf].parent = -1U;
+		return;
+	}
+
+	//walk down, picking the sibling that increases total tree surface area the least:
+	glm::vec3 leaf_min = nodes[leaf].min, leaf_max = nodes[leaf].max;
+	uint32_t index = root;
+	while (!nodes[index].is_leaf()) {
+		Node const &node = nodes[index];
+		float node_area = area(node.min, node.max);
+		float combined_area = area(glm::min(node.min, leaf_min), glm::max(node.max, leaf_max));
+
+		//cost of making a new parent for this node and the leaf:
+		float cost = 2.0f * combined_area;
+		//minimum cost of pushing the leaf further down:
+		float inheritance = 2.0f * (combined_area - node_area);
+
+		float child_cost[2];
+		for (uint32_t c = 0; c < 2; ++c) {
+			Node const &child = nodes[node.children[c]];
+			float enlarged = area(glm::min(child.min, leaf_min), glm::max(child.max, leaf_max));
+			child_cost[c] = (child.is_leaf() ? enlarged : enlarged - area(child.min, child.max)) + inheritance;
+		}
+
+		if (cost < child_cost[0] && cost < child_cost[1]) break;
+		index = node.children[child_cost[0] <= child_cost[1] ? 0 : 1];
+	}
+
+	//new parent for the chosen sibling and the leaf:
+	uint32_t sibling = index;
+	uint32_t old_parent = nodes[sibling].parent;
+	uint32_t parent = allocate_node();
+	nodes[parent].parent = old_parent;
+	nodes[parent].children[0] = sibling;
+	nodes[parent].children[1] = leaf;
+	nodes[sibling].parent = parent;
+	nodes[leaf].parent = parent;
+
+	if (old_parent == -1U) {
+		root = parent;
+	} else {
+		Node &op = nodes[old_parent];
+		op.children[op.children[0] == sibling ? 0 : 1] = parent;
+	}
+
+	refit(parent);
+}
+
+void SceneQuery::remove_leaf(uint32_t leaf) {
+	if (leaf == root) {
+		root = -1U;
+		return;
+	}
+
+	uint32_t parent = nodes[leaf].parent;
+	uint32_t grandparent = nodes[parent].parent;
+	uint32_t sibling = nodes[parent].children[nodes[parent].children[0] == leaf ? 1 : 0];
+
+	//sibling takes the parent's place:
+	if (grandparent == -1U) {
+		root = sibling;
+		nodes[sibling].parent = -1U;
+	} else {
+		Node &gp = nodes[grandparent];
+		gp.children[gp.children[0] == parent ? 0 : 1] = sibling;
+		nodes[sibling].parent = grandparent;
+		refit(grandparent);
+	}
+	free_nodes.emplace_back(parent);
+	nodes[leaf].parent = -1U;
+}
+
+void SceneQuery::refit(uint32_t index) {
+	while (index != -1U) {
+		Node &node = nodes[index];
+		Node const &a = nodes[node.children[0]];
+		Node const &b = nodes[node.children[1]];
+		node.min = glm::min(a.min, b.min);
+		node.max = glm::max(a.max, b.max);
+		index = node.parent;
+	}
+}
+
+template< typename Overlap, typename Visit >
+void SceneQuery::traverse(Overlap &&overlap, Visit &&visit) const {
+	if (root == -1U) return;
+
+	//(the tree isn't strictly balanced, so the stack spills to the heap if it gets unusually deep)
+	constexpr uint32_t LocalStack = 64;
+	uint32_t local[LocalStack];
+	std::vector< uint32_t > spill;
+	uint32_t top = 0;
+	auto push = [&](uint32_t index) {
+		if (top < LocalStack) local[top] = index;
+		else spill.emplace_back(index);
+		++top;
+	};
+	auto pop = [&]() {
+		--top;
+		if (top < LocalStack) return local[top];
+		uint32_t index = spill.back();
+		spill.pop_back();
+		return index;
+	};
+
+	push(root);
+	while (top > 0) {
+		Node const &node = nodes[pop()];
+		if (!overlap(node)) continue;
+		if (node.is_leaf()) {
+			visit(node.proxy);
+		} else {
+			push(node.children[1]);
+			push(node.children[0]);
+		}
+	}
+}
+
+//------------ exact tests ------------
+
+bool SceneQuery::raycast_proxy(uint32_t id, Ray const &ray, float max_t, RayHit *hit) const {
+	Proxy const &proxy = proxies[id];
+	Scene::Collider const *collider = proxy.collider.get();
+
+	float t = 0.0f;
+	glm::vec3 normal;
+
+	if (collider && collider->type == Scene::ColliderType::Sphere) {
+		Scene::SphereCollider const &sphere = static_cast< Scene::SphereCollider const & >(*collider);
+		glm::mat4x3 local_to_world = proxy.transform->make_local_to_world();
+		glm::vec3 center = local_to_world * glm::vec4(sphere.center, 1.0f);
+		float radius = (local_to_world * glm::vec4(sphere.radius, 0.0f, 0.0f, 0.0f)).x; //(uniform scale, as in Scene's tests)
+
+		glm::vec3 to = ray.origin - center;
+		float a = glm::dot(ray.direction, ray.direction);
+		float b = glm::dot(ray.direction, to);
+		float c = glm::dot(to, to) - radius * radius;
+		if (c <= 0.0f) { //starts inside
+			t = 0.0f;
+			normal = -ray.direction;
+		} else {
+			float disc = b * b - a * c;
+			if (disc < 0.0f || b > 0.0f) return false;
+			t = (-b - std::sqrt(disc)) / a;
+			normal = ray.origin + t * ray.direction - center;
+		}
+	} else if (collider && collider->type == Scene::ColliderType::Plane) {
+		Scene::PlaneCollider const &plane = static_cast< Scene::PlaneCollider const & >(*collider);
+		glm::mat4x3 local_to_world = proxy.transform->make_local_to_world();
+		glm::mat4x3 world_to_local = proxy.transform->make_world_to_local();
+		normal = glm::transpose(glm::mat3(world_to_local)) * plane.normal;
+		glm::vec3 point = local_to_world * glm::vec4(plane.normal * plane.distance, 1.0f);
+		float denom = glm::dot(ray.direction, normal);
+		if (denom == 0.0f) return false;
+		t = glm::dot(point - ray.origin, normal) / denom;
+		if (denom > 0.0f) normal = -normal;
+	} else {
+		//boxes, meshes, and plain bounds: intersect in local space (t is unchanged by the affine transform):
+		glm::mat4x3 world_to_local = proxy.transform->make_world_to_local();
+		glm::vec3 origin = world_to_local * glm::vec4(ray.origin, 1.0f);
+		glm::vec3 direction = world_to_local * glm::vec4(ray.direction, 0.0f);
+		glm::vec3 local_normal;
+
+		if (collider && collider->type == Scene::ColliderType::TriangleMesh) {
+			Scene::TriangleMeshCollider const &mesh = static_cast< Scene::TriangleMeshCollider const & >(*collider);
+			if (!mesh.bvh->raycast(origin, direction, max_t, &t, &local_normal)) return false;
+		} else {
+			uint32_t axis = -1U;
+			t = ray_enter(origin, 1.0f / direction, max_t, proxy.local_min, proxy.local_max, &axis);
+			if (!(t <= max_t)) return false;
+			if (axis == -1U) { //starts inside
+				local_normal = -direction;
+			} else {
+				local_normal = glm::vec3(0.0f);
+				local_normal[axis] = (direction[axis] > 0.0f ? -1.0f : 1.0f);
+			}
+		}
+		//normals transform by the inverse transpose:
+		normal = glm::transpose(glm::mat3(world_to_local)) * local_normal;
+	}
+
+	if (t < 0.0f || t > max_t) return false;
+	hit->proxy = id;
+	hit->user = proxy.user;
+	hit->t = t;
+	hit->point = ray.origin + t * ray.direction;
+	hit->normal = glm::normalize(normal);
+	return true;
+}
+
+bool SceneQuery::overlaps_sphere(uint32_t id, Sphere const &sphere) const {
+	Proxy const &proxy = proxies[id];
+	if (!proxy.collider) {
+		glm::vec3 min, max;
+		world_bounds(proxy, &min, &max);
+		return sphere_overlaps_box(sphere, min, max);
+	}
+
+	//use the physics tests against a scratch sphere collider (per thread, so queries can run in parallel):
+	static thread_local Scene::Transform query_transform;
+	static thread_local std::shared_ptr< Scene::SphereCollider > query_sphere = std::make_shared< Scene::SphereCollider >(glm::vec3(0.0f), 1.0f);
+	query_transform.position = sphere.center;
+	query_sphere->radius = sphere.radius;
+	return Scene::test_collision(query_sphere, &query_transform, proxy.collider, proxy.transform).has_collision;
+}
+
+//------------ queries ------------
+
+bool SceneQuery::raycast(Ray const &ray, RayHit *hit_) const {
+	assert(hit_);
+	RayHit best;
+	float best_t = ray.max_t;
+	glm::vec3 inv_dir = 1.0f / ray.direction;
+
+	auto visit = [&](uint32_t id) {
+		RayHit hit;
+		if (raycast_proxy(id, ray, best_t, &hit) && hit.t <= best_t) {
+			best = hit;
+			best_t = hit.t;
+		}
+	};
+
+	for (uint32_t id : unbounded) visit(id);
+	traverse([&](Node const &node) {
+		return ray_enter(ray.origin, inv_dir, best_t, node.min, node.max) <= best_t;
+	}, visit);
+
+	if (best.proxy == -1U) return false;
+	*hit_ = best;
+	return true;
+}
+
+void SceneQuery::overlap_sphere(Sphere const &sphere, std::vector< uint32_t > *proxies_) const {
+	assert(proxies_);
+	for (uint32_t id : unbounded) {
+		if (overlaps_sphere(id, sphere)) proxies_->emplace_back(id);
+	}
+	traverse([&](Node const &node) {
+		return sphere_overlaps_box(sphere, node.min, node.max);
+	}, [&](uint32_t id) {
+		if (overlaps_sphere(id, sphere)) proxies_->emplace_back(id);
+	});
+}
+
+void SceneQuery::overlap_box(glm::vec3 const &min, glm::vec3 const &max, std::vector< uint32_t > *proxies_) const {
+	assert(proxies_);
+	glm::vec3 center = 0.5f * (min + max);
+	glm::vec3 half = 0.5f * (max - min);
+	for (uint32_t id : unbounded) {
+		Proxy const &proxy = proxies[id];
+		//(only planes are unbounded; treat them as solid below their surface, like the physics does)
+		if (!proxy.collider || proxy.collider->type != Scene::ColliderType::Plane) continue;
+		Scene::PlaneCollider const &plane = static_cast< Scene::PlaneCollider const & >(*proxy.collider);
+		glm::mat4x3 local_to_world = proxy.transform->make_local_to_world();
+		glm::vec3 normal = glm::normalize(glm::transpose(glm::mat3(proxy.transform->make_world_to_local())) * plane.normal);
+		glm::vec3 point = local_to_world * glm::vec4(plane.normal * plane.distance, 1.0f);
+		float reach = glm::dot(half, glm::abs(normal));
+		if (glm::dot(center - point, normal) <= reach) proxies_->emplace_back(id);
+	}
+	traverse([&](Node const &node) {
+		return boxes_overlap(min, max, node.min, node.max);
+	}, [&](uint32_t id) {
+		glm::vec3 proxy_min, proxy_max;
+		world_bounds(proxies[id], &proxy_min, &proxy_max);
+		if (boxes_overlap(min, max, proxy_min, proxy_max)) proxies_->emplace_back(id);
+	});
+}
+
+void SceneQuery::raycast(Ray const *rays, uint32_t count, RayHit *hits) const {
+	assert(rays || count == 0);
+	assert(hits || count == 0);
+	auto run = [&](uint32_t begin, uint32_t end) {
+		for (uint32_t i = begin; i < end; ++i) {
+			if (!raycast(rays[i], &hits[i])) hits[i] = RayHit();
+		}
+	};
+	if (count > BatchGrain) JobSystem::get().parallel_for(0, count, BatchGrain, run);
+	else run(0, count);
+}
+
+void SceneQuery::overlap_sphere(Sphere const *spheres, uint32_t count, std::vector< uint32_t > *results) const {
+	assert(spheres || count == 0);
+	assert(results || count == 0);
+	auto run = [&](uint32_t begin, uint32_t end) {
+		for (uint32_t i = begin; i < end; ++i) {
+			results[i].clear();
+			overlap_sphere(spheres[i], &results[i]);
+		}
+	};
+	if (count > BatchGrain) JobSystem::get().parallel_for(0, count, BatchGrain, run);
+	else run(0, count);
+}
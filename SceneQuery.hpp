@@ -0,0 +1,125 @@
+#pragma once
+
+/*
+ * SceneQuery answers spatial questions about a scene -- "what does this ray hit?",
+ *  "what overlaps this sphere / box?" -- without scanning every object.
+ *
+ * Things that can be found are registered as proxies: either a physics collider,
+ *  or a plain bounding box (e.g., a drawable's mesh bounds), attached to a transform.
+ * Proxies live in a dynamic AABB tree. Each leaf stores a slightly enlarged ("fat") box,
+ *  so dynamic proxies only need to be re-inserted when they move outside it;
+ *  update() does this for all dynamic proxies and should be called after things move.
+ *
+ * Example:
+ *  SceneQuery query;
+ *  uint32_t wall = query.add_collider(wall_transform, wall_collider, SceneQuery::Static);
+ *  uint32_t ball = query.add_collider(ball_transform, ball_collider, SceneQuery::Dynamic);
+ *  ...
+ *  query.update(); //(once per frame)
+ *  SceneQuery::RayHit hit;
+ *  if (query.raycast(SceneQuery::Ray{origin, dir, 10.0f}, &hit)) { ... hit.proxy ... }
+ *
+ * Queries are const and may run concurrently (the batch versions use the JobSystem).
+ * Sphere overlaps against colliders use the exact collider shape; box overlaps,
+ *  and overlaps with plain bounds, are tested against world-space bounding boxes.
+ */
+
+#include "Scene.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+struct SceneQuery {
+	enum Motion : uint8_t {
+		Static, //never moves (or caller calls refresh() when it does)
+		Dynamic //checked for movement on every update()
+	};
+
+	//-- proxies --
+	//(returned ids stay valid until removed; 'user' is any value the caller wants back from queries)
+	uint32_t add_collider(Scene::Transform const *transform, std::shared_ptr< Scene::Collider > collider, Motion motion, uint32_t user = 0);
+	uint32_t add_bounds(Scene::Transform const *transform, glm::vec3 const &min, glm::vec3 const &max, Motion motion, uint32_t user = 0);
+	void remove(uint32_t proxy);
+	//remove every proxy attached to one of the (sorted) transforms -- e.g., after Scene::erase:
+	void remove_attached(std::vector< Scene::Transform const * > const &sorted_transforms);
+	void clear();
+
+	//re-fit dynamic proxies that have moved outside their fattened boxes:
+	void update();
+	//re-fit one proxy (e.g., a static object that was teleported):
+	void refresh(uint32_t proxy);
+
+	//-- queries --
+	struct Ray {
+		glm::vec3 origin = glm::vec3(0.0f);
+		glm::vec3 direction = glm::vec3(0.0f, 0.0f, -1.0f); //need not be normalized; t is measured in multiples of it
+		float max_t = 1.0f;
+	};
+	struct RayHit {
+		uint32_t proxy = -1U;
+		uint32_t user = 0;
+		float t = 0.0f;
+		glm::vec3 point = glm::vec3(0.0f); //world space
+		glm::vec3 normal = glm::vec3(0.0f); //world space, normalized
+	};
+	//closest hit along the ray (false if nothing was hit):
+	bool raycast(Ray const &ray, RayHit *hit) const;
+
+	struct Sphere {
+		glm::vec3 center = glm::vec3(0.0f);
+		float radius = 0.0f;
+	};
+	//append the proxies overlapping the sphere / box to *proxies:
+	void overlap_sphere(Sphere const &sphere, std::vector< uint32_t > *proxies) const;
+	void overlap_box(glm::vec3 const &min, glm::vec3 const &max, std::vector< uint32_t > *proxies) const;
+
+	//batched queries (spread over the JobSystem for large batches):
+	// hits[i] is the result for rays[i] (hits[i].proxy == -1U on a miss)
+	void raycast(Ray const *rays, uint32_t count, RayHit *hits) const;
+	// results[i] receives the overlaps for spheres[i]
+	void overlap_sphere(Sphere const *spheres, uint32_t count, std::vector< uint32_t > *results) const;
+
+	uint32_t user(uint32_t proxy) const { return proxies[proxy].user; }
+
+	//-- internals --
+	struct Proxy {
+		Scene::Transform const *transform = nullptr;
+		std::shared_ptr< Scene::Collider > collider; //(null for plain bounds)
+		glm::vec3 local_min = glm::vec3(0.0f), local_max = glm::vec3(0.0f); //bounds in transform space
+		Motion motion = Static;
+		uint32_t user = 0;
+		uint32_t leaf = -1U; //tree node (or -1U if unbounded [planes] or free)
+		bool used = false;
+	};
+	std::vector< Proxy > proxies;
+	std::vector< uint32_t > free_proxies;
+	std::vector< uint32_t > unbounded; //proxies with infinite extent (tested against every query)
+	std::vector< uint32_t > dynamic; //proxies checked by update()
+
+	struct Node {
+		glm::vec3 min, max; //(fattened, for leaves)
+		uint32_t parent = -1U;
+		uint32_t children[2] = {-1U, -1U}; //both -1U for leaves
+		uint32_t proxy = -1U; //leaves only
+		bool is_leaf() const { return children[0] == -1U; }
+	};
+	std::vector< Node > nodes;
+	std::vector< uint32_t > free_nodes;
+	uint32_t root = -1U;
+
+	uint32_t add_proxy(Proxy &&proxy);
+	void world_bounds(Proxy const &proxy, glm::vec3 *min, glm::vec3 *max) const;
+	uint32_t allocate_node();
+	void insert_leaf(uint32_t leaf);
+	void remove_leaf(uint32_t leaf);
+	void refit(uint32_t node); //recompute bounds from 'node' up to the root
+
+	bool raycast_proxy(uint32_t proxy, Ray const &ray, float max_t, RayHit *hit) const;
+	bool overlaps_sphere(uint32_t proxy, Sphere const &sphere) const;
+
+	template< typename Overlap, typename Visit >
+	void traverse(Overlap &&overlap, Visit &&visit) const;
+};
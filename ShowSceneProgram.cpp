@@ -3,16 +3,16 @@
 #include "gl_compile_program.hpp"
 #include "gl_errors.hpp"
 
-Scene::Drawable::Pipeline show_scene_program_pipeline;
+Scene::Material show_scene_program_material;
 
 Load< ShowSceneProgram > show_scene_program(LoadTagEarly, []() -> ShowSceneProgram * {
 	auto *ret = new ShowSceneProgram();
 
-	show_scene_program_pipeline.program = ret->program;
+	show_scene_program_material.program = ret->program;
 
-	show_scene_program_pipeline.OBJECT_TO_CLIP_mat4 = ret->OBJECT_TO_CLIP_mat4;
-	show_scene_program_pipeline.OBJECT_TO_LIGHT_mat4x3 = ret->OBJECT_TO_LIGHT_mat4x3;
-	show_scene_program_pipeline.NORMAL_TO_LIGHT_mat3 = ret->NORMAL_TO_LIGHT_mat3;
+	show_scene_program_material.OBJECT_TO_CLIP_mat4 = ret->OBJECT_TO_CLIP_mat4;
+	show_scene_program_material.OBJECT_TO_LIGHT_mat4x3 = ret->OBJECT_TO_LIGHT_mat4x3;
+	show_scene_program_material.NORMAL_TO_LIGHT_mat3 = ret->NORMAL_TO_LIGHT_mat3;
 
 	return ret;
 });
@@ -0,0 +1,124 @@
+#include "StaticGeometry.hpp"
+
+#include "gl_errors.hpp"
+
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+MeshBuffer *bake_static_geometry(Scene &scene, MeshBuffer const &meshes, std::function< bool(Scene::Transform const &) > const &is_static) {
+	//pick out the drawables to bake, grouped by material and by the chunk their bounds' centers fall in (in drawable order):
+	struct Chunk {
+		uint32_t material = 0;
+		std::vector< uint32_t > drawables;
+	};
+	std::map< std::tuple< uint32_t, int32_t, int32_t, int32_t >, Chunk > chunk_of;
+	std::vector< bool > baked(scene.drawables.size(), false);
+	for (uint32_t i = 0; i < scene.drawables.size(); ++i) {
+		Scene::Drawable const &drawable = scene.drawables.data()[i];
+		Scene::Drawable::Pipeline const &pipeline = drawable.pipeline;
+		if (pipeline.material >= scene.materials.size()) continue;
+		if (pipeline.vao == 0 || pipeline.count == 0) continue;
+		if (pipeline.type != GL_TRIANGLES) continue;
+		if (!is_static(*drawable.transform)) continue;
+
+		glm::vec3 center = glm::vec3(0.0f);
+		if (pipeline.shape < scene.shapes.size()) center = glm::vec3(scene.shapes[pipeline.shape].bounds);
+		glm::ivec3 cell = glm::ivec3(glm::floor(drawable.transform->make_local_to_world() * glm::vec4(center, 1.0f) / StaticChunkSize));
+
+		Chunk &chunk = chunk_of[std::make_tuple(pipeline.material, cell.x, cell.y, cell.z)];
+		chunk.material = pipeline.material;
+		chunk.drawables.emplace_back(i);
+		baked[i] = true;
+	}
+	if (chunk_of.empty()) return nullptr;
+	std::vector< Chunk > chunks;
+	chunks.reserve(chunk_of.size());
+	for (auto &kv : chunk_of) chunks.emplace_back(std::move(kv.second));
+
+	//(baked from the CPU-side copy the buffer kept when it loaded, rather than read back from the GPU)
+	std::vector< MeshBuffer::Vertex > const &source_vertices = meshes.vertices;
+	std::vector< uint32_t > const &source_indices = meshes.indices;
+
+	//transform each drawable's triangles into world space, appending them to its chunk's range:
+	std::vector< MeshBuffer::Vertex > vertices;
+	std::vector< uint32_t > indices;
+	std::map< std::string, Mesh > merged;
+	std::unordered_map< uint32_t, uint32_t > remap; //source vertex -> baked vertex (within one drawable)
+	for (uint32_t c = 0; c < chunks.size(); ++c) {
+		Mesh mesh;
+		mesh.type = GL_TRIANGLES;
+		mesh.start = GLuint(indices.size());
+		for (uint32_t i : chunks[c].drawables) {
+			Scene::Drawable const &drawable = scene.drawables.data()[i];
+			Scene::Drawable::Pipeline const &pipeline = drawable.pipeline;
+			bool indexed = (pipeline.index_type != GL_NONE);
+			if (pipeline.start + pipeline.count > (indexed ? source_indices.size() : source_vertices.size())) {
+				throw std::runtime_error("Static drawable on '" + drawable.transform->name + "' is out of range of its mesh buffer.");
+			}
+
+			glm::mat4x3 object_to_world = drawable.transform->make_local_to_world();
+			glm::mat3 normal_to_world = glm::inverse(glm::transpose(glm::mat3(object_to_world)));
+			//mirroring transforms flip triangles over, so swap two corners of each to keep the front faces in front:
+			bool flip = (glm::determinant(glm::mat3(object_to_world)) < 0.0f);
+
+			remap.clear();
+			for (GLuint c = 0; c < pipeline.count; ++c) {
+				GLuint corner = c;
+				if (flip && c % 3 == 1) corner = c + 1;
+				else if (flip && c % 3 == 2) corner = c - 1;
+				uint32_t source = (indexed ? source_indices[pipeline.start + corner] : pipeline.start + corner);
+				auto ret = remap.emplace(source, uint32_t(vertices.size()));
+				if (ret.second) {
+					MeshBuffer::Vertex v = source_vertices[source];
+					v.Position = object_to_world * glm::vec4(v.Position, 1.0f);
+					glm::vec3 normal = normal_to_world * v.Normal;
+					v.Normal = (normal != glm::vec3(0.0f) ? glm::normalize(normal) : normal);
+					vertices.emplace_back(v);
+					mesh.min = glm::min(mesh.min, v.Position);
+					mesh.max = glm::max(mesh.max, v.Position);
+				}
+				indices.emplace_back(ret.first->second);
+			}
+		}
+		mesh.count = GLuint(indices.size()) - mesh.start;
+		merged.emplace("static-" + std::to_string(c), mesh);
+	}
+
+	MeshBuffer *buffer = new MeshBuffer(vertices, indices, merged);
+
+	//swap the baked drawables for the merged ones:
+	for (uint32_t i = uint32_t(scene.drawables.size()); i > 0; --i) {
+		if (baked[i-1]) scene.drawables.erase_index(i-1);
+	}
+
+	scene.transforms.emplace_back();
+	Scene::Transform *transform = &scene.transforms.back();
+	transform->name = StaticGeometryTransform;
+
+	std::unordered_map< GLuint, GLuint > vaos; //program -> vertex array
+	for (uint32_t c = 0; c < chunks.size(); ++c) {
+		Mesh const &mesh = buffer->lookup("static-" + std::to_string(c));
+		uint32_t m = chunks[c].material;
+
+		GLuint program = scene.materials[m].program;
+		auto f = vaos.find(program);
+		if (f == vaos.end()) f = vaos.emplace(program, buffer->make_vao_for_program(program)).first;
+
+		Scene::Drawable &drawable = scene.drawables.emplace_back(transform);
+		drawable.pipeline.material = m;
+		drawable.pipeline.vao = f->second;
+		drawable.pipeline.type = mesh.type;
+		drawable.pipeline.start = mesh.start;
+		drawable.pipeline.count = mesh.count;
+		drawable.pipeline.index_type = mesh.index_type;
+		drawable.pipeline.shape = scene.add_shape(Scene::Shape::make(mesh));
+	}
+
+	GL_ERRORS();
+
+	return buffer;
+}
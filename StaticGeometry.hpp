@@ -0,0 +1,39 @@
+#pragma once
+
+/*
+ * Static geometry baking:
+ *  Most level transforms (ground, walls, decor) never move, so drawing them as separate
+ *  drawables just means evaluating the same world matrices (and binding the same blocks)
+ *  every frame. bake_static_geometry() runs once at load time: it pre-transforms the meshes
+ *  of every static drawable into world space, merges them into one range per material and
+ *  StaticChunkSize-sized cell of the world (by the center of each drawable's bounds) in a new
+ *  MeshBuffer, and replaces those drawables with one drawable per range, attached to a single
+ *  identity transform named StaticGeometryTransform.
+ *
+ * (chunks keep their own bounds, so there is still something for front-to-back drawing
+ *  -- see Scene::OpaqueMode -- to sort; one range per material would leave it nothing)
+ *
+ *  MeshBuffer const *baked = bake_static_geometry(scene, meshes, [](Scene::Transform const &t){ ... });
+ *
+ * Static transforms themselves stay in the scene (colliders and queries still use them);
+ *  they just have nothing left to draw.
+ *
+ * Merged ranges are drawn at full detail (the per-mesh LOD ranges don't survive merging).
+ */
+
+#include "Scene.hpp"
+#include "Mesh.hpp"
+
+#include <functional>
+
+//name of the transform that baked drawables are attached to:
+constexpr char const *StaticGeometryTransform = "StaticGeometry";
+//edge length of the (axis-aligned, world-space) cells static drawables are merged within:
+constexpr float StaticChunkSize = 4.0f;
+
+//bake the triangle-list drawables in 'scene' whose transform 'is_static' accepts (they must all draw from 'meshes'):
+// 'is_static' should only accept transforms whose ancestors don't move either
+// returns the buffer holding the merged geometry (or nullptr if nothing was baked);
+//  the caller owns it, and it needs to outlive 'scene' and any copies of it
+// note: bakes from the CPU-side copy of 'meshes' (MeshBuffer::vertices and ::indices); still meant for load time
+MeshBuffer *bake_static_geometry(Scene &scene, MeshBuffer const &meshes, std::function< bool(Scene::Transform const &) > const &is_static);
@@ -0,0 +1,255 @@
+#include "TextureArrays.hpp"
+
+#include "load_pngs.hpp"
+#include "JobSystem.hpp"
+#include "gl_errors.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+
+static_assert((1U << (TextureArrays::LayerLevels - 1)) == TextureArrays::LayerSize, "LayerLevels goes down to 1x1.");
+static_assert((TextureArrays::Gutter >> (TextureArrays::PackedLevels - 1)) >= 1, "Packed levels keep some gutter.");
+
+TextureArrays::~TextureArrays() {
+	for (auto &array : arrays) {
+		glDeleteTextures(1, &array.texture);
+		array.texture = 0;
+	}
+}
+
+TextureArrays &TextureArrays::get() {
+	//(never destroyed, since the context may be gone by the time static destructors run)
+	static TextureArrays *arrays = new TextureArrays();
+	return *arrays;
+}
+
+TextureArrays::Slot TextureArrays::add(glm::uvec2 size, std::vector< glm::u8vec4 > const &data) {
+	if (size.x == 0 || size.y == 0 || size.x > LayerSize || size.y > LayerSize) {
+		throw std::runtime_error("Texture of size " + std::to_string(size.x) + "x" + std::to_string(size.y) + " doesn't fit in a " + std::to_string(LayerSize) + "x" + std::to_string(LayerSize) + " texture array layer.");
+	}
+	return add(CookedTexture::make(size, data));
+}
+
+TextureArrays::Slot TextureArrays::add(CookedTexture const &texture) {
+	glm::uvec2 size = texture.size;
+	if (size.x == 0 || size.y == 0 || size.x > LayerSize || size.y > LayerSize) {
+		throw std::runtime_error("Texture of size " + std::to_string(size.x) + "x" + std::to_string(size.y) + " doesn't fit in a " + std::to_string(LayerSize) + "x" + std::to_string(LayerSize) + " texture array layer.");
+	}
+	if (texture.levels == 0 || texture.texels.size() != texture.level_offset(texture.levels)) {
+		throw std::runtime_error("Texture is missing texels.");
+	}
+
+	Slot slot;
+
+	//full-size textures get a layer to themselves:
+	if (size.x == LayerSize && size.y == LayerSize) {
+		uint32_t array, layer;
+		new_layer(false, &array, &layer);
+		//(textures with a partial mip chain repeat their last level)
+		for (uint32_t l = 0; l < LayerLevels; ++l) {
+			uint32_t from = std::min(l, texture.levels - 1);
+			glm::uvec2 ls = glm::max(glm::uvec2(1), glm::uvec2(LayerSize >> l));
+			if (texture.level_size(from) == ls) {
+				write(array, layer, l, glm::uvec2(0), ls, texture.texels.data() + texture.level_offset(from));
+			} else {
+				glm::u8vec4 last = texture.texels.back();
+				std::vector< glm::u8vec4 > fill(size_t(ls.x) * ls.y, last);
+				write(array, layer, l, glm::uvec2(0), ls, fill.data());
+			}
+		}
+		slot.texture = arrays[array].texture;
+		slot.layer = layer;
+		return slot;
+	}
+
+	//everything else goes on a shelf, with edge texels copied out into a gutter:
+	// (positions and sizes are multiples of Align, so each level's copy lands exactly on the next level down)
+	constexpr uint32_t Align = 1U << (PackedLevels - 1);
+	glm::uvec2 padded = (size + glm::uvec2(2 * Gutter + Align - 1)) / Align * Align;
+	if (padded.x > LayerSize || padded.y > LayerSize) {
+		throw std::runtime_error("Texture of size " + std::to_string(size.x) + "x" + std::to_string(size.y) + " is too big to pack with a gutter (use exactly " + std::to_string(LayerSize) + "x" + std::to_string(LayerSize) + ", or something smaller).");
+	}
+	if (shelves.layer != -1U && shelves.x + padded.x > LayerSize) { //next shelf
+		shelves.x = 0;
+		shelves.y += shelves.height;
+		shelves.height = 0;
+	}
+	if (shelves.layer == -1U || shelves.y + padded.y > LayerSize) { //next layer
+		new_layer(true, &shelves.array, &shelves.layer);
+		shelves.x = shelves.y = shelves.height = 0;
+	}
+
+	std::vector< glm::u8vec4 > pixels;
+	for (uint32_t l = 0; l < PackedLevels; ++l) {
+		uint32_t from = std::min(l, texture.levels - 1);
+		glm::uvec2 ls = texture.level_size(from);
+		glm::u8vec4 const *source = texture.texels.data() + texture.level_offset(from);
+		int32_t gutter = int32_t(Gutter >> l);
+		glm::uvec2 lp = glm::uvec2(padded.x >> l, padded.y >> l);
+
+		pixels.resize(size_t(lp.x) * lp.y);
+		for (uint32_t y = 0; y < lp.y; ++y) {
+			uint32_t sy = uint32_t(std::clamp(int32_t(y) - gutter, 0, int32_t(ls.y) - 1));
+			for (uint32_t x = 0; x < lp.x; ++x) {
+				uint32_t sx = uint32_t(std::clamp(int32_t(x) - gutter, 0, int32_t(ls.x) - 1));
+				pixels[y * lp.x + x] = source[sy * ls.x + sx];
+			}
+		}
+		write(shelves.array, shelves.layer, l, glm::uvec2(shelves.x >> l, shelves.y >> l), lp, pixels.data());
+	}
+
+	slot.texture = arrays[shelves.array].texture;
+	slot.layer = shelves.layer;
+	slot.rect = glm::vec4(
+		float(shelves.x + Gutter) / float(LayerSize), float(shelves.y + Gutter) / float(LayerSize),
+		float(size.x) / float(LayerSize), float(size.y) / float(LayerSize)
+	);
+
+	shelves.x += padded.x;
+	shelves.height = std::max(shelves.height, padded.y);
+
+	return slot;
+}
+
+TextureArrays::Slot TextureArrays::load_png(std::string const &filename) {
+	auto f = loaded.find(filename);
+	if (f != loaded.end()) return f->second;
+
+	glm::uvec2 size;
+	std::vector< glm::u8vec4 > data;
+	::load_png(filename, &size, &data, LowerLeftOrigin);
+
+	Slot slot = add(size, data);
+	loaded.emplace(filename, slot);
+	return slot;
+}
+
+std::vector< TextureArrays::Slot > TextureArrays::load_pngs(std::vector< std::string > const &filenames) {
+	//decode only the files not already added (each once, even if named twice):
+	std::vector< std::string > missing;
+	for (auto const &filename : filenames) {
+		if (loaded.count(filename)) continue;
+		if (std::find(missing.begin(), missing.end(), filename) != missing.end()) continue;
+		missing.emplace_back(filename);
+	}
+
+	std::vector< PNGImage > images = ::load_pngs(missing, LowerLeftOrigin);
+	std::vector< CookedTexture > textures(images.size());
+	JobSystem::get().parallel_for(0, uint32_t(images.size()), 1, [&](uint32_t begin, uint32_t end) {
+		for (uint32_t i = begin; i < end; ++i) {
+			if (images[i].size.x > LayerSize || images[i].size.y > LayerSize) continue; //(add() will complain)
+			textures[i] = CookedTexture::make(images[i].size, images[i].data);
+			images[i].data = std::vector< glm::u8vec4 >();
+		}
+	});
+
+	//(uploads happen here, on the calling thread)
+	for (uint32_t i = 0; i < missing.size(); ++i) {
+		if (textures[i].levels == 0) add(images[i].size, images[i].data); //(too big for a layer; throws)
+		loaded.emplace(missing[i], add(textures[i]));
+	}
+
+	std::vector< Slot > slots;
+	slots.reserve(filenames.size());
+	for (auto const &filename : filenames) {
+		slots.emplace_back(loaded.at(filename));
+	}
+	return slots;
+}
+
+TextureArrays::Slot TextureArrays::load_cooked(std::string const &filename) {
+	auto f = loaded.find(filename);
+	if (f != loaded.end()) return f->second;
+
+	Slot slot = add(CookedTexture(filename));
+	loaded.emplace(filename, slot);
+	return slot;
+}
+
+TextureArrays::Slot TextureArrays::white() {
+	if (!have_white) {
+		white_slot = add(glm::uvec2(1), std::vector< glm::u8vec4 >(1, glm::u8vec4(0xff)));
+		have_white = true;
+	}
+	return white_slot;
+}
+
+size_t TextureArrays::level_offset(uint32_t level) {
+	size_t offset = 0;
+	for (uint32_t l = 0; l < level; ++l) {
+		size_t ls = std::max(1U, uint32_t(LayerSize) >> l);
+		offset += ls * ls;
+	}
+	return offset;
+}
+
+void TextureArrays::new_layer(bool packed, uint32_t *array_, uint32_t *layer_) {
+	assert(array_ && layer_);
+
+	//last array of the right kind, if it has room:
+	uint32_t index = -1U;
+	for (uint32_t a = uint32_t(arrays.size()); a > 0; --a) {
+		if (arrays[a-1].packed == packed) {
+			if (arrays[a-1].layers.size() < MaxLayers) index = a-1;
+			break;
+		}
+	}
+
+	if (index == -1U) {
+		index = uint32_t(arrays.size());
+		arrays.emplace_back();
+		Array &array = arrays.back();
+		array.packed = packed;
+		array.levels = (packed ? PackedLevels : LayerLevels);
+		glGenTextures(1, &array.texture);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, array.texture);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, array.levels - 1);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+	}
+	Array &array = arrays[index];
+	array.layers.emplace_back(level_offset(array.levels), glm::u8vec4(0x00));
+
+	if (array.layers.size() > array.capacity) {
+		//grow (doubling), re-filling existing layers from their CPU copies:
+		array.capacity = std::min(std::max(array.capacity * 2, 1U), uint32_t(MaxLayers));
+		glBindTexture(GL_TEXTURE_2D_ARRAY, array.texture);
+		for (uint32_t l = 0; l < array.levels; ++l) {
+			GLsizei ls = std::max(1U, uint32_t(LayerSize) >> l);
+			glTexImage3D(GL_TEXTURE_2D_ARRAY, l, GL_RGBA8, ls, ls, array.capacity, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+			for (uint32_t layer = 0; layer < array.layers.size(); ++layer) {
+				glTexSubImage3D(GL_TEXTURE_2D_ARRAY, l, 0, 0, layer, ls, ls, 1, GL_RGBA, GL_UNSIGNED_BYTE, array.layers[layer].data() + level_offset(l));
+			}
+		}
+		glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+	}
+
+	*array_ = index;
+	*layer_ = uint32_t(array.layers.size()) - 1;
+
+	GL_ERRORS();
+}
+
+void TextureArrays::write(uint32_t array_, uint32_t layer, uint32_t level, glm::uvec2 at, glm::uvec2 size, glm::u8vec4 const *pixels) {
+	Array &array = arrays.at(array_);
+	assert(level < array.levels);
+	uint32_t ls = std::max(1U, uint32_t(LayerSize) >> level);
+	assert(at.x + size.x <= ls && at.y + size.y <= ls);
+
+	glm::u8vec4 *copy = array.layers.at(layer).data() + level_offset(level);
+	for (uint32_t y = 0; y < size.y; ++y) {
+		std::copy(pixels + y * size.x, pixels + (y + 1) * size.x, copy + (at.y + y) * ls + at.x);
+	}
+
+	glBindTexture(GL_TEXTURE_2D_ARRAY, array.texture);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, at.x, at.y, layer, size.x, size.y, 1, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+	GL_ERRORS();
+}
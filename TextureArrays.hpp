@@ -0,0 +1,106 @@
+#pragma once
+
+/*
+ * TextureArrays packs textures into a few GL_TEXTURE_2D_ARRAY textures, so that drawables
+ *  with different textures still share one texture binding (and can share batches):
+ *
+ *  TextureArrays::Slot slot = TextureArrays::get().load_cooked(data_path("levels/grass.tex"));
+ *  material.textures[0].texture = slot.texture; //(target GL_TEXTURE_2D_ARRAY)
+ *  material.textures[0].target = GL_TEXTURE_2D_ARRAY;
+ *  material.texture_layer = slot.layer;
+ *  material.texture_rect = slot.rect;
+ *
+ * Every layer is LayerSize x LayerSize texels, and textures are mipmapped:
+ *  - textures exactly LayerSize on a side get a layer to themselves (and can repeat), with a full mip chain;
+ *  - smaller textures are packed into shared layers ("shelf" packing), surrounded by a Gutter
+ *    of copied edge texels so that filtering doesn't pick up their neighbors; they clamp rather than repeat,
+ *    and only have PackedLevels mip levels (past that, the gutter would be gone).
+ *
+ * Cooked textures (see CookedTexture.hpp) bring their own mip chains; anything else has
+ *  its mip chain built when it is added.
+ *
+ * Shaders map texture coordinates into the slot (see LitColorTextureProgram), clamping them
+ *  for packed textures (whose rect is smaller than the layer) -- per fragment, so that
+ *  triangles reaching outside [0,1] still interpolate correctly:
+ *  uv = (TEX_RECT.zw == vec2(1.0) ? texCoord : clamp(texCoord, 0.0, 1.0));
+ *  texture(TEX, vec3(TEX_RECT.xy + uv * TEX_RECT.zw, TEX_LAYER))
+ *
+ */
+
+#include "GL.hpp"
+#include "CookedTexture.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct TextureArrays {
+	TextureArrays() = default;
+	~TextureArrays();
+
+	TextureArrays(TextureArrays const &) = delete;
+
+	//the arrays used for level textures (created on first use; GL thread only):
+	static TextureArrays &get();
+
+	enum : uint32_t {
+		LayerSize = 512,
+		LayerLevels = 10, //mip levels of whole-layer textures (down to 1x1)
+		Gutter = 4,
+		PackedLevels = 3, //mip levels of packed textures (Gutter >> (PackedLevels-1) is still at least one texel)
+		MaxLayers = 16, //per array
+	};
+
+	//where a texture ended up:
+	struct Slot {
+		GLuint texture = 0; //GL_TEXTURE_2D_ARRAY texture
+		uint32_t layer = 0;
+		glm::vec4 rect = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f); //texture coordinate offset (xy) and scale (zw) within the layer
+	};
+
+	//add a texture (with its origin at the lower left, like OpenGL's):
+	// note: will throw if it is larger than LayerSize
+	Slot add(CookedTexture const &texture);
+	Slot add(glm::uvec2 size, std::vector< glm::u8vec4 > const &data);
+
+	//add a texture from a .png file (loaded through load_png) or a cooked .tex file:
+	// (re-uses the slot if the file was already added)
+	Slot load_png(std::string const &filename);
+	Slot load_cooked(std::string const &filename);
+	//load many .png files at once (decoding and building mip chains in parallel on the JobSystem):
+	std::vector< Slot > load_pngs(std::vector< std::string > const &filenames);
+
+	//a single white texel (for materials that don't use a texture):
+	Slot white();
+
+	//-- internals --
+	struct Array {
+		GLuint texture = 0;
+		bool packed = false; //holds packed textures (PackedLevels levels) rather than whole layers (LayerLevels levels)
+		uint32_t levels = 0;
+		uint32_t capacity = 0; //layers allocated in the texture
+		std::vector< std::vector< glm::u8vec4 > > layers; //CPU copies of every level (used to re-fill the texture when it grows)
+	};
+	std::vector< Array > arrays;
+
+	//layers that textures are being packed into, filled shelf by shelf:
+	struct Shelves {
+		uint32_t array = -1U, layer = -1U;
+		uint32_t x = 0, y = 0; //where the next texture goes on the current shelf
+		uint32_t height = 0; //of the current shelf
+	} shelves;
+
+	std::unordered_map< std::string, Slot > loaded; //filename -> slot
+	Slot white_slot;
+	bool have_white = false;
+
+	//find room for a new layer (allocating arrays / growing them as needed):
+	void new_layer(bool packed, uint32_t *array, uint32_t *layer);
+	//copy 'pixels' (w x h) into a level of the texture and its CPU copy:
+	void write(uint32_t array, uint32_t layer, uint32_t level, glm::uvec2 at, glm::uvec2 size, glm::u8vec4 const *pixels);
+	//offset of a level within a layer's CPU copy:
+	static size_t level_offset(uint32_t level);
+};
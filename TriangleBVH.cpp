@@ -0,0 +1,309 @@
+#include "TriangleBVH.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+
+//build parameters:
+static constexpr uint32_t Bins = 12; //SAH candidate splits per axis
+static constexpr uint32_t MaxLeafTriangles = 8; //leaves may be bigger than this only if splitting can't help
+static constexpr uint32_t MinSplitTriangles = 2; //never split fewer triangles than this
+static constexpr float TraversalCost = 2.0f; //cost of visiting a node, relative to testing one triangle
+static constexpr uint32_t MaxDepth = 28; //past this, fall back to median splits (so depth stays under the 64-entry query stack)
+
+namespace {
+	struct Bounds {
+		glm::vec3 min = glm::vec3( std::numeric_limits< float >::infinity());
+		glm::vec3 max = glm::vec3(-std::numeric_limits< float >::infinity());
+		void add(glm::vec3 const &p) {
+			min = glm::min(min, p);
+			max = glm::max(max, p);
+		}
+		void add(Bounds const &b) {
+			min = glm::min(min, b.min);
+			max = glm::max(max, b.max);
+		}
+		float area() const {
+			glm::vec3 e = max - min;
+			if (e.x < 0.0f) return 0.0f; //empty
+			return 2.0f * (e.x * e.y + e.y * e.z + e.z * e.x);
+		}
+	};
+
+	glm::vec3 centroid(TriangleBVH::Triangle const &tri) {
+		return (tri.a + tri.b + tri.c) * (1.0f / 3.0f);
+	}
+}
+
+TriangleBVH::TriangleBVH(glm::vec3 const *positions, uint32_t count) {
+	assert(positions || count == 0);
+	triangles.reserve(count / 3);
+	for (uint32_t i = 0; i + 2 < count; i += 3) {
+		triangles.emplace_back(Triangle{positions[i], positions[i+1], positions[i+2]});
+	}
+	if (triangles.empty()) return;
+
+	nodes.reserve(2 * (triangles.size() / MinSplitTriangles) + 1);
+	nodes.emplace_back();
+	build(0, 0, uint32_t(triangles.size()), 0);
+}
+
+void TriangleBVH::build(uint32_t node_index, uint32_t begin, uint32_t end, uint32_t depth) {
+	Bounds bounds, centroids;
+	for (uint32_t t = begin; t < end; ++t) {
+		Triangle const &tri = triangles[t];
+		bounds.add(tri.a);
+		bounds.add(tri.b);
+		bounds.add(tri.c);
+		centroids.add(centroid(tri));
+	}
+	nodes[node_index].min = bounds.min;
+	nodes[node_index].max = bounds.max;
+
+	uint32_t count = end - begin;
+	auto make_leaf = [&]() {
+		nodes[node_index].offset = begin;
+		nodes[node_index].count = count;
+	};
+	if (count < MinSplitTriangles) {
+		make_leaf();
+		return;
+	}
+
+	//find the cheapest binned split by surface area heuristic:
+	float best_cost = std::numeric_limits< float >::infinity();
+	uint32_t best_axis = 0;
+	uint32_t best_bin = 0; //split goes between bins [0,best_bin] and [best_bin+1,Bins)
+
+	glm::vec3 extent = centroids.max - centroids.min;
+	auto bin_of = [&](glm::vec3 const &c, uint32_t axis) {
+		uint32_t bin = uint32_t((c[axis] - centroids.min[axis]) / extent[axis] * float(Bins));
+		return std::min(bin, Bins - 1);
+	};
+
+	for (uint32_t axis = 0; axis < 3; ++axis) {
+		if (!(extent[axis] > 0.0f)) continue; //all centroids coincide on this axis
+
+		Bounds bin_bounds[Bins];
+		uint32_t bin_counts[Bins] = {};
+		for (uint32_t t = begin; t < end; ++t) {
+			Triangle const &tri = triangles[t];
+			uint32_t bin = bin_of(centroid(tri), axis);
+			bin_counts[bin] += 1;
+			bin_bounds[bin].add(tri.a);
+			bin_bounds[bin].add(tri.b);
+			bin_bounds[bin].add(tri.c);
+		}
+
+		//sweep from the right to get the cost of everything above each split:
+		float right_area[Bins];
+		uint32_t right_count[Bins];
+		Bounds right;
+		uint32_t right_total = 0;
+		for (uint32_t b = Bins - 1; b > 0; --b) {
+			right.add(bin_bounds[b]);
+			right_total += bin_counts[b];
+			right_area[b] = right.area();
+			right_count[b] = right_total;
+		}
+
+		Bounds left;
+		uint32_t left_total = 0;
+		for (uint32_t b = 0; b + 1 < Bins; ++b) {
+			left.add(bin_bounds[b]);
+			left_total += bin_counts[b];
+			if (left_total == 0 || right_count[b+1] == 0) continue;
+			float cost = float(left_total) * left.area() + float(right_count[b+1]) * right_area[b+1];
+			if (cost < best_cost) {
+				best_cost = cost;
+				best_axis = axis;
+				best_bin = b;
+			}
+		}
+	}
+
+	//compare against just testing every triangle here (costs are all scaled by surface area):
+	float leaf_cost = float(count) * bounds.area();
+	bool have_split = best_cost < std::numeric_limits< float >::infinity();
+	if (depth < MaxDepth && (!have_split || best_cost + TraversalCost * bounds.area() >= leaf_cost) && count <= MaxLeafTriangles) {
+		make_leaf();
+		return;
+	}
+
+	uint32_t mid;
+	if (have_split && depth < MaxDepth) {
+		mid = uint32_t(std::partition(triangles.begin() + begin, triangles.begin() + end, [&](Triangle const &tri) {
+			return bin_of(centroid(tri), best_axis) <= best_bin;
+		}) - triangles.begin());
+	} else {
+		//no useful SAH split (or too deep): split at the median along the longest axis
+		uint32_t axis = (extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2));
+		mid = begin + count / 2;
+		std::nth_element(triangles.begin() + begin, triangles.begin() + mid, triangles.begin() + end, [&](Triangle const &x, Triangle const &y) {
+			return centroid(x)[axis] < centroid(y)[axis];
+		});
+	}
+	assert(begin < mid && mid < end);
+
+	//first child directly follows this node; second child goes after the first child's subtree:
+	uint32_t first = uint32_t(nodes.size());
+	nodes.emplace_back();
+	build(first, begin, mid, depth + 1);
+	uint32_t second = uint32_t(nodes.size());
+	nodes.emplace_back();
+	build(second, mid, end, depth + 1);
+
+	assert(first == node_index + 1);
+	nodes[node_index].offset = second;
+	nodes[node_index].count = 0;
+}
+
+bool TriangleBVH::raycast(glm::vec3 const &origin, glm::vec3 const &dir, float max_t, float *t_, glm::vec3 *normal_) const {
+	if (nodes.empty()) return false;
+
+	//slab test against node bounds, returning the entry distance (or infinity on a miss):
+	glm::vec3 inv_dir = 1.0f / dir;
+	float best_t = max_t;
+	auto enter = [&](Node const &node) {
+		glm::vec3 t0 = (node.min - origin) * inv_dir;
+		glm::vec3 t1 = (node.max - origin) * inv_dir;
+		glm::vec3 lo = glm::min(t0, t1);
+		glm::vec3 hi = glm::max(t0, t1);
+		float near = glm::max(glm::max(lo.x, lo.y), glm::max(lo.z, 0.0f));
+		float far = glm::min(glm::min(hi.x, hi.y), glm::min(hi.z, best_t));
+		return (near <= far ? near : std::numeric_limits< float >::infinity());
+	};
+
+	bool hit = false;
+	uint32_t stack[64];
+	uint32_t top = 0;
+	stack[top++] = 0;
+	while (top > 0) {
+		uint32_t index = stack[--top];
+		Node const &node = nodes[index];
+		if (!(enter(node) <= best_t)) continue;
+		if (node.count != 0) {
+			for (uint32_t i = node.offset; i < node.offset + node.count; ++i) {
+				//Moller-Trumbore intersection:
+				Triangle const &tri = triangles[i];
+				glm::vec3 e1 = tri.b - tri.a;
+				glm::vec3 e2 = tri.c - tri.a;
+				glm::vec3 p = glm::cross(dir, e2);
+				float det = glm::dot(e1, p);
+				if (std::abs(det) < 1e-12f) continue; //parallel
+				float inv_det = 1.0f / det;
+				glm::vec3 s = origin - tri.a;
+				float u = glm::dot(s, p) * inv_det;
+				if (u < 0.0f || u > 1.0f) continue;
+				glm::vec3 q = glm::cross(s, e1);
+				float v = glm::dot(dir, q) * inv_det;
+				if (v < 0.0f || u + v > 1.0f) continue;
+				float t = glm::dot(e2, q) * inv_det;
+				if (t < 0.0f || t > best_t) continue;
+				best_t = t;
+				glm::vec3 n = glm::cross(e1, e2);
+				*normal_ = (glm::dot(n, dir) > 0.0f ? -n : n);
+				hit = true;
+			}
+		} else {
+			//visit the nearer child first (pushed last), so farther subtrees are more likely to be culled:
+			uint32_t first = index + 1;
+			uint32_t second = node.offset;
+			if (enter(nodes[second]) < enter(nodes[first])) std::swap(first, second);
+			stack[top++] = second;
+			stack[top++] = first;
+		}
+	}
+
+	if (hit) *t_ = best_t;
+	return hit;
+}
+
+bool TriangleBVH::closest_point(glm::vec3 const &p, float max_distance, glm::vec3 *closest_) const {
+	if (nodes.empty()) return false;
+
+	//squared distance from p to node bounds:
+	float best2 = max_distance * max_distance;
+	auto distance2 = [&](Node const &node) {
+		glm::vec3 to = glm::clamp(p, node.min, node.max) - p;
+		return glm::dot(to, to);
+	};
+
+	bool found = false;
+	uint32_t stack[64];
+	uint32_t top = 0;
+	stack[top++] = 0;
+	while (top > 0) {
+		uint32_t index = stack[--top];
+		Node const &node = nodes[index];
+		if (!(distance2(node) < best2)) continue;
+		if (node.count != 0) {
+			for (uint32_t i = node.offset; i < node.offset + node.count; ++i) {
+				glm::vec3 close = closest_point(p, triangles[i]);
+				glm::vec3 to = close - p;
+				float d2 = glm::dot(to, to);
+				if (d2 < best2) {
+					best2 = d2;
+					*closest_ = close;
+					found = true;
+				}
+			}
+		} else {
+			//visit the nearer child first (pushed last), so farther subtrees are more likely to be culled:
+			uint32_t first = index + 1;
+			uint32_t second = node.offset;
+			if (distance2(nodes[second]) < distance2(nodes[first])) std::swap(first, second);
+			stack[top++] = second;
+			stack[top++] = first;
+		}
+	}
+
+	return found;
+}
+
+glm::vec3 TriangleBVH::closest_point(glm::vec3 const &p, Triangle const &tri) {
+	//from Ericson, "Real-Time Collision Detection", section 5.1.5:
+	glm::vec3 const &a = tri.a, &b = tri.b, &c = tri.c;
+	glm::vec3 ab = b - a;
+	glm::vec3 ac = c - a;
+	glm::vec3 ap = p - a;
+
+	float d1 = glm::dot(ab, ap);
+	float d2 = glm::dot(ac, ap);
+	if (d1 <= 0.0f && d2 <= 0.0f) return a; //vertex region a
+
+	glm::vec3 bp = p - b;
+	float d3 = glm::dot(ab, bp);
+	float d4 = glm::dot(ac, bp);
+	if (d3 >= 0.0f && d4 <= d3) return b; //vertex region b
+
+	float vc = d1 * d4 - d3 * d2;
+	if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) { //edge region ab
+		float v = d1 / (d1 - d3);
+		return a + v * ab;
+	}
+
+	glm::vec3 cp = p - c;
+	float d5 = glm::dot(ab, cp);
+	float d6 = glm::dot(ac, cp);
+	if (d6 >= 0.0f && d5 <= d6) return c; //vertex region c
+
+	float vb = d5 * d2 - d1 * d6;
+	if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) { //edge region ac
+		float w = d2 / (d2 - d6);
+		return a + w * ac;
+	}
+
+	float va = d3 * d6 - d5 * d4;
+	if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f) { //edge region bc
+		float w = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+		return b + w * (c - b);
+	}
+
+	//inside face region:
+	float denom = 1.0f / (va + vb + vc);
+	float v = vb * denom;
+	float w = vc * denom;
+	return a + ab * v + ac * w;
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+/*
+ * TriangleBVH is a bounding volume hierarchy over a static triangle list,
+ *  used to collide against arbitrary level geometry (see Scene::TriangleMeshCollider).
+ *
+ * It is built once (binned surface area heuristic) and stored flattened:
+ *  nodes are 32 bytes, an interior node's first child immediately follows it,
+ *  and leaves reference a contiguous run of (reordered) triangles.
+ *
+ * Example:
+ *  TriangleBVH bvh(&buffer.positions[mesh.start], mesh.count);
+ *  bvh.overlap_sphere(center, radius, [&](TriangleBVH::Triangle const &tri) { ... });
+ *
+ */
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+struct TriangleBVH {
+	//build from a triangle list (every three positions make one triangle):
+	TriangleBVH(glm::vec3 const *positions, uint32_t count);
+
+	struct Triangle {
+		glm::vec3 a, b, c;
+	};
+
+	//call fn(triangle) for every triangle whose leaf bounds overlap the sphere:
+	// (a conservative test -- callers do their own exact triangle test)
+	template< typename F >
+	void overlap_sphere(glm::vec3 const &center, float radius, F &&fn) const;
+
+	//closest hit of the ray origin + t * dir (for t in [0, max_t]) against any triangle:
+	// returns false on a miss; otherwise sets *t and *normal (unnormalized, facing against dir)
+	bool raycast(glm::vec3 const &origin, glm::vec3 const &dir, float max_t, float *t, glm::vec3 *normal) const;
+
+	//closest point to 'p' on any triangle that is nearer than 'max_distance':
+	// returns false if there is none; otherwise sets *closest
+	bool closest_point(glm::vec3 const &p, float max_distance, glm::vec3 *closest) const;
+
+	//closest point to 'p' on triangle abc:
+	static glm::vec3 closest_point(glm::vec3 const &p, Triangle const &tri);
+
+	//-- internals --
+	struct Node {
+		glm::vec3 min;
+		uint32_t offset; //interior: index of second child; leaf: first triangle
+		glm::vec3 max;
+		uint32_t count; //interior: 0; leaf: number of triangles
+	};
+	static_assert(sizeof(Node) == 32, "Node is packed.");
+
+	std::vector< Node > nodes; //nodes[0] is the root
+	std::vector< Triangle > triangles; //reordered so every leaf's triangles are contiguous
+
+	void build(uint32_t node, uint32_t begin, uint32_t end, uint32_t depth);
+};
+
+template< typename F >
+void TriangleBVH::overlap_sphere(glm::vec3 const &center, float radius, F &&fn) const {
+	if (nodes.empty()) return;
+
+	float radius2 = radius * radius;
+	auto overlaps = [&](Node const &node) {
+		glm::vec3 close = glm::clamp(center, node.min, node.max);
+		glm::vec3 to = close - center;
+		return glm::dot(to, to) <= radius2;
+	};
+
+	uint32_t stack[64];
+	uint32_t top = 0;
+	stack[top++] = 0;
+	while (top > 0) {
+		Node const &node = nodes[stack[--top]];
+		if (!overlaps(node)) continue;
+		if (node.count != 0) {
+			for (uint32_t t = node.offset; t < node.offset + node.count; ++t) {
+				fn(triangles[t]);
+			}
+		} else {
+			//(build() limits depth, so the stack can't overflow)
+			stack[top++] = node.offset;
+			stack[top++] = uint32_t(&node - nodes.data()) + 1;
+		}
+	}
+}
@@ -0,0 +1,140 @@
+#include "UniformBlocks.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+#include <string>
+
+ObjectUniforms ObjectUniforms::make(glm::mat4x3 const &object_to_world, glm::mat4 const &world_to_clip, glm::mat4x3 const &world_to_light) {
+	ObjectUniforms ret;
+	ret.OBJECT_TO_CLIP = world_to_clip * glm::mat4(object_to_world);
+	glm::mat4x3 object_to_light = world_to_light * glm::mat4(object_to_world);
+	glm::mat3 normal_to_light = glm::inverse(glm::transpose(glm::mat3(object_to_light)));
+	for (uint32_t c = 0; c < 4; ++c) ret.OBJECT_TO_LIGHT[c] = glm::vec4(object_to_light[c], 0.0f);
+	for (uint32_t c = 0; c < 3; ++c) ret.NORMAL_TO_LIGHT[c] = glm::vec4(normal_to_light[c], 0.0f);
+	return ret;
+}
+
+//find block 'name', check its size, and bind it to 'binding':
+static GLuint bind_block(GLuint program, char const *name, GLuint binding, GLint expected_size) {
+	GLuint index = glGetUniformBlockIndex(program, name);
+	if (index == GL_INVALID_INDEX) return -1U;
+
+	GLint data_size = 0;
+	glGetActiveUniformBlockiv(program, index, GL_UNIFORM_BLOCK_DATA_SIZE, &data_size);
+	if (data_size != expected_size) {
+		throw std::runtime_error("Uniform block '" + std::string(name) + "' is " + std::to_string(data_size) + " bytes, but its structure is " + std::to_string(expected_size) + " bytes.");
+	}
+
+	glUniformBlockBinding(program, index, binding);
+	return index;
+}
+
+void bind_uniform_blocks(GLuint program, GLuint *Frame_block, GLuint *Object_block) {
+	assert(Frame_block);
+	assert(Object_block);
+	*Frame_block = bind_block(program, "Frame", FrameBinding, sizeof(FrameUniforms));
+	*Object_block = bind_block(program, "Object", ObjectBinding, sizeof(ObjectUniforms));
+}
+
+void set_frame_uniforms(FrameUniforms const &uniforms) {
+	static GLuint buffer = 0;
+	if (buffer == 0) glGenBuffers(1, &buffer);
+
+	glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameUniforms), &uniforms, GL_STREAM_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+	glBindBufferBase(GL_UNIFORM_BUFFER, FrameBinding, buffer);
+}
+
+UniformRing::UniformRing(GLsizeiptr size_) : size(size_) {
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	alignment = std::max(alignment, GLint(1));
+
+	glGenBuffers(1, &buffer);
+	glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+	glBufferData(GL_UNIFORM_BUFFER, size, nullptr, GL_STREAM_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+UniformRing::~UniformRing() {
+	for (auto const &b : busy) glDeleteSync(b.fence);
+	busy.clear();
+	glDeleteBuffers(1, &buffer);
+	buffer = 0;
+}
+
+UniformRing &UniformRing::get() {
+	//(never destroyed, since the context may be gone by the time static destructors run)
+	static UniformRing *ring = new UniformRing();
+	return *ring;
+}
+
+void UniformRing::wait(GLintptr begin, GLintptr end) {
+	//ranges are fenced in order, so waiting on the newest overlapping range covers everything before it:
+	size_t last = busy.size();
+	for (size_t i = 0; i < busy.size(); ++i) {
+		if (busy[i].begin < end && begin < busy[i].end) last = i;
+	}
+	if (last == busy.size()) return;
+
+	GLsync fence = busy[last].fence;
+	while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED) { }
+
+	for (size_t i = 0; i <= last; ++i) glDeleteSync(busy[i].fence);
+	busy.erase(busy.begin(), busy.begin() + last + 1);
+}
+
+void UniformRing::allocate(uint32_t count, GLsizeiptr block_size_) {
+	assert(batch_size == 0 && "previous batch should be fenced before allocating another");
+	assert(count > 0);
+
+	block_size = block_size_;
+	stride = (block_size + alignment - 1) / alignment * alignment;
+	GLsizeiptr bytes = stride * count;
+
+	glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+
+	if (bytes > size) {
+		//grow; re-specifying the storage orphans the old one, so nothing needs to wait for draws still reading it:
+		while (size < bytes) size *= 2;
+		glBufferData(GL_UNIFORM_BUFFER, size, nullptr, GL_STREAM_DRAW);
+		for (auto const &b : busy) glDeleteSync(b.fence);
+		busy.clear();
+		head = 0;
+	}
+
+	if (head + bytes > size) head = 0; //wrap around
+	wait(head, head + bytes);
+
+	batch = head;
+	batch_size = bytes;
+	head += bytes;
+
+	mapped = reinterpret_cast< uint8_t * >(glMapBufferRange(GL_UNIFORM_BUFFER, batch, batch_size,
+		GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT));
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	if (!mapped) throw std::runtime_error("Failed to map uniform ring.");
+}
+
+void UniformRing::upload() {
+	assert(mapped);
+	glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+	glUnmapBuffer(GL_UNIFORM_BUFFER);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	mapped = nullptr;
+}
+
+void UniformRing::bind(GLuint binding, uint32_t index) const {
+	assert(batch_size != 0 && !mapped);
+	assert(GLsizeiptr(index) * stride < batch_size);
+	glBindBufferRange(GL_UNIFORM_BUFFER, binding, buffer, batch + index * stride, block_size);
+}
+
+void UniformRing::fence() {
+	if (batch_size == 0) return;
+	assert(!mapped);
+	busy.emplace_back(Busy{ glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0), batch, batch + batch_size });
+	batch_size = 0;
+}
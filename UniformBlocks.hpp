@@ -0,0 +1,132 @@
+#pragma once
+
+/*
+ * Uniform blocks shared by shader programs (std140 layout, fixed binding points):
+ *
+ *  "Frame" (FrameBinding) -- per-frame values (camera, light); set once per frame with set_frame_uniforms()
+ *  "Object" (ObjectBinding) -- per-drawable transforms and texture slot; Scene::draw writes every drawable's block into
+ *    a UniformRing up front, then each draw only binds its offset with glBindBufferRange
+ *
+ * Programs paste FRAME_BLOCK_GLSL / OBJECT_BLOCK_GLSL into their shader source and call
+ *  bind_uniform_blocks() after linking to find (and bind) the blocks they use:
+ *
+ *  program = gl_compile_program("#version 330\n" OBJECT_BLOCK_GLSL "in vec4 Position; ...", ...);
+ *  bind_uniform_blocks(program, &Frame_block, &Object_block);
+ *
+ */
+
+#include "GL.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <deque>
+
+enum : GLuint {
+	FrameBinding = 0,
+	ObjectBinding = 1,
+};
+
+#define FRAME_BLOCK_GLSL \
+	"layout(std140) uniform Frame {\n" \
+	"	mat4 WORLD_TO_CLIP;\n" \
+	"	vec3 LIGHT_LOCATION;\n" \
+	"	int LIGHT_TYPE;\n" \
+	"	vec3 LIGHT_DIRECTION;\n" \
+	"	float LIGHT_CUTOFF;\n" \
+	"	vec3 LIGHT_ENERGY;\n" \
+	"};\n"
+
+//matches FRAME_BLOCK_GLSL (std140: vec3s are padded out to 16 bytes, which the following scalars fill):
+struct FrameUniforms {
+	glm::mat4 WORLD_TO_CLIP = glm::mat4(1.0f);
+	glm::vec3 LIGHT_LOCATION = glm::vec3(0.0f);
+	int32_t LIGHT_TYPE = 0; //0: point, 1: hemisphere, 2: spot, 3: directional
+	glm::vec3 LIGHT_DIRECTION = glm::vec3(0.0f, 0.0f, -1.0f);
+	float LIGHT_CUTOFF = 1.0f; //(cosine of the spot cone's half-angle)
+	glm::vec3 LIGHT_ENERGY = glm::vec3(1.0f);
+	float padding = 0.0f;
+};
+static_assert(sizeof(FrameUniforms) == 112, "FrameUniforms matches the std140 layout of the 'Frame' block.");
+
+#define OBJECT_BLOCK_GLSL \
+	"layout(std140) uniform Object {\n" \
+	"	mat4 OBJECT_TO_CLIP;\n" \
+	"	mat4x3 OBJECT_TO_LIGHT;\n" \
+	"	mat3 NORMAL_TO_LIGHT;\n" \
+	"	vec4 TEX_RECT;\n" \
+	"	float TEX_LAYER;\n" \
+	"};\n"
+
+//matches OBJECT_BLOCK_GLSL (std140: each matrix column is padded to a vec4):
+struct ObjectUniforms {
+	glm::mat4 OBJECT_TO_CLIP;
+	glm::vec4 OBJECT_TO_LIGHT[4]; //mat4x3 columns
+	glm::vec4 NORMAL_TO_LIGHT[3]; //mat3 columns
+	glm::vec4 TEX_RECT = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f); //texture coordinate offset (xy) and scale (zw); see TextureArrays.hpp
+	float TEX_LAYER = 0.0f; //texture array layer
+	float padding[3] = {0.0f, 0.0f, 0.0f};
+
+	//the standard transforms for an object drawn with the given world-to-clip and world-to-light matrices:
+	static ObjectUniforms make(glm::mat4x3 const &object_to_world, glm::mat4 const &world_to_clip, glm::mat4x3 const &world_to_light);
+};
+static_assert(sizeof(ObjectUniforms) == 208, "ObjectUniforms matches the std140 layout of the 'Object' block.");
+
+//look up the "Frame" and "Object" blocks in 'program' and bind them to FrameBinding / ObjectBinding:
+// indices are set to -1U for blocks the program doesn't use
+// note: will throw if a block's size doesn't match its C++ structure
+void bind_uniform_blocks(GLuint program, GLuint *Frame_block, GLuint *Object_block);
+
+//upload this frame's "Frame" block and bind it to FrameBinding:
+// (the buffer is re-specified each call, so the driver never has to wait for the previous frame's draws)
+void set_frame_uniforms(FrameUniforms const &uniforms);
+
+//A UniformRing sub-allocates uniform blocks from one large buffer:
+// allocate() maps space for a batch of blocks (without synchronizing, so the CPU never waits on draws
+// that are still reading older parts of the ring), write the blocks, upload() to unmap, bind() each one
+// while drawing, then fence() once the draws that read the batch have been issued.
+struct UniformRing {
+	UniformRing(GLsizeiptr size = 4 * 1024 * 1024);
+	~UniformRing();
+
+	UniformRing(UniformRing const &) = delete;
+
+	//the ring Scene draws from (created on first use; GL thread only):
+	static UniformRing &get();
+
+	//map 'count' blocks of 'block_size' bytes; block i is written at block(i):
+	// (waits only if the GPU is still using the space; grows the ring if the batch doesn't fit at all)
+	void allocate(uint32_t count, GLsizeiptr block_size);
+	template< typename T >
+	T *block(uint32_t index) const { return reinterpret_cast< T * >(mapped + index * stride); }
+
+	//unmap the batch, making it visible to the GPU:
+	void upload();
+
+	//bind block 'index' of the batch to a uniform buffer binding point:
+	void bind(GLuint binding, uint32_t index) const;
+
+	//mark the batch as in use until the draws issued so far have finished:
+	void fence();
+
+	//-- internals --
+	GLuint buffer = 0;
+	GLsizeiptr size = 0;
+	GLint alignment = 256; //GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT
+
+	GLintptr head = 0; //where the next batch starts
+	GLintptr batch = 0; //offset of the current batch
+	GLsizeiptr batch_size = 0; //(0 if there is no current batch)
+	GLsizeiptr block_size = 0;
+	GLsizeiptr stride = 0; //block_size rounded up to alignment
+	uint8_t *mapped = nullptr; //(while the batch is mapped)
+
+	struct Busy {
+		GLsync fence;
+		GLintptr begin, end;
+	};
+	std::deque< Busy > busy; //oldest first
+
+	//wait for every busy range that overlaps [begin,end):
+	void wait(GLintptr begin, GLintptr end);
+};
@@ -0,0 +1,1284 @@
+/*
+ * benchmarks.cpp runs a suite of microbenchmarks over the engine's hot paths:
+ *  - chunk reading, MeshBuffer (exported and cooked) and Scene loading for the shipped levels, from loose files and an AssetPack
+ *  - level-of-detail selection (triangles drawn, and LOD switches with and without hysteresis)
+ *  - Scene copying (Scene::set) and render snapshots (Scene::snapshot)
+ *  - transform hierarchy evaluation (make_local_to_world)
+ *  - PlayMode::handle_physics with synthetic collider counts
+ *  - triangle mesh collider BVH building and sphere queries
+ *  - SceneQuery raycasts / overlaps (single and batched) and dynamic refits
+ *  - Attraction (gravity wells) with the Barnes-Hut octree vs. exact summation
+ *  - static geometry baking, and drawing the shipped levels with and without it
+ *  - packing textures into texture arrays, and drawing with many materials that share one array
+ *  - loading textures from .png (decoding and building mip chains) vs. from cooked .tex files
+ *  - decoding a directory of .png files one at a time vs. in parallel (load_pngs)
+ *  - DynamicResolution: how its scale settles for synthetic GPU costs, and drawing a level at fixed scales
+ *  - drawing the shipped levels unordered, front-to-back, and with a depth pre-pass (time and shaded samples)
+ *  - draw list traversal and Scene drawing (per-object uniform blocks from a ring) at 1k-50k drawables,
+ *    with the GL state cache's issued / filtered call counts
+ *  - DrawLines text generation
+ *  - JobSystem scaling (parallel_for and task graphs at different worker counts)
+ *
+ * Results are written as CSV (one row per benchmark, times in nanoseconds per operation)
+ *  so that runs from different commits can be compared with diff or a spreadsheet:
+ *
+ *   $ dist/benchmarks [--filter substring] [--out results.csv] [--images directory]
+ *
+ * (--images picks the .png files to decode; by default, a set of synthetic images is written to a scratch directory)
+ *
+ */
+
+#include "PlayMode.hpp"
+#include "Scene.hpp"
+#include "Mesh.hpp"
+#include "DrawLines.hpp"
+#include "LitColorTextureProgram.hpp"
+#include "UniformBlocks.hpp"
+#include "Load.hpp"
+#include "GL.hpp"
+#include "gl_errors.hpp"
+#include "data_path.hpp"
+#include "read_write_chunk.hpp"
+#include "JobSystem.hpp"
+#include "FrameArena.hpp"
+#include "SceneQuery.hpp"
+#include "Attraction.hpp"
+#include "AssetPack.hpp"
+#include "StaticGeometry.hpp"
+#include "TextureArrays.hpp"
+#include "DynamicResolution.hpp"
+#include "CookedTexture.hpp"
+#include "load_save_png.hpp"
+#include "load_pngs.hpp"
+
+#include <SDL.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <list>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+//------------ benchmark harness ------------
+
+struct BenchmarkResult {
+	std::string name;
+	uint32_t samples = 0; //number of timed calls
+	uint32_t batch = 0; //operations performed per timed call
+	double min_ns = 0.0, median_ns = 0.0, mean_ns = 0.0, max_ns = 0.0; //per operation
+};
+
+static std::vector< BenchmarkResult > results;
+static std::string filter; //only run benchmarks whose name contains this string
+static std::string images_dir; //.png files for benchmark_png_decoding (synthetic ones are written if empty)
+
+//time repeated calls of 'fn' (each of which performs 'batch' operations) and record per-operation statistics:
+// (runs at least 'MinSamples' calls and keeps sampling until 'MinTime' has passed or 'MaxSamples' calls are made)
+template< typename F >
+void benchmark(std::string const &name, uint32_t batch, F &&fn) {
+	if (!filter.empty() && name.find(filter) == std::string::npos) return;
+
+	constexpr uint32_t MinSamples = 10;
+	constexpr uint32_t MaxSamples = 10000;
+	constexpr double MinTime = 0.25; //seconds
+
+	std::cerr << "  " << name << "..." << std::flush;
+
+	fn(); //warm up caches (and any lazily-initialized state)
+	FrameArena::current().reset(); //(each call is treated as a frame)
+
+	std::vector< double > times;
+	double total = 0.0;
+	while (times.size() < MinSamples || (total < MinTime && times.size() < MaxSamples)) {
+		auto before = std::chrono::high_resolution_clock::now();
+		fn();
+		auto after = std::chrono::high_resolution_clock::now();
+		FrameArena::current().reset();
+		double seconds = std::chrono::duration< double >(after - before).count();
+		total += seconds;
+		times.emplace_back(seconds * 1e9 / double(batch));
+	}
+
+	std::sort(times.begin(), times.end());
+
+	BenchmarkResult result;
+	result.name = name;
+	result.samples = uint32_t(times.size());
+	result.batch = batch;
+	result.min_ns = times.front();
+	result.median_ns = times[times.size() / 2];
+	result.max_ns = times.back();
+	for (double t : times) result.mean_ns += t;
+	result.mean_ns /= double(times.size());
+	results.emplace_back(result);
+
+	std::cerr << " " << result.median_ns << " ns" << std::endl;
+}
+
+static void write_results(std::ostream &to) {
+	to << "name,samples,batch,min_ns,median_ns,mean_ns,max_ns\n";
+	to << std::fixed << std::setprecision(1);
+	for (auto const &r : results) {
+		to << r.name << ',' << r.samples << ',' << r.batch << ','
+		   << r.min_ns << ',' << r.median_ns << ',' << r.mean_ns << ',' << r.max_ns << '\n';
+	}
+}
+
+//------------ benchmarks ------------
+
+static std::vector< std::string > const level_names = { "lvl0", "lvl1", "lvl2", "lvl3" };
+
+static void benchmark_loading() {
+	//pack every level (as scenes/pack-assets would) to compare with loading loose files:
+	std::string pack_file = data_path("benchmark-levels.pack");
+	{
+		std::vector< std::string > assets;
+		for (auto const &level : level_names) {
+			assets.emplace_back("levels/" + level + ".pnci");
+			assets.emplace_back("levels/" + level + ".scene");
+		}
+		AssetPack::write(pack_file, data_path(""), assets);
+	}
+	std::unique_ptr< AssetPack > pack = std::make_unique< AssetPack >(pack_file);
+
+	for (auto const &level : level_names) {
+		std::string pnct = data_path("levels/" + level + ".pnct");
+		std::string scene = data_path("levels/" + level + ".scene");
+
+		{ //chunk parsing from memory (isolates read_chunk from file system overhead):
+			std::ifstream file(pnct, std::ios::binary);
+			std::string bytes((std::istreambuf_iterator< char >(file)), std::istreambuf_iterator< char >());
+			benchmark("read_chunk/memory/" + level + ".pnct", 1, [&](){
+				std::istringstream from(bytes);
+				std::vector< char > data, strings, index;
+				read_chunk(from, "pnct", &data);
+				read_chunk(from, "str0", &strings);
+				read_chunk(from, "idx0", &index);
+			});
+		}
+
+		benchmark("read_chunk/file/" + level + ".pnct", 1, [&](){
+			std::ifstream from(pnct, std::ios::binary);
+			std::vector< char > data, strings, index;
+			read_chunk(from, "pnct", &data);
+			read_chunk(from, "str0", &strings);
+			read_chunk(from, "idx0", &index);
+		});
+
+		benchmark("MeshBuffer/" + level + ".pnct", 1, [&](){
+			MeshBuffer buffer(pnct);
+			glDeleteBuffers(1, &buffer.buffer);
+		});
+
+		//cooked (indexed) meshes, as loaded by the game:
+		std::string pnci = data_path("levels/" + level + ".pnci");
+		benchmark("MeshBuffer/" + level + ".pnci", 1, [&](){
+			MeshBuffer buffer(pnci);
+			glDeleteBuffers(1, &buffer.buffer);
+			glDeleteBuffers(1, &buffer.index_buffer);
+		});
+
+		//..from the (compressed) pack:
+		benchmark("read/pack/" + level + ".pnci", 1, [&](){
+			std::unique_ptr< std::istream > from = pack->open("levels/" + level + ".pnci");
+			std::vector< char > data, indices;
+			read_chunk(*from, "pnct", &data);
+			read_chunk(*from, "i032", &indices);
+		});
+		benchmark("read/file/" + level + ".pnci", 1, [&](){
+			std::ifstream from(pnci, std::ios::binary);
+			std::vector< char > data, indices;
+			read_chunk(from, "pnct", &data);
+			read_chunk(from, "i032", &indices);
+		});
+		benchmark("MeshBuffer/pack/" + level + ".pnci", 1, [&](){
+			MeshBuffer buffer(*pack->open("levels/" + level + ".pnci"), "levels/" + level + ".pnci");
+			glDeleteBuffers(1, &buffer.buffer);
+			glDeleteBuffers(1, &buffer.index_buffer);
+		});
+
+		MeshBuffer meshes(pnct);
+		benchmark("Scene::load/" + level + ".scene", 1, [&](){
+			Scene loaded(scene, [&](Scene &s, Scene::Transform *transform, std::string const &mesh_name){
+				Mesh const &mesh = meshes.lookup(mesh_name);
+				s.drawables.emplace_back(transform);
+				s.drawables.back().pipeline.type = mesh.type;
+				s.drawables.back().pipeline.start = mesh.start;
+				s.drawables.back().pipeline.count = mesh.count;
+				s.drawables.back().pipeline.index_type = mesh.index_type;
+				s.drawables.back().pipeline.shape = s.add_shape(Scene::Shape::make(mesh));
+			});
+		});
+
+		Scene loaded(scene, [&](Scene &s, Scene::Transform *transform, std::string const &mesh_name){
+			Mesh const &mesh = meshes.lookup(mesh_name);
+			s.drawables.emplace_back(transform);
+			s.drawables.back().pipeline.type = mesh.type;
+			s.drawables.back().pipeline.start = mesh.start;
+			s.drawables.back().pipeline.count = mesh.count;
+			s.drawables.back().pipeline.index_type = mesh.index_type;
+			s.drawables.back().pipeline.shape = s.add_shape(Scene::Shape::make(mesh));
+		});
+		benchmark("Scene::load/pack/" + level + ".scene", 1, [&](){
+			Scene loaded(*pack->open("levels/" + level + ".scene"), "levels/" + level + ".scene", [&](Scene &s, Scene::Transform *transform, std::string const &mesh_name){
+				s.drawables.emplace_back(transform);
+			});
+		});
+
+		Scene copy;
+		benchmark("Scene::set/" + level + ".scene", 1, [&](){
+			copy.set(loaded);
+		});
+
+		Scene::Snapshot snapshot;
+		benchmark("Scene::snapshot/" + level + ".scene", 1, [&](){
+			loaded.snapshot(&snapshot);
+		});
+
+		glDeleteBuffers(1, &meshes.buffer);
+	}
+
+	pack.reset();
+	std::remove(pack_file.c_str());
+}
+
+static void benchmark_hierarchy() {
+	for (uint32_t depth : {1, 4, 16, 64}) {
+		Scene scene;
+		Scene::Transform *parent = nullptr;
+		for (uint32_t i = 0; i < depth; ++i) {
+			scene.transforms.emplace_back();
+			Scene::Transform &t = scene.transforms.back();
+			t.parent = parent;
+			t.position = glm::vec3(0.1f * i, 0.0f, 1.0f);
+			t.rotation = glm::angleAxis(0.05f * i, glm::vec3(0.0f, 0.0f, 1.0f));
+			parent = &t;
+		}
+
+		constexpr uint32_t Batch = 1000;
+		glm::mat4x3 sink(0.0f);
+		benchmark("Transform::make_local_to_world/depth=" + std::to_string(depth), Batch, [&](){
+			for (uint32_t i = 0; i < Batch; ++i) {
+				sink = sink + parent->make_local_to_world();
+			}
+		});
+		benchmark("Transform::make_world_to_local/depth=" + std::to_string(depth), Batch, [&](){
+			for (uint32_t i = 0; i < Batch; ++i) {
+				sink = sink + parent->make_world_to_local();
+			}
+		});
+		if (sink[0].x == 12345.0f) std::cerr << "(unlikely)" << std::endl; //keep 'sink' live
+	}
+}
+
+static void benchmark_physics() {
+	for (uint32_t count : {16, 64, 256, 1024}) {
+		PlayMode play;
+
+		//fixed seed so that every run (and every commit) simulates the same thing:
+		std::mt19937 mt(0x15466);
+		std::uniform_real_distribution< float > spread(-4.0f, 4.0f);
+		std::uniform_real_distribution< float > height(0.5f, 2.0f);
+		std::uniform_real_distribution< float > speed(-2.0f, 2.0f);
+
+		//half moving spheres, half static boxes:
+		for (uint32_t i = 0; i < count; ++i) {
+			play.scene.transforms.emplace_back();
+			Scene::Transform *transform = &play.scene.transforms.back();
+			transform->name = "Benchmark";
+			transform->position = glm::vec3(spread(mt), spread(mt), height(mt));
+			if (i % 2 == 0) {
+				Scene::RigidBody &body = play.bodies.emplace_back(transform, std::make_shared< Scene::SphereCollider >(glm::vec3(0.0f), 0.05f));
+				body.velocity = glm::vec3(speed(mt), speed(mt), speed(mt));
+			} else {
+				play.static_objects.emplace(transform, std::make_shared< Scene::BoxCollider >(glm::vec3(-0.1f), glm::vec3(0.1f)));
+			}
+		}
+
+		benchmark("PlayMode::handle_physics/colliders=" + std::to_string(count), 1, [&](){
+			play.handle_physics(1.0f / 60.0f);
+		});
+	}
+
+	{ //a stress level: hundreds of balls that have come to rest on the ground (they should cost almost nothing):
+		constexpr uint32_t Count = 512;
+		PlayMode play;
+		play.scene.transforms.emplace_back();
+		Scene::Transform *ground = &play.scene.transforms.back();
+		play.static_objects.emplace(ground, std::make_shared< Scene::PlaneCollider >(glm::vec3(0.0f, 0.0f, 1.0f), 0.0f), 0.7f);
+		for (uint32_t i = 0; i < Count; ++i) {
+			play.scene.transforms.emplace_back();
+			Scene::Transform *transform = &play.scene.transforms.back();
+			transform->position = glm::vec3(float(i % 32) * 0.2f - 3.2f, float(i / 32) * 0.2f - 3.2f, 0.1f);
+			play.bodies.emplace_back(transform, std::make_shared< Scene::SphereCollider >(glm::vec3(0.0f), 0.03f));
+		}
+		//(the level's own ball and hole are far from the field; settle for a while first)
+		for (uint32_t step = 0; step < 600; ++step) play.handle_physics(1.0f / 60.0f);
+		uint32_t sleeping = 0;
+		for (auto const &body : play.bodies) sleeping += body.sleeping;
+		std::cerr << "    " << sleeping << " of " << play.bodies.size() << " bodies asleep after settling" << std::endl;
+
+		benchmark("PlayMode::handle_physics/resting=" + std::to_string(Count), 1, [&](){
+			play.handle_physics(1.0f / 60.0f);
+		});
+	}
+
+	{ //fast balls vs. a thin wall at a low physics rate (continuous collision has to stop every one of them):
+		constexpr uint32_t Count = 64;
+		constexpr float Step = 1.0f / 15.0f;
+		PlayMode play;
+		play.scene.transforms.emplace_back();
+		Scene::Transform *wall = &play.scene.transforms.back();
+		wall->position = glm::vec3(100.0f, 0.0f, 5.0f); //(well away from the level)
+		Scene::CollisionObject &wall_object = play.static_objects.emplace_back(wall, std::make_shared< Scene::BoxCollider >(glm::vec3(-0.01f, -4.0f, -4.0f), glm::vec3(0.01f, 4.0f, 4.0f)));
+		//(continuous collision finds what to sweep against through the scene query, so register everything as init() does)
+		wall_object.query_proxy = play.query.add_collider(wall, wall_object.collider, SceneQuery::Static);
+		std::vector< Scene::Transform * > balls;
+		auto launch = [&]() {
+			for (uint32_t i = 0; i < Count; ++i) {
+				balls[i]->position = glm::vec3(99.0f, float(i % 8) * 0.5f - 2.0f, float(i / 8) * 0.5f + 3.0f);
+				play.bodies.data()[play.bodies.size() - Count + i].velocity = glm::vec3(play.max_hit_velocity * 3.0f, 0.0f, 0.0f);
+			}
+			play.query.update();
+		};
+		for (uint32_t i = 0; i < Count; ++i) {
+			play.scene.transforms.emplace_back();
+			balls.emplace_back(&play.scene.transforms.back());
+			Scene::RigidBody &ball = play.bodies.emplace_back(balls.back(), std::make_shared< Scene::SphereCollider >(glm::vec3(0.0f), 0.03f));
+			ball.query_proxy = play.query.add_collider(balls.back(), ball.collider, SceneQuery::Dynamic);
+		}
+		launch();
+		for (uint32_t step = 0; step < 15; ++step) play.handle_physics(Step);
+		for (auto *ball : balls) {
+			if (ball->position.x > 100.0f) throw std::runtime_error("A fast ball tunneled through a thin wall.");
+		}
+
+		benchmark("PlayMode::handle_physics/fast_balls=" + std::to_string(Count), 1, [&](){
+			launch();
+			play.handle_physics(Step);
+		});
+	}
+
+	{ //triangle mesh colliders, using a bumpy 64x64-quad terrain:
+		constexpr uint32_t Size = 64;
+		auto height = [](uint32_t x, uint32_t y) { return 0.2f * std::sin(0.3f * float(x)) * std::cos(0.2f * float(y)); };
+		std::vector< glm::vec3 > positions;
+		for (uint32_t y = 0; y < Size; ++y) {
+			for (uint32_t x = 0; x < Size; ++x) {
+				glm::vec3 p00(x, y, height(x, y)), p10(x+1, y, height(x+1, y));
+				glm::vec3 p01(x, y+1, height(x, y+1)), p11(x+1, y+1, height(x+1, y+1));
+				positions.insert(positions.end(), {p00, p10, p11, p00, p11, p01});
+			}
+		}
+
+		benchmark("TriangleBVH/build/triangles=" + std::to_string(positions.size() / 3), 1, [&](){
+			TriangleBVH bvh(positions.data(), uint32_t(positions.size()));
+		});
+
+		Scene scene;
+		scene.transforms.emplace_back();
+		Scene::Transform *terrain = &scene.transforms.back();
+		scene.transforms.emplace_back();
+		Scene::Transform *ball = &scene.transforms.back();
+		auto mesh = std::make_shared< Scene::TriangleMeshCollider >(std::make_shared< TriangleBVH >(positions.data(), uint32_t(positions.size())));
+		auto sphere = std::make_shared< Scene::SphereCollider >(glm::vec3(0.0f), 0.1f);
+
+		std::mt19937 mt(0x15466);
+		std::uniform_real_distribution< float > across(0.0f, float(Size));
+		std::vector< glm::vec3 > queries;
+		for (uint32_t i = 0; i < 1000; ++i) queries.emplace_back(across(mt), across(mt), 0.0f);
+
+		uint32_t hits = 0;
+		benchmark("Scene::test_sphere_mesh", uint32_t(queries.size()), [&](){
+			for (auto const &q : queries) {
+				ball->position = q;
+				hits += Scene::test_collision(sphere, ball, mesh, terrain).has_collision;
+			}
+		});
+		if (hits == 0) throw std::runtime_error("Scene::test_sphere_mesh never found a collision with the terrain.");
+	}
+}
+
+static void benchmark_queries() {
+	for (uint32_t count : {256, 4096}) {
+		//a field of static boxes and moving spheres, in a list (so transform pointers stay put):
+		std::list< Scene::Transform > transforms;
+		std::mt19937 mt(0x15466);
+		std::uniform_real_distribution< float > spread(-20.0f, 20.0f);
+		std::uniform_real_distribution< float > unit(-1.0f, 1.0f);
+
+		SceneQuery query;
+		std::vector< Scene::Transform * > moving;
+		for (uint32_t i = 0; i < count; ++i) {
+			transforms.emplace_back();
+			Scene::Transform *transform = &transforms.back();
+			transform->position = glm::vec3(spread(mt), spread(mt), spread(mt));
+			if (i % 4 == 0) {
+				query.add_collider(transform, std::make_shared< Scene::SphereCollider >(glm::vec3(0.0f), 0.3f), SceneQuery::Dynamic);
+				moving.emplace_back(transform);
+			} else {
+				query.add_collider(transform, std::make_shared< Scene::BoxCollider >(glm::vec3(-0.25f), glm::vec3(0.25f)), SceneQuery::Static);
+			}
+		}
+		std::string suffix = "/proxies=" + std::to_string(count);
+
+		constexpr uint32_t Queries = 1000;
+		std::vector< SceneQuery::Ray > rays;
+		std::vector< SceneQuery::Sphere > spheres;
+		for (uint32_t i = 0; i < Queries; ++i) {
+			rays.emplace_back(SceneQuery::Ray{glm::vec3(spread(mt), spread(mt), spread(mt)), glm::vec3(unit(mt), unit(mt), unit(mt)), 40.0f});
+			spheres.emplace_back(SceneQuery::Sphere{glm::vec3(spread(mt), spread(mt), spread(mt)), 1.0f});
+		}
+
+		//compare the tree against testing every proxy:
+		for (auto const &ray : rays) {
+			SceneQuery::RayHit hit, brute;
+			bool found = query.raycast(ray, &hit);
+			for (uint32_t p = 0; p < query.proxies.size(); ++p) {
+				SceneQuery::RayHit h;
+				if (query.raycast_proxy(p, ray, brute.proxy == -1U ? ray.max_t : brute.t, &h)) brute = h;
+			}
+			if (found != (brute.proxy != -1U) || (found && std::abs(hit.t - brute.t) > 1e-4f)) {
+				throw std::runtime_error("SceneQuery::raycast disagrees with brute force.");
+			}
+		}
+
+		benchmark("SceneQuery::raycast" + suffix, Queries, [&](){
+			SceneQuery::RayHit hit;
+			for (auto const &ray : rays) query.raycast(ray, &hit);
+		});
+		std::vector< SceneQuery::RayHit > hits(Queries);
+		benchmark("SceneQuery::raycast/batch" + suffix, Queries, [&](){
+			query.raycast(rays.data(), Queries, hits.data());
+		});
+
+		std::vector< uint32_t > found;
+		benchmark("SceneQuery::overlap_sphere" + suffix, Queries, [&](){
+			for (auto const &sphere : spheres) {
+				found.clear();
+				query.overlap_sphere(sphere, &found);
+			}
+		});
+		std::vector< std::vector< uint32_t > > batch_found(Queries);
+		benchmark("SceneQuery::overlap_sphere/batch" + suffix, Queries, [&](){
+			query.overlap_sphere(spheres.data(), Queries, batch_found.data());
+		});
+
+		//small per-frame movement (mostly absorbed by the fattened leaves):
+		uint32_t frame = 0;
+		benchmark("SceneQuery::update" + suffix, 1, [&](){
+			float step = (frame++ % 2 == 0 ? 0.02f : -0.02f);
+			for (auto *transform : moving) transform->position.x += step;
+			query.update();
+		});
+	}
+}
+
+static void benchmark_attraction() {
+	std::mt19937 mt(0x15466);
+	std::uniform_real_distribution< float > spread(-50.0f, 50.0f);
+	std::uniform_real_distribution< float > strength(0.1f, 2.0f);
+
+	constexpr uint32_t Targets = 4096;
+	std::vector< glm::vec3 > targets;
+	for (uint32_t i = 0; i < Targets; ++i) targets.emplace_back(spread(mt), spread(mt), spread(mt));
+
+	for (uint32_t count : {16, 256, 4096}) {
+		std::vector< Attraction::Source > sources;
+		for (uint32_t i = 0; i < count; ++i) {
+			sources.emplace_back(Attraction::Source{glm::vec3(spread(mt), spread(mt), spread(mt)), strength(mt)});
+		}
+		std::string suffix = "/sources=" + std::to_string(count);
+
+		Attraction attraction;
+		benchmark("Attraction::build" + suffix, 1, [&](){
+			attraction.build(sources.data(), uint32_t(sources.size()));
+		});
+
+		//the octree should stay close to the exact sum:
+		float worst = 0.0f;
+		for (auto const &at : targets) {
+			attraction.exact = false;
+			glm::vec3 approx = attraction.pull(at, 0.0f);
+			attraction.exact = true;
+			glm::vec3 exact = attraction.pull(at, 0.0f);
+			if (exact != glm::vec3(0.0f)) worst = std::max(worst, glm::length(approx - exact) / glm::length(exact));
+		}
+		std::cerr << "    worst relative error vs. exact: " << worst << std::endl;
+		if (worst > 0.1f) throw std::runtime_error("Attraction's octree is too far from the exact pull.");
+
+		for (bool exact : {false, true}) {
+			attraction.exact = exact;
+			glm::vec3 total = glm::vec3(0.0f);
+			benchmark("Attraction::pull" + std::string(exact ? "/exact" : "/octree") + suffix, Targets, [&](){
+				for (auto const &at : targets) total += attraction.pull(at, 0.0f);
+			});
+		}
+	}
+}
+
+static void benchmark_lods() {
+	//cooked meshes come with simplified levels of detail:
+	MeshBuffer meshes(data_path("levels/lvl3.pnci"));
+	Mesh const &mesh = meshes.lookup("Sphere");
+	if (mesh.lods.empty()) throw std::runtime_error("Expected the cooked 'Sphere' mesh to have LODs.");
+
+	auto make_drawable = [&](Scene &scene, glm::vec3 const &position) {
+		scene.transforms.emplace_back();
+		scene.transforms.back().position = position;
+		scene.drawables.emplace_back(&scene.transforms.back());
+		Scene::Drawable::Pipeline &pipeline = scene.drawables.back().pipeline;
+		pipeline.type = mesh.type;
+		pipeline.start = mesh.start;
+		pipeline.count = mesh.count;
+		pipeline.index_type = mesh.index_type;
+		pipeline.shape = scene.add_shape(Scene::Shape::make(mesh));
+	};
+
+	//camera at the origin, looking down -z:
+	Scene::Transform camera_transform;
+	Scene::Camera camera(&camera_transform);
+	camera.aspect = 16.0f / 9.0f;
+	glm::mat4 world_to_clip = camera.make_projection() * glm::mat4(camera_transform.make_world_to_local());
+
+	{ //a field of spheres stretching away from the camera:
+		std::mt19937 mt(0x10d5);
+		std::uniform_real_distribution< float > across(-100.0f, 100.0f);
+		std::uniform_real_distribution< float > away(-400.0f, -2.0f);
+		Scene scene;
+		scene.lod_settings.viewport_height = 1080.0f;
+		for (uint32_t i = 0; i < 10000; ++i) {
+			make_drawable(scene, glm::vec3(across(mt), across(mt), away(mt)));
+		}
+
+		Scene::Snapshot snapshot;
+		for (bool enabled : {false, true}) {
+			scene.lod_settings.enabled = enabled;
+			benchmark(std::string("Scene::snapshot/lods=") + (enabled ? "on" : "off") + "/drawables=10000", 1, [&](){
+				scene.snapshot(&snapshot, world_to_clip);
+			});
+			std::cerr << "    triangles: " << scene.lod_stats.triangles << " of " << scene.lod_stats.full_triangles << std::endl;
+		}
+	}
+
+	{ //a sphere moving back and forth across the distance where its first LOD kicks in shouldn't keep switching:
+		Scene scene;
+		scene.lod_settings.viewport_height = 1080.0f;
+		make_drawable(scene, glm::vec3(0.0f));
+		Scene::Transform &transform = scene.transforms.back();
+
+		//(distance from the near side of the bounds at which LOD 1's error is exactly max_error pixels)
+		float pixels_per_unit = 0.5f * scene.lod_settings.viewport_height / std::tan(0.5f * camera.fovy);
+		float radius = scene.shapes.at(scene.drawables.back().pipeline.shape).bounds.w;
+		float boundary = pixels_per_unit * mesh.lods[0].error / scene.lod_settings.max_error;
+
+		for (float hysteresis : {0.0f, 0.25f}) {
+			scene.lod_settings.hysteresis = hysteresis;
+			Scene::Snapshot snapshot;
+			uint32_t switches = 0;
+			for (uint32_t frame = 0; frame < 100; ++frame) {
+				transform.position.z = -(boundary * (frame % 2 ? 1.1f : 0.9f) + radius);
+				scene.snapshot(&snapshot, world_to_clip);
+				if (frame > 0) switches += scene.lod_stats.switches;
+			}
+			std::cerr << "    LOD switches over 100 frames (hysteresis " << hysteresis << "): " << switches << std::endl;
+			if (hysteresis > 0.1f && switches > 1) throw std::runtime_error("LOD hysteresis didn't prevent popping.");
+		}
+	}
+}
+
+static void benchmark_draw_scene() {
+	//every drawable shares a material and vertex array, so the state cache should filter most binds:
+	MeshBuffer meshes(data_path("levels/lvl3.pnci"));
+	Mesh const &mesh = meshes.lookup("Sphere");
+	GLuint vao = meshes.make_vao_for_program(lit_color_texture_program->program);
+
+	std::cerr << "    sizeof(Scene::Drawable): " << sizeof(Scene::Drawable) << ", sizeof(Scene::Snapshot::Item): " << sizeof(Scene::Snapshot::Item) << std::endl;
+
+	Scene::Transform camera_transform;
+	Scene::Camera camera(&camera_transform);
+	FrameUniforms frame;
+	frame.WORLD_TO_CLIP = camera.make_projection() * glm::mat4(camera_transform.make_world_to_local());
+	set_frame_uniforms(frame);
+
+	for (uint32_t count : {1000, 10000, 50000}) {
+		std::string suffix = "/drawables=" + std::to_string(count);
+
+		Scene scene;
+		std::mt19937 mt(0x91a5);
+		std::uniform_real_distribution< float > across(-20.0f, 20.0f);
+		uint32_t material = scene.add_material(lit_color_texture_program_material);
+		for (uint32_t i = 0; i < count; ++i) {
+			scene.transforms.emplace_back();
+			scene.transforms.back().position = glm::vec3(across(mt), across(mt), across(mt) - 50.0f);
+			scene.drawables.emplace_back(&scene.transforms.back());
+			Scene::Drawable::Pipeline &pipeline = scene.drawables.back().pipeline;
+			pipeline.material = material;
+			pipeline.vao = vao;
+			pipeline.type = mesh.type;
+			pipeline.start = mesh.start;
+			pipeline.count = mesh.count;
+			pipeline.index_type = mesh.index_type;
+		}
+		if (scene.materials.size() != 1) throw std::runtime_error("Expected identical materials to be shared.");
+
+		//just the walk over per-drawable draw state (what draw() touches for every drawable, besides transforms):
+		benchmark("draw list traversal" + suffix, count, [&](){
+			uint32_t changes = 0;
+			uint32_t current_material = -1U;
+			GLuint current_vao = 0;
+			uint64_t indices = 0;
+			for (auto const &drawable : scene.drawables) {
+				Scene::Drawable::Pipeline const &pipeline = drawable.pipeline;
+				if (pipeline.material != current_material || pipeline.vao != current_vao) {
+					changes += 1;
+					current_material = pipeline.material;
+					current_vao = pipeline.vao;
+				}
+				indices += pipeline.count;
+			}
+			if (changes != 1 || indices != uint64_t(count) * mesh.count) throw std::runtime_error("Unexpected draw list traversal result.");
+		});
+
+		glEnable(GL_DEPTH_TEST);
+		benchmark("Scene::draw" + suffix, 1, [&](){
+			scene.draw(camera);
+			glFinish();
+		});
+		glDisable(GL_DEPTH_TEST);
+
+		//count the calls that one draw makes:
+		gl_state_next_frame();
+		scene.draw(camera);
+		gl_state_next_frame();
+		std::cerr << "    state changes" << suffix << ": " << gl_state_last_frame.issued << " issued, " << gl_state_last_frame.filtered << " filtered" << std::endl;
+		if (gl_state_last_frame.filtered < scene.drawables.size()) throw std::runtime_error("Expected the GL state cache to filter redundant binds.");
+	}
+
+	glDeleteVertexArrays(1, &vao);
+	glDeleteBuffers(1, &meshes.buffer);
+	glDeleteBuffers(1, &meshes.index_buffer);
+}
+
+static void benchmark_static_geometry() {
+	for (auto const &level : level_names) {
+		MeshBuffer meshes(data_path("levels/" + level + ".pnci"));
+		GLuint vao = meshes.make_vao_for_program(lit_color_texture_program->program);
+		Scene scene(data_path("levels/" + level + ".scene"), [&](Scene &s, Scene::Transform *transform, std::string const &mesh_name){
+			Mesh const &mesh = meshes.lookup(mesh_name);
+			Scene::Drawable &drawable = s.drawables.emplace_back(transform);
+			drawable.pipeline.material = s.add_material(lit_color_texture_program_material);
+			drawable.pipeline.vao = vao;
+			drawable.pipeline.type = mesh.type;
+			drawable.pipeline.start = mesh.start;
+			drawable.pipeline.count = mesh.count;
+			drawable.pipeline.index_type = mesh.index_type;
+		});
+
+		if (scene.cameras.empty()) throw std::runtime_error("Expected a camera in '" + level + ".scene'.");
+		Scene::Camera const &camera = scene.cameras.front();
+		FrameUniforms frame;
+		frame.WORLD_TO_CLIP = camera.make_projection() * glm::mat4(camera.transform->make_world_to_local());
+		set_frame_uniforms(frame);
+
+		glEnable(GL_DEPTH_TEST);
+		benchmark("Scene::draw/" + level + "/unbaked", 1, [&](){
+			scene.draw(camera);
+			glFinish();
+		});
+
+		Scene baked;
+		MeshBuffer *buffer = nullptr;
+		auto free_baked = [&](){
+			if (!buffer) return;
+			for (auto const &drawable : baked.drawables) {
+				if (drawable.transform->name == StaticGeometryTransform) glDeleteVertexArrays(1, &drawable.pipeline.vao);
+			}
+			glDeleteBuffers(1, &buffer->buffer);
+			glDeleteBuffers(1, &buffer->index_buffer);
+			delete buffer;
+			buffer = nullptr;
+		};
+		benchmark("bake_static_geometry/" + level, 1, [&](){
+			free_baked();
+			baked.set(scene);
+			buffer = bake_static_geometry(baked, meshes, PlayMode::is_static);
+		});
+
+		benchmark("Scene::draw/" + level + "/baked", 1, [&](){
+			baked.draw(baked.cameras.front());
+			glFinish();
+		});
+		glDisable(GL_DEPTH_TEST);
+
+		std::cerr << "    drawables: " << scene.drawables.size() << " unbaked, " << baked.drawables.size() << " baked" << std::endl;
+		if (baked.drawables.size() > scene.drawables.size()) throw std::runtime_error("Baking static geometry added drawables.");
+
+		free_baked();
+		glDeleteVertexArrays(1, &vao);
+		glDeleteBuffers(1, &meshes.buffer);
+		glDeleteBuffers(1, &meshes.index_buffer);
+	}
+}
+
+static void benchmark_texture_arrays() {
+	//some small textures (different sizes, so the shelves get some use):
+	std::vector< std::pair< glm::uvec2, std::vector< glm::u8vec4 > > > textures;
+	std::mt19937 mt(0x7e47);
+	for (uint32_t i = 0; i < 16; ++i) {
+		glm::uvec2 size(32u << (mt() % 3), 32u << (mt() % 3));
+		textures.emplace_back(size, std::vector< glm::u8vec4 >(size.x * size.y, glm::u8vec4(mt() & 0xff, mt() & 0xff, mt() & 0xff, 0xff)));
+	}
+
+	benchmark("TextureArrays::add/textures=16", 16, [&](){
+		TextureArrays arrays;
+		for (auto const &texture : textures) arrays.add(texture.first, texture.second);
+	});
+
+	//one material per texture, drawn interleaved (so consecutive drawables never share a material):
+	TextureArrays arrays;
+	MeshBuffer meshes(data_path("levels/lvl3.pnci"));
+	Mesh const &mesh = meshes.lookup("Sphere");
+	GLuint vao = meshes.make_vao_for_program(lit_color_texture_program->program);
+
+	Scene scene;
+	std::vector< uint32_t > materials;
+	for (auto const &texture : textures) {
+		TextureArrays::Slot slot = arrays.add(texture.first, texture.second);
+		Scene::Material material = lit_color_texture_program_material;
+		material.textures[0].texture = slot.texture;
+		material.texture_layer = slot.layer;
+		material.texture_rect = slot.rect;
+		materials.emplace_back(scene.add_material(material));
+	}
+	if (arrays.arrays.size() != 1) throw std::runtime_error("Expected 16 small textures to fit in one texture array.");
+
+	std::uniform_real_distribution< float > across(-20.0f, 20.0f);
+	for (uint32_t i = 0; i < 1000; ++i) {
+		scene.transforms.emplace_back();
+		scene.transforms.back().position = glm::vec3(across(mt), across(mt), across(mt) - 50.0f);
+		Scene::Drawable::Pipeline &pipeline = scene.drawables.emplace_back(&scene.transforms.back()).pipeline;
+		pipeline.material = materials[i % materials.size()];
+		pipeline.vao = vao;
+		pipeline.type = mesh.type;
+		pipeline.start = mesh.start;
+		pipeline.count = mesh.count;
+		pipeline.index_type = mesh.index_type;
+	}
+
+	Scene::Transform camera_transform;
+	Scene::Camera camera(&camera_transform);
+	FrameUniforms frame;
+	frame.WORLD_TO_CLIP = camera.make_projection() * glm::mat4(camera_transform.make_world_to_local());
+	set_frame_uniforms(frame);
+
+	glEnable(GL_DEPTH_TEST);
+	benchmark("Scene::draw/materials=16/texture_arrays", 1, [&](){
+		scene.draw(camera);
+		glFinish();
+	});
+	glDisable(GL_DEPTH_TEST);
+
+	gl_state_next_frame();
+	scene.draw(camera);
+	gl_state_next_frame();
+	std::cerr << "    state changes: " << gl_state_last_frame.issued << " issued, " << gl_state_last_frame.filtered << " filtered" << std::endl;
+	//(every material binds the same array, so only the first bind of each frame -- and the un-bind after -- should get through)
+	if (gl_state_last_frame.issued > 32) throw std::runtime_error("Expected materials sharing a texture array not to re-bind textures.");
+
+	glDeleteVertexArrays(1, &vao);
+	glDeleteBuffers(1, &meshes.buffer);
+	glDeleteBuffers(1, &meshes.index_buffer);
+}
+
+static void benchmark_cooked_textures() {
+	//a noisy 512x512 image (so the .png doesn't compress to nothing), written out both ways:
+	glm::uvec2 size(TextureArrays::LayerSize);
+	std::vector< glm::u8vec4 > data(size.x * size.y);
+	std::mt19937 mt(0x7e40);
+	for (auto &texel : data) texel = glm::u8vec4(mt() & 0xff, mt() & 0xff, mt() & 0xff, 0xff);
+
+	std::string png_file = data_path("benchmark-texture.png");
+	std::string tex_file = data_path("benchmark-texture.tex");
+	save_png(png_file, size, data.data(), LowerLeftOrigin);
+	{
+		std::ofstream out(tex_file, std::ios::binary);
+		CookedTexture::make(size, data).save(out);
+	}
+
+	benchmark("texture load/png+mipmaps/512x512", 1, [&](){
+		glm::uvec2 png_size;
+		std::vector< glm::u8vec4 > png_data;
+		load_png(png_file, &png_size, &png_data, LowerLeftOrigin);
+		CookedTexture texture = CookedTexture::make(png_size, png_data);
+	});
+
+	benchmark("texture load/cooked/512x512", 1, [&](){
+		CookedTexture texture(tex_file);
+	});
+
+	//...and all the way into a texture array:
+	benchmark("TextureArrays::load_png/512x512", 1, [&](){
+		TextureArrays arrays;
+		arrays.load_png(png_file);
+		glFinish();
+	});
+
+	benchmark("TextureArrays::load_cooked/512x512", 1, [&](){
+		TextureArrays arrays;
+		arrays.load_cooked(tex_file);
+		glFinish();
+	});
+
+	std::remove(png_file.c_str());
+	std::remove(tex_file.c_str());
+}
+
+static void benchmark_png_decoding() {
+	std::vector< std::string > filenames;
+	std::string scratch;
+	if (!images_dir.empty()) {
+		for (auto const &entry : std::filesystem::directory_iterator(images_dir)) {
+			if (entry.path().extension() == ".png") filenames.emplace_back(entry.path().string());
+		}
+		std::sort(filenames.begin(), filenames.end());
+		if (filenames.empty()) throw std::runtime_error("No .png files in '" + images_dir + "'.");
+	} else {
+		//smooth gradients with some noise (so they compress somewhat, like real textures), in a few sizes:
+		scratch = data_path("benchmark-images");
+		std::filesystem::create_directories(scratch);
+		std::mt19937 mt(0x9e6);
+		for (uint32_t i = 0; i < 32; ++i) {
+			glm::uvec2 size(128u << (i % 3), 128u << ((i / 3) % 3));
+			std::vector< glm::u8vec4 > data(size.x * size.y);
+			for (uint32_t y = 0; y < size.y; ++y) {
+				for (uint32_t x = 0; x < size.x; ++x) {
+					data[y * size.x + x] = glm::u8vec4((x * 255) / size.x, (y * 255) / size.y, mt() & 0x1f, 0xff);
+				}
+			}
+			filenames.emplace_back(scratch + "/image-" + std::to_string(i) + ".png");
+			save_png(filenames.back(), size, data.data(), LowerLeftOrigin);
+		}
+	}
+
+	uint64_t bytes = 0, texels = 0;
+	for (auto const &filename : filenames) bytes += std::filesystem::file_size(filename);
+	for (auto const &image : load_pngs(filenames, LowerLeftOrigin)) texels += image.data.size();
+	std::cerr << "  (" << filenames.size() << " images, " << bytes / 1024 << " kB compressed, " << texels * 4 / (1024 * 1024) << " MB decoded)" << std::endl;
+
+	std::string suffix = "/images=" + std::to_string(filenames.size());
+	uint32_t batch = uint32_t(filenames.size());
+
+	benchmark("load_png/serial" + suffix, batch, [&](){
+		for (auto const &filename : filenames) {
+			glm::uvec2 size;
+			std::vector< glm::u8vec4 > data;
+			load_png(filename, &size, &data, LowerLeftOrigin);
+		}
+	});
+
+	benchmark("load_pngs/workers=" + std::to_string(JobSystem::get().worker_count()) + suffix, batch, [&](){
+		std::vector< PNGImage > images = load_pngs(filenames, LowerLeftOrigin);
+	});
+
+	//into one shared buffer (no per-image allocations at all after the first call):
+	std::vector< size_t > offsets(filenames.size() + 1, 0);
+	{
+		std::vector< PNGImage > images = load_pngs(filenames, LowerLeftOrigin);
+		for (uint32_t i = 0; i < images.size(); ++i) offsets[i+1] = offsets[i] + images[i].data.size();
+	}
+	std::vector< glm::u8vec4 > buffer(offsets.back());
+	benchmark("load_pngs/one buffer" + suffix, batch, [&](){
+		load_pngs(filenames, LowerLeftOrigin, [&](uint32_t index, glm::uvec2 size) -> glm::u8vec4 * {
+			if (offsets[index] + size_t(size.x) * size.y != offsets[index+1]) return nullptr;
+			return buffer.data() + offsets[index];
+		});
+	});
+
+	//...and all the way into texture arrays (only images that get a whole layer or can be packed with a gutter):
+	std::vector< std::string > fits;
+	{
+		std::vector< PNGImage > images = load_pngs(filenames, LowerLeftOrigin);
+		for (uint32_t i = 0; i < images.size(); ++i) {
+			glm::uvec2 size = images[i].size;
+			bool whole = (size.x == TextureArrays::LayerSize && size.y == TextureArrays::LayerSize);
+			bool packed = (size.x + 2 * TextureArrays::Gutter <= TextureArrays::LayerSize && size.y + 2 * TextureArrays::Gutter <= TextureArrays::LayerSize);
+			if (whole || packed) fits.emplace_back(filenames[i]);
+		}
+	}
+	benchmark("TextureArrays::load_png/serial/images=" + std::to_string(fits.size()), uint32_t(fits.size()), [&](){
+		TextureArrays arrays;
+		for (auto const &filename : fits) arrays.load_png(filename);
+		glFinish();
+	});
+	benchmark("TextureArrays::load_pngs/images=" + std::to_string(fits.size()), uint32_t(fits.size()), [&](){
+		TextureArrays arrays;
+		arrays.load_pngs(fits);
+		glFinish();
+	});
+
+	if (!scratch.empty()) std::filesystem::remove_all(scratch);
+}
+
+static void benchmark_dynamic_resolution() {
+	//controller: a scene costing 30ms at full resolution should settle near sqrt(12/30) of it...
+	DynamicResolution resolution;
+	float full_cost = 30.0f;
+	for (uint32_t frame = 0; frame < 60; ++frame) {
+		resolution.update_scale(full_cost * resolution.scale * resolution.scale, resolution.scale);
+	}
+	float settled = resolution.scale;
+	float expected = std::sqrt(resolution.target_ms / full_cost);
+	//...and climb back to full resolution once the scene gets cheap:
+	full_cost = 6.0f;
+	uint32_t frames_to_recover = 0;
+	while (resolution.scale < resolution.max_scale && frames_to_recover < 1000) {
+		resolution.update_scale(full_cost * resolution.scale * resolution.scale, resolution.scale);
+		++frames_to_recover;
+	}
+	std::cerr << "  DynamicResolution settled at " << settled << " (expected " << expected << "), back to full resolution in " << frames_to_recover << " frames" << std::endl;
+	if (std::abs(settled - expected) > 0.05f) throw std::runtime_error("DynamicResolution didn't settle near the scale that meets its target.");
+	if (frames_to_recover >= 1000) throw std::runtime_error("DynamicResolution didn't return to full resolution.");
+
+	//drawing at fixed scales (at the benchmark window's size):
+	GLint viewport[4];
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	glm::uvec2 drawable_size(viewport[2], viewport[3]);
+
+	MeshBuffer meshes(data_path("levels/lvl3.pnci"));
+	GLuint vao = meshes.make_vao_for_program(lit_color_texture_program->program);
+	Scene scene(data_path("levels/lvl3.scene"), [&](Scene &s, Scene::Transform *transform, std::string const &mesh_name){
+		Mesh const &mesh = meshes.lookup(mesh_name);
+		Scene::Drawable &drawable = s.drawables.emplace_back(transform);
+		drawable.pipeline.material = s.add_material(lit_color_texture_program_material);
+		drawable.pipeline.vao = vao;
+		drawable.pipeline.type = mesh.type;
+		drawable.pipeline.start = mesh.start;
+		drawable.pipeline.count = mesh.count;
+		drawable.pipeline.index_type = mesh.index_type;
+	});
+	if (scene.cameras.empty()) throw std::runtime_error("Expected a camera in 'lvl3.scene'.");
+	Scene::Camera const &camera = scene.cameras.front();
+	FrameUniforms frame;
+	frame.WORLD_TO_CLIP = camera.make_projection() * glm::mat4(camera.transform->make_world_to_local());
+	set_frame_uniforms(frame);
+
+	DynamicResolution fixed;
+	fixed.enabled = false;
+	for (float scale : { 1.0f, 0.75f, 0.5f }) {
+		fixed.scale = scale;
+		benchmark("DynamicResolution/lvl3/scale=" + std::to_string(int32_t(scale * 100.0f)) + "%", 1, [&](){
+			fixed.begin(drawable_size);
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			glEnable(GL_DEPTH_TEST);
+			scene.draw(camera);
+			glDisable(GL_DEPTH_TEST);
+			fixed.end(drawable_size);
+			glFinish();
+		});
+		std::cerr << "    GPU time: " << fixed.gpu_ms << " ms" << std::endl;
+	}
+
+	glDeleteVertexArrays(1, &vao);
+	glDeleteBuffers(1, &meshes.buffer);
+	glDeleteBuffers(1, &meshes.index_buffer);
+}
+
+static void benchmark_opaque_order() {
+	GLuint query = 0;
+	glGenQueries(1, &query);
+
+	//time each mode and count the fragments it shades:
+	static std::array< std::string, 3 > const mode_names{ "unordered", "front-to-back", "prepass" };
+	auto measure = [&](Scene &scene, std::string const &name) {
+		Scene::Camera const &camera = scene.cameras.front();
+		FrameUniforms frame;
+		frame.WORLD_TO_CLIP = camera.make_projection() * glm::mat4(camera.transform->make_world_to_local());
+		set_frame_uniforms(frame);
+
+		std::array< GLuint64, 3 > samples;
+		glEnable(GL_DEPTH_TEST);
+		for (uint32_t m = 0; m < mode_names.size(); ++m) {
+			scene.opaque_settings = Scene::OpaqueSettings();
+			scene.opaque_settings.mode = Scene::OpaqueMode(m);
+			benchmark("Scene::draw/" + name + "/" + mode_names[m], 1, [&](){
+				glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+				scene.draw(camera);
+				glFinish();
+			});
+
+			//count shaded fragments:
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			scene.opaque_settings.samples_query = query;
+			scene.draw(camera);
+			glGetQueryObjectui64v(query, GL_QUERY_RESULT, &samples[m]);
+			FrameArena::current().reset();
+		}
+		glDisable(GL_DEPTH_TEST);
+
+		std::cerr << "    shaded samples (" << scene.drawables.size() << " drawables): " << samples[0] << " unordered, " << samples[1] << " front-to-back, " << samples[2] << " prepass" << std::endl;
+		if (samples[2] > samples[0] || samples[2] > samples[1]) throw std::runtime_error("Depth pre-pass shaded more fragments than drawing without one.");
+		return samples;
+	};
+
+	//(levels are also measured baked, as the game draws them -- see StaticGeometry.hpp -- since that's what front-to-back has to sort)
+	bool baked_sorting_mattered = false;
+	for (auto const &level : level_names) {
+		MeshBuffer meshes(data_path("levels/" + level + ".pnci"));
+		GLuint vao = meshes.make_vao_for_program(lit_color_texture_program->program);
+		Scene scene(data_path("levels/" + level + ".scene"), [&](Scene &s, Scene::Transform *transform, std::string const &mesh_name){
+			Mesh const &mesh = meshes.lookup(mesh_name);
+			Scene::Drawable &drawable = s.drawables.emplace_back(transform);
+			drawable.pipeline.material = s.add_material(lit_color_texture_program_material);
+			drawable.pipeline.vao = vao;
+			drawable.pipeline.type = mesh.type;
+			drawable.pipeline.start = mesh.start;
+			drawable.pipeline.count = mesh.count;
+			drawable.pipeline.index_type = mesh.index_type;
+			drawable.pipeline.shape = s.add_shape(Scene::Shape::make(mesh));
+		});
+		if (scene.cameras.empty()) throw std::runtime_error("Expected a camera in '" + level + ".scene'.");
+
+		measure(scene, level);
+
+		Scene baked;
+		baked.set(scene);
+		MeshBuffer *buffer = bake_static_geometry(baked, meshes, PlayMode::is_static);
+		std::array< GLuint64, 3 > samples = measure(baked, level + "/baked");
+		if (samples[1] != samples[0]) baked_sorting_mattered = true;
+
+		if (buffer) {
+			for (auto const &drawable : baked.drawables) {
+				if (drawable.transform->name == StaticGeometryTransform) glDeleteVertexArrays(1, &drawable.pipeline.vao);
+			}
+			glDeleteBuffers(1, &buffer->buffer);
+			glDeleteBuffers(1, &buffer->index_buffer);
+			delete buffer;
+		}
+		glDeleteVertexArrays(1, &vao);
+		glDeleteBuffers(1, &meshes.buffer);
+		glDeleteBuffers(1, &meshes.index_buffer);
+	}
+	if (!baked_sorting_mattered) throw std::runtime_error("Front-to-back drawing shaded the same fragments as unordered drawing on every baked level.");
+
+	glDeleteQueries(1, &query);
+}
+
+static void benchmark_draw_lines() {
+	std::string const text = "Mouse + WASD to move, LSHIFT to run. Look down + hold LMB to swing. R to reset level.";
+	constexpr float H = 0.09f;
+
+	{ //text to line vertices:
+		constexpr uint32_t Batch = 100;
+		benchmark("DrawLines::draw_text/hud", Batch, [&](){
+			//(DrawLines lives in the frame arena, so it can't outlive one benchmark call)
+			DrawLines lines(glm::mat4(1.0f));
+			for (uint32_t i = 0; i < Batch; ++i) {
+				lines.attribs.clear();
+				lines.draw_text(text, glm::vec3(-1.0f, -1.0f, 0.0f), glm::vec3(H, 0.0f, 0.0f), glm::vec3(0.0f, H, 0.0f), glm::u8vec4(0xff));
+			}
+			lines.attribs.clear(); //nothing to upload
+		});
+	}
+
+	//full HUD overlay, including upload + draw submission:
+	benchmark("DrawLines/hud_overlay", 1, [&](){
+		DrawLines lines(glm::mat4(1.0f));
+		lines.draw_text(text, glm::vec3(-1.0f, -1.0f, 0.0f), glm::vec3(H, 0.0f, 0.0f), glm::vec3(0.0f, H, 0.0f), glm::u8vec4(0x00));
+		lines.draw_text(text, glm::vec3(-1.0f, -1.0f, 0.0f), glm::vec3(H, 0.0f, 0.0f), glm::vec3(0.0f, H, 0.0f), glm::u8vec4(0xff));
+	});
+	glFinish();
+}
+
+static void benchmark_jobs() {
+	//worker counts 0 (everything runs on the calling thread), 1, 2, 4, ... up to the default:
+	std::vector< uint32_t > worker_counts{0};
+	for (uint32_t w = 1; w < JobSystem::default_worker_count(); w *= 2) worker_counts.emplace_back(w);
+	if (JobSystem::default_worker_count() > 0) worker_counts.emplace_back(JobSystem::default_worker_count());
+
+	//some per-element work that is heavy enough to be worth splitting up:
+	auto work = [](uint32_t i) {
+		float x = float(i);
+		for (uint32_t iter = 0; iter < 32; ++iter) x = std::sqrt(x * x + 1.0f);
+		return x;
+	};
+
+	constexpr uint32_t Count = 1 << 16;
+	std::vector< float > expected(Count);
+	for (uint32_t i = 0; i < Count; ++i) expected[i] = work(i);
+
+	for (uint32_t workers : worker_counts) {
+		JobSystem jobs(workers);
+		std::string suffix = "/workers=" + std::to_string(workers);
+
+		std::vector< float > out(Count);
+		benchmark("JobSystem::parallel_for" + suffix, Count, [&](){
+			jobs.parallel_for(0, Count, 256, [&](uint32_t begin, uint32_t end) {
+				for (uint32_t i = begin; i < end; ++i) out[i] = work(i);
+			});
+		});
+		if (out != expected) throw std::runtime_error("JobSystem::parallel_for produced wrong results with " + std::to_string(workers) + " workers.");
+
+		//(once warmed up by the benchmark, parallel_for shouldn't allocate -- physics, LOD picking, and queries rely on it)
+		if (FrameArena::CountsHeapAllocations) {
+			uint64_t before = FrameArena::heap_allocations();
+			jobs.parallel_for(0, Count, 256, [&](uint32_t begin, uint32_t end) {
+				for (uint32_t i = begin; i < end; ++i) out[i] = work(i);
+			});
+			uint64_t allocations = FrameArena::heap_allocations() - before;
+			if (allocations) throw std::runtime_error("JobSystem::parallel_for made " + std::to_string(allocations) + " heap allocations with " + std::to_string(workers) + " workers.");
+		}
+
+		//fan-out / fan-in graph: each middle task depends on 'start', 'finish' depends on all of them:
+		constexpr uint32_t Width = 64;
+		std::atomic< uint32_t > started{0}, middle{0};
+		std::atomic< bool > ordered{true};
+		benchmark("JobSystem::run/graph" + suffix, Width + 2, [&](){
+			started = 0;
+			middle = 0;
+			auto start = jobs.run([&](){ started += 1; });
+			std::vector< JobSystem::TaskHandle > tasks;
+			tasks.reserve(Width);
+			for (uint32_t i = 0; i < Width; ++i) {
+				tasks.emplace_back(jobs.run([&](){
+					if (started != 1) ordered = false;
+					middle += 1;
+				}, {start}));
+			}
+			auto finish = jobs.run([&](){
+				if (middle != Width) ordered = false;
+			}, tasks);
+			jobs.wait(finish);
+		});
+		if (!ordered) throw std::runtime_error("JobSystem ran a task before its dependencies with " + std::to_string(workers) + " workers.");
+
+		auto stats = jobs.stats();
+		std::cerr << "    utilization:";
+		for (auto const &s : stats) {
+			std::cerr << " " << uint32_t(s.utilization() * 100.0f) << "% (" << s.tasks << " tasks, " << s.steals << " steals)";
+		}
+		std::cerr << std::endl;
+	}
+}
+
+//------------ main ------------
+
+int main(int argc, char **argv) {
+#ifdef _WIN32
+	//when compiled on windows, unhandled exceptions don't have their message printed, which can make debugging simple issues difficult.
+	try {
+#endif
+
+	std::string out_file;
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		if (arg == "--filter" && i + 1 < argc) {
+			filter = argv[++i];
+		} else if (arg == "--out" && i + 1 < argc) {
+			out_file = argv[++i];
+		} else if (arg == "--images" && i + 1 < argc) {
+			images_dir = argv[++i];
+		} else {
+			std::cerr << "Usage:\n\t" << argv[0] << " [--filter substring] [--out results.csv] [--images directory]" << std::endl;
+			return 1;
+		}
+	}
+
+	//------------  initialization ------------
+	//(loaders and DrawLines need a GL context, so make a hidden window to hold one)
+
+	SDL_Init(SDL_INIT_VIDEO);
+
+	SDL_GL_ResetAttributes();
+	SDL_GL_SetAttribute(SDL_GL_DEPTH_SIZE, 24);
+	SDL_GL_SetAttribute(SDL_GL_DOUBLEBUFFER, 1);
+	SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
+	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
+	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
+
+	SDL_Window *window = SDL_CreateWindow(
+		"benchmarks",
+		SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED,
+		256, 256,
+		SDL_WINDOW_OPENGL | SDL_WINDOW_HIDDEN
+	);
+
+	if (!window) {
+		std::cerr << "Error creating SDL window: " << SDL_GetError() << std::endl;
+		return 1;
+	}
+
+	SDL_GLContext context = SDL_GL_CreateContext(window);
+
+	if (!context) {
+		SDL_DestroyWindow(window);
+		std::cerr << "Error creating OpenGL context: " << SDL_GetError() << std::endl;
+		return 1;
+	}
+
+	init_GL();
+
+	//report GL errors through the driver's debug output, when it has it:
+	gl_debug_output_init();
+
+	call_load_functions();
+
+	//------------ run benchmarks ------------
+
+	std::cerr << "Running benchmarks:" << std::endl;
+	benchmark_loading();
+	benchmark_hierarchy();
+	benchmark_physics();
+	benchmark_queries();
+	benchmark_attraction();
+	benchmark_lods();
+	benchmark_static_geometry();
+	benchmark_draw_scene();
+	benchmark_texture_arrays();
+	benchmark_cooked_textures();
+	benchmark_png_decoding();
+	benchmark_dynamic_resolution();
+	benchmark_opaque_order();
+	benchmark_draw_lines();
+	benchmark_jobs();
+
+	if (out_file != "") {
+		std::ofstream out(out_file);
+		write_results(out);
+		std::cerr << "Wrote " << results.size() << " results to '" << out_file << "'." << std::endl;
+	} else {
+		write_results(std::cout);
+	}
+
+	//------------  teardown ------------
+
+	SDL_GL_DeleteContext(context);
+	context = 0;
+
+	SDL_DestroyWindow(window);
+	window = NULL;
+
+	return 0;
+
+#ifdef _WIN32
+	} catch (std::exception const &e) {
+		std::cerr << "Unhandled exception:\n" << e.what() << std::endl;
+		return 1;
+	} catch (...) {
+		std::cerr << "Unhandled exception (unknown type)." << std::endl;
+		throw;
+	}
+#endif
+}
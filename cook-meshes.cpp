@@ -0,0 +1,359 @@
+/*
+ * cook-meshes converts an exported .pnct (non-indexed triangle lists, in whatever order
+ *  Blender produced them) into an indexed, optimized .pnci that MeshBuffer can load:
+ *
+ *   $ scenes/cook-meshes dist/levels/lvl0.pnct dist/levels/lvl0.pnci
+ *
+ * Per mesh, it:
+ *  - merges identical vertices and builds an index buffer,
+ *  - orders triangles for the post-transform vertex cache (Forsyth),
+ *  - orders cache-friendly clusters of triangles outside-in to reduce overdraw,
+ *  - renumbers vertices by first use,
+ *  - builds up to three simplified levels of detail (each about half the triangles of the last),
+ * and prints vertex cache statistics (ACMR / ATVR) before and after, and the triangle counts of each LOD.
+ *
+ * .pnci layout (chunks as in read_write_chunk.hpp):
+ *  "pnct" -- vertices (same 36-byte format as .pnct)
+ *  "i032" -- uint32 indices (each mesh's indices are absolute, into the whole vertex chunk)
+ *  "str0" -- mesh names
+ *  "idx1" -- { name_begin, name_end, index_begin, index_end } per mesh
+ *  "lod0" -- { mesh, index_begin, index_end, error } per simplified level, coarser levels later
+ *            (mesh is the position in "idx1"; error is how far the surface moved, in mesh units)
+ */
+
+#include "MeshOptimize.hpp"
+#include "TriangleBVH.hpp"
+#include "read_write_chunk.hpp"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct Vertex {
+	glm::vec3 Position;
+	glm::vec3 Normal;
+	glm::u8vec4 Color;
+	glm::vec2 TexCoord;
+};
+static_assert(sizeof(Vertex) == 3*4+3*4+4*1+2*4, "Vertex is packed.");
+
+//vertices are merged only if they are bit-for-bit identical:
+struct VertexBits {
+	size_t operator()(Vertex const &v) const {
+		//(FNV-1a over the bytes)
+		unsigned char const *bytes = reinterpret_cast< unsigned char const * >(&v);
+		size_t hash = 14695981039346656037ULL;
+		for (size_t i = 0; i < sizeof(Vertex); ++i) {
+			hash = (hash ^ bytes[i]) * 1099511628211ULL;
+		}
+		return hash;
+	}
+	bool operator()(Vertex const &a, Vertex const &b) const {
+		return std::memcmp(&a, &b, sizeof(Vertex)) == 0;
+	}
+};
+
+//level of detail parameters:
+static constexpr uint32_t MaxLODs = 3;
+static constexpr float LODMaxError = 0.25f; //(as a fraction of the mesh's bounding radius)
+static constexpr float LODMinReduction = 0.8f; //levels with more than this fraction of the previous level's triangles are dropped
+
+//order an indexed triangle list for the vertex cache, then for overdraw, then renumber its vertices by first use:
+static void optimize(std::vector< Vertex > *vertices, std::vector< uint32_t > *indices) {
+	uint32_t vertex_count = uint32_t(vertices->size());
+	std::vector< glm::vec3 > positions;
+	positions.reserve(vertices->size());
+	for (auto const &v : *vertices) positions.emplace_back(v.Position);
+
+	optimize_vertex_cache(indices, vertex_count);
+	optimize_overdraw(indices, positions);
+	std::vector< uint32_t > order = optimize_vertex_fetch(indices, vertex_count);
+
+	std::vector< Vertex > reordered;
+	reordered.reserve(order.size());
+	for (uint32_t o : order) reordered.emplace_back((*vertices)[o]);
+	*vertices = std::move(reordered);
+}
+
+//largest distance from the corners and centers of triangles in 'from' to the surface made by the triangles in 'to'
+// (simplify() only estimates its error, so the cooked LODs record this, measured both ways, instead):
+static float max_distance(TriangleBVH const &from, TriangleBVH const &to) {
+	float worst = 0.0f;
+	for (auto const &tri : from.triangles) {
+		glm::vec3 samples[4] = { tri.a, tri.b, tri.c, (tri.a + tri.b + tri.c) / 3.0f };
+		for (auto const &p : samples) {
+			glm::vec3 closest;
+			if (!to.closest_point(p, std::numeric_limits< float >::infinity(), &closest)) continue; //(empty 'to')
+			worst = std::max(worst, glm::length(closest - p));
+		}
+	}
+	return worst;
+}
+
+int main(int argc, char **argv) {
+#ifdef _WIN32
+	//when compiled on windows, unhandled exceptions don't have their message printed, which can make debugging simple issues difficult.
+	try {
+#endif
+
+	if (argc != 3) {
+		std::cerr << "Usage:\n\t" << argv[0] << " <in.pnct> <out.pnci>" << std::endl;
+		return 1;
+	}
+	std::string in_file = argv[1];
+	std::string out_file = argv[2];
+
+	//------------ read ------------
+
+	std::vector< Vertex > in_vertices;
+	std::vector< char > strings;
+	struct IndexEntry {
+		uint32_t name_begin, name_end;
+		uint32_t vertex_begin, vertex_end;
+	};
+	static_assert(sizeof(IndexEntry) == 16, "Index entry should be packed");
+	std::vector< IndexEntry > in_index;
+	{
+		std::ifstream file(in_file, std::ios::binary);
+		if (!file) throw std::runtime_error("Failed to open '" + in_file + "'.");
+		read_chunk(file, "pnct", &in_vertices);
+		read_chunk(file, "str0", &strings);
+		read_chunk(file, "idx0", &in_index);
+	}
+
+	//------------ cook each mesh ------------
+
+	std::vector< Vertex > vertices;
+	std::vector< uint32_t > indices;
+	struct MeshEntry {
+		uint32_t name_begin, name_end;
+		uint32_t index_begin, index_end;
+	};
+	static_assert(sizeof(MeshEntry) == 16, "Mesh entry should be packed");
+	std::vector< MeshEntry > out_index;
+	struct LODEntry {
+		uint32_t mesh;
+		uint32_t index_begin, index_end;
+		float error;
+	};
+	static_assert(sizeof(LODEntry) == 16, "LOD entry should be packed");
+	std::vector< LODEntry > out_lods;
+
+	std::cout << std::fixed << std::setprecision(3);
+	std::cout << "mesh, triangles, vertices (exported -> unique), ACMR before -> after, ATVR before -> after, LOD triangles\n";
+	uint64_t total_triangles = 0;
+	double total_misses_before = 0.0, total_misses_after = 0.0;
+
+	for (auto const &entry : in_index) {
+		if (!(entry.name_begin <= entry.name_end && entry.name_end <= strings.size())) {
+			throw std::runtime_error("index entry has out-of-range name begin/end");
+		}
+		if (!(entry.vertex_begin <= entry.vertex_end && entry.vertex_end <= in_vertices.size())) {
+			throw std::runtime_error("index entry has out-of-range vertex start/count");
+		}
+		if ((entry.vertex_end - entry.vertex_begin) % 3 != 0) {
+			throw std::runtime_error("mesh vertex count isn't a multiple of three (expecting triangles)");
+		}
+		std::string name(strings.data() + entry.name_begin, strings.data() + entry.name_end);
+
+		//merge identical vertices:
+		std::vector< Vertex > unique;
+		std::vector< uint32_t > mesh_indices;
+		std::unordered_map< Vertex, uint32_t, VertexBits, VertexBits > lookup;
+		for (uint32_t v = entry.vertex_begin; v < entry.vertex_end; ++v) {
+			auto ret = lookup.emplace(in_vertices[v], uint32_t(unique.size()));
+			if (ret.second) unique.emplace_back(in_vertices[v]);
+			mesh_indices.emplace_back(ret.first->second);
+		}
+		uint32_t unique_count = uint32_t(unique.size());
+
+		VertexCacheStats before = analyze_vertex_cache(mesh_indices, unique_count);
+
+		std::vector< Vertex > original = unique; //(kept for simplification)
+		optimize(&unique, &mesh_indices);
+
+		VertexCacheStats after = analyze_vertex_cache(mesh_indices, unique_count);
+
+		//check that the result draws exactly the input triangles (same windings, any order):
+		{
+			auto triangles = [](Vertex const *v, uint32_t const *i, size_t count) {
+				std::vector< std::string > tris;
+				for (size_t t = 0; t + 2 < count; t += 3) {
+					std::string bytes;
+					for (uint32_t k = 0; k < 3; ++k) {
+						Vertex const &vertex = (i ? v[i[t+k]] : v[t+k]);
+						bytes.append(reinterpret_cast< char const * >(&vertex), sizeof(Vertex));
+					}
+					tris.emplace_back(std::move(bytes));
+				}
+				std::sort(tris.begin(), tris.end());
+				return tris;
+			};
+			if (triangles(&in_vertices[entry.vertex_begin], nullptr, entry.vertex_end - entry.vertex_begin)
+			 != triangles(unique.data(), mesh_indices.data(), mesh_indices.size())) {
+				throw std::runtime_error("Cooked mesh '" + name + "' doesn't match its input triangles.");
+			}
+		}
+
+		//append to output:
+		MeshEntry out;
+		out.name_begin = entry.name_begin;
+		out.name_end = entry.name_end;
+		out.index_begin = uint32_t(indices.size());
+		uint32_t base = uint32_t(vertices.size());
+		for (uint32_t i : mesh_indices) indices.emplace_back(base + i);
+		vertices.insert(vertices.end(), unique.begin(), unique.end());
+		out.index_end = uint32_t(indices.size());
+		out_index.emplace_back(out);
+
+		uint32_t triangle_count = uint32_t(mesh_indices.size() / 3);
+		std::cout << name << ", " << triangle_count << ", "
+			<< (entry.vertex_end - entry.vertex_begin) << " -> " << unique_count << ", "
+			<< before.acmr << " -> " << after.acmr << ", "
+			<< before.atvr << " -> " << after.atvr;
+
+		{ //levels of detail:
+			//weld vertices by position, so attribute seams don't tear open while simplifying:
+			std::vector< glm::vec3 > welded_positions;
+			std::vector< uint32_t > welded_of(original.size());
+			std::vector< std::vector< uint32_t > > vertices_of; //welded vertex -> original vertices there
+			{
+				std::unordered_map< Vertex, uint32_t, VertexBits, VertexBits > weld;
+				for (uint32_t v = 0; v < original.size(); ++v) {
+					Vertex key{};
+					key.Position = original[v].Position;
+					auto ret = weld.emplace(key, uint32_t(welded_positions.size()));
+					if (ret.second) {
+						welded_positions.emplace_back(original[v].Position);
+						vertices_of.emplace_back();
+					}
+					welded_of[v] = ret.first->second;
+					vertices_of[ret.first->second].emplace_back(v);
+				}
+			}
+			//(the original, unoptimized indices -- the vertex cache order doesn't matter here)
+			std::vector< uint32_t > welded_indices;
+			for (uint32_t v = entry.vertex_begin; v < entry.vertex_end; ++v) {
+				welded_indices.emplace_back(welded_of[lookup.at(in_vertices[v])]);
+			}
+
+			//flat-shaded meshes (every triangle's corners share one normal) get flat normals on their LODs as well:
+			bool flat = true;
+			for (uint32_t i = entry.vertex_begin; i + 2 < entry.vertex_end && flat; i += 3) {
+				flat = (in_vertices[i].Normal == in_vertices[i+1].Normal && in_vertices[i].Normal == in_vertices[i+2].Normal);
+			}
+
+			glm::vec3 min = glm::vec3(std::numeric_limits< float >::infinity());
+			glm::vec3 max = -min;
+			for (auto const &p : welded_positions) {
+				min = glm::min(min, p);
+				max = glm::max(max, p);
+			}
+			float radius = 0.5f * glm::length(max - min);
+
+			//(errors are measured with closest-point queries against BVHs of each surface)
+			std::vector< glm::vec3 > full_corners;
+			full_corners.reserve(welded_indices.size());
+			for (uint32_t i : welded_indices) full_corners.emplace_back(welded_positions[i]);
+			TriangleBVH full_bvh(full_corners.data(), uint32_t(full_corners.size()));
+
+			uint32_t previous = uint32_t(welded_indices.size());
+			for (uint32_t l = 0; l < MaxLODs; ++l) {
+				uint32_t target = (previous / 6) * 3;
+				std::vector< uint32_t > simplified = simplify(welded_indices, welded_positions, target, LODMaxError * radius);
+				if (simplified.empty() || simplified.size() > LODMinReduction * previous) break;
+				previous = uint32_t(simplified.size());
+
+				std::vector< glm::vec3 > lod_corners;
+				lod_corners.reserve(simplified.size());
+				for (uint32_t i : simplified) lod_corners.emplace_back(welded_positions[i]);
+				TriangleBVH lod_bvh(lod_corners.data(), uint32_t(lod_corners.size()));
+				float error = std::max(max_distance(full_bvh, lod_bvh), max_distance(lod_bvh, full_bvh));
+
+				//pick each corner's attributes from the original vertex there that faces most like the new triangle:
+				std::vector< Vertex > lod_vertices;
+				std::vector< uint32_t > lod_indices;
+				std::unordered_map< Vertex, uint32_t, VertexBits, VertexBits > lod_lookup;
+				for (uint32_t t = 0; t < simplified.size(); t += 3) {
+					glm::vec3 const &a = welded_positions[simplified[t+0]];
+					glm::vec3 const &b = welded_positions[simplified[t+1]];
+					glm::vec3 const &c = welded_positions[simplified[t+2]];
+					glm::vec3 normal = glm::cross(b - a, c - a);
+					if (normal != glm::vec3(0.0f)) normal = glm::normalize(normal);
+					for (uint32_t k = 0; k < 3; ++k) {
+						Vertex const *best = nullptr;
+						float best_dot = -std::numeric_limits< float >::infinity();
+						for (uint32_t v : vertices_of[simplified[t+k]]) {
+							float d = glm::dot(original[v].Normal, normal);
+							if (d > best_dot) {
+								best_dot = d;
+								best = &original[v];
+							}
+						}
+						Vertex vertex = *best;
+						if (flat) vertex.Normal = normal;
+						auto ret = lod_lookup.emplace(vertex, uint32_t(lod_vertices.size()));
+						if (ret.second) lod_vertices.emplace_back(vertex);
+						lod_indices.emplace_back(ret.first->second);
+					}
+				}
+				optimize(&lod_vertices, &lod_indices);
+
+				LODEntry lod;
+				lod.mesh = uint32_t(out_index.size() - 1);
+				lod.index_begin = uint32_t(indices.size());
+				uint32_t lod_base = uint32_t(vertices.size());
+				for (uint32_t i : lod_indices) indices.emplace_back(lod_base + i);
+				vertices.insert(vertices.end(), lod_vertices.begin(), lod_vertices.end());
+				lod.index_end = uint32_t(indices.size());
+				lod.error = error;
+				out_lods.emplace_back(lod);
+
+				std::cout << ", LOD" << (l + 1) << " " << (lod_indices.size() / 3) << " (error " << error << ")";
+			}
+		}
+		std::cout << "\n";
+		total_triangles += triangle_count;
+		total_misses_before += double(before.acmr) * triangle_count;
+		total_misses_after += double(after.acmr) * triangle_count;
+	}
+
+	if (total_triangles > 0) {
+		std::cout << "total: " << total_triangles << " triangles, " << in_vertices.size() << " -> " << vertices.size() << " vertices, ACMR "
+			<< total_misses_before / total_triangles << " -> " << total_misses_after / total_triangles << std::endl;
+	}
+
+	//------------ write ------------
+
+	std::ofstream file(out_file, std::ios::binary);
+	write_chunk("pnct", vertices, &file);
+	write_chunk("i032", indices, &file);
+	write_chunk("str0", strings, &file);
+	write_chunk("idx1", out_index, &file);
+	write_chunk("lod0", out_lods, &file);
+	if (!file) throw std::runtime_error("Failed to write '" + out_file + "'.");
+
+	std::cout << "Wrote '" << out_file << "'." << std::endl;
+
+	return 0;
+
+#ifdef _WIN32
+	} catch (std::exception const &e) {
+		std::cerr << "Unhandled exception:\n" << e.what() << std::endl;
+		return 1;
+	} catch (...) {
+		std::cerr << "Unhandled exception (unknown type)." << std::endl;
+		throw;
+	}
+#endif
+}
@@ -0,0 +1,126 @@
+/*
+ * cook-textures converts a .png into a .tex (see CookedTexture.hpp) that TextureArrays can
+ *  upload directly -- pixels flipped to OpenGL's lower-left origin, with the whole mip chain built ahead of time:
+ *
+ *   $ scenes/cook-textures [--cache <dir>] levels/grass.png dist/levels/grass.tex
+ *
+ * With --cache, cooked textures are also kept in <dir> (which must exist), named by a hash of
+ *  the .png's bytes; a .png that has been cooked before (under any name) is copied from the cache
+ *  instead of being decoded and filtered again.
+ */
+
+#include "CookedTexture.hpp"
+#include "load_save_png.hpp"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+//bump when the cooked output changes, so that stale cache entries aren't used:
+static constexpr uint32_t CookVersion = 1;
+
+static std::vector< char > read_file(std::string const &filename) {
+	std::ifstream file(filename, std::ios::binary);
+	if (!file) throw std::runtime_error("Failed to open '" + filename + "'.");
+	return std::vector< char >(std::istreambuf_iterator< char >(file), std::istreambuf_iterator< char >());
+}
+
+static void write_file(std::string const &filename, std::vector< char > const &data) {
+	std::ofstream file(filename, std::ios::binary);
+	file.write(data.data(), data.size());
+	if (!file) throw std::runtime_error("Failed to write '" + filename + "'.");
+}
+
+int main(int argc, char **argv) {
+#ifdef _WIN32
+	//when compiled on windows, unhandled exceptions don't have their message printed, which can make debugging simple issues difficult.
+	try {
+#endif
+
+	std::string cache_dir;
+	std::vector< std::string > files;
+	for (int i = 1; i < argc; ++i) {
+		if (std::strcmp(argv[i], "--cache") == 0 && i + 1 < argc) {
+			cache_dir = argv[++i];
+		} else {
+			files.emplace_back(argv[i]);
+		}
+	}
+	if (files.size() != 2) {
+		std::cerr << "Usage:\n\t" << argv[0] << " [--cache <dir>] <in.png> <out.tex>" << std::endl;
+		return 1;
+	}
+	std::string in_file = files[0];
+	std::string out_file = files[1];
+
+	//------------ check the cache ------------
+
+	std::vector< char > png = read_file(in_file);
+
+	std::string cache_file;
+	if (!cache_dir.empty()) {
+		//(FNV-1a over the version and the bytes)
+		uint64_t hash = 14695981039346656037ULL;
+		auto add = [&hash](unsigned char c) { hash = (hash ^ c) * 1099511628211ULL; };
+		for (uint32_t i = 0; i < 4; ++i) add((CookVersion >> (8 * i)) & 0xff);
+		for (char c : png) add(static_cast< unsigned char >(c));
+
+		std::ostringstream name;
+		name << cache_dir << '/' << std::hex << std::setw(16) << std::setfill('0') << hash << ".tex";
+		cache_file = name.str();
+
+		std::ifstream cached(cache_file, std::ios::binary);
+		if (cached) {
+			std::vector< char > data((std::istreambuf_iterator< char >(cached)), std::istreambuf_iterator< char >());
+			write_file(out_file, data);
+			std::cout << "Wrote '" << out_file << "' (cached as '" << cache_file << "')." << std::endl;
+			return 0;
+		}
+	}
+
+	//------------ cook ------------
+
+	glm::uvec2 size;
+	std::vector< glm::u8vec4 > data;
+	load_png(in_file, &size, &data, LowerLeftOrigin);
+
+	CookedTexture texture = CookedTexture::make(size, data);
+
+	std::ostringstream cooked;
+	texture.save(cooked);
+	std::string const &bytes = cooked.str();
+	std::vector< char > out(bytes.begin(), bytes.end());
+
+	//------------ write ------------
+
+	write_file(out_file, out);
+	if (!cache_file.empty()) {
+		//(write under a temporary name first, so that an interrupted cook never leaves a partial cache entry)
+		write_file(cache_file + ".tmp", out);
+		if (std::rename((cache_file + ".tmp").c_str(), cache_file.c_str()) != 0) {
+			std::cerr << "WARNING: failed to add '" << cache_file << "' to the cache." << std::endl;
+		}
+	}
+
+	std::cout << "Wrote '" << out_file << "' (" << size.x << "x" << size.y << ", " << texture.levels << " levels)." << std::endl;
+
+	return 0;
+
+#ifdef _WIN32
+	} catch (std::exception const &e) {
+		std::cerr << "Unhandled exception:\n" << e.what() << std::endl;
+		return 1;
+	} catch (...) {
+		std::cerr << "Unhandled exception (unknown type)." << std::endl;
+		throw;
+	}
+#endif
+}
@@ -0,0 +1,163 @@
+#include "gl_errors.hpp"
+
+#ifndef NDEBUG
+
+#include <SDL.h>
+
+#include <atomic>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+//KHR_debug isn't part of OpenGL 3.3 core, so GL.hpp doesn't have it:
+#define GL_DEBUG_OUTPUT_SYNCHRONOUS       0x8242
+#define GL_DEBUG_SOURCE_API               0x8246
+#define GL_DEBUG_SOURCE_WINDOW_SYSTEM     0x8247
+#define GL_DEBUG_SOURCE_SHADER_COMPILER   0x8248
+#define GL_DEBUG_SOURCE_THIRD_PARTY       0x8249
+#define GL_DEBUG_SOURCE_APPLICATION       0x824A
+#define GL_DEBUG_SOURCE_OTHER             0x824B
+#define GL_DEBUG_TYPE_ERROR               0x824C
+#define GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR 0x824D
+#define GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR  0x824E
+#define GL_DEBUG_TYPE_PORTABILITY         0x824F
+#define GL_DEBUG_TYPE_PERFORMANCE         0x8250
+#define GL_DEBUG_TYPE_OTHER               0x8251
+#define GL_DEBUG_SEVERITY_HIGH            0x9146
+#define GL_DEBUG_SEVERITY_MEDIUM          0x9147
+#define GL_DEBUG_SEVERITY_LOW             0x9148
+#define GL_DEBUG_SEVERITY_NOTIFICATION    0x826B
+#define GL_DEBUG_OUTPUT                   0x92E0
+#define GL_CONTEXT_FLAG_DEBUG_BIT         0x00000002
+
+typedef void (APIENTRY *GLDEBUGPROC)(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length, const GLchar *message, const void *userParam);
+typedef void (APIENTRY *PFNGLDEBUGMESSAGECALLBACKPROC)(GLDEBUGPROC callback, const void *userParam);
+typedef void (APIENTRY *PFNGLDEBUGMESSAGECONTROLPROC)(GLenum source, GLenum type, GLenum severity, GLsizei count, const GLuint *ids, GLboolean enabled);
+
+//messages arrive from the driver (possibly on its own thread) and wait here for the next GL_ERRORS():
+static std::mutex queue_mutex;
+static std::vector< std::string > queue;
+static std::atomic< uint32_t > queued(0); //(so GL_ERRORS() can skip the lock when there's nothing to report)
+static std::unordered_map< uint64_t, uint32_t > seen; //source/type/id -> times seen (guarded by queue_mutex)
+static bool debug_output = false; //was the callback installed?
+
+static char const *source_name(GLenum source) {
+	switch (source) {
+		case GL_DEBUG_SOURCE_API: return "api";
+		case GL_DEBUG_SOURCE_WINDOW_SYSTEM: return "window system";
+		case GL_DEBUG_SOURCE_SHADER_COMPILER: return "shader compiler";
+		case GL_DEBUG_SOURCE_THIRD_PARTY: return "third party";
+		case GL_DEBUG_SOURCE_APPLICATION: return "application";
+		default: return "other";
+	}
+}
+
+static char const *type_name(GLenum type) {
+	switch (type) {
+		case GL_DEBUG_TYPE_ERROR: return "error";
+		case GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR: return "deprecated behavior";
+		case GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR: return "undefined behavior";
+		case GL_DEBUG_TYPE_PORTABILITY: return "portability";
+		case GL_DEBUG_TYPE_PERFORMANCE: return "performance";
+		default: return "other";
+	}
+}
+
+static char const *severity_name(GLenum severity) {
+	switch (severity) {
+		case GL_DEBUG_SEVERITY_HIGH: return "high";
+		case GL_DEBUG_SEVERITY_MEDIUM: return "medium";
+		case GL_DEBUG_SEVERITY_LOW: return "low";
+		default: return "notification";
+	}
+}
+
+static void APIENTRY debug_callback(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length, const GLchar *message, const void *userParam) {
+	std::unique_lock< std::mutex > lock(queue_mutex);
+
+	//only report the 1st, 2nd, 4th, 8th, ... time a message shows up:
+	uint64_t key = (uint64_t(source & 0xffff) << 48) | (uint64_t(type & 0xffff) << 32) | uint64_t(id);
+	uint32_t count = ++seen[key];
+	if (count & (count - 1)) return;
+
+	std::string text = std::string("gl ") + type_name(type) + " (" + severity_name(severity) + " severity, from " + source_name(source) + "): ";
+	text += (length < 0 ? std::string(message) : std::string(message, length));
+	if (!text.empty() && text.back() == '\n') text.pop_back();
+	if (count > 1) text += " [seen " + std::to_string(count) + " times]";
+
+	queue.emplace_back(std::move(text));
+	queued.store(uint32_t(queue.size()), std::memory_order_release);
+}
+
+bool gl_debug_output_init(bool synchronous) {
+	if (!SDL_GL_ExtensionSupported("GL_KHR_debug")) {
+		std::cerr << "NOTE: GL_KHR_debug isn't supported; GL_ERRORS() will poll glGetError()." << std::endl;
+		return false;
+	}
+	auto DebugMessageCallback = (PFNGLDEBUGMESSAGECALLBACKPROC)SDL_GL_GetProcAddress("glDebugMessageCallback");
+	auto DebugMessageControl = (PFNGLDEBUGMESSAGECONTROLPROC)SDL_GL_GetProcAddress("glDebugMessageControl");
+	if (!DebugMessageCallback || !DebugMessageControl) {
+		std::cerr << "NOTE: couldn't find KHR_debug entry points; GL_ERRORS() will poll glGetError()." << std::endl;
+		return false;
+	}
+
+	GLint flags = 0;
+	glGetIntegerv(GL_CONTEXT_FLAGS, &flags);
+	if (!(flags & GL_CONTEXT_FLAG_DEBUG_BIT)) {
+		std::cerr << "NOTE: not a debug context; the driver may report fewer GL errors." << std::endl;
+	}
+
+	//have the driver drop notifications (e.g., buffer placement info) before they reach the callback:
+	DebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DEBUG_SEVERITY_NOTIFICATION, 0, nullptr, GL_FALSE);
+
+	DebugMessageCallback(debug_callback, nullptr);
+	glEnable(GL_DEBUG_OUTPUT);
+	if (synchronous) glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+	else glDisable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+
+	//clear anything that happened before the callback was installed:
+	while (glGetError() != GL_NO_ERROR) { }
+
+	debug_output = true;
+	return true;
+}
+
+void gl_errors(char const *where) {
+	if (debug_output) {
+		if (queued.load(std::memory_order_acquire) == 0) return;
+		std::vector< std::string > messages;
+		{
+			std::unique_lock< std::mutex > lock(queue_mutex);
+			messages.swap(queue);
+			queued.store(0, std::memory_order_relaxed);
+		}
+		for (auto const &message : messages) {
+			std::cerr << "WARNING: " << message << " (at or before " << where << ")" << std::endl;
+		}
+		return;
+	}
+
+	GLenum err = 0;
+	while ((err = glGetError()) != GL_NO_ERROR) {
+		#define CHECK( ERR ) \
+			if (err == ERR) { \
+				std::cerr << "WARNING: gl error '" #ERR "' at " << where << std::endl; \
+			} else
+
+		CHECK( GL_INVALID_ENUM )
+		CHECK( GL_INVALID_VALUE )
+		CHECK( GL_INVALID_OPERATION )
+		CHECK( GL_INVALID_FRAMEBUFFER_OPERATION )
+		CHECK( GL_OUT_OF_MEMORY )
+		CHECK( GL_STACK_UNDERFLOW )
+		CHECK( GL_STACK_OVERFLOW )
+		{
+			std::cerr << "WARNING: gl error '" << err << "' at " << where << std::endl;
+		}
+		#undef CHECK
+	}
+}
+
+#endif
@@ -1,31 +1,40 @@
 #pragma once
 
+/*
+ * GL error reporting:
+ *
+ *  GL_ERRORS(); //report any GL errors since the last check, tagged with this file:line
+ *
+ * When the driver supports KHR_debug, gl_debug_output_init() installs a debug message
+ *  callback, so errors are delivered by the driver as they happen (asynchronously, without
+ *  stalling the pipeline) and GL_ERRORS() only prints messages that have been queued since
+ *  the last check. Otherwise GL_ERRORS() falls back to polling glGetError().
+ *
+ * Messages are filtered (notifications are dropped by the driver) and de-duplicated
+ *  (a repeated message is printed again only on its 2nd, 4th, 8th, ... occurrence).
+ *
+ * In release builds (compiled with -DNDEBUG) error checking compiles to nothing.
+ */
+
 #include "GL.hpp"
-#include <iostream>
 
 #define STR2(X) # X
 #define STR(X) STR2(X)
 
-inline void gl_errors(std::string const &where) {
-	GLenum err = 0;
-	while ((err = glGetError()) != GL_NO_ERROR) {
-		#define CHECK( ERR ) \
-			if (err == ERR) { \
-				std::cerr << "WARNING: gl error '" #ERR "' at " << where << std::endl; \
-			} else
-
-		CHECK( GL_INVALID_ENUM )
-		CHECK( GL_INVALID_VALUE )
-		CHECK( GL_INVALID_OPERATION )
-		CHECK( GL_INVALID_FRAMEBUFFER_OPERATION )
-		CHECK( GL_OUT_OF_MEMORY )
-		CHECK( GL_STACK_UNDERFLOW )
-		CHECK( GL_STACK_OVERFLOW )
-		{
-			std::cerr << "WARNING: gl error '" << err << "'" << std::endl;
-		}
-		#undef CHECK
-	}
-}
+#ifdef NDEBUG
+
+inline bool gl_debug_output_init(bool synchronous = false) { return false; }
+#define GL_ERRORS() ((void)0)
+
+#else
+
+//call after init_GL() on the thread that has the context current:
+// returns false (and leaves GL_ERRORS() polling glGetError) if debug output isn't available
+// 'synchronous' delivers messages on the thread (and in the call) that caused them, which is slower but handy with a debugger
+bool gl_debug_output_init(bool synchronous = false);
+
+//print queued debug messages (or glGetError results) as having happened at or before 'where':
+void gl_errors(char const *where);
 #define GL_ERRORS() gl_errors(__FILE__  ":" STR(__LINE__) )
 
+#endif
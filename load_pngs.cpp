@@ -0,0 +1,42 @@
+#include "load_pngs.hpp"
+
+#include "JobSystem.hpp"
+
+#include <stdexcept>
+
+std::vector< PNGImage > load_pngs(std::vector< std::string > const &filenames, OriginLocation origin) {
+	std::vector< PNGImage > images(filenames.size());
+	load_pngs(filenames, origin, [&images](uint32_t index, glm::uvec2 size) {
+		//(each index is only ever touched by one thread)
+		images[index].size = size;
+		images[index].data.resize(size.x * size.y);
+		return images[index].data.data();
+	});
+	return images;
+}
+
+void load_pngs(std::vector< std::string > const &filenames, OriginLocation origin, std::function< glm::u8vec4 *(uint32_t index, glm::uvec2 size) > const &allocate) {
+	//tasks must not throw, so failures are collected and reported once everything is done:
+	std::vector< std::string > errors(filenames.size());
+
+	//(one file per task -- decoding even a small image is plenty of work to be worth a task)
+	JobSystem::get().parallel_for(0, uint32_t(filenames.size()), 1, [&](uint32_t begin, uint32_t end) {
+		for (uint32_t i = begin; i < end; ++i) {
+			try {
+				load_png(filenames[i], origin, [&allocate, i](glm::uvec2 size) {
+					return allocate(i, size);
+				});
+			} catch (std::exception const &e) {
+				errors[i] = e.what();
+			}
+		}
+	});
+
+	std::string message;
+	for (auto const &error : errors) {
+		if (error.empty()) continue;
+		if (!message.empty()) message += "\n";
+		message += error;
+	}
+	if (!message.empty()) throw std::runtime_error(message);
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "load_save_png.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+/*
+ * Load a batch of PNG files at once, decoding them in parallel on JobSystem::get():
+ *
+ *  std::vector< PNGImage > images = load_pngs({ data_path("a.png"), data_path("b.png") }, LowerLeftOrigin);
+ *
+ * Or decode straight into storage of your choosing (e.g., slices of one big buffer):
+ *
+ *  load_pngs(filenames, LowerLeftOrigin, [&](uint32_t index, glm::uvec2 size) -> glm::u8vec4 * { ... });
+ *
+ * 'allocate' is called from worker threads -- possibly for several files at the same time --
+ *  once per file, as soon as that file's size is known.
+ */
+
+struct PNGImage {
+	glm::uvec2 size = glm::uvec2(0);
+	std::vector< glm::u8vec4 > data;
+};
+
+//NOTE: load_pngs will throw on error (after every file has been tried; the message names all the failures)
+std::vector< PNGImage > load_pngs(std::vector< std::string > const &filenames, OriginLocation origin);
+void load_pngs(std::vector< std::string > const &filenames, OriginLocation origin, std::function< glm::u8vec4 *(uint32_t index, glm::uvec2 size) > const &allocate);
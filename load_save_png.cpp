@@ -5,6 +5,8 @@
 #include <iostream>
 #include <fstream>
 #include <cassert>
+#include <cstring>
+#include <iterator>
 #include <vector>
 
 #define LOG_ERROR( X ) std::cerr << X << std::endl
@@ -12,16 +14,35 @@
 using std::vector;
 
 bool load_png(std::istream &from, unsigned int *width, unsigned int *height, vector< glm::u8vec4 > *data, OriginLocation origin);
+static bool decode_png(png_rw_ptr read_fn, void *io, OriginLocation origin, std::function< glm::u8vec4 *(glm::uvec2) > const &allocate);
+static void memory_read_data(png_structp png_ptr, png_bytep data, png_size_t length);
 void save_png(std::ostream &to, unsigned int width, unsigned int height, glm::u8vec4 const *data, OriginLocation origin);
 
 void load_png(std::string filename, glm::uvec2 *size, std::vector< glm::u8vec4 > *data, OriginLocation origin) {
 	assert(size);
+	assert(data);
+
+	load_png(filename, origin, [&](glm::uvec2 size_) {
+		*size = size_;
+		data->resize(size_.x * size_.y);
+		return data->data();
+	});
+}
 
+//(the whole file is read at once, rather than in the many small reads libpng makes)
+struct MemoryReader {
+	std::vector< char > bytes;
+	size_t at = 0;
+};
+
+void load_png(std::string filename, OriginLocation origin, std::function< glm::u8vec4 *(glm::uvec2 size) > const &allocate) {
 	std::ifstream file(filename.c_str(), std::ios::binary);
 	if (!file) {
 		throw std::runtime_error("Failed to open PNG image file '" + filename + "'.");
 	}
-	if (!load_png(file, &size->x, &size->y, data, origin)) {
+	MemoryReader reader;
+	reader.bytes.assign(std::istreambuf_iterator< char >(file), std::istreambuf_iterator< char >());
+	if (!decode_png(memory_read_data, &reader, origin, allocate)) {
 		throw std::runtime_error("Failed to read PNG image from '" + filename + "'.");
 	}
 }
@@ -40,6 +61,16 @@ static void user_read_data(png_structp png_ptr, png_bytep data, png_size_t lengt
 	}
 }
 
+static void memory_read_data(png_structp png_ptr, png_bytep data, png_size_t length) {
+	MemoryReader *from = reinterpret_cast< MemoryReader * >(png_get_io_ptr(png_ptr));
+	assert(from);
+	if (length > from->bytes.size() - from->at) {
+		png_error(png_ptr, "Error reading.");
+	}
+	std::memcpy(data, from->bytes.data() + from->at, length);
+	from->at += length;
+}
+
 static void user_write_data(png_structp png_ptr, png_bytep data, png_size_t length) {
 	std::ostream *to = reinterpret_cast< std::ostream * >(png_get_io_ptr(png_ptr));
 	assert(to);
@@ -64,28 +95,39 @@ bool load_png(std::istream &from, unsigned int *width, unsigned int *height, vec
 	if (height == nullptr) height = &local_height;
 	*width = *height = 0;
 	data->clear();
+	bool ok = decode_png(user_read_data, &from, origin, [&](glm::uvec2 size) {
+		*width = size.x;
+		*height = size.y;
+		data->resize(size.x * size.y);
+		return data->data();
+	});
+	if (!ok) {
+		*width = *height = 0;
+		data->clear();
+	}
+	return ok;
+}
+
+static bool decode_png(png_rw_ptr read_fn, void *io, OriginLocation origin, std::function< glm::u8vec4 *(glm::uvec2) > const &allocate) {
 	//..... load file ......
 	//Load a png file, as per the libpng docs:
 	png_structp png = png_create_read_struct(PNG_LIBPNG_VER_STRING, (png_voidp)NULL, (png_error_ptr)NULL, (png_error_ptr)NULL);
 
-	png_set_read_fn(png, &from, user_read_data);
-
 	if (!png) {
 		LOG_ERROR("  cannot alloc read struct.");
 		return false;
 	}
+	png_set_read_fn(png, io, read_fn);
+
 	png_infop info = png_create_info_struct(png);
 	if (!info) {
 		LOG_ERROR("  cannot alloc info struct.");
 		png_destroy_read_struct(&png, (png_infopp)NULL, (png_infopp)NULL);
 		return false;
 	}
-	png_bytep *row_pointers = NULL;
 	if (setjmp(png_jmpbuf(png))) {
 		LOG_ERROR("  png interal error.");
 		png_destroy_read_struct(&png, &info, (png_infopp)NULL);
-		if (row_pointers != NULL) delete[] row_pointers;
-		data->clear();
 		return false;
 	}
 	//not needed with custom read/write functions: png_init_io(png, NULL);
@@ -102,28 +144,31 @@ bool load_png(std::istream &from, unsigned int *width, unsigned int *height, vec
 		png_set_packing(png);
 	if (png_get_bit_depth(png,info) == 16)
 		png_set_strip_16(png);
+	int passes = png_set_interlace_handling(png);
 	//Ok, should be 32-bit RGBA now.
 
 	png_read_update_info(png, info);
 	size_t rowbytes = png_get_rowbytes(png, info);
 	//Make sure it's the format we think it is...
 	assert(rowbytes == w*sizeof(uint32_t));
+	(void)rowbytes; //(only used by the assert)
 
-	data->resize(w*h);
-	row_pointers = new png_bytep[h];
-	for (unsigned int r = 0; r < h; ++r) {
-		if (origin == LowerLeftOrigin) {
-			row_pointers[h-1-r] = (png_bytep)(&(*data)[r*w]);
-		} else {
-			row_pointers[r] = (png_bytep)(&(*data)[r*w]);
+	glm::u8vec4 *data = allocate(glm::uvec2(w, h));
+	if (data == nullptr) {
+		LOG_ERROR("  no storage for image data.");
+		png_destroy_read_struct(&png, &info, NULL);
+		return false;
+	}
+
+	//read rows straight into place (no row pointer array; interlaced images make several passes over the same rows):
+	for (int pass = 0; pass < passes; ++pass) {
+		for (unsigned int r = 0; r < h; ++r) {
+			png_read_row(png, (png_bytep)(data + size_t(origin == LowerLeftOrigin ? h-1-r : r) * w), NULL);
 		}
 	}
-	png_read_image(png, row_pointers);
+	png_read_end(png, NULL);
 	png_destroy_read_struct(&png, &info, NULL);
-	delete[] row_pointers;
 
-	*width = w;
-	*height = h;
 	return true;
 }
 
@@ -2,6 +2,7 @@
 
 #include <glm/glm.hpp>
 
+#include <functional>
 #include <string>
 #include <vector>
 #include <stdint.h>
@@ -17,4 +18,7 @@ enum OriginLocation {
 
 //NOTE: load_png will throw on error
 void load_png(std::string filename, glm::uvec2 *size, std::vector< glm::u8vec4 > *data, OriginLocation origin);
+//load into storage chosen once the size is known: 'allocate(size)' returns where the size.x * size.y texels go
+// (rows are decoded straight into it; e.g., a slice of a larger buffer or a mapped upload buffer):
+void load_png(std::string filename, OriginLocation origin, std::function< glm::u8vec4 *(glm::uvec2 size) > const &allocate);
 void save_png(std::string filename, glm::uvec2 size, glm::u8vec4 const *data, OriginLocation origin);
@@ -9,10 +9,20 @@
 
 //GL.hpp will include a non-namespace-polluting set of opengl prototypes:
 #include "GL.hpp"
+#include "gl_errors.hpp"
 
 //for screenshots:
 #include "load_save_png.hpp"
 
+//for (optionally) drawing on a separate thread:
+#include "RenderThread.hpp"
+
+//for (optionally) measuring input latency:
+#include "LatencyMeter.hpp"
+
+//per-frame scratch memory:
+#include "FrameArena.hpp"
+
 //Includes for libSDL:
 #include <SDL.h>
 
@@ -22,6 +32,7 @@
 #include <stdexcept>
 #include <memory>
 #include <algorithm>
+#include <string>
 
 #ifdef _WIN32
 extern "C" { uint32_t GetACP(); }
@@ -42,6 +53,24 @@ int main(int argc, char **argv) {
 	try {
 #endif
 
+	//------------  command line ------------
+
+	//--render-thread: simulate the next frame while a separate thread draws the current one:
+	bool threaded_rendering = false;
+	//--latency: print input-to-swap latency statistics (adds a glFinish after every swap):
+	std::unique_ptr< LatencyMeter > latency;
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		if (arg == "--render-thread") {
+			threaded_rendering = true;
+		} else if (arg == "--latency") {
+			latency.reset(new LatencyMeter);
+		} else {
+			std::cerr << "Usage:\n\t" << argv[0] << " [--render-thread] [--latency]" << std::endl;
+			return 1;
+		}
+	}
+
 	//------------  initialization ------------
 
 	//Initialize SDL library:
@@ -91,6 +120,9 @@ int main(int argc, char **argv) {
 	//On windows, load OpenGL entrypoints: (does nothing on other platforms)
 	init_GL();
 
+	//report GL errors through the driver's debug output, when it has it:
+	gl_debug_output_init();
+
 	//Set VSYNC + Late Swap (prevents crazy FPS):
 	if (SDL_GL_SetSwapInterval(-1) != 0) {
 		std::cerr << "NOTE: couldn't set vsync + late swap tearing (" << SDL_GetError() << ")." << std::endl;
@@ -108,6 +140,23 @@ int main(int argc, char **argv) {
 	//------------ create game mode + make current --------------
 	Mode::set_current(std::make_shared< PlayMode >());
 
+	//------------ hand GL context to render thread (if requested) --------------
+	std::unique_ptr< RenderThread > render_thread;
+	if (threaded_rendering) {
+		SDL_GL_MakeCurrent(window, nullptr);
+		render_thread.reset(new RenderThread(window, context));
+		if (latency) {
+			render_thread->on_swap = [&latency](uint32_t input_time){
+				glFinish(); //make sure the swap has actually happened
+				latency->swapped(input_time);
+			};
+			render_thread->on_snapshot = [&latency](Mode &mode, uint32_t input_time){
+				return latency->latched(input_time, mode.latched_input_time);
+			};
+		}
+		std::cout << "Rendering on a separate thread." << std::endl;
+	}
+
 	//------------ main loop ------------
 
 	//this inline function will be called whenever the window is resized,
@@ -121,7 +170,8 @@ int main(int argc, char **argv) {
 		window_size = glm::uvec2(w, h);
 		SDL_GL_GetDrawableSize(window, &w, &h);
 		drawable_size = glm::uvec2(w, h);
-		glViewport(0, 0, drawable_size.x, drawable_size.y);
+		//(render thread sets its own viewport each frame)
+		if (!render_thread) glViewport(0, 0, drawable_size.x, drawable_size.y);
 	};
 	on_resize();
 
@@ -130,9 +180,13 @@ int main(int argc, char **argv) {
 		//every pass through the game loop creates one frame of output
 		//  by performing three steps:
 
+		//(transient per-frame data from the previous pass is no longer in use)
+		FrameArena::current().reset();
+
 		{ //(1) process any events that are pending
 			static SDL_Event evt;
 			while (SDL_PollEvent(&evt) == 1) {
+				if (latency) latency->event(evt);
 				//handle resizing:
 				if (evt.type == SDL_WINDOWEVENT && evt.window.event == SDL_WINDOWEVENT_SIZE_CHANGED) {
 					on_resize();
@@ -145,18 +199,23 @@ int main(int argc, char **argv) {
 					break;
 				} else if (evt.type == SDL_KEYDOWN && evt.key.keysym.sym == SDLK_PRINTSCREEN) {
 					// --- screenshot key ---
-					std::string filename = "screenshot.png";
-					std::cout << "Saving screenshot to '" << filename << "'." << std::endl;
-					glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
-					glReadBuffer(GL_FRONT);
-					int w,h;
-					SDL_GL_GetDrawableSize(window, &w, &h);
-					std::vector< glm::u8vec4 > data(w*h);
-					glReadPixels(0,0,w,h, GL_RGBA, GL_UNSIGNED_BYTE, data.data());
-					for (auto &px : data) {
-						px.a = 0xff;
-					}
-					save_png(filename, glm::uvec2(w,h), data.data(), LowerLeftOrigin);
+					auto screenshot = [&](){
+						std::string filename = "screenshot.png";
+						std::cout << "Saving screenshot to '" << filename << "'." << std::endl;
+						glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+						glReadBuffer(GL_FRONT);
+						int w,h;
+						SDL_GL_GetDrawableSize(window, &w, &h);
+						std::vector< glm::u8vec4 > data(w*h);
+						glReadPixels(0,0,w,h, GL_RGBA, GL_UNSIGNED_BYTE, data.data());
+						for (auto &px : data) {
+							px.a = 0xff;
+						}
+						save_png(filename, glm::uvec2(w,h), data.data(), LowerLeftOrigin);
+					};
+					//(GL calls need to happen wherever the context is current)
+					if (render_thread) render_thread->run(screenshot);
+					else screenshot();
 				}
 			}
 			if (!Mode::current) break;
@@ -176,18 +235,33 @@ int main(int argc, char **argv) {
 			if (!Mode::current) break;
 		}
 
-		{ //(3) call the current mode's "draw" function to produce output:
+		//(when measuring latency, note the oldest input that this frame will show)
+		uint32_t input_time = (latency ? latency->take_input_time() : 0);
+
+		if (render_thread) { //(3) hand a snapshot of the current mode to the render thread:
+			//(returns right away, so the next update overlaps with drawing this frame)
+			render_thread->submit(*Mode::current, drawable_size, input_time);
+		} else { //(3) call the current mode's "draw" function to produce output:
 		
 			Mode::current->draw(drawable_size);
-		}
+			if (latency && Mode::current) input_time = latency->latched(input_time, Mode::current->latched_input_time);
 
-		//Wait until the recently-drawn frame is shown before doing it all again:
-		SDL_GL_SwapWindow(window);
+			//Wait until the recently-drawn frame is shown before doing it all again:
+			SDL_GL_SwapWindow(window);
+			gl_state_next_frame();
+
+			if (latency) {
+				glFinish(); //make sure the swap has actually happened
+				latency->swapped(input_time);
+			}
+		}
 	}
 
 
 	//------------  teardown ------------
 
+	render_thread.reset(); //finishes any in-flight frame
+
 	SDL_GL_DeleteContext(context);
 	context = 0;
 
@@ -104,6 +104,203 @@ with open('glcorearb.h', 'r') as f:
 
 
 
+#hand-written state cache, appended to GL.hpp / GL.cpp:
+STATE_CACHE_HPP = """
+//------------------------------------------------
+//State cache:
+// glUseProgram, glBindVertexArray, glBindBuffer, glActiveTexture, glBindTexture, glEnable, and glDisable
+//  are routed through a cache of the context's current state, and calls that wouldn't change
+//  anything are dropped before they reach the driver.
+// (define GL_NO_STATE_CACHE before including GL.hpp to call the driver directly)
+//
+// The cache assumes every change to these bindings goes through it; if something else
+//  (e.g., a library) might have changed them, call gl_state_invalidate().
+
+struct GLStateStats {
+	uint32_t issued = 0; //calls passed to the driver
+	uint32_t filtered = 0; //calls dropped as redundant
+};
+extern GLStateStats gl_state_stats; //since the last gl_state_next_frame()
+extern GLStateStats gl_state_last_frame; //for the frame before that
+
+//call once per frame (e.g., after swapping) to move gl_state_stats to gl_state_last_frame:
+void gl_state_next_frame();
+
+//forget all cached state (the next call to each entry point will be passed through):
+void gl_state_invalidate();
+
+void gl_state_UseProgram(GLuint program);
+void gl_state_BindVertexArray(GLuint array);
+void gl_state_BindBuffer(GLenum target, GLuint buffer);
+void gl_state_ActiveTexture(GLenum texture);
+void gl_state_BindTexture(GLenum target, GLuint texture);
+void gl_state_Enable(GLenum cap);
+void gl_state_Disable(GLenum cap);
+
+//deleting objects unbinds them, so deletes also go through the cache:
+void gl_state_DeleteVertexArrays(GLsizei n, const GLuint *arrays);
+void gl_state_DeleteBuffers(GLsizei n, const GLuint *buffers);
+void gl_state_DeleteTextures(GLsizei n, const GLuint *textures);
+
+#ifndef GL_NO_STATE_CACHE
+#define glUseProgram gl_state_UseProgram
+#define glBindVertexArray gl_state_BindVertexArray
+#define glBindBuffer gl_state_BindBuffer
+#define glActiveTexture gl_state_ActiveTexture
+#define glBindTexture gl_state_BindTexture
+#define glEnable gl_state_Enable
+#define glDisable gl_state_Disable
+#define glDeleteVertexArrays gl_state_DeleteVertexArrays
+#define glDeleteBuffers gl_state_DeleteBuffers
+#define glDeleteTextures gl_state_DeleteTextures
+#endif"""
+
+STATE_CACHE_CPP = """
+//------------------------------------------------
+//State cache:
+
+GLStateStats gl_state_stats;
+GLStateStats gl_state_last_frame;
+
+//cached values are 'Unknown' until first set after gl_state_invalidate() (which init_GL() calls):
+static constexpr GLuint Unknown = -1U;
+
+//texture units and targets beyond these are passed straight through:
+static constexpr uint32_t CachedTextureUnits = 32;
+static constexpr GLenum CachedTextureTargets[] = {
+	GL_TEXTURE_1D, GL_TEXTURE_2D, GL_TEXTURE_3D,
+	GL_TEXTURE_1D_ARRAY, GL_TEXTURE_2D_ARRAY,
+	GL_TEXTURE_RECTANGLE, GL_TEXTURE_CUBE_MAP, GL_TEXTURE_BUFFER,
+	GL_TEXTURE_2D_MULTISAMPLE, GL_TEXTURE_2D_MULTISAMPLE_ARRAY,
+};
+static constexpr uint32_t CachedTextureTargetCount = sizeof(CachedTextureTargets) / sizeof(CachedTextureTargets[0]);
+
+//enable/disable capabilities (others are passed straight through):
+static constexpr GLenum CachedCapabilities[] = {
+	GL_BLEND, GL_CULL_FACE, GL_DEPTH_TEST, GL_STENCIL_TEST, GL_SCISSOR_TEST,
+	GL_POLYGON_OFFSET_FILL, GL_FRAMEBUFFER_SRGB, GL_MULTISAMPLE, GL_PROGRAM_POINT_SIZE,
+	GL_PRIMITIVE_RESTART, GL_SAMPLE_ALPHA_TO_COVERAGE, GL_DEPTH_CLAMP, GL_LINE_SMOOTH,
+};
+static constexpr uint32_t CachedCapabilityCount = sizeof(CachedCapabilities) / sizeof(CachedCapabilities[0]);
+
+static struct {
+	GLuint program;
+	GLuint vertex_array;
+	GLuint array_buffer;
+	GLuint element_array_buffer; //(part of the vertex array's state)
+	GLuint active_unit;
+	GLuint textures[CachedTextureUnits][CachedTextureTargetCount];
+	GLuint capabilities[CachedCapabilityCount]; //GL_TRUE, GL_FALSE, or Unknown
+} state;
+
+template< uint32_t N >
+static uint32_t index_of(GLenum const (&list)[N], GLenum value) {
+	for (uint32_t i = 0; i < N; ++i) {
+		if (list[i] == value) return i;
+	}
+	return N;
+}
+
+//update a cached value; returns true if the call should be passed to the driver:
+static bool changes(GLuint *cached, GLuint value) {
+	if (cached && *cached == value) {
+		gl_state_stats.filtered += 1;
+		return false;
+	}
+	if (cached) *cached = value;
+	gl_state_stats.issued += 1;
+	return true;
+}
+
+void gl_state_next_frame() {
+	gl_state_last_frame = gl_state_stats;
+	gl_state_stats = GLStateStats();
+}
+
+void gl_state_invalidate() {
+	state.program = Unknown;
+	state.vertex_array = Unknown;
+	state.array_buffer = Unknown;
+	state.element_array_buffer = Unknown;
+	state.active_unit = Unknown;
+	for (auto &unit : state.textures) {
+		for (auto &texture : unit) texture = Unknown;
+	}
+	for (auto &cap : state.capabilities) cap = Unknown;
+}
+
+void gl_state_UseProgram(GLuint program) {
+	if (changes(&state.program, program)) glUseProgram(program);
+}
+
+void gl_state_BindVertexArray(GLuint array) {
+	if (changes(&state.vertex_array, array)) {
+		glBindVertexArray(array);
+		state.element_array_buffer = Unknown;
+	}
+}
+
+void gl_state_BindBuffer(GLenum target, GLuint buffer) {
+	GLuint *cached = nullptr;
+	if (target == GL_ARRAY_BUFFER) cached = &state.array_buffer;
+	else if (target == GL_ELEMENT_ARRAY_BUFFER) cached = &state.element_array_buffer;
+	if (changes(cached, buffer)) glBindBuffer(target, buffer);
+}
+
+void gl_state_ActiveTexture(GLenum texture) {
+	if (changes(&state.active_unit, texture - GL_TEXTURE0)) glActiveTexture(texture);
+}
+
+void gl_state_BindTexture(GLenum target, GLuint texture) {
+	GLuint *cached = nullptr;
+	uint32_t t = index_of(CachedTextureTargets, target);
+	if (state.active_unit < CachedTextureUnits && t < CachedTextureTargetCount) {
+		cached = &state.textures[state.active_unit][t];
+	}
+	if (changes(cached, texture)) glBindTexture(target, texture);
+}
+
+void gl_state_Enable(GLenum cap) {
+	uint32_t c = index_of(CachedCapabilities, cap);
+	if (changes(c < CachedCapabilityCount ? &state.capabilities[c] : nullptr, GL_TRUE)) glEnable(cap);
+}
+
+void gl_state_Disable(GLenum cap) {
+	uint32_t c = index_of(CachedCapabilities, cap);
+	if (changes(c < CachedCapabilityCount ? &state.capabilities[c] : nullptr, GL_FALSE)) glDisable(cap);
+}
+
+void gl_state_DeleteVertexArrays(GLsizei n, const GLuint *arrays) {
+	for (GLsizei i = 0; i < n; ++i) {
+		if (arrays[i] != 0 && arrays[i] == state.vertex_array) {
+			state.vertex_array = 0;
+			state.element_array_buffer = Unknown;
+		}
+	}
+	glDeleteVertexArrays(n, arrays);
+}
+
+void gl_state_DeleteBuffers(GLsizei n, const GLuint *buffers) {
+	for (GLsizei i = 0; i < n; ++i) {
+		if (buffers[i] == 0) continue;
+		if (buffers[i] == state.array_buffer) state.array_buffer = 0;
+		if (buffers[i] == state.element_array_buffer) state.element_array_buffer = 0;
+	}
+	glDeleteBuffers(n, buffers);
+}
+
+void gl_state_DeleteTextures(GLsizei n, const GLuint *textures) {
+	for (GLsizei i = 0; i < n; ++i) {
+		if (textures[i] == 0) continue;
+		for (auto &unit : state.textures) {
+			for (auto &texture : unit) {
+				if (texture == textures[i]) texture = 0;
+			}
+		}
+	}
+	glDeleteTextures(n, textures);
+}"""
+
 with open("GL.hpp", "w") as f:
 	print("""#pragma once
 
@@ -153,9 +350,13 @@ typedef signed   long  int     khronos_ssize_t;
 	print("""
 }""", file=f)
 
+	print(STATE_CACHE_HPP, file=f)
+
 
 with open("GL.cpp", "w") as f:
-	print("""#include "GL.hpp"
+	print("""//GL.cpp implements the state cache, so it calls the driver directly:
+#define GL_NO_STATE_CACHE
+#include "GL.hpp"
 
 #include <SDL.h>
 #include <iostream>
@@ -173,7 +374,10 @@ with open("GL.cpp", "w") as f:
 
 void init_GL() {""", file=f)
 	print("\t" + "\n\t".join(lookups),file=f)
-	print("""}
+	print("""
+	gl_state_invalidate();
+}
 #ifdef _WIN32""", file=f)
 	print("\t" + "\n\t".join(fps),file=f)
 	print("""#endif""", file=f)
+	print(STATE_CACHE_CPP, file=f)
@@ -0,0 +1,60 @@
+/*
+ * pack-assets collects asset files into a single AssetPack (see AssetPack.hpp):
+ *
+ *   $ scenes/pack-assets dist/assets.pack dist/ levels/lvl0.pnci levels/lvl0.scene ...
+ *
+ * Each asset is stored under its name (relative to the base directory, which is how
+ *  open_asset() looks it up), compressed with deflate when that makes it noticeably smaller.
+ * Prints each entry's size before and after.
+ */
+
+#include "AssetPack.hpp"
+
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+int main(int argc, char **argv) {
+#ifdef _WIN32
+	//when compiled on windows, unhandled exceptions don't have their message printed, which can make debugging simple issues difficult.
+	try {
+#endif
+
+	if (argc < 4) {
+		std::cerr << "Usage:\n\t" << argv[0] << " <out.pack> <base directory> <asset> [asset ...]" << std::endl;
+		return 1;
+	}
+	std::string out_file = argv[1];
+	std::string base = argv[2];
+	if (!base.empty() && base.back() != '/' && base.back() != '\\') base += '/';
+	std::vector< std::string > names(argv + 3, argv + argc);
+
+	AssetPack::write(out_file, base, names);
+
+	//read it back, to report (and check) what was written:
+	AssetPack pack(out_file);
+	uint64_t total_raw = 0, total_stored = 0;
+	for (auto const &name : names) {
+		AssetPack::Entry const *entry = pack.find(name);
+		if (!entry) throw std::runtime_error("Pack is missing '" + name + "' after writing it.");
+		std::cout << name << ": " << entry->raw_size << " -> " << entry->size << " bytes"
+			<< (entry->codec == AssetPack::Deflate ? " (deflate)" : " (stored)") << "\n";
+		total_raw += entry->raw_size;
+		total_stored += entry->size;
+	}
+	std::cout << "Wrote '" << out_file << "': " << names.size() << " assets, " << total_raw << " -> " << total_stored << " bytes of data, "
+		<< pack.data_size << " bytes in all." << std::endl;
+
+	return 0;
+
+#ifdef _WIN32
+	} catch (std::exception const &e) {
+		std::cerr << "Unhandled exception:\n" << e.what() << std::endl;
+		return 1;
+	} catch (...) {
+		std::cerr << "Unhandled exception (unknown type)." << std::endl;
+		throw;
+	}
+#endif
+}
@@ -2,7 +2,9 @@
 #include "ShowMeshesMode.hpp"
 #include "Load.hpp"
 #include "GL.hpp"
+#include "gl_errors.hpp"
 #include "load_save_png.hpp"
+#include "FrameArena.hpp"
 
 #include <SDL.h>
 
@@ -67,6 +69,9 @@ int main(int argc, char **argv) {
 	//On windows, load OpenGL entrypoints: (does nothing on other platforms)
 	init_GL();
 
+	//report GL errors through the driver's debug output, when it has it:
+	gl_debug_output_init();
+
 	//Set VSYNC + Late Swap (prevents crazy FPS):
 	if (SDL_GL_SetSwapInterval(-1) != 0) {
 		std::cerr << "NOTE: couldn't set vsync + late swap tearing (" << SDL_GetError() << ")." << std::endl;
@@ -123,6 +128,9 @@ int main(int argc, char **argv) {
 		//every pass through the game loop creates one frame of output
 		//  by performing three steps:
 
+		//(transient per-frame data from the previous pass is no longer in use)
+		FrameArena::current().reset();
+
 		{ //(1) process any events that are pending
 			static SDL_Event evt;
 			while (SDL_PollEvent(&evt) == 1) {
@@ -2,8 +2,10 @@
 #include "ShowSceneMode.hpp"
 #include "Load.hpp"
 #include "GL.hpp"
+#include "gl_errors.hpp"
 #include "load_save_png.hpp"
 #include "ShowSceneProgram.hpp"
+#include "FrameArena.hpp"
 
 #include <SDL.h>
 
@@ -68,6 +70,9 @@ int main(int argc, char **argv) {
 	//On windows, load OpenGL entrypoints: (does nothing on other platforms)
 	init_GL();
 
+	//report GL errors through the driver's debug output, when it has it:
+	gl_debug_output_init();
+
 	//Set VSYNC + Late Swap (prevents crazy FPS):
 	if (SDL_GL_SetSwapInterval(-1) != 0) {
 		std::cerr << "NOTE: couldn't set vsync + late swap tearing (" << SDL_GetError() << ")." << std::endl;
@@ -114,12 +119,14 @@ int main(int argc, char **argv) {
 				scene.drawables.emplace_back(transform);
 				Scene::Drawable &drawable = scene.drawables.back();
 
-				drawable.pipeline = show_scene_program_pipeline;
+				drawable.pipeline.material = scene.add_material(show_scene_program_material);
 
 				drawable.pipeline.vao = buffer_vao;
 				drawable.pipeline.type = mesh.type;
 				drawable.pipeline.start = mesh.start;
 				drawable.pipeline.count = mesh.count;
+				drawable.pipeline.index_type = mesh.index_type;
+				drawable.pipeline.shape = scene.add_shape(Scene::Shape::make(mesh));
 
 			});
 		} catch (std::exception &e) {
@@ -165,6 +172,9 @@ int main(int argc, char **argv) {
 		//every pass through the game loop creates one frame of output
 		//  by performing three steps:
 
+		//(transient per-frame data from the previous pass is no longer in use)
+		FrameArena::current().reset();
+
 		{ //(1) process any events that are pending
 			static SDL_Event evt;
 			while (SDL_PollEvent(&evt) == 1) {